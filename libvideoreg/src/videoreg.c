@@ -9,60 +9,79 @@ static videoTypeAttrs videoTypeArr[] =
 	  {".hd2",HD2},
 };
 
-static int youkuExtractID(const char *url,char *id)
+/*does the literal s start at p, with n bytes left?*/
+#define AT(p,n,s) ((size_t)(n) >= sizeof(s)-1 && memcmp((p),(s),sizeof(s)-1)==0)
+
+/*
+ * the first literal s at or after p and before end,or NULL; memchr()
+ * looks for its byte k, picked to be rare in URLs
+ */
+#define FIND(p,end,s,k) videoregFind((p),(end),(s),sizeof(s)-1,(k))
+
+static const char *videoregFind(const char *p,const char *end,const char *s,size_t n,size_t k)
 {
-    char *youkubegin;
-    char *youkuIDstart=NULL;
-    char *youkuIDend=NULL;
-    if( strstr(url,"/youku/")  &&  strstr(url,".flv?nk=") )/*?nk=ģĿǰ޷*/
-    	return 0;
-    if( strstr(url,"/youku/")  &&  strstr(url,".mp4?nk=") )/*?nk=ģĿǰ޷*/
-    	return 0;
-    if ( (youkubegin=strstr(url,"/youku/"))  && (  (youkuIDend= strstr(url,".flv") ) || (youkuIDend=strstr(url,".mp4") ) ))
-    {
-    	  //debug(20, 8) ("i am in youkuIDstart: \n");
-    	  printf("find video url\n");
-    	  youkuIDstart=youkubegin+7;
-    	  while(  (*youkuIDstart++) != '/' && *youkuIDstart !='\0') ;//ƥһ/
-        if(youkuIDend+4-youkuIDstart>1024) 
-    	  	return 0;
-        strncpy(id,youkuIDstart,youkuIDend+4-youkuIDstart);//4Ƶ׺
-        id[youkuIDend+5-youkuIDstart]='\0';
-        //debug(20, 8) ("youkuExtractID: %s \n",id);
-        return 1;
-    }
-    return 0;  
+    const char *q;
+    if((size_t)(end-p)<n)
+        return NULL;
+    for(q=p+k;(q=memchr(q,s[k],end-n+k+1-q))!=NULL;q++)
+        if(memcmp(q-k,s,n)==0)
+            return q-k;
+    return NULL;
 }
 
-static int letvExtractID(const char *url,char *id)
+/*
+ * .../youku/<dir>/<id>.flv or .mp4; the ID runs from the path component
+ * after <dir> to the end of the first video suffix.
+ */
+static int youkuExtractID(const char *url,size_t len,videoIdSpan *span)
 {
-    char *letvIDstart=NULL;
-    char *letvIDend=NULL;
+    const char *p=url;
+    const char *end=url+len;
+    const char *youkuIDstart;
+    if((p=FIND(p,end,"/youku/",4))==NULL)
+        return 0;
+    if((p=memchr(p+7,'/',end-p-7))==NULL)//ƥһ/
+        return 0;
+    youkuIDstart=++p;
+    while((p=memchr(p,'.',end-p))!=NULL && !AT(p,end-p,".flv") && !AT(p,end-p,".mp4"))
+        p++;//the first of either suffix
+    if(p==NULL)
+        return 0;
+    if(AT(p+4,end-p-4,"?nk="))/*?nk=ģĿǰ޷*/
+        return 0;
+    span->off=youkuIDstart-url;
+    span->len=p+4-youkuIDstart;//4Ƶ׺
+    return span->len<=VIDEO_ID_MAXLEN;
+}
 
-    if ( strstr(url,"/letv-uts/")  && (letvIDstart=strstr(url,"ver_")) && (letvIDend=strstr(url,".ts")) )
-     {
-        strncpy(id,letvIDstart,letvIDend-letvIDstart+3);//
-        id[letvIDend+4-letvIDstart]='\0';
-       //debug(20, 8) ("letvExtractID: %s \n",id);
-       return 1;
-     }
-     return 0;
+/*
+ * .../letv-uts/...ver_<id>.ts; the ID runs from the first "ver_" after
+ * "/letv-uts/" to the end of the first ".ts" after that, in one pass.
+ */
+static int letvExtractID(const char *url,size_t len,videoIdSpan *span)
+{
+    const char *end=url+len;
+    const char *letvIDstart;
+    const char *letvIDend;
+    if((letvIDstart=FIND(url,end,"/letv-uts/",5))==NULL)
+        return 0;
+    if((letvIDstart=FIND(letvIDstart+10,end,"ver_",3))==NULL)
+        return 0;
+    if((letvIDend=FIND(letvIDstart+4,end,".ts",2))==NULL)
+        return 0;
+    span->off=letvIDstart-url;
+    span->len=letvIDend+3-letvIDstart;
+    return span->len<=VIDEO_ID_MAXLEN;
 }
 
 pfFun pf[MAXFLAGNUM]={youkuExtractID,letvExtractID};/*A function pointer array,all video processing function register here*/
 
 /*driver table,according to flag select related func*/
-int selectFunc(const char *url,char *id,website_type_t flag )
+int selectFunc(const char *url,size_t len,videoIdSpan *span,website_type_t flag )
 {
-	int ret=0;
 	if(flag<100 || flag >999)
 		return 0;
-	if( pf[flag-100] !=NULL) 
-	{
-	   ret=pf[flag-100](url,id);
-	}
-	else{
-		printf("siteflag:%d not register\n",flag);
-	}
-	return ret;
+	if( pf[flag-100] ==NULL)
+		return 0;
+	return pf[flag-100](url,len,span);
 }
\ No newline at end of file
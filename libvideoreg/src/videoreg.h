@@ -38,16 +38,45 @@ typedef struct _videoUrlDesc
 }videoUrlDesc;
 
 
+#define VIDEO_ID_MAXLEN 1024 //longest video ID an extractor returns
+
+/*
+ * Where the video ID lies in the URL.  An extractor is given the URL
+ * and its length (it need not be NUL terminated), parses it in a single
+ * forward pass and, if it recognises a video, fills in the span and
+ * returns 1.  Otherwise it returns 0 and the span is undefined.
+ */
+typedef struct _videoIdSpan
+{
+	size_t off;//offset of the ID in the URL
+	size_t len;//length of the ID
+}videoIdSpan;
+
 typedef struct _videoProcessHandler
 {
 	int siteflag;
-	int (*handler)(const char*,char*); //callback function
+	int (*handler)(const char*,size_t,videoIdSpan*); //callback function
 }videoProcessHandler;
 
-typedef int (*pfFun)(const char*,char*);
+typedef int (*pfFun)(const char*,size_t,videoIdSpan*);
+
+/*
+ * Extractor modules are shared objects loaded by the proxy at run time.
+ * Each one exports a videoregModule named VIDEOREG_MODULE_SYMBOL whose
+ * handlers array is terminated by an entry with siteflag 0.
+ */
+#define VIDEOREG_MODULE_ABI 2
+#define VIDEOREG_MODULE_SYMBOL "videoreg_module"
+
+typedef struct _videoregModule
+{
+	int abi;//must be VIDEOREG_MODULE_ABI
+	const char *name;//module name, for logs and cachemgr
+	const videoProcessHandler *handlers;
+}videoregModule;
 
 
-int selectFunc(const char *url,char *id,website_type_t flag );
+int selectFunc(const char *url,size_t len,videoIdSpan *span,website_type_t flag );
 
 extern pfFun pf[MAXFLAGNUM];
 #endif
@@ -0,0 +1,262 @@
+/*
+ * Compare the single-pass extractors with the strstr() based ones they
+ * replaced, on URLs read one per line from a file or made up at random,
+ * and time both.  The best of -r rounds is reported.
+ *
+ *   videoreg_bench [-n count] [-s seed] [-r rounds] [urls.txt]
+ *
+ * The old extractors are kept here, returning spans instead of copying
+ * the ID.  They differ from the new ones by design where a URL has
+ * another video suffix (or for letv a ".ts") ahead of the one the new
+ * extractor picks, or a "ver_" ahead of "/letv-uts/"; those URLs are
+ * counted apart.  Any other difference is reported and makes the exit
+ * status 1.
+ *
+ * Built with "make bench"; add CFLAGS="-g -fsanitize=address,undefined"
+ * to fuzz, as the new extractors are given a copy of the URL without
+ * its terminating NUL.
+ */
+
+#include <sys/time.h>
+#include <unistd.h>
+#include "videoreg.h"
+
+static int oldYoukuExtractID(const char *url,videoIdSpan *span)
+{
+    const char *youkubegin;
+    const char *youkuIDstart=NULL;
+    const char *youkuIDend=NULL;
+    if( strstr(url,"/youku/")  &&  strstr(url,".flv?nk=") )
+	return 0;
+    if( strstr(url,"/youku/")  &&  strstr(url,".mp4?nk=") )
+	return 0;
+    if ( (youkubegin=strstr(url,"/youku/"))  && (  (youkuIDend= strstr(url,".flv") ) || (youkuIDend=strstr(url,".mp4") ) ))
+    {
+	youkuIDstart=youkubegin+7;
+	if(*youkuIDstart=='\0')/*the old loop read past the end here*/
+	    return 0;
+	while(  (*youkuIDstart++) != '/' && *youkuIDstart !='\0') ;
+	if(youkuIDend+4-youkuIDstart>1024 || youkuIDend<youkuIDstart)
+	    return 0;
+	span->off=youkuIDstart-url;
+	span->len=youkuIDend+4-youkuIDstart;
+	return 1;
+    }
+    return 0;
+}
+
+static int oldLetvExtractID(const char *url,videoIdSpan *span)
+{
+    const char *letvIDstart=NULL;
+    const char *letvIDend=NULL;
+
+    if ( strstr(url,"/letv-uts/")  && (letvIDstart=strstr(url,"ver_")) && (letvIDend=strstr(url,".ts")) )
+    {
+	if(letvIDend<letvIDstart)
+	    return 0;
+	span->off=letvIDstart-url;
+	span->len=letvIDend+3-letvIDstart;
+	return 1;
+    }
+    return 0;
+}
+
+/*number of times s occurs in url*/
+static int count(const char *url,const char *s)
+{
+    int n=0;
+    for(url=strstr(url,s);url;url=strstr(url+1,s))
+	n++;
+    return n;
+}
+
+/*does the old extractor see a different suffix than the new one can?*/
+static int differsByDesign(const char *url,website_type_t site)
+{
+    const char *ver;
+    if(site==YOUKU_VIDEO)
+	return count(url,".flv")+count(url,".mp4")>1;
+    /*the new one takes the first ver_ after /letv-uts/*/
+    ver=strstr(url,"ver_");
+    return ver && (ver<strstr(url,"/letv-uts/") || strstr(url,".ts")<ver);
+}
+
+static const char *tokens[]={
+    "/youku/","/letv-uts/","/",".flv",".mp4",".ts","?nk=","ver_","?","&","=",
+    "http://","v.example.com","abc","01","x",".","-",
+};
+
+static void randomUrl(char *url,size_t size)
+{
+    size_t n=0;
+    int k=1+rand()%12;
+    const char *t;
+    while(k-- > 0)
+    {
+	t=tokens[rand()%(sizeof(tokens)/sizeof(tokens[0]))];
+	if(n+strlen(t)>=size)
+	    break;
+	strcpy(url+n,t);
+	n+=strlen(t);
+    }
+    url[n]='\0';
+}
+
+static double now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec*1e9+tv.tv_usec*1e3;
+}
+
+static const website_type_t sites[]={YOUKU_VIDEO,LETV_VIDEO};
+static const char *keywords[]={"/youku/","/letv-uts/"};
+static int (*const old[])(const char*,videoIdSpan*)={oldYoukuExtractID,oldLetvExtractID};
+
+typedef struct {
+    const char *url;
+    size_t len;
+    int site;
+} benchCall;
+
+/*the best of rounds runs of calls through the old and the new extractors*/
+static void timeCalls(const benchCall *calls,size_t n,int rounds,double *told,double *tnew)
+{
+    videoIdSpan span;
+    double t0,t;
+    size_t i;
+    int r;
+    *told=*tnew=0;
+    for(r=0;r<rounds;r++)
+    {
+	t0=now();
+	for(i=0;i<n;i++)
+	    old[calls[i].site](calls[i].url,&span);
+	t=now()-t0;
+	if(!r || t<*told)
+	    *told=t;
+	t0=now();
+	for(i=0;i<n;i++)
+	    selectFunc(calls[i].url,calls[i].len,&span,sites[calls[i].site]);
+	t=now()-t0;
+	if(!r || t<*tnew)
+	    *tnew=t;
+    }
+}
+
+int main(int argc,char *argv[])
+{
+    char **urls=NULL;
+    size_t *lens=NULL;
+    size_t nurls=0,size=0,i,j;
+    long n=1000000;
+    char line[4096];
+    FILE *fp=NULL;
+    videoIdSpan a,b;
+    int ra,rb,c,rounds=5;
+    long found=0,design=0,bad=0;
+    double told,tnew;
+    benchCall *calls;
+    size_t ncalls=0;
+
+    srand(1);
+    while((c=getopt(argc,argv,"n:s:r:"))!=-1)
+    {
+	switch(c)
+	{
+	case 'n': n=atol(optarg); break;
+	case 's': srand(atoi(optarg)); break;
+	case 'r': rounds=atoi(optarg); break;
+	default:
+	    fprintf(stderr,"usage: %s [-n count] [-s seed] [-r rounds] [urls.txt]\n",argv[0]);
+	    return 1;
+	}
+    }
+    if(optind<argc && (fp=fopen(argv[optind],"r"))==NULL)
+    {
+	perror(argv[optind]);
+	return 1;
+    }
+    for(;;)
+    {
+	if(fp)
+	{
+	    if(!fgets(line,sizeof(line),fp))
+		break;
+	    line[strcspn(line,"\r\n")]='\0';
+	}
+	else
+	{
+	    if(nurls==(size_t)n)
+		break;
+	    randomUrl(line,sizeof(line));
+	}
+	if(nurls==size)
+	{
+	    size=size?size*2:1024;
+	    urls=realloc(urls,size*sizeof(*urls));
+	    lens=realloc(lens,size*sizeof(*lens));
+	}
+	lens[nurls]=strlen(line);
+	urls[nurls++]=strdup(line);
+    }
+    if(fp)
+	fclose(fp);
+
+    for(i=0;i<nurls;i++)
+    {
+	for(j=0;j<sizeof(sites)/sizeof(sites[0]);j++)
+	{
+	    size_t len=lens[i];
+	    /*the new extractors must not read past len*/
+	    char *copy=malloc(len?len:1);
+	    memcpy(copy,urls[i],len);
+	    ra=old[j](urls[i],&a);
+	    rb=selectFunc(copy,len,&b,sites[j]);
+	    free(copy);
+	    if(ra==rb && (!ra || (a.off==b.off && a.len==b.len)))
+	    {
+		found+=ra;
+		continue;
+	    }
+	    if(differsByDesign(urls[i],sites[j]))
+	    {
+		design++;
+		continue;
+	    }
+	    printf("MISMATCH site %d %s: old %d %.*s, new %d %.*s\n",sites[j],urls[i],
+		ra,ra?(int)a.len:0,ra?urls[i]+a.off:"",
+		rb,rb?(int)b.len:0,rb?urls[i]+b.off:"");
+	    bad++;
+	}
+    }
+
+    /*every URL through both extractors, and what Squid does: only the
+      URLs holding the keyword of the extractor's site*/
+    calls=calloc(2*nurls+1,sizeof(*calls));
+    for(i=0;i<nurls;i++)
+	for(j=0;j<2;j++)
+	{
+	    calls[ncalls].url=urls[i];
+	    calls[ncalls].len=lens[i];
+	    calls[ncalls++].site=j;
+	}
+    timeCalls(calls,ncalls,rounds,&told,&tnew);
+    printf("%lu URLs: %ld IDs, %ld differ by design, %ld mismatches\n",
+	(unsigned long)nurls,found,design,bad);
+    printf("all URLs:     old %.1f ns/call, new %.1f ns/call, %lu calls\n",
+	ncalls?told/ncalls:0.0,ncalls?tnew/ncalls:0.0,(unsigned long)ncalls);
+    for(i=j=0;i<ncalls;i++)
+	if(strstr(calls[i].url,keywords[calls[i].site]))
+	    calls[j++]=calls[i];
+    ncalls=j;
+    timeCalls(calls,ncalls,rounds,&told,&tnew);
+    printf("keyword hits: old %.1f ns/call, new %.1f ns/call, %lu calls\n",
+	ncalls?told/ncalls:0.0,ncalls?tnew/ncalls:0.0,(unsigned long)ncalls);
+    free(calls);
+    for(i=0;i<nurls;i++)
+	free(urls[i]);
+    free(urls);
+    free(lens);
+    return bad?1:0;
+}
@@ -288,8 +288,9 @@ httpHdrRangePackInto(const HttpHdrRange * range, Packer * p)
     HttpHdrRangePos pos = HttpHdrRangeInitPos;
     const HttpHdrRangeSpec *spec;
     assert(range);
+    packerAppend(p, "bytes=", 6);
     while ((spec = httpHdrRangeGetSpec(range, &pos))) {
-	if (pos != HttpHdrRangeInitPos)
+	if (pos != HttpHdrRangeInitPos + 1)
 	    packerAppend(p, ",", 1);
 	httpHdrRangeSpecPackInto(spec, p);
     }
@@ -467,7 +468,7 @@ httpHdrRangeBoundaryStr(clientHttpRequest * http)
     assert(http);
     stringAppend(&b, full_appname_string, strlen(full_appname_string));
     stringAppend(&b, ":", 1);
-    key = storeKeyText(http->entry->hash.key);
+    key = storeKeyText(http->entry->key);
     stringAppend(&b, key, strlen(key));
     return b;
 }
@@ -142,6 +142,19 @@ static const HttpHeaderFieldAttrs HeadersAttrs[] =
 };
 static HttpHeaderFieldInfo *Headers = NULL;
 
+/*
+ * Perfect hash of the known header names, so a parsed field name is
+ * compared against one candidate only.  The hash mixes the length and
+ * five characters of the name; the seed is searched for at startup
+ * until no two names share a slot, and the table is checked against
+ * Headers[] before it is used.  Squid does not start without one, so
+ * a header name added to HeadersAttrs that defeats the hash is seen
+ * at once: raise HDR_ID_HASH_SIZE or change the characters mixed in.
+ */
+#define HDR_ID_HASH_SIZE 512
+static unsigned char HeaderIdHash[HDR_ID_HASH_SIZE];
+static unsigned int HeaderIdSeed = 0;
+
 /*
  * headers with field values defined as #(values) in HTTP/1.1
  * Headers that are currently not recognized, are commented out.
@@ -247,9 +260,16 @@ static int HeaderEntryParsedCount = 0;
 static HttpHeaderEntry *httpHeaderEntryCreate(http_hdr_type id, const char *name, const char *value);
 static HttpHeaderEntry *httpHeaderEntryCreate2(http_hdr_type id, String name, String value);
 static void httpHeaderEntryDestroy(HttpHeaderEntry * e);
-static HttpHeaderEntry *httpHeaderEntryParseCreate(const char *field_start, const char *field_end);
+static HttpHeaderEntry *httpHeaderEntryParseCreate(HttpHeaderBlock * block, const char *field_start, const char *field_end);
+static HttpHeaderBlock *httpHeaderBlockCreate(int capacity);
+static void httpHeaderBlockSlice(HttpHeaderBlock * block, String * s, const char *str, int len);
+static void httpHeaderBlockUnlock(HttpHeaderBlock * block);
+static int httpHeaderParseFields(HttpHeader * hdr, HttpHeaderBlock * block, const char *header_start, const char *header_end);
 static void httpHeaderNoteParsedEntry(http_hdr_type id, String value, int error);
 
+static void httpHeaderFieldsInit(void);
+static int httpHeaderIdLookup(const char *name, int name_len);
+
 static void httpHeaderStatInit(HttpHeaderStat * hs, const char *label);
 static void httpHeaderStatDump(const HttpHeaderStat * hs, StoreEntry * e);
 
@@ -266,7 +286,7 @@ httpHeaderInitModule(void)
     /* all headers must be described */
     assert(countof(HeadersAttrs) == HDR_ENUM_END);
     if (!Headers)
-	Headers = httpHeaderBuildFieldsInfo(HeadersAttrs, HDR_ENUM_END);
+	httpHeaderFieldsInit();
     /* create masks */
     httpHeaderMaskInit(&ListHeadersMask, 0);
     httpHeaderCalcMask(&ListHeadersMask, ListHeadersArr, countof(ListHeadersArr));
@@ -299,9 +319,77 @@ httpHeaderCleanModule(void)
 {
     httpHeaderDestroyFieldsInfo(Headers, HDR_ENUM_END);
     Headers = NULL;
+    HeaderIdSeed = 0;
     httpHdrCcCleanModule();
 }
 
+/*
+ * Header names are tokens, so or-ing in 0x20 lowercases them without a
+ * table lookup.  Other characters may alias, which the final compare
+ * in httpHeaderIdLookup() catches.
+ */
+static unsigned int
+httpHeaderIdHash(const char *name, int len, unsigned int seed)
+{
+    unsigned int h = len;
+    h = h * seed + (name[0] | 0x20);
+    h = h * seed + (name[len >> 2] | 0x20);
+    h = h * seed + (name[len >> 1] | 0x20);
+    h = h * seed + (name[(3 * len) >> 2] | 0x20);
+    h = h * seed + (name[len - 1] | 0x20);
+    return (h ^ (h >> 7)) & (HDR_ID_HASH_SIZE - 1);
+}
+
+static void
+httpHeaderFieldsInit(void)
+{
+    unsigned int seed;
+    int i;
+    Headers = httpHeaderBuildFieldsInfo(HeadersAttrs, HDR_ENUM_END);
+    assert(HDR_ENUM_END < 256);
+    for (seed = 1; seed < 65536; seed++) {
+	memset(HeaderIdHash, HDR_ENUM_END, sizeof(HeaderIdHash));
+	for (i = 0; i < HDR_ENUM_END; i++) {
+	    unsigned int h = httpHeaderIdHash(strBuf(Headers[i].name), strLen(Headers[i].name), seed);
+	    if (HeaderIdHash[h] != HDR_ENUM_END)
+		break;
+	    HeaderIdHash[h] = i;
+	}
+	if (i == HDR_ENUM_END)
+	    break;
+    }
+    if (seed == 65536)
+	fatalf("httpHeaderFieldsInit: no perfect hash for the %d HTTP header names in %d slots\n",
+	    HDR_ENUM_END, HDR_ID_HASH_SIZE);
+    HeaderIdSeed = seed;
+    debug(55, 2) ("httpHeaderFieldsInit: header name hash seed %u\n", seed);
+    /* every name, in any case, must come back as its own id */
+    for (i = 0; i < HDR_ENUM_END; i++) {
+	LOCAL_ARRAY(char, name, 64);
+	int len = strLen(Headers[i].name);
+	int k;
+	assert(len < 64);
+	assert(httpHeaderIdLookup(strBuf(Headers[i].name), len) == i);
+	for (k = 0; k < len; k++)
+	    name[k] = xtoupper(strBuf(Headers[i].name)[k]);
+	assert(httpHeaderIdLookup(name, len) == i);
+    }
+}
+
+static int
+httpHeaderIdLookup(const char *name, int name_len)
+{
+    int id;
+    if (!HeaderIdSeed || name_len <= 0)
+	return httpHeaderIdByName(name, name_len, Headers, HDR_ENUM_END);
+    id = HeaderIdHash[httpHeaderIdHash(name, name_len, HeaderIdSeed)];
+    if (id == HDR_ENUM_END || strLen(Headers[id].name) != name_len)
+	return -1;
+    if (strncasecmp(name, strBuf(Headers[id].name), name_len) != 0)
+	return -1;
+    return id;
+}
+
 static void
 httpHeaderStatInit(HttpHeaderStat * hs, const char *label)
 {
@@ -448,15 +536,32 @@ httpHeaderReset(HttpHeader * hdr)
     return 0;
 }
 
+/*
+ * The names and values of the parsed fields are not allocated one by
+ * one.  They are packed into a single block sized for the whole header,
+ * which the entries share and which goes away with the last of them.
+ */
 int
 httpHeaderParse(HttpHeader * hdr, const char *header_start, const char *header_end)
 {
-    const char *field_ptr = header_start;
-    HttpHeaderEntry *e;
+    HttpHeaderBlock *block;
+    int result;
 
     assert(hdr);
     assert(header_start && header_end);
     debug(55, 7) ("parsing hdr: (%p)\n%s\n", hdr, getStringPrefix(header_start, header_end));
+    block = httpHeaderBlockCreate(header_end - header_start + 1);
+    result = httpHeaderParseFields(hdr, block, header_start, header_end);
+    httpHeaderBlockUnlock(block);
+    return result;
+}
+
+static int
+httpHeaderParseFields(HttpHeader * hdr, HttpHeaderBlock * block, const char *header_start, const char *header_end)
+{
+    const char *field_ptr = header_start;
+    HttpHeaderEntry *e;
+
     HttpHeaderStats[hdr->owner].parsedCount++;
     if (memchr(header_start, '\0', header_end - header_start)) {
 	debug(55, 1) ("WARNING: HTTP header contains NULL characters {%s}\n",
@@ -509,7 +614,7 @@ httpHeaderParse(HttpHeader * hdr, const char *header_start, const char *header_e
 	    }
 	    break;		/* terminating blank line */
 	}
-	e = httpHeaderEntryParseCreate(field_start, field_end);
+	e = httpHeaderEntryParseCreate(block, field_start, field_end);
 	if (NULL == e) {
 	    debug(55, 1) ("WARNING: unparseable HTTP header field {%s}\n",
 		getStringPrefix(field_start, field_end));
@@ -1215,6 +1320,7 @@ httpHeaderEntryCreate(http_hdr_type id, const char *name, const char *value)
     else
 	stringInit(&e->name, name);
     stringInit(&e->value, value);
+    e->block = NULL;
     Headers[id].stat.aliveCount++;
     debug(55, 9) ("created entry %p: '%s: %s'\n", e, strBuf(e->name), strBuf(e->value));
     return e;
@@ -1232,6 +1338,7 @@ httpHeaderEntryCreate2(http_hdr_type id, String name, String value)
     else
 	stringLimitInit(&e->name, strBuf(name), strLen(name));
     stringLimitInit(&e->value, strBuf(value), strLen(value));
+    e->block = NULL;
     Headers[id].stat.aliveCount++;
     debug(55, 9) ("created entry %p: '%s: %s'\n", e, strBuf(e->name), strBuf(e->value));
     return e;
@@ -1247,6 +1354,8 @@ httpHeaderEntryDestroy(HttpHeaderEntry * e)
     if (e->id == HDR_OTHER)
 	stringClean(&e->name);
     stringClean(&e->value);
+    if (e->block)
+	httpHeaderBlockUnlock(e->block);
     assert(Headers[e->id].stat.aliveCount);
     Headers[e->id].stat.aliveCount--;
     e->id = -1;
@@ -1255,7 +1364,7 @@ httpHeaderEntryDestroy(HttpHeaderEntry * e)
 
 /* parses and inits header entry, returns new entry on success */
 static HttpHeaderEntry *
-httpHeaderEntryParseCreate(const char *field_start, const char *field_end)
+httpHeaderEntryParseCreate(HttpHeaderBlock * block, const char *field_start, const char *field_end)
 {
     HttpHeaderEntry *e;
     int id;
@@ -1287,14 +1396,14 @@ httpHeaderEntryParseCreate(const char *field_start, const char *field_end)
     e = memAllocate(MEM_HTTP_HDR_ENTRY);
     debug(55, 9) ("creating entry %p: near '%s'\n", e, getStringPrefix(field_start, field_end));
     /* is it a "known" field? */
-    id = httpHeaderIdByName(field_start, name_len, Headers, HDR_ENUM_END);
+    id = httpHeaderIdLookup(field_start, name_len);
     if (id < 0)
 	id = HDR_OTHER;
     assert_eid(id);
     e->id = id;
     /* set field name */
     if (id == HDR_OTHER)
-	stringLimitInit(&e->name, field_start, name_len);
+	httpHeaderBlockSlice(block, &e->name, field_start, name_len);
     else
 	e->name = Headers[id].name;
     /* trim field value */
@@ -1306,13 +1415,13 @@ httpHeaderEntryParseCreate(const char *field_start, const char *field_end)
 	/* String must be LESS THAN 64K and it adds a terminating NULL */
 	debug(55, 1) ("WARNING: ignoring '%s' header of %d bytes\n",
 	    strBuf(e->name), (int) (field_end - value_start));
-	if (e->id == HDR_OTHER)
-	    stringClean(&e->name);
 	memFree(e, MEM_HTTP_HDR_ENTRY);
 	return NULL;
     }
     /* set field value */
-    stringLimitInit(&e->value, value_start, field_end - value_start);
+    httpHeaderBlockSlice(block, &e->value, value_start, field_end - value_start);
+    e->block = block;
+    block->refcount++;
     Headers[id].stat.seenCount++;
     Headers[id].stat.aliveCount++;
     debug(55, 9) ("created entry %p: '%s: %s'\n", e, strBuf(e->name), strBuf(e->value));
@@ -1322,7 +1431,65 @@ httpHeaderEntryParseCreate(const char *field_start, const char *field_end)
 HttpHeaderEntry *
 httpHeaderEntryClone(const HttpHeaderEntry * e)
 {
-    return httpHeaderEntryCreate2(e->id, e->name, e->value);
+    HttpHeaderEntry *clone;
+    if (!e->block || !strBorrowed(e->value) || (e->id == HDR_OTHER && !strBorrowed(e->name)))
+	return httpHeaderEntryCreate2(e->id, e->name, e->value);
+    /* still as parsed, share the block */
+    clone = memAllocate(MEM_HTTP_HDR_ENTRY);
+    clone->id = e->id;
+    clone->name = e->name;
+    clone->value = e->value;
+    clone->block = e->block;
+    clone->block->refcount++;
+    Headers[clone->id].stat.aliveCount++;
+    return clone;
+}
+
+/*
+ * HttpHeaderBlock
+ */
+
+/* reply headers fit the string pools; large requests use the buffer pools */
+#define HDR_BLOCK_STRING_MAX 512
+
+static HttpHeaderBlock *
+httpHeaderBlockCreate(int capacity)
+{
+    HttpHeaderBlock *block;
+    size_t size = sizeof(*block) + capacity;
+    if (size <= HDR_BLOCK_STRING_MAX)
+	block = memAllocString(size, &size);
+    else
+	block = memAllocBuf(size, &size);
+    block->refcount = 1;
+    block->size = size;
+    block->capacity = capacity;
+    block->used = 0;
+    block->buf = (char *) (block + 1);
+    return block;
+}
+
+/* copies str into the block and makes s a slice of it */
+static void
+httpHeaderBlockSlice(HttpHeaderBlock * block, String * s, const char *str, int len)
+{
+    char *buf = block->buf + block->used;
+    assert(block->used + len < block->capacity);
+    xmemcpy(buf, str, len);
+    stringInitSlice(s, buf, len);
+    block->used += len + 1;
+}
+
+static void
+httpHeaderBlockUnlock(HttpHeaderBlock * block)
+{
+    assert(block->refcount > 0);
+    if (--block->refcount > 0)
+	return;
+    if (block->size <= HDR_BLOCK_STRING_MAX)
+	memFreeString(block->size, block);
+    else
+	memFreeBuf(block->size, block);
 }
 
 void
@@ -1463,15 +1630,15 @@ int
 httpHeaderIdByNameDef(const char *name, int name_len)
 {
     if (!Headers)
-	Headers = httpHeaderBuildFieldsInfo(HeadersAttrs, HDR_ENUM_END);
-    return httpHeaderIdByName(name, name_len, Headers, HDR_ENUM_END);
+	httpHeaderFieldsInit();
+    return httpHeaderIdLookup(name, name_len);
 }
 
 const char *
 httpHeaderNameById(int id)
 {
     if (!Headers)
-	Headers = httpHeaderBuildFieldsInfo(HeadersAttrs, HDR_ENUM_END);
+	httpHeaderFieldsInit();
     assert(id >= 0 && id < HDR_ENUM_END);
     return strBuf(Headers[id].name);
 }
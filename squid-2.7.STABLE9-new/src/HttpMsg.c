@@ -202,27 +202,20 @@ httpMsgParseRequestLine(HttpMsgBuf * hmsg)
     }
     hmsg->u_start = i;
 
-    /* Find \r\n or \n - thats the end of the line. Keep track of the last whitespace! */
-    for (; i <= hmsg->req_end; i++) {
-	/* If \n - its end of line */
-	if (hmsg->buf[i] == '\n') {
-	    line_end = i;
-	    break;
-	}
-	/* we know for sure that there is at least a \n following.. */
-	if (hmsg->buf[i] == '\r' && hmsg->buf[i + 1] == '\n') {
-	    line_end = i;
-	    break;
-	}
-	/* If its a whitespace, note it as it'll delimit our version */
+    /*
+     * The line ends at \r\n or \n, and req_end is the first \n. The
+     * last whitespace delimits the version, so look for it from the
+     * end of the line rather than walking the whole URL.
+     */
+    line_end = hmsg->req_end;
+    if (hmsg->buf[line_end - 1] == '\r')
+	line_end--;
+    for (i = line_end - 1; i > hmsg->u_start; i--) {
 	if (hmsg->buf[i] == ' ' || hmsg->buf[i] == '\t') {
 	    last_whitespace = i;
+	    break;
 	}
     }
-    if (i > hmsg->req_end) {
-	retcode = -1;
-	goto finish;
-    }
     /* At this point we don't need the 'i' value; so we'll recycle it for version parsing */
 
     /* 
@@ -310,58 +303,28 @@ httpMsgParseRequestLine(HttpMsgBuf * hmsg)
 }
 
 /*
- * A temporary replacement for headersEnd() in this codebase.
- * This routine searches for the end of the headers in a HTTP request
- * (obviously anything > HTTP/0.9.)
+ * Find the end of the headers in a HTTP request (obviously anything
+ * > HTTP/0.9) and note where the header block ends.
  *
  * It returns buffer length on success or 0 on failure.
  */
 int
 httpMsgFindHeadersEnd(HttpMsgBuf * hmsg)
 {
-    int e = 0;
-    int state = 1;
     const char *mime = hmsg->buf;
-    int l = hmsg->size;
-    int he = -1;
+    int e, blank;
 
     /* Always succeed HTTP/0.9 - it means we've already parsed the buffer for the request */
     if (hmsg->v_maj == 0 && hmsg->v_min == 9)
 	return 1;
 
-    while (e < l && state < 3) {
-	switch (state) {
-	case 0:
-	    if ('\n' == mime[e]) {
-		he = e;
-		state = 1;
-	    }
-	    break;
-	case 1:
-	    if ('\r' == mime[e])
-		state = 2;
-	    else if ('\n' == mime[e])
-		state = 3;
-	    else
-		state = 0;
-	    break;
-	case 2:
-	    if ('\n' == mime[e])
-		state = 3;
-	    else
-		state = 0;
-	    break;
-	default:
-	    break;
-	}
-	e++;
-    }
-    if (3 == state) {
-	hmsg->h_end = he;
-	hmsg->h_start = hmsg->req_end + 1;
-	hmsg->h_len = hmsg->h_end - hmsg->h_start;
-	return e;
-    }
-    return 0;
-
+    e = headersEnd(mime, hmsg->size);
+    if (!e)
+	return 0;
+    /* the terminating blank line is either "\n" or "\r\n" */
+    blank = (e >= 2 && mime[e - 2] == '\r') ? e - 2 : e - 1;
+    hmsg->h_end = blank - 1;
+    hmsg->h_start = hmsg->req_end + 1;
+    hmsg->h_len = hmsg->h_end - hmsg->h_start;
+    return e;
 }
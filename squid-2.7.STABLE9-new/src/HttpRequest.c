@@ -61,6 +61,7 @@ requestDestroy(request_t * req)
 	authenticateAuthUserRequestUnlock(req->auth_user_request);
     safe_free(req->store_url);
     safe_free(req->canonical);
+    safe_free(req->video.id);
     safe_free(req->vary_hdr);
     safe_free(req->vary_headers);
     stringClean(&req->vary_encoding);
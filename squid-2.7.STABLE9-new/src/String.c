@@ -63,6 +63,22 @@ stringLimitInit(String * s, const char *str, int len)
     s->buf[len] = '\0';
 }
 
+/*
+ * Makes s refer to len bytes of a buffer owned by someone else, which
+ * must outlive it.  The byte after the slice is overwritten with a
+ * terminating '\0'.  Such a string is copied as soon as it grows.
+ */
+void
+stringInitSlice(String * s, char *str, int len)
+{
+    assert(s && str);
+    assert(len < 65536);
+    s->size = 0;
+    s->len = len;
+    s->buf = str;
+    s->buf[len] = '\0';
+}
+
 String
 stringDup(const String * s)
 {
@@ -76,7 +92,7 @@ void
 stringClean(String * s)
 {
     assert(s);
-    if (s->buf)
+    if (s->buf && s->size)
 	memFreeString(s->size, s->buf);
     *s = StringNull;
 }
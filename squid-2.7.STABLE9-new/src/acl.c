@@ -53,7 +53,7 @@ static struct _acl *aclFindByName(const char *name);
 static int aclMatchAcl(struct _acl *, aclCheck_t *);
 static int aclMatchTime(acl_time_data * data, time_t when);
 static int aclMatchUser(void *proxyauth_acl, char *user);
-static int aclMatchIp(void *dataptr, struct in_addr c);
+static int aclMatchIp(const acl_ip_list * L, struct in_addr c);
 static int aclMatchDomainList(void *dataptr, const char *);
 static int aclMatchIntegerRange(intrange * data, int i);
 static int aclMatchWordList(wordlist *, const char *);
@@ -75,7 +75,7 @@ static IPH aclLookupDstIPforASNDone;
 static FQDNH aclLookupSrcFQDNDone;
 static FQDNH aclLookupDstFQDNDone;
 static EAH aclLookupExternalDone;
-static wordlist *aclDumpIpList(void *);
+static wordlist *aclDumpIpList(acl_ip_list *);
 static wordlist *aclDumpDomainList(void *data);
 static wordlist *aclDumpTimeSpecList(acl_time_data *);
 static wordlist *aclDumpRegexList(relist * data);
@@ -90,6 +90,7 @@ static SPLAYCMP aclDomainCompare;
 static SPLAYWALKEE aclDumpIpListWalkee;
 static SPLAYWALKEE aclDumpDomainListWalkee;
 static SPLAYFREE aclFreeIpData;
+static void aclFreeIpList(acl_ip_list *);
 
 #if USE_ARP_ACL
 static void aclParseArpList(void *curlist);
@@ -563,13 +564,15 @@ static void
 aclParseIpList(void *curlist)
 {
     char *t = NULL;
-    splayNode **Top = curlist;
+    acl_ip_list **L = curlist;
     acl_ip_data *q = NULL;
+    if (*L == NULL)
+	*L = memAllocate(MEM_ACL_IP_LIST);
     while ((t = strtokFile())) {
 	acl_ip_data *next;
 	for (q = aclParseIpData(t); q != NULL; q = next) {
 	    next = q->next;
-	    *Top = splay_insert(q, *Top, aclIpNetworkCompare);
+	    (*L)->tree = splay_insert(q, (*L)->tree, aclIpNetworkCompare);
 	    if (splayLastResult == 0)
 		xfree(q);
 	}
@@ -1301,28 +1304,161 @@ aclParseAclList(acl_list ** head)
 /* aclMatchIp */
 /**************/
 
+/*
+ * Lists compiled to at least this many ranges get a /16 index in
+ * front of the binary search.
+ */
+#define ACL_IP_INDEX_MIN 64
+
 static int
-aclMatchIp(void *dataptr, struct in_addr c)
+aclIpRangeCompare(const void *a, const void *b)
 {
-    splayNode **Top = dataptr;
-    acl_ip_data x;
-    /*
-     * aclIpAddrNetworkCompare() takes two acl_ip_data pointers as
-     * arguments, so we must create a fake one for the client's IP
-     * address, and use a /32 netmask.  However, the current code
-     * probably only accesses the addr1 element of this argument,
-     * so it might be possible to leave addr2 and mask unset.
-     * XXX Could eliminate these repetitive assignments with a
-     * static structure.
-     */
-    x.addr1 = c;
-    x.addr2 = any_addr;
-    x.mask = no_addr;
-    x.next = NULL;
-    *Top = splay_splay(&x, *Top, aclIpAddrNetworkCompare);
+    const u_int32_t *p = a;
+    const u_int32_t *q = b;
+    if (p[0] != q[0])
+	return p[0] < q[0] ? -1 : 1;
+    return 0;
+}
+
+typedef struct {
+    acl_ip_list *list;
+    u_int32_t *ranges;		/* lo, hi pairs */
+    int n;
+    int size;
+} aclIpCompileState;
+
+static void
+aclIpCompileWalkee(void *node, void *state)
+{
+    acl_ip_data *q = node;
+    aclIpCompileState *S = state;
+    acl_ip_list *L = S->list;
+    u_int32_t host = ~ntohl(q->mask.s_addr);
+    u_int32_t lo = ntohl(q->addr1.s_addr);
+    u_int32_t hi = q->addr2.s_addr ? ntohl(q->addr2.s_addr) : lo;
+    if (host & (host + 1)) {
+	/* the netmask is not a prefix, so the entry is no single range */
+	L->odd = xrealloc(L->odd, (L->nodd + 1) * sizeof(*L->odd));
+	L->odd[L->nodd++] = q;
+	return;
+    }
+    /* addr1 and addr2 are already masked */
+    hi |= host;
+    if (lo > hi)
+	return;
+    if (S->n == S->size) {
+	S->size = S->size ? S->size * 2 : 16;
+	S->ranges = xrealloc(S->ranges, S->size * 2 * sizeof(u_int32_t));
+    }
+    S->ranges[S->n * 2] = lo;
+    S->ranges[S->n * 2 + 1] = hi;
+    S->n++;
+}
+
+/*
+ * Turn the configured entries into sorted, disjoint address ranges.
+ * Overlapping and adjacent ranges are merged.
+ */
+static void
+aclIpListCompile(acl_ip_list * L)
+{
+    aclIpCompileState S;
+    int i, j;
+    memset(&S, '\0', sizeof(S));
+    S.list = L;
+    safe_free(L->lo);
+    safe_free(L->hi);
+    safe_free(L->index);
+    safe_free(L->odd);
+    L->nranges = L->nodd = 0;
+    splay_walk(L->tree, aclIpCompileWalkee, &S);
+    qsort(S.ranges, S.n, 2 * sizeof(u_int32_t), aclIpRangeCompare);
+    L->lo = xcalloc(S.n + 1, sizeof(u_int32_t));
+    L->hi = xcalloc(S.n + 1, sizeof(u_int32_t));
+    for (i = 0, j = -1; i < S.n; i++) {
+	u_int32_t lo = S.ranges[i * 2];
+	u_int32_t hi = S.ranges[i * 2 + 1];
+	if (j >= 0 && (L->hi[j] == 0xFFFFFFFFU || lo <= L->hi[j] + 1)) {
+	    if (hi > L->hi[j])
+		L->hi[j] = hi;
+	    continue;
+	}
+	j++;
+	L->lo[j] = lo;
+	L->hi[j] = hi;
+    }
+    L->nranges = j + 1;
+    safe_free(S.ranges);
+    if (L->nranges >= ACL_IP_INDEX_MIN) {
+	L->index = xcalloc(65537, sizeof(int));
+	for (i = 0, j = 0; i < 65536; i++) {
+	    while (j < L->nranges && L->hi[j] < ((u_int32_t) i << 16))
+		j++;
+	    L->index[i] = j;
+	}
+	L->index[65536] = L->nranges;
+    }
+    debug(28, 3) ("aclIpListCompile: %d ranges, %d odd entries%s\n",
+	L->nranges, L->nodd, L->index ? ", indexed" : "");
+}
+
+/*
+ * Compile the address lists of all src, dst and myip ACLs. Called
+ * once the configuration has been read.
+ */
+void
+aclConfigure(void)
+{
+    acl *a;
+    for (a = Config.aclList; a; a = a->next) {
+	switch (a->type) {
+	case ACL_SRC_IP:
+	case ACL_DST_IP:
+	case ACL_MY_IP:
+	    if (a->data)
+		aclIpListCompile(a->data);
+	    break;
+	default:
+	    break;
+	}
+    }
+}
+
+static int
+aclMatchIp(const acl_ip_list * L, struct in_addr c)
+{
+    u_int32_t a = ntohl(c.s_addr);
+    int lo = 0;
+    int hi;
+    int i;
+    int found = 0;
+    if (L == NULL)
+	return 0;
+    hi = L->nranges;
+    if (L->index) {
+	lo = L->index[a >> 16];
+	if (hi > L->index[(a >> 16) + 1] + 1)
+	    hi = L->index[(a >> 16) + 1] + 1;
+    }
+    /* find the first range starting above a; the one before may hold it */
+    while (lo < hi) {
+	int mid = (lo + hi) / 2;
+	if (L->lo[mid] <= a)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    if (lo > 0 && a <= L->hi[lo - 1])
+	found = 1;
+    for (i = 0; !found && i < L->nodd; i++) {
+	acl_ip_data x;
+	x.addr1 = c;
+	if (aclIpAddrNetworkCompare(&x, L->odd[i]) == 0)
+	    found = 1;
+    }
     debug(28, 3) ("aclMatchIp: '%s' %s\n",
-	inet_ntoa(c), splayLastResult ? "NOT found" : "found");
-    return !splayLastResult;
+	inet_ntoa(c), found ? "found" : "NOT found");
+    return found;
 }
 
 /**********************/
@@ -1342,13 +1478,43 @@ aclMatchDomainList(void *dataptr, const char *host)
     return !splayLastResult;
 }
 
+/*
+ * Lists with at least this many patterns are matched through a
+ * RegexSet instead of trying each pattern in turn.
+ */
+#define ACL_REGEX_SET_MIN 4
+
+static void
+aclRegexSetBuild(relist * data)
+{
+    relist *r;
+    int n = 0;
+    for (r = data; r && n < ACL_REGEX_SET_MIN; r = r->next)
+	n++;
+    if (n < ACL_REGEX_SET_MIN)
+	return;
+    data->set = regexSetCreate();
+    for (r = data; r; r = r->next)
+	regexSetAdd(data->set, r->pattern, &r->regex, r);
+    regexSetCompile(data->set);
+}
+
 int
 aclMatchRegex(relist * data, const char *word)
 {
     relist *first, *prev;
-    if (word == NULL)
+    if (word == NULL || data == NULL)
 	return 0;
     debug(28, 3) ("aclMatchRegex: checking '%s'\n", word);
+    if (data->set == NULL && data->next)
+	aclRegexSetBuild(data);
+    if (data->set) {
+	relist *r = regexSetMatch(data->set, word);
+	if (r == NULL)
+	    return 0;
+	debug(28, 2) ("aclMatchRegex: match '%s' found in '%s'\n", r->pattern, word);
+	return 1;
+    }
     first = data;
     prev = NULL;
     while (data) {
@@ -1792,16 +1958,16 @@ aclMatchAcl(acl * ae, aclCheck_t * checklist)
     debug(28, 3) ("aclMatchAcl: checking '%s'\n", ae->cfgline);
     switch (ae->type) {
     case ACL_SRC_IP:
-	return aclMatchIp(&ae->data, checklist->src_addr);
+	return aclMatchIp(ae->data, checklist->src_addr);
 	/* NOTREACHED */
     case ACL_MY_IP:
-	return aclMatchIp(&ae->data, checklist->my_addr);
+	return aclMatchIp(ae->data, checklist->my_addr);
 	/* NOTREACHED */
     case ACL_DST_IP:
 	ia = ipcache_gethostbyname(r->host, IP_LOOKUP_IF_MISS);
 	if (ia) {
 	    for (k = 0; k < (int) ia->count; k++) {
-		if (aclMatchIp(&ae->data, ia->in_addrs[k]))
+		if (aclMatchIp(ae->data, ia->in_addrs[k]))
 		    return 1;
 	    }
 	    return 0;
@@ -2474,6 +2640,8 @@ void
 aclDestroyRegexList(relist * data)
 {
     relist *next = NULL;
+    if (data && data->set)
+	regexSetDestroy(data->set);
     for (; data; data = next) {
 	next = data->next;
 	regfree(&data->regex);
@@ -2488,6 +2656,19 @@ aclFreeIpData(void *p)
     memFree(p, MEM_ACL_IP_DATA);
 }
 
+static void
+aclFreeIpList(acl_ip_list * L)
+{
+    if (L == NULL)
+	return;
+    splay_destroy(L->tree, aclFreeIpData);
+    safe_free(L->lo);
+    safe_free(L->hi);
+    safe_free(L->index);
+    safe_free(L->odd);
+    memFree(L, MEM_ACL_IP_LIST);
+}
+
 static void
 aclFreeUserData(void *data)
 {
@@ -2515,7 +2696,7 @@ aclDestroyAcls(acl ** head)
 	case ACL_SRC_IP:
 	case ACL_DST_IP:
 	case ACL_MY_IP:
-	    splay_destroy(a->data, aclFreeIpData);
+	    aclFreeIpList(a->data);
 	    break;
 #if USE_ARP_ACL
 	case ACL_SRC_ARP:
@@ -2800,7 +2981,8 @@ aclIpNetworkCompare(const void *a, const void *b)
  * matching checks.  The first argument (a) is a "host" address,
  * i.e.  the IP address of a cache client.  The second argument (b)
  * is an entry in some address-based access control element.  This
- * function is called via aclMatchIp() and the splay library.
+ * function is called via aclMatchIp() for entries whose netmask
+ * cannot be compiled into an address range.
  */
 static int
 aclIpAddrNetworkCompare(const void *a, const void *b)
@@ -2849,10 +3031,11 @@ aclDumpIpListWalkee(void *node, void *state)
 }
 
 static wordlist *
-aclDumpIpList(void *data)
+aclDumpIpList(acl_ip_list * L)
 {
     wordlist *w = NULL;
-    splay_walk(data, aclDumpIpListWalkee, &w);
+    if (L)
+	splay_walk(L->tree, aclDumpIpListWalkee, &w);
     return w;
 }
 
@@ -1,66 +1,24 @@
-#include <assert.h>
-#include "acsmDFA.h"
+/*
+ * DEBUG: section 86    Video Cache
+ */
+
+#include "squid.h"
 
 #define MAXPATTERNLEN 257
-#define SHOW_PATTERN_RESULT
 
 
 
 ACSM_STRUCT *acsm_cap[ACSM_NUM] = {NULL};
+int acsm_compact = 1;
 
 
-static unsigned int nfound = 0;
-/************************************************ 
-*ƥǷַ
-* 룺 
-* pattern:Զģʽָ
-* mlist: ֵģʽ
-* ֵ ַflag
-************************************************/ 
-int PrintMatch (ACSM_PATTERN * pattern,ACSM_PATTERN * mlist) 
-{
-	/* Count the Each Match Pattern */
-   ACSM_PATTERN *temp = pattern;
-	for (;temp!=NULL;temp=temp->next) {
-		if(!strcmp((const char *)temp->patrn_cap,(const char *)mlist->patrn_cap)){
-			temp->nmatch++;
-			nfound++;
-			return temp->urlflag;
-			break;
-		}		
-	}
-	return 0;
-}
-
-/************************************************ 
-*ƽ0
-* 룺 
-* pattern:Զģʽָ
-* ֵ 
-************************************************/ 
-void PrintSummary (ACSM_STRUCT *acsm)
-{
-	ACSM_PATTERN * mlist = acsm->acsmPatterns;
-
-	for (;mlist!=NULL;mlist=mlist->next){
-	#ifdef SHOW_PATTERN_RESULT
-		printf("***%-20s:%-5d\n",mlist->patrn_cap,mlist->nmatch);
-	#endif
-		mlist->nmatch = 0;			
-	}
-#ifdef SHOW_PATTERN_RESULT
-	printf("####Total matching number is:%d#####\n\n\n",nfound);
-#endif
-	nfound=0;
-}
-
 /*
 *Malloc the AC memory
 */
 static void *AC_MALLOC(uint32_t n)
 {
 	void *p;
-	p = malloc(n);
+	p = xmalloc(n);
 	return p;
 }
 
@@ -70,7 +28,7 @@ static void *AC_MALLOC(uint32_t n)
 static void AC_FREE(void *p)
 {
 	if(p)
-       free(p);
+       xfree(p);
 	p = NULL;
 }
 
@@ -194,7 +152,7 @@ void ConvertCaseEX(unsigned char *d,unsigned char *s,uint32_t m)
 /*
 *   Add a pattern to the list of patterns for this state machine
 */ 
-static int acsmAddPattern(ACSM_STRUCT *p, unsigned char *pat, uint32_t n,uint32_t urlflag) 
+static int acsmAddPattern(ACSM_STRUCT *p, unsigned char *pat, uint32_t n,uint32_t urlflag,uint32_t priority,ACSM_RULE *rule)
 {
 	ACSM_PATTERN *plist;
 	int len = 0;
@@ -211,6 +169,8 @@ static int acsmAddPattern(ACSM_STRUCT *p, unsigned char *pat, uint32_t n,uint32_
 	plist->nmatch=0;
 
   plist->urlflag=urlflag;
+	plist->priority = priority ? priority : n;	/* longest pattern wins by default */
+	plist->rule = rule;
   
 	/*Add the pattern into the pattern list*/
 	plist->next = p->acsmPatterns;
@@ -220,16 +180,108 @@ static int acsmAddPattern(ACSM_STRUCT *p, unsigned char *pat, uint32_t n,uint32_
 }
 
 
+/*
+*Free an ID extraction rule
+*/
+static void acsmRuleFree(ACSM_RULE *rule)
+{
+	unsigned i;
+
+	if (!rule)
+		return;
+	for (i = 0; i < ACSM_RULE_MAXALT; i++) {
+		AC_FREE(rule->start[i]);
+		AC_FREE(rule->end[i]);
+		AC_FREE(rule->keep[i]);
+		AC_FREE(rule->skip[i]);
+	}
+	AC_FREE(rule);
+}
+
+/*
+*Parse the ID extraction options at the end of a keyword line.Returns NULL
+*when there are none,and sets *err on a grammar error.
+*/
+static ACSM_RULE *acsmRuleParse(char *opts, int *err)
+{
+	ACSM_RULE *rule = NULL;
+	char *tok, *val, *alt, **list;
+	unsigned *count;
+	size_t *len;
+	unsigned char *set, c;
+
+	*err = 0;
+	for (tok = strtok(opts, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+		if (!rule) {
+			rule = (ACSM_RULE *)AC_MALLOC(sizeof(ACSM_RULE));
+			memset(rule, 0, sizeof(ACSM_RULE));
+		}
+		if ((val = strchr(tok, '=')) == NULL || val[1] == '\0')
+			goto bad;
+		*val++ = '\0';
+		if (!strcmp(tok, "after") || !strcmp(tok, "from")) {
+			if (rule->nstart)
+				goto bad;
+			if (tok[0] == 'f')
+				rule->flags |= ACSM_RULE_START_AT;
+			list = rule->start;
+			count = &rule->nstart;
+			len = rule->startlen;
+			set = rule->startset;
+		} else if (!strcmp(tok, "before") || !strcmp(tok, "through")) {
+			if (rule->nend)
+				goto bad;
+			if (tok[0] == 't')
+				rule->flags |= ACSM_RULE_END_AFTER;
+			list = rule->end;
+			count = &rule->nend;
+			len = rule->endlen;
+			set = rule->endset;
+		} else if (!strcmp(tok, "keep")) {
+			list = rule->keep;
+			count = &rule->nkeep;
+			len = rule->keeplen;
+			set = NULL;
+		} else if (!strcmp(tok, "skip")) {
+			list = rule->skip;
+			count = &rule->nskip;
+			len = rule->skiplen;
+			set = NULL;
+		} else
+			goto bad;
+		for (alt = strtok_r(val, ",", &val); alt; alt = strtok_r(NULL, ",", &val)) {
+			if (*count >= ACSM_RULE_MAXALT)
+				goto bad;
+			if (set) {
+				c = xlatcase[(unsigned char)alt[0]];
+				set[c >> 3] |= 1 << (c & 7);
+			}
+			len[*count] = strlen(alt);
+			list[(*count)++] = xstrdup(alt);
+		}
+	}
+	return rule;
+
+bad:
+	debug(86, 0) ("acsmRuleParse: unknown or repeated rule option '%s', keyword ignored\n", tok);
+	acsmRuleFree(rule);
+	*err = 1;
+	return NULL;
+}
+
 int acsm_parse_line(const char *urlFile, ACSM_STRUCT *acsm)
 {
 	char line[LEN];
 	unsigned char keychar[LEN];
-	unsigned char siteflag[3];
+	unsigned char siteflag[4];
+	uint32_t priority;
+	ACSM_RULE *rule;
+	int err;
   unsigned char *start,*p,*q,*k;//p is the end point of keychar,k is the start point of siteflag,q is the end point of siteflag
 	FILE *kwFp = fopen(urlFile, "r");
 
 	if (!kwFp) {
-		fprintf(stderr, "Open url file error!\n");
+		debug(86, 0) ("acsm_parse_line: %s: %s\n", urlFile, xstrerror());
 		return -1;
 	}
 
@@ -279,20 +331,40 @@ int acsm_parse_line(const char *urlFile, ACSM_STRUCT *acsm)
 		  	q++;
 			}
 			else {
-				printf("grammar error,.txt flag must number!\n");
-				return 0;
+				debug(86, 0) ("acsm_parse_line: %s: the flag of '%s' is not a number, keyword ignored\n", urlFile, keychar);
+				break;
 			}
 	  }
+	  if (*q != '\0' && *q != ' ' && *q != '\t' && *q != '\n' && *q != '\r')
+	  	continue;
 	  memset(siteflag, 0, sizeof(siteflag));
 	  if(q-k<= 3)
 	    strncpy(siteflag,k,q-k);
-	  else
-	  	printf("grammar error,.txt flag too long!\n");
-	   
-	  printf("key:%s  flag:%d\n",keychar,atoi(siteflag));
+	  else {
+	  	debug(86, 0) ("acsm_parse_line: %s: the flag of '%s' is too long, keyword ignored\n", urlFile, keychar);
+	  	continue;
+	  }
+
+	  /*optional third column:match priority*/
+	  priority = 0;
+	  while (*q == ' ' || *q == '\t')
+	  	q++;
+	  if (*q >= '0' && *q <= '9') {
+	  	priority = atoi((char *)q);
+	  	while (*q >= '0' && *q <= '9')
+	  		q++;
+	  }
+
+	  /*then the optional ID extraction rule*/
+	  rule = acsmRuleParse((char *)q, &err);
+	  if (err)
+	  	continue;
+	   	   
+	  debug(86, 2) ("acsm_parse_line: key:%s  flag:%d  priority:%u%s\n",keychar,atoi(siteflag),priority,rule ? "  rule" : "");
 		if (line[0] != '\0') {
-			acsmAddPattern((ACSM_STRUCT *)acsm, (unsigned char *)keychar, strlen(keychar),atoi(siteflag));
-		}
+			acsmAddPattern((ACSM_STRUCT *)acsm, (unsigned char *)keychar, strlen(keychar),atoi(siteflag),priority,rule);
+		} else
+			acsmRuleFree(rule);
 	}
 
 	fclose(kwFp);
@@ -411,6 +483,169 @@ static void Build_DFA(ACSM_STRUCT *acsm)
 	queue_free(queue);
 }
 
+/*
+*Find the pattern of the pattern list which is reported for a match list
+*/
+static ACSM_PATTERN *acsmFindPattern(ACSM_PATTERN *pattern, ACSM_PATTERN *mlist)
+{
+	for (;pattern!=NULL;pattern=pattern->next) {
+		if(!strcmp((const char *)pattern->patrn_cap,(const char *)mlist->patrn_cap))
+			return pattern;
+	}
+	return NULL;
+}
+
+/*
+*Pick the better of two matches:higher priority first,then the longer pattern
+*/
+static ACSM_PATTERN *acsmBetter(ACSM_PATTERN *a, ACSM_PATTERN *b)
+{
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+	if (a->priority != b->priority)
+		return b->priority > a->priority ? b : a;
+	return b->n_cap > a->n_cap ? b : a;
+}
+
+/*
+*Best match reported through the fail chain of state s,only solid states
+*count.Fail states are shallower than s,so the recursion terminates.
+*/
+static ACSM_PATTERN *acsmFailAccept(ACSM_STRUCT *acsm, uint32_t s, unsigned char *done)
+{
+	ACSM_STATETABLE *st = &acsm->acsmStateTable[s];
+	ACSM_STATETABLE *ft;
+
+	if (done[s])
+		return st->FailAccept;
+	done[s] = 1;
+	if (st->FailState != 0) {
+		ft = &acsm->acsmStateTable[st->FailState];
+		st->FailAccept = acsmBetter(ft->flag == SOLID_STATE ? ft->Accept : NULL,
+			acsmFailAccept(acsm, st->FailState, done));
+	}
+	return st->FailAccept;
+}
+
+/*
+*Store the reported pattern directly on every state,so the search never
+*walks a match list or a fail chain
+*/
+static void acsmBuildAccept(ACSM_STRUCT *acsm)
+{
+	unsigned char *done;
+	uint32_t s;
+
+	for (s = 0; s <= acsm->acsmNumState; s++) {
+		ACSM_STATETABLE *st = &acsm->acsmStateTable[s];
+		st->Accept = st->MatchList ? acsmFindPattern(acsm->acsmPatterns, st->MatchList) : NULL;
+	}
+	done = (unsigned char *)AC_MALLOC(acsm->acsmNumState + 1);
+	memset(done, 0, acsm->acsmNumState + 1);
+	for (s = 0; s <= acsm->acsmNumState; s++)
+		acsmFailAccept(acsm, s, done);
+	AC_FREE(done);
+}
+
+/*
+*Free the full state table and the match list copies hanging off it
+*/
+static void acsmFreeStateTable(ACSM_STRUCT *acsm)
+{
+	unsigned i;
+	ACSM_PATTERN *mlist, *ilist;
+
+	for (i = 0; i <= acsm->acsmNumState; i++) {
+		mlist = acsm->acsmStateTable[i].MatchList;
+		while (mlist) {
+			ilist = mlist;
+			mlist = mlist->next;
+			AC_FREE (ilist);
+		}
+	}
+	AC_FREE (acsm->acsmStateTable);
+	acsm->acsmStateTable = NULL;
+}
+
+/*
+*Build the compact automaton from the full state table.
+*Bytes that occur in no pattern always lead back to state 0,so they share
+*equivalence class 0;every pattern byte gets a class of its own.Patterns
+*are upper case,so a lower case byte is folded into the class of its
+*upper case form and the text can be searched without converting it.
+*/
+static void acsmCompactBuild(ACSM_STRUCT *acsm)
+{
+	ACSM_COMPACT *c;
+	ACSM_PATTERN *plist;
+	uint32_t numState = acsm->acsmNumState + 1;
+	uint32_t i, k, s;
+
+	if (!acsm_compact || numState > ACSM_COMPACT_MAXSTATE)
+		return;
+
+	c = (ACSM_COMPACT *)AC_MALLOC(sizeof(ACSM_COMPACT));
+	if (!c)
+		return;
+	memset(c, 0, sizeof(ACSM_COMPACT));
+	c->NumClass = 1;
+	for (plist = acsm->acsmPatterns; plist != NULL; plist = plist->next) {
+		for (k = 0; k < plist->n_cap; k++) {
+			if (!c->xlat[plist->patrn_cap[k]])
+				c->xlat[plist->patrn_cap[k]] = c->NumClass++;
+		}
+	}
+	for (i = 0; i < ALPHABET_SIZE; i++)
+		c->xlat[i] = c->xlat[xlatcase[i]];
+
+	c->NextState = (uint16_t *)AC_MALLOC(sizeof(uint16_t) * numState * c->NumClass);
+	c->State = (ACSM_CSTATE *)AC_MALLOC(sizeof(ACSM_CSTATE) * numState);
+	if (!c->NextState || !c->State) {
+		AC_FREE(c->NextState);
+		AC_FREE(c->State);
+		AC_FREE(c);
+		return;
+	}
+
+	for (s = 0; s < numState; s++) {
+		ACSM_STATETABLE *st = &acsm->acsmStateTable[s];
+		for (i = 0; i < ALPHABET_SIZE; i++)
+			c->NextState[s * c->NumClass + c->xlat[i]] = (uint16_t)st->NextState[xlatcase[i]];
+		c->State[s].flag = st->flag;
+		c->State[s].Accept = st->Accept;
+		c->State[s].FailAccept = st->FailAccept;
+	}
+	c->size = sizeof(ACSM_COMPACT) + sizeof(uint16_t) * numState * c->NumClass +
+		sizeof(ACSM_CSTATE) * numState;
+
+	acsm->acsmCompact = c;
+	acsmFreeStateTable(acsm);
+}
+
+/*
+*Free the compact automaton
+*/
+static void acsmCompactFree(ACSM_COMPACT *c)
+{
+	if (!c)
+		return;
+	AC_FREE(c->NextState);
+	AC_FREE(c->State);
+	AC_FREE(c);
+}
+
+/*
+*Resident size of the automaton used for searching
+*/
+size_t acsmMemSize(ACSM_STRUCT *acsm)
+{
+	if (acsm->acsmCompact)
+		return acsm->acsmCompact->size;
+	return sizeof(ACSM_STATETABLE) * acsm->acsmMaxState;
+}
+
 /*
 * Init the acsm DataStruct	
 */ 
@@ -469,6 +704,12 @@ int acsmCompile_cap(ACSM_STRUCT * acsm)
 	/* Build the NFA  */ 
 	Build_DFA(acsm);
 
+	/* Resolve the reported pattern of every state */
+	acsmBuildAccept(acsm);
+
+	/* Switch to the compact layout when the state ids fit */
+	acsmCompactBuild(acsm);
+
 	return 0;
 }
 
@@ -476,99 +717,233 @@ int acsmCompile_cap(ACSM_STRUCT * acsm)
 //static unsigned char Tc[MAXLINELEN];
 
 /*
-*   Search Text or Binary Data for Pattern matches
-*/ 
-int acsmSearch_cap(ACSM_STRUCT * acsm, unsigned char *Tx, unsigned int n) 
+*Keep the better of best and p,remembering where the better one ends
+*/
+#define ACSM_CONSIDER(p) do { \
+	ACSM_PATTERN *_b = acsmBetter(best, (p)); \
+	if (_b != best) { \
+		best = _b; \
+		bestEnd = T; \
+	} \
+} while (0)
+
+/*
+*Count a hit on the best match and return it
+*/
+static ACSM_PATTERN *acsmReport(ACSM_PATTERN *best, unsigned char *bestEnd,
+	unsigned char *Tx, uint32_t *end)
+{
+	if (!best)
+		return NULL;
+	best->nmatch++;
+	if (end)
+		*end = bestEnd + 1 - Tx;
+	return best;
+}
+
+/*
+*   Search using the compact automaton,same semantics as the full table
+*/
+static ACSM_PATTERN *acsmSearchCompact(ACSM_STRUCT * acsm, unsigned char *Tx, unsigned int n, uint32_t *end)
+{
+	const ACSM_COMPACT *c = acsm->acsmCompact;
+	const uint16_t *NextState = c->NextState;
+	const unsigned char *xlat = c->xlat;
+	const ACSM_CSTATE *State = c->State;
+	unsigned NumClass = c->NumClass;
+	unsigned state, temp;
+	unsigned char *T, *Tend;
+	ACSM_PATTERN *best = NULL;
+	unsigned char *bestEnd = NULL;
+
+	T = Tx;
+	Tend = Tx + n;
+
+	for (state = 0; T < Tend && *T != '\0'; T++) {
+		temp = state;
+		state = NextState[state * NumClass + xlat[*T]];
+
+		if (*T < 128) {
+			ACSM_CONSIDER(State[state].Accept);
+			ACSM_CONSIDER(State[state].FailAccept);
+		} else {
+			/*forbide virtual state to virtual state*/
+			if (State[temp].flag == VIRTUAL_STATE1 && State[state].flag == VIRTUAL_STATE1)
+				state = 0;
+			/*jump one char to avoid wrong matching*/
+			if (state == 0 && State[temp].flag == SOLID_STATE) {
+				T++;
+				continue;
+			}
+			if (State[temp].flag == VIRTUAL_STATE1)
+				ACSM_CONSIDER(State[state].Accept);
+			ACSM_CONSIDER(State[state].FailAccept);
+		}
+	}
+
+	return acsmReport(best, bestEnd, Tx, end);
+}
+
+/*
+*   Search Text or Binary Data for Pattern matches.
+*   Every match in the text is considered and the best one is returned:
+*   highest priority first,then the longest pattern.*end is set to the
+*   offset just past the first occurrence of that pattern.
+*/
+ACSM_PATTERN *acsmSearchBest(ACSM_STRUCT * acsm, unsigned char *Tx, unsigned int n, uint32_t *end)
 {
-	unsigned state, temp, fail;
-	ACSM_PATTERN *mlist;
+	unsigned state, temp;
 	unsigned char *Tend;
 	ACSM_STATETABLE * StateTable = acsm->acsmStateTable;
 	unsigned char *T;
+	ACSM_PATTERN *best = NULL;
+	unsigned char *bestEnd = NULL;
 
-	nfound = 0;
-
-	if((int) n <= 0){
-		return -1;
-	}
+	if (acsm->acsmCompact)
+		return acsmSearchCompact(acsm, Tx, n, end);
 
-	/* Case conversion */
-	/* ConvertCaseEX(Tc, Tx, n);
-	T = Tc;
-	Tend = Tc + n;*/
-	//////////////////////////////////////////////////////////////////////////
-	/*no case conversion*/
+	/* Case is folded through xlatcase in the scan loop,no copy is made */
 	T = Tx;
 	Tend = Tx + n;
-	//////////////////////////////////////////////////////////////////////////
 	
-	for (state = 0; T < Tend; T++) {
+	for (state = 0; T < Tend && *T != '\0'; T++) {
 		temp=state;
-
-		if(*T == '\0')
-			return -1; 
-
-		state = StateTable[state].NextState[*T];
+		state = StateTable[state].NextState[xlatcase[*T]];
 
 		if(*T < 128) {
-			 /* State is an accept state? */
-			if( StateTable[state].MatchList != NULL ){
-				for(mlist=StateTable[state].MatchList; mlist!=NULL;mlist=mlist->next){
-					PrintMatch(acsm->acsmPatterns,mlist);
-					return PrintMatch (acsm->acsmPatterns,mlist);
-        }
-      }
-
-			fail=StateTable[state].FailState;
-
-			while(fail!=0) {
-				if(StateTable[fail].MatchList!=NULL && StateTable[fail].flag==SOLID_STATE){
-					for(mlist=StateTable[fail].MatchList; mlist!=NULL;mlist=mlist->next){
-						//nfound++;
-						return PrintMatch (acsm->acsmPatterns,mlist);
-
-					
-					}
-				}
-				fail=StateTable[fail].FailState;
-			}
+			ACSM_CONSIDER(StateTable[state].Accept);
+			ACSM_CONSIDER(StateTable[state].FailAccept);
 		}
-		else if(*T >= 128){
+		else {
 			/*forbide virtual state to virtual state*/
 			if(StateTable[temp].flag==VIRTUAL_STATE1 && StateTable[state].flag==VIRTUAL_STATE1)
 				state = 0;
 		    /*jump one char to avoid wrong matching*/
-			if(state==0 && StateTable[temp].flag == SOLID_STATE) 
+			if(state==0 && StateTable[temp].flag == SOLID_STATE) {
 				T++;
-			else{
-				if( StateTable[state].MatchList != NULL && StateTable[temp].flag==VIRTUAL_STATE1){
-					for( mlist=StateTable[state].MatchList; mlist!=NULL;mlist=mlist->next){
-						PrintMatch (acsm->acsmPatterns,mlist); 
-
-						if (nfound) {
-							return acsm->acsmPatterns->urlflag;
-						}
-					}
-				}
-				fail=StateTable[state].FailState;
-				while(fail!=0){
-					if(StateTable[fail].MatchList!=NULL && StateTable[fail].flag==SOLID_STATE){
-						for(mlist=StateTable[fail].MatchList; mlist!=NULL;mlist=mlist->next){
-							//nfound++;
-							PrintMatch (acsm->acsmPatterns,mlist);
-
-							return PrintMatch (acsm->acsmPatterns,mlist);
-						}
-					}
-					fail=StateTable[fail].FailState;
-				}
+				continue;
 			}
-			/* State is a accept state? */
+			if (StateTable[temp].flag == VIRTUAL_STATE1)
+				ACSM_CONSIDER(StateTable[state].Accept);
+			ACSM_CONSIDER(StateTable[state].FailAccept);
 		}
 	}
 
-	return 0;
-	//return nfound;
+	return acsmReport(best, bestEnd, Tx, end);
+}
+
+/*
+*   Flag of the best match,0 if nothing matches
+*/
+int acsmSearch_cap(ACSM_STRUCT * acsm, unsigned char *Tx, unsigned int n)
+{
+	ACSM_PATTERN *best;
+
+	if((int) n <= 0){
+		return -1;
+	}
+	best = acsmSearchBest(acsm, Tx, n, NULL);
+	return best ? (int) best->urlflag : 0;
+}
+
+/*
+*Offset of the first of the anchors at or after from,or n.*alen is set to
+*the length of the anchor found.Anchors match case insensitively;set holds
+*their case folded first bytes,so most offsets are passed over with one test.
+*/
+static size_t acsmRuleFind(char * const *anchor, const size_t *len, unsigned na,
+	const unsigned char *set, const char *url, size_t n, size_t from, size_t *alen)
+{
+	size_t i;
+	unsigned k;
+	unsigned char c;
+
+	for (i = from; i < n; i++) {
+		c = xlatcase[(unsigned char)url[i]];
+		if (!(set[c >> 3] & (1 << (c & 7))))
+			continue;
+		for (k = 0; k < na; k++) {
+			if (len[k] <= n - i && strncasecmp(url + i, anchor[k], len[k]) == 0) {
+				*alen = len[k];
+				return i;
+			}
+		}
+	}
+	*alen = 0;
+	return n;
+}
+
+/*
+*Index of the parameter of list the query parameter at url[i] names,or -1
+*/
+static int acsmRuleParam(char * const *list, const size_t *len, unsigned nl,
+	const char *url, size_t i, size_t n)
+{
+	unsigned k;
+
+	for (k = 0; k < nl; k++) {
+		if (len[k] <= n - i && memcmp(url + i, list[k], len[k]) == 0 &&
+				(i + len[k] == n || url[i + len[k]] == '=' || url[i + len[k]] == '&'))
+			return k;
+	}
+	return -1;
+}
+
+/*
+*Extract the video ID of url by rule.The keyword match ends at from.
+*Returns 1 with the ID span and the kept parameter spans,in rule order,
+*or 0 when the rule does not apply.
+*/
+int acsmRuleExtract(const ACSM_RULE *rule, const char *url, size_t n, size_t from,
+	videoIdSpan *id, videoIdSpan *keep, unsigned *nkeep)
+{
+	size_t q, i, e, s, alen;
+	int k;
+	videoIdSpan found[ACSM_RULE_MAXALT];
+
+	/*query parameters:skip disables the rule,keep collects spans*/
+	q = (const char *)memchr(url, '?', n) ? (size_t)((const char *)memchr(url, '?', n) - url) : n;
+	memset(found, 0, sizeof(found));
+	for (i = q + 1; i < n; i = e + 1) {
+		e = (const char *)memchr(url + i, '&', n - i) ? (size_t)((const char *)memchr(url + i, '&', n - i) - url) : n;
+		if (acsmRuleParam(rule->skip, rule->skiplen, rule->nskip, url, i, e) >= 0)
+			return 0;
+		if ((k = acsmRuleParam(rule->keep, rule->keeplen, rule->nkeep, url, i, e)) >= 0 && !found[k].len) {
+			found[k].off = i;
+			found[k].len = e - i;
+		}
+	}
+
+	/*ID start*/
+	s = from;
+	if (rule->nstart) {
+		s = acsmRuleFind(rule->start, rule->startlen, rule->nstart, rule->startset, url, n, from, &alen);
+		if (s == n)
+			return 0;
+		if (!(rule->flags & ACSM_RULE_START_AT))
+			s += alen;
+	}
+
+	/*ID end,by default the end of the path*/
+	e = q > s ? q : n;
+	if (rule->nend) {
+		e = acsmRuleFind(rule->end, rule->endlen, rule->nend, rule->endset, url, n, s, &alen);
+		if (e == n)
+			return 0;
+		if (rule->flags & ACSM_RULE_END_AFTER)
+			e += alen;
+	}
+	if (e <= s || e - s > VIDEO_ID_MAXLEN)
+		return 0;
+
+	id->off = s;
+	id->len = e - s;
+	*nkeep = 0;
+	for (k = 0; k < (int) rule->nkeep; k++) {
+		if (found[k].len)
+			keep[(*nkeep)++] = found[k];
+	}
+	return 1;
 }
 
 /*
@@ -576,27 +951,25 @@ int acsmSearch_cap(ACSM_STRUCT * acsm, unsigned char *Tx, unsigned int n)
 */ 
 void acsmFree (ACSM_STRUCT * acsm) 
 {
-	unsigned  i;
 	ACSM_PATTERN * mlist, *ilist;
 
 	if(NULL == acsm)
 		return;
 
-	for (i = 0; i < acsm->acsmNumState; i++) {
-		if (acsm->acsmStateTable[i].MatchList != NULL) {
-			mlist = acsm->acsmStateTable[i].MatchList;
-			while (mlist) {
-				ilist = mlist;	
-				mlist = mlist->next;			
-				AC_FREE (ilist->patrn_cap);
-				AC_FREE (ilist);				
-			}
-		}
+	if (acsm->acsmStateTable)
+		acsmFreeStateTable(acsm);
+	acsmCompactFree(acsm->acsmCompact);
+
+	mlist = acsm->acsmPatterns;
+	while (mlist) {
+		ilist = mlist;
+		mlist = mlist->next;
+		AC_FREE (ilist->patrn_cap);
+		acsmRuleFree (ilist->rule);
+		AC_FREE (ilist);
 	}
 
-	AC_FREE (acsm->acsmPatterns);
-	AC_FREE (acsm->acsmStateTable);
-	acsm = NULL;
+	AC_FREE (acsm);
 }
 
 /*
@@ -612,50 +985,44 @@ int acsmDFA(ACSM_STRUCT *acsm)
 	return 0;
 }
 
-int acsm_changed(uint8_t *msg, int len, uint8_t **retbuf, int *retlen)
+/*
+*Build a new automaton from fileName off to the side.Returns NULL when the
+*file can not be read or compiled.
+*/
+ACSM_STRUCT *acsmLoad(const char *fileName)
 {
-	int i, ret;
-	ACSM_STRUCT *acsm_old;
-	for (i = 0; i < ACSM_NUM; i++) {
-		ACSM_STRUCT *acsm_cap_new = NULL;
-		acsm_cap_new = acsmNew();	
-		ret = acsmDFA(acsm_cap_new);
-		if(ret == -1){
-			goto error;
-		}
-
-		if(acsm_cap[i]) {
-			acsm_old = acsm_cap[i];
-			acsm_cap[i] = acsm_cap_new;
-
-			acsmFree(acsm_old);
-		}
-		else 
-			acsm_cap[i] = acsm_cap_new;
+	ACSM_STRUCT *acsm;
+
+	acsm = acsmNew();
+	if (!acsm)
+		return NULL;
+	if (acsm_parse_line(fileName, acsm) < 0 || acsmDFA(acsm) == -1) {
+		acsmFree(acsm);
+		return NULL;
 	}
-
-	return 0;
-
-error:
-	//fprintf(stderr, "malloc acsm failed: %s", strerror(errno));
-	fprintf(stderr, "malloc acsm failed:\n");
-	return -1;
+	debug(86, 1) ("%s: %u states, %u classes, %lu bytes\n", fileName,
+		acsm->acsmNumState + 1,
+		acsm->acsmCompact ? acsm->acsmCompact->NumClass : ALPHABET_SIZE,
+		(unsigned long)acsmMemSize(acsm));
+	return acsm;
 }
 
+/*
+*(Re)load automaton n from fileName.The new automaton is complete before
+*it replaces acsm_cap[n],and the old one is freed only after the swap.
+*On failure the current automaton stays in place.
+*/
 int init_acsm(int n,const char *fileName)
 {
+	ACSM_STRUCT *acsm_new, *acsm_old;
 
-	  int ret;
-		acsm_cap[n] = acsmNew();
-		
-		acsm_parse_line(fileName, acsm_cap[n]);
-
-		ret = acsmDFA(acsm_cap[n]);
-		if(ret == -1){
-			fprintf(stderr,"create acsm_gb fail!\n");
-			return ret;
-		}
-	//get_interference();
+	acsm_new = acsmLoad(fileName);
+	if (!acsm_new) {
+		debug(86, 0) ("init_acsm: can not create the automaton from %s\n", fileName);
+		return -1;
+	}
+	acsm_old = acsm_cap[n];
+	acsm_cap[n] = acsm_new;
+	acsmFree(acsm_old);
 	return 0;
 }
-
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <videoreg.h>
 
 #define LEN 1024
 #define ACSM_NUM 		2
@@ -18,6 +19,29 @@
 
 
 
+/*
+**video ID extraction rule of a keyword,given as options after the flag:
+**  after=A,..|from=A,..     ID starts after/at the first anchor past the keyword
+**  before=E,..|through=E,.. ID ends before/after the first end anchor past the start
+**  keep=P,..                query parameters appended to the ID
+**  skip=P,..                query parameters that stop the URL being keyed by ID
+*/
+#define ACSM_RULE_MAXALT	4			//alternatives per option
+#define ACSM_RULE_START_AT	1			//from=:the start anchor is part of the ID
+#define ACSM_RULE_END_AFTER	2			//through=:the end anchor is part of the ID
+
+typedef struct _acsm_rule {
+	unsigned	flags;							//ACSM_RULE_* flags
+	unsigned	nstart, nend, nkeep, nskip;
+	char		*start[ACSM_RULE_MAXALT];		//ID start anchors
+	char		*end[ACSM_RULE_MAXALT];			//ID end anchors
+	char		*keep[ACSM_RULE_MAXALT];		//query parameters kept in the ID
+	char		*skip[ACSM_RULE_MAXALT];		//query parameters disabling the ID
+	size_t		startlen[ACSM_RULE_MAXALT], endlen[ACSM_RULE_MAXALT];
+	size_t		keeplen[ACSM_RULE_MAXALT], skiplen[ACSM_RULE_MAXALT];
+	unsigned char	startset[32], endset[32];		//case folded first bytes of the anchors
+} ACSM_RULE;
+
 /*
 **struct of pattern
 */
@@ -27,6 +51,8 @@ typedef struct _acsm_pattern {
 	unsigned int				n_cap;					//length of pattern
   unsigned int 	 			nmatch;				//number of successes of matching pattern
   unsigned int urlflag; // identification number of different video web url
+	unsigned int				priority;				//match priority,higher wins
+	ACSM_RULE					*rule;					//ID extraction rule,if any
 
 } ACSM_PATTERN;
 
@@ -38,8 +64,33 @@ typedef struct {
 	unsigned 	NextState[ALPHABET_SIZE];		//next state-based on input character
 	unsigned 	FailState;						//fail state-used when building NFA & DFA
 	ACSM_PATTERN *MatchList;					//list of patterns those and here,if any
+	ACSM_PATTERN *Accept;						//pattern reported at this state,if any
+	ACSM_PATTERN *FailAccept;					//best pattern reported through the fail chain
 } ACSM_STATETABLE;
 
+/*
+**per state data of the compact automaton
+*/
+typedef struct {
+	unsigned		flag;							//flag of state:solid or virtual?
+	ACSM_PATTERN	*Accept;						//pattern reported at this state,if any
+	ACSM_PATTERN	*FailAccept;					//best pattern reported through the fail chain
+} ACSM_CSTATE;
+
+/*
+**compact automaton:byte equivalence classes,16-bit state ids and a flat
+**transition array of NumState x NumClass entries
+*/
+typedef struct {
+	unsigned		NumClass;						//number of equivalence classes
+	unsigned char	xlat[ALPHABET_SIZE];			//byte -> equivalence class
+	uint16_t		*NextState;						//flat transition array
+	ACSM_CSTATE		*State;							//per state data
+	size_t			size;							//resident bytes
+} ACSM_COMPACT;
+
+#define ACSM_COMPACT_MAXSTATE	65535			//state ids must fit in 16 bits
+
 /*
 **struct of state machine
 */
@@ -48,17 +99,38 @@ typedef struct {
 	unsigned acsmNumState;						//number of states
 	ACSM_PATTERN	*acsmPatterns;		       //pointer to patterns
 	ACSM_STATETABLE	*acsmStateTable;	       //pointer to state table
+	ACSM_COMPACT	*acsmCompact;		       //compact automaton,if built
 } ACSM_STRUCT;
 
 extern ACSM_STRUCT *acsm_cap[ACSM_NUM];
+/*
+**build the compact layout when the state ids fit;the layout benchmark
+**clears it to measure the full table
+*/
+extern int acsm_compact;
 
+/*
+**(re)load automaton n from fileName,keeping the old one on failure
+*/
 int init_acsm(int n,const char *fileName);
+ACSM_STRUCT *acsmLoad(const char *fileName);
+void acsmFree(ACSM_STRUCT *acsm);
 void ConvertCaseEX(unsigned char *d,unsigned char *s,uint32_t m);
+/*
+**search is case insensitive,Tx is scanned in place;returns the flag of
+**the best match (priority,then length) or 0
+*/
 int acsmSearch_cap(ACSM_STRUCT *acsm,unsigned char *Tx,uint32_t n);
-
 /*
-**print the sunmmary of matching
+**same search,returning the best pattern and the offset just past its match
+*/
+ACSM_PATTERN *acsmSearchBest(ACSM_STRUCT *acsm,unsigned char *Tx,uint32_t n,uint32_t *end);
+/*
+**apply rule to the n byte url whose keyword match ends at from;fills in
+**the ID span and up to ACSM_RULE_MAXALT kept parameter spans
 */
-void PrintSummary (ACSM_STRUCT *acsm);
+int acsmRuleExtract(const ACSM_RULE *rule,const char *url,size_t n,size_t from,
+	videoIdSpan *id,videoIdSpan *keep,unsigned *nkeep);
+size_t acsmMemSize(ACSM_STRUCT *acsm);
 #endif
 
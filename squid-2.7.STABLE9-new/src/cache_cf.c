@@ -465,6 +465,7 @@ configDoConfigure(void)
     /* Sanity checks */
     if (Config.cacheSwap.swapDirs == NULL)
 	fatal("No cache_dir's specified in config file");
+    workerConfigure();
     /* calculate Config.Swap.maxSize */
     storeDirConfigure();
     if (0 == Config.Swap.maxSize)
@@ -547,6 +548,8 @@ configDoConfigure(void)
     authenticateConfigure(&Config.authConfig);
     externalAclConfigure();
     refreshCheckConfigure();
+    refreshConfigure();
+    aclConfigure();
 #if HTTP_VIOLATIONS
     {
 	const refresh_t *R;
@@ -1473,6 +1476,7 @@ parse_cachedir(cacheSwap * swap)
     fs = find_fstype(type_str);
     if (fs < 0)
 	self_destruct();
+    path_str = workerSwapDirPath(path_str);
 
     /* reconfigure existing dir */
     for (i = 0; i < swap->n_configured; i++) {
@@ -1489,7 +1493,8 @@ parse_cachedir(cacheSwap * swap)
     }
 
     /* new cache_dir */
-    assert(swap->n_configured < 63);	/* 7 bits, signed */
+    if (swap->n_configured >= STORE_DIRN_MAX)
+	fatalf("Too many cache_dir lines, at most %d are supported\n", STORE_DIRN_MAX);
 
     allocate_new_swapdir(swap);
     sd = swap->swapDirs + swap->n_configured;
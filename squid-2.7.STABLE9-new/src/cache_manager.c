@@ -205,12 +205,12 @@ cachemgrStart(int fd, request_t * request, StoreEntry * entry)
 	err = errorCon(ERR_INVALID_URL, HTTP_NOT_FOUND, request);
 	err->url = xstrdup(storeUrl(entry));
 	errorAppendEntry(entry, err);
-	entry->expires = squid_curtime;
+	entry->expires = storeTimeRel(squid_curtime);
 	return;
     }
     mgr->entry = entry;
     storeLockObject(entry);
-    entry->expires = squid_curtime;
+    entry->expires = storeTimeRel(squid_curtime);
     debug(16, 5) ("CACHEMGR: %s requesting '%s'\n",
 	fd_table[fd].ipaddr, mgr->action);
     /* get additional info from request headers */
@@ -239,7 +239,7 @@ cachemgrStart(int fd, request_t * request, StoreEntry * entry)
 	httpHeaderPutAuth(&rep->header, "Basic", mgr->action);
 	/* store the reply */
 	httpReplySwapOut(rep, entry);
-	entry->expires = squid_curtime;
+	entry->expires = storeTimeRel(squid_curtime);
 	storeComplete(entry);
 	cachemgrStateFree(mgr);
 	return;
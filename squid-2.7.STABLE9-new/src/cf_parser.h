@@ -105,6 +105,8 @@ default_all(void)
 	default_line("dead_peer_timeout 10 seconds");
 	/* No default for hierarchy_stoplist */
 	default_line("cache_mem 8 MB");
+	default_line("memory_page_size 4 KB");
+	default_line("memory_huge_pages off");
 	default_line("maximum_object_size_in_memory 8 KB");
 	default_line("memory_replacement_policy lru");
 	default_line("cache_replacement_policy lru");
@@ -172,6 +174,12 @@ default_all(void)
 	default_line("location_rewrite_children 5");
 	default_line("location_rewrite_concurrency 0");
 	/* No default for location_rewrite_access */
+	default_line("video_keywords_file /etc/squid/keyword.txt");
+	default_line("video_exclusions_file /etc/squid/exclusions.txt");
+	/* No default for video_extractor_module */
+	default_line("video_seek off");
+	default_line("video_seek_params start");
+	default_line("video_segment_size 0 KB");
 	/* No default for cache */
 	default_line("max_stale 1 week");
 	/* No default for refresh_pattern */
@@ -179,6 +187,7 @@ default_all(void)
 	default_line("quick_abort_max 16 KB");
 	default_line("quick_abort_pct 95");
 	default_line("read_ahead_gap 16 KB");
+	default_line("client_sendfile on");
 	default_line("negative_ttl 5 minutes");
 	default_line("positive_dns_ttl 6 hours");
 	default_line("negative_dns_ttl 1 minute");
@@ -229,6 +238,7 @@ default_all(void)
 	/* No default for mail_from */
 	default_line("mail_program mail");
 	default_line("cache_effective_user nobody");
+	default_line("workers 1");
 	/* No default for cache_effective_group */
 	default_line("httpd_suppress_version_string off");
 	/* No default for visible_hostname */
@@ -375,6 +385,7 @@ default_all(void)
 	/* No default for accept_filter */
 	default_line("tcp_recv_bufsize 0 bytes");
 	default_line("incoming_rate 30");
+	default_line("epoll_edge_triggered off");
 	default_line("check_hostnames on");
 	default_line("allow_underscore on");
 #if USE_DNSSERVERS
@@ -634,6 +645,10 @@ parse_line(char *buff)
 		parse_wordlist(&Config.hierarchy_stoplist);
 	else if (!strcmp(token, "cache_mem"))
 		parse_b_size_t(&Config.memMaxSize);
+	else if (!strcmp(token, "memory_page_size"))
+		parse_b_size_t(&Config.memPageSize);
+	else if (!strcmp(token, "memory_huge_pages"))
+		parse_onoff(&Config.onoff.mem_huge_pages);
 	else if (!strcmp(token, "maximum_object_size_in_memory"))
 		parse_b_size_t(&Config.Store.maxInMemObjSize);
 	else if (!strcmp(token, "memory_replacement_policy"))
@@ -772,6 +787,18 @@ parse_line(char *buff)
 		parse_int(&Config.Program.location_rewrite.concurrency);
 	else if (!strcmp(token, "location_rewrite_access"))
 		parse_acl_access(&Config.accessList.location_rewrite);
+	else if (!strcmp(token, "video_keywords_file"))
+		parse_string(&Config.videoCache.keywords);
+	else if (!strcmp(token, "video_exclusions_file"))
+		parse_string(&Config.videoCache.exclusions);
+	else if (!strcmp(token, "video_extractor_module"))
+		parse_wordlist(&Config.videoCache.modules);
+	else if (!strcmp(token, "video_seek"))
+		parse_onoff(&Config.videoCache.seek);
+	else if (!strcmp(token, "video_seek_params"))
+		parse_wordlist(&Config.videoCache.seekParams);
+	else if (!strcmp(token, "video_segment_size"))
+		parse_b_size_t(&Config.videoCache.segmentSize);
 	else if (!strcmp(token, "cache"))
 		parse_acl_access(&Config.accessList.noCache);
 	else if (!strcmp(token, "no_cache"))
@@ -788,6 +815,8 @@ parse_line(char *buff)
 		parse_int(&Config.quickAbort.pct);
 	else if (!strcmp(token, "read_ahead_gap"))
 		parse_b_size_t(&Config.readAheadGap);
+	else if (!strcmp(token, "client_sendfile"))
+		parse_onoff(&Config.onoff.client_sendfile);
 	else if (!strcmp(token, "negative_ttl"))
 		parse_time_t(&Config.negativeTtl);
 	else if (!strcmp(token, "positive_dns_ttl"))
@@ -880,6 +909,8 @@ parse_line(char *buff)
 		parse_eol(&Config.EmailProgram);
 	else if (!strcmp(token, "cache_effective_user"))
 		parse_string(&Config.effectiveUser);
+	else if (!strcmp(token, "workers"))
+		parse_int(&Config.workers);
 	else if (!strcmp(token, "cache_effective_group"))
 		parse_string(&Config.effectiveGroup);
 	else if (!strcmp(token, "httpd_suppress_version_string"))
@@ -1110,6 +1141,8 @@ parse_line(char *buff)
 		parse_b_size_t(&Config.tcpRcvBufsz);
 	else if (!strcmp(token, "incoming_rate"))
 		parse_int(&Config.incoming_rate);
+	else if (!strcmp(token, "epoll_edge_triggered"))
+		parse_onoff(&Config.onoff.epoll_edge_triggered);
 	else if (!strcmp(token, "check_hostnames"))
 		parse_onoff(&Config.onoff.check_hostnames);
 	else if (!strcmp(token, "allow_underscore"))
@@ -1285,6 +1318,8 @@ dump_config(StoreEntry *entry)
 	dump_time_t(entry, "dead_peer_timeout", Config.Timeout.deadPeer);
 	dump_wordlist(entry, "hierarchy_stoplist", Config.hierarchy_stoplist);
 	dump_b_size_t(entry, "cache_mem", Config.memMaxSize);
+	dump_b_size_t(entry, "memory_page_size", Config.memPageSize);
+	dump_onoff(entry, "memory_huge_pages", Config.onoff.mem_huge_pages);
 	dump_b_size_t(entry, "maximum_object_size_in_memory", Config.Store.maxInMemObjSize);
 	dump_removalpolicy(entry, "memory_replacement_policy", Config.memPolicy);
 	dump_removalpolicy(entry, "cache_replacement_policy", Config.replPolicy);
@@ -1352,6 +1387,12 @@ dump_config(StoreEntry *entry)
 	dump_int(entry, "location_rewrite_children", Config.Program.location_rewrite.children);
 	dump_int(entry, "location_rewrite_concurrency", Config.Program.location_rewrite.concurrency);
 	dump_acl_access(entry, "location_rewrite_access", Config.accessList.location_rewrite);
+	dump_string(entry, "video_keywords_file", Config.videoCache.keywords);
+	dump_string(entry, "video_exclusions_file", Config.videoCache.exclusions);
+	dump_wordlist(entry, "video_extractor_module", Config.videoCache.modules);
+	dump_onoff(entry, "video_seek", Config.videoCache.seek);
+	dump_wordlist(entry, "video_seek_params", Config.videoCache.seekParams);
+	dump_b_size_t(entry, "video_segment_size", Config.videoCache.segmentSize);
 	dump_acl_access(entry, "cache", Config.accessList.noCache);
 	dump_time_t(entry, "max_stale", Config.maxStale);
 	dump_refreshpattern(entry, "refresh_pattern", Config.Refresh);
@@ -1359,6 +1400,7 @@ dump_config(StoreEntry *entry)
 	dump_kb_size_t(entry, "quick_abort_max", Config.quickAbort.max);
 	dump_int(entry, "quick_abort_pct", Config.quickAbort.pct);
 	dump_b_size_t(entry, "read_ahead_gap", Config.readAheadGap);
+	dump_onoff(entry, "client_sendfile", Config.onoff.client_sendfile);
 	dump_time_t(entry, "negative_ttl", Config.negativeTtl);
 	dump_time_t(entry, "positive_dns_ttl", Config.positiveDnsTtl);
 	dump_time_t(entry, "negative_dns_ttl", Config.negativeDnsTtl);
@@ -1409,6 +1451,7 @@ dump_config(StoreEntry *entry)
 	dump_string(entry, "mail_from", Config.EmailFrom);
 	dump_eol(entry, "mail_program", Config.EmailProgram);
 	dump_string(entry, "cache_effective_user", Config.effectiveUser);
+	dump_int(entry, "workers", Config.workers);
 	dump_string(entry, "cache_effective_group", Config.effectiveGroup);
 	dump_onoff(entry, "httpd_suppress_version_string", Config.onoff.httpd_suppress_version_string);
 	dump_string(entry, "visible_hostname", Config.visibleHostname);
@@ -1555,6 +1598,7 @@ dump_config(StoreEntry *entry)
 	dump_string(entry, "accept_filter", Config.accept_filter);
 	dump_b_size_t(entry, "tcp_recv_bufsize", Config.tcpRcvBufsz);
 	dump_int(entry, "incoming_rate", Config.incoming_rate);
+	dump_onoff(entry, "epoll_edge_triggered", Config.onoff.epoll_edge_triggered);
 	dump_onoff(entry, "check_hostnames", Config.onoff.check_hostnames);
 	dump_onoff(entry, "allow_underscore", Config.onoff.allow_underscore);
 #if USE_DNSSERVERS
@@ -1690,6 +1734,8 @@ free_all(void)
 	free_time_t(&Config.Timeout.deadPeer);
 	free_wordlist(&Config.hierarchy_stoplist);
 	free_b_size_t(&Config.memMaxSize);
+	free_b_size_t(&Config.memPageSize);
+	free_onoff(&Config.onoff.mem_huge_pages);
 	free_b_size_t(&Config.Store.maxInMemObjSize);
 	free_removalpolicy(&Config.memPolicy);
 	free_removalpolicy(&Config.replPolicy);
@@ -1757,6 +1803,12 @@ free_all(void)
 	free_int(&Config.Program.location_rewrite.children);
 	free_int(&Config.Program.location_rewrite.concurrency);
 	free_acl_access(&Config.accessList.location_rewrite);
+	free_string(&Config.videoCache.keywords);
+	free_string(&Config.videoCache.exclusions);
+	free_wordlist(&Config.videoCache.modules);
+	free_onoff(&Config.videoCache.seek);
+	free_wordlist(&Config.videoCache.seekParams);
+	free_b_size_t(&Config.videoCache.segmentSize);
 	free_acl_access(&Config.accessList.noCache);
 	free_time_t(&Config.maxStale);
 	free_refreshpattern(&Config.Refresh);
@@ -1764,6 +1816,7 @@ free_all(void)
 	free_kb_size_t(&Config.quickAbort.max);
 	free_int(&Config.quickAbort.pct);
 	free_b_size_t(&Config.readAheadGap);
+	free_onoff(&Config.onoff.client_sendfile);
 	free_time_t(&Config.negativeTtl);
 	free_time_t(&Config.positiveDnsTtl);
 	free_time_t(&Config.negativeDnsTtl);
@@ -1814,6 +1867,7 @@ free_all(void)
 	free_string(&Config.EmailFrom);
 	free_eol(&Config.EmailProgram);
 	free_string(&Config.effectiveUser);
+	free_int(&Config.workers);
 	free_string(&Config.effectiveGroup);
 	free_onoff(&Config.onoff.httpd_suppress_version_string);
 	free_string(&Config.visibleHostname);
@@ -1960,6 +2014,7 @@ free_all(void)
 	free_string(&Config.accept_filter);
 	free_b_size_t(&Config.tcpRcvBufsz);
 	free_int(&Config.incoming_rate);
+	free_onoff(&Config.onoff.epoll_edge_triggered);
 	free_onoff(&Config.onoff.check_hostnames);
 	free_onoff(&Config.onoff.allow_underscore);
 #if USE_DNSSERVERS
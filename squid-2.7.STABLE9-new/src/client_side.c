@@ -109,6 +109,16 @@ static const char *const crlf = "\r\n";
 
 static CWCB clientWriteComplete;
 static CWCB clientWriteBodyComplete;
+#if HAVE_SYS_SENDFILE_H || HAVE_SYS_UIO_H
+static CWCB clientWriteRunComplete;
+static squid_off_t clientReplyRunLeft(clientHttpRequest * http);
+#endif
+#if HAVE_SYS_SENDFILE_H
+static int clientSendFile(clientHttpRequest * http);
+#endif
+#if HAVE_SYS_UIO_H
+static int clientSendMem(clientHttpRequest * http);
+#endif
 static PF clientReadRequest;
 static PF connStateFree;
 static PF requestTimeout;
@@ -439,6 +449,7 @@ clientFinishRewriteStuff(clientHttpRequest * http)
 {
     /* This is the final part of the rewrite chain - this should be broken out! */
     clientInterpretRequestHeaders(http);
+    requestVideoClassify(http->request);
     /* XXX This really should become a ref-counted string type pointer, not a copy! */
     fd_note(http->conn->fd, http->uri);
 #if HEADERS_LOG
@@ -651,7 +662,7 @@ clientHandleETagReply(void *data, HttpReply * rep)
 		vary = httpMakeVaryMark(request, rep);
 
 	    if (etag && vary) {
-		storeAddVary(entry->mem_obj->store_url, entry->mem_obj->url, entry->mem_obj->method, NULL, httpHeaderGetStr(&rep->header, HDR_ETAG), request->vary_hdr, request->vary_headers, strBuf(request->vary_encoding));
+		storeAddVary(entry->mem_obj->store_url, entry->mem_obj->url, entry->mem_obj->method, NULL, httpHeaderGetStr(&rep->header, HDR_ETAG), request->vary_hdr, request->vary_headers, strBuf(request->vary_encoding), request);
 	    }
 	}
 	clientHandleETagMiss(http);
@@ -770,12 +781,12 @@ clientProcessExpired(clientHttpRequest * http)
     /* delay_id is already set on original store client */
     delaySetStoreClient(http->sc, delayClient(http));
 #endif
-    if (can_revalidate && http->old_entry->lastmod > 0) {
-	http->request->lastmod = http->old_entry->lastmod;
+    if (can_revalidate && storeTime(http->old_entry->lastmod) > 0) {
+	http->request->lastmod = storeTime(http->old_entry->lastmod);
 	http->request->flags.cache_validation = 1;
     } else
 	http->request->lastmod = -1;
-    debug(33, 5) ("clientProcessExpired: lastmod %ld\n", (long int) entry->lastmod);
+    debug(33, 5) ("clientProcessExpired: lastmod %ld\n", (long int) storeTime(entry->lastmod));
     /* NOTE, don't call storeLockObject(), storeCreateEntry() does it */
     http->entry = entry;
     http->out.offset = 0;
@@ -970,7 +981,7 @@ modifiedSince(StoreEntry * entry, request_t * request)
 {
     squid_off_t object_length;
     MemObject *mem = entry->mem_obj;
-    time_t mod_time = entry->lastmod;
+    time_t mod_time = storeTime(entry->lastmod);
     debug(33, 3) ("modifiedSince: '%s'\n", storeLookupUrl(entry));
     debug(33, 3) ("modifiedSince: mod_time = %ld\n", (long int) mod_time);
     if (mod_time < 0)
@@ -1060,14 +1071,14 @@ clientPurgeRequest(clientHttpRequest * http)
     }
     /* And for Vary, release the base URI if none of the headers was included in the request */
     if (http->request->vary_headers && !strstr(http->request->vary_headers, "=")) {
-	entry = storeGetPublic(urlCanonical(http->request), METHOD_GET);
+	entry = storeGetPublicUrlRequest(urlCanonical(http->request), METHOD_GET, http->request);
 	if (entry) {
 	    debug(33, 4) ("clientPurgeRequest: Vary GET '%s'\n",
 		storeUrl(entry));
 	    storeRelease(entry);
 	    status = HTTP_OK;
 	}
-	entry = storeGetPublic(urlCanonical(http->request), METHOD_HEAD);
+	entry = storeGetPublicUrlRequest(urlCanonical(http->request), METHOD_HEAD, http->request);
 	if (entry) {
 	    debug(33, 4) ("clientPurgeRequest: Vary HEAD '%s'\n",
 		storeUrl(entry));
@@ -1091,7 +1102,7 @@ checkNegativeHit(StoreEntry * e)
 {
     if (!EBIT_TEST(e->flags, ENTRY_NEGCACHED))
 	return 0;
-    if (e->expires <= squid_curtime)
+    if (storeTime(e->expires) <= squid_curtime)
 	return 0;
     if (e->store_status != STORE_OK)
 	return 0;
@@ -1260,6 +1271,8 @@ httpRequestFree(void *data)
     http->al.request = NULL;
     safe_free(http->redirect.location);
     stringClean(&http->range_iter.boundary);
+    if (http->flags.sendfile)
+	file_close(http->out.file);
     if (http->old_entry && http->old_entry->mem_obj && http->old_entry->mem_obj->ims_entry && http->old_entry->mem_obj->ims_entry == http->entry) {
 	storeUnlockObject(http->old_entry->mem_obj->ims_entry);
 	http->old_entry->mem_obj->ims_entry = NULL;
@@ -1445,10 +1458,13 @@ clientInterpretRequestHeaders(clientHttpRequest * http)
 	/*
 	 * ThisCache cannot be a member of Via header, "1.0 ThisCache" can.
 	 * Note ThisCache2 has a space prepended to the hostname so we don't
-	 * accidentally match super-domains.
+	 * accidentally match super-domains.  The worker forwarding a
+	 * request has added it once already.
 	 */
 	String s = httpHeaderGetList(req_hdr, HDR_VIA);
 	int n = strIsSubstr(&s, ThisCache2);
+	if (request->flags.worker && n)
+	    n--;
 	if (n) {
 	    debugObj(33, 1, "WARNING: Forwarding loop detected for:\n",
 		request, (ObjPackMethod) & httpRequestPackDebug);
@@ -1643,7 +1659,7 @@ clientIfRangeMatch(clientHttpRequest * http, HttpReply * rep)
     }
     /* got modification time? */
     else if (spec.time >= 0) {
-	return http->entry->lastmod == spec.time;
+	return storeTime(http->entry->lastmod) == spec.time;
     }
     assert(0);			/* should not happen */
     return 0;
@@ -1715,7 +1731,7 @@ clientBuildRangeHeader(clientHttpRequest * http, HttpReply * rep)
 	range_err = "too complex range header";
     else if (!request->flags.cachable)	/* from we_do_ranges in http.c */
 	range_err = "non-cachable request";
-    else if (!http->flags.hit && httpHdrRangeOffsetLimit(http->request->range))
+    else if (!http->flags.hit && httpHdrRangeOffsetLimit(http->request->range) && !videoCacheRangeFromFull(request))
 	range_err = "range outside range_offset_limit";
     /* get rid of our range specs on error */
     if (range_err) {
@@ -1734,11 +1750,16 @@ clientBuildRangeHeader(clientHttpRequest * http, HttpReply * rep)
 	    HttpHdrRangePos pos = HttpHdrRangeInitPos;
 	    const HttpHdrRangeSpec *spec = httpHdrRangeGetSpec(http->request->range, &pos);
 	    assert(spec);
-	    /* append Content-Range */
-	    httpHeaderAddContRange(hdr, *spec, rep->content_length);
-	    /* set new Content-Length to the actual number of bytes
-	     * transmitted in the message-body */
-	    actual_clen = spec->length;
+	    if (request->video.seek) {
+		/* a pseudo-streaming seek is a whole FLV file to the client */
+		actual_clen = sizeof(videoFlvSeekHeader) + spec->length;
+	    } else {
+		/* append Content-Range */
+		httpHeaderAddContRange(hdr, *spec, rep->content_length);
+		/* set new Content-Length to the actual number of bytes
+		 * transmitted in the message-body */
+		actual_clen = spec->length;
+	    }
 	} else {
 	    /* multipart! */
 	    /* generate boundary string */
@@ -1833,7 +1854,7 @@ clientBuildReplyHeader(clientHttpRequest * http, HttpReply * rep)
 	    if (EBIT_TEST(http->entry->flags, ENTRY_SPECIAL)) {
 		httpHeaderDelById(hdr, HDR_DATE);
 		httpHeaderInsertTime(hdr, 0, HDR_DATE, squid_curtime);
-	    } else if (http->entry->timestamp < 0) {
+	    } else if (storeTime(http->entry->timestamp) < 0) {
 		(void) 0;
 	    } else if (http->conn->port->act_as_origin) {
 		HttpHeaderEntry *h = httpHeaderFindEntry(hdr, HDR_DATE);
@@ -1842,18 +1863,18 @@ clientBuildReplyHeader(clientHttpRequest * http, HttpReply * rep)
 		httpHeaderDelById(hdr, HDR_DATE);
 		httpHeaderInsertTime(hdr, 0, HDR_DATE, squid_curtime);
 		h = httpHeaderFindEntry(hdr, HDR_EXPIRES);
-		if (h && http->entry->expires >= 0) {
+		if (h && storeTime(http->entry->expires) >= 0) {
 		    httpHeaderPutExt(hdr, "X-Origin-Expires", strBuf(h->value));
 		    httpHeaderDelById(hdr, HDR_EXPIRES);
-		    httpHeaderInsertTime(hdr, 1, HDR_EXPIRES, squid_curtime + http->entry->expires - http->entry->timestamp);
+		    httpHeaderInsertTime(hdr, 1, HDR_EXPIRES, squid_curtime + storeTime(http->entry->expires) - storeTime(http->entry->timestamp));
 		} {
 		    char age[64];
-		    snprintf(age, sizeof(age), "%ld", (long int) squid_curtime - http->entry->timestamp);
+		    snprintf(age, sizeof(age), "%ld", (long int) squid_curtime - storeTime(http->entry->timestamp));
 		    httpHeaderPutExt(hdr, "X-Cache-Age", age);
 		}
-	    } else if (http->entry->timestamp < squid_curtime) {
+	    } else if (storeTime(http->entry->timestamp) < squid_curtime) {
 		httpHeaderPutInt(hdr, HDR_AGE,
-		    squid_curtime - http->entry->timestamp);
+		    squid_curtime - storeTime(http->entry->timestamp));
 	    }
 	    if (!httpHeaderHas(hdr, HDR_CONTENT_LENGTH) && http->entry->mem_obj && http->entry->store_status == STORE_OK) {
 		rep->content_length = contentLen(http->entry);
@@ -2003,7 +2024,7 @@ clientCloneReply(clientHttpRequest * http, HttpReply * orig_rep)
 	/* do header conversions */
 	clientBuildReplyHeader(http, rep);
 	/* if we do ranges, change status to "Partial Content" */
-	if (http->request->range)
+	if (http->request->range && !http->request->video.seek)
 	    httpStatusLineSet(&rep->sline, rep->sline.version,
 		HTTP_PARTIAL_CONTENT, NULL);
     } else {
@@ -2171,8 +2192,8 @@ clientAsyncRefresh(clientHttpRequest * http)
     httpHeaderDelById(&request->header, HDR_IF_RANGE);
     httpHeaderDelById(&request->header, HDR_IF_NONE_MATCH);
     httpHeaderDelById(&request->header, HDR_IF_MATCH);
-    if (async->old_entry->lastmod > 0)
-	request->lastmod = async->old_entry->lastmod;
+    if (storeTime(async->old_entry->lastmod) > 0)
+	request->lastmod = storeTime(async->old_entry->lastmod);
     else if (async->old_entry->mem_obj && async->old_entry->mem_obj->reply)
 	request->lastmod = async->old_entry->mem_obj->reply->date;
     else
@@ -2263,7 +2284,8 @@ clientCacheHit(void *data, HttpReply * rep)
 	    return;
 	}
 	/* We currently don't enforce that memObjects with storeurl's -require- a request with a storeurl */
-	if (strcmp(mem->url, urlCanonical(r)) != 0) {
+	/* Video objects are keyed by video ID, so their URLs legitimately differ */
+	if (!r->video.id && strcmp(mem->url, urlCanonical(r)) != 0) {
 	    debug(33, 1) ("clientCacheHit: (store url '%s'); URL mismatch '%s' != '%s'?\n", r->store_url, e->mem_obj->url, urlCanonical(r));
 	    clientProcessMiss(http);
 	    return;
@@ -2462,7 +2484,7 @@ clientProcessHit(clientHttpRequest * http)
     StoreEntry *e = http->entry;
 
     if (is_modified == 0) {
-	time_t timestamp = e->timestamp;
+	store_time_t timestamp = e->timestamp;
 	MemBuf mb = httpPacked304Reply(e->mem_obj->reply, http->conn->port->http11);
 	http->log_type = LOG_TCP_IMS_HIT;
 	storeClientUnregister(http->sc, e, http);
@@ -2563,6 +2585,11 @@ clientPackRange(clientHttpRequest * http,
 	    mb
 	    );
     }
+    /*
+     * a pseudo-streaming seek starts with a fresh FLV header
+     */
+    if (http->request->video.seek && i->debt_size == i->spec->length)
+	memBufAppend(mb, videoFlvSeekHeader, sizeof(videoFlvSeekHeader));
     /*
      * append content
      */
@@ -3175,6 +3202,142 @@ clientWriteBodyComplete(int fd, char *buf, size_t size, int errflag, void *data)
     clientWriteComplete(fd, NULL, size, errflag, data);
 }
 
+#if HAVE_SYS_SENDFILE_H || HAVE_SYS_UIO_H
+/*
+ * How much of the reply body is left to send from out.offset as one run
+ * of the stored object: 0 if the rest has to be put together by
+ * clientSendMoreData (multipart ranges, chunking, the FLV header of a
+ * seek, or a connection that is not a plain socket), or -1 if it runs
+ * to the end of an object that is still being stored.
+ */
+static squid_off_t
+clientReplyRunLeft(clientHttpRequest * http)
+{
+    HttpHdrRangeIter *i = &http->range_iter;
+    if (http->request->flags.chunked_response)
+	return 0;
+    if (fd_table[http->conn->fd].write_method != &default_write_method)
+	return 0;
+    if (http->request->range) {
+	/* a single range, past the FLV header of a seek */
+	if (http->request->range->specs.count > 1 || !i->spec)
+	    return 0;
+	if (http->request->video.seek && i->debt_size == i->spec->length)
+	    return 0;
+	return i->debt_size;
+    }
+    if (http->entry->store_status != STORE_OK)
+	return -1;
+    return objectLen(http->entry) - http->out.offset;
+}
+
+static void
+clientWriteRunComplete(int fd, char *bufnotused, size_t size, int errflag, void *data)
+{
+    clientHttpRequest *http = data;
+    http->out.offset += size;
+    if (http->request->range) {
+	http->range_iter.debt_size -= size;
+	if (!http->range_iter.debt_size)
+	    http->flags.done_copying = 1;
+    }
+    clientWriteComplete(fd, NULL, size, errflag, http);
+}
+#endif
+
+#if HAVE_SYS_SENDFILE_H
+/*
+ * Open the swap file of a disk hit for clientSendFile().  Replies that
+ * go through a delay pool are left to the store client, which is where
+ * the pool is applied.
+ */
+static int
+clientSendFileOpen(clientHttpRequest * http)
+{
+    StoreEntry *e = http->entry;
+    struct stat sb;
+    char *path;
+    int file;
+#if DELAY_POOLS
+    if (delayClient(http))
+	return 0;
+#endif
+    if ((path = storeSwapFilePath(e)) == NULL)
+	return 0;
+    if ((file = file_open(path, O_RDONLY | O_BINARY)) < 0)
+	return 0;
+    if (fstat(file, &sb) < 0 || sb.st_size != e->swap_file_sz) {
+	debug(33, 2) ("clientSendFileOpen: %s does not hold %s\n", path, storeUrl(e));
+	file_close(file);
+	return 0;
+    }
+    debug(33, 3) ("clientSendFileOpen: FD %d holds %s for FD %d\n", file, path, http->conn->fd);
+    http->out.file = file;
+    http->flags.sendfile = 1;
+    return 1;
+}
+
+/*
+ * Send the rest of a disk hit to the client straight from its swap file,
+ * rather than copying it through the store client, if what is left is
+ * one run of the file.  Large objects go in CLIENT_SENDFILE_MAX pieces.
+ * The file is opened once for the first piece and held in out.file
+ * until the request is freed.  Returns 0 if the reply has to take the
+ * copy path.
+ */
+static int
+clientSendFile(clientHttpRequest * http)
+{
+    StoreEntry *e = http->entry;
+    MemObject *mem = e->mem_obj;
+    int fd = http->conn->fd;
+    squid_off_t size;
+
+    if (!Config.onoff.client_sendfile)
+	return 0;
+    if (e->store_status != STORE_OK || e->swap_status != SWAPOUT_DONE || e->mem_status == IN_MEMORY)
+	return 0;
+    if (!mem->swap_hdr_sz)
+	return 0;
+    size = clientReplyRunLeft(http);
+    if (size <= 0 || clientReplyBodyTooLarge(http, http->out.offset + size - 4096))
+	return 0;
+    if (size > CLIENT_SENDFILE_MAX)
+	size = CLIENT_SENDFILE_MAX;	/* the rest follows when this is written */
+    if (!http->flags.sendfile && !clientSendFileOpen(http))
+	return 0;
+    debug(33, 3) ("clientSendFile: FD %d sending %" PRINTF_OFF_T " bytes of %s\n", fd, size, storeUrl(e));
+    comm_sendfile(fd, http->out.file, mem->swap_hdr_sz + http->out.offset, (size_t) size, clientWriteRunComplete, http);
+    return 1;
+}
+#endif
+
+#if HAVE_SYS_UIO_H
+/*
+ * Write the memory pages holding the next run of the reply body to the
+ * client with one writev(), rather than copying them 4 KB at a time into
+ * a store client buffer.  Returns 0 if the reply has to take the copy
+ * path, which also waits for data not yet in memory.
+ */
+static int
+clientSendMem(clientHttpRequest * http)
+{
+    squid_off_t size = clientReplyRunLeft(http);
+    mem_iovec *v;
+
+    if (size == 0)
+	return 0;
+    if (size < 0 || size > MEM_IOVEC_MAX * (squid_off_t) mem_page_size)
+	size = MEM_IOVEC_MAX * (squid_off_t) mem_page_size;
+    if (clientReplyBodyTooLarge(http, http->out.offset + size - 4096))
+	return 0;
+    if ((v = storeClientRef(http->sc, http->entry, http->out.offset, size)) == NULL)
+	return 0;
+    comm_writev(http->conn->fd, v->iov, v->n, clientWriteRunComplete, http, stmemIovecFree, v);
+    return 1;
+}
+#endif
+
 static void
 clientKeepaliveNextRequest(clientHttpRequest * http)
 {
@@ -3303,6 +3466,14 @@ clientWriteComplete(int fd, char *bufnotused, size_t size, int errflag, void *da
     } else if (clientReplyBodyTooLarge(http, http->out.offset - 4096)) {
 	/* 4096 is a margin for the HTTP headers included in out.offset */
 	comm_close(fd);
+#if HAVE_SYS_SENDFILE_H
+    } else if (clientSendFile(http)) {
+	/* the rest of a disk hit goes straight from the swap file */
+#endif
+#if HAVE_SYS_UIO_H
+    } else if (clientSendMem(http)) {
+	/* what is in memory goes out from the pages it is in */
+#endif
     } else {
 	/* More data will be coming from primary server; register with 
 	 * storage manager. */
@@ -3467,7 +3638,7 @@ clientProcessRequest2(clientHttpRequest * http)
 	debug(33, 3) ("clientProcessRequest2: complex range MISS\n");
 	http->entry = NULL;
 	return LOG_TCP_MISS;
-    } else if (clientCheckRangeForceMiss(e, r->range)) {
+    } else if (!videoCacheRangeFromFull(r) && clientCheckRangeForceMiss(e, r->range)) {
 	debug(33, 3) ("clientProcessRequest2: forcing miss due to range_offset_limit\n");
 	http->entry = NULL;
 	return LOG_TCP_MISS;
@@ -3533,6 +3704,14 @@ clientProcessRequest(clientHttpRequest * http)
 	}
 	/* yes, continue */
 	http->log_type = LOG_TCP_MISS;
+    } else if (!http->redirect.status && videoSegmentable(r)) {
+	http->log_type = LOG_TCP_MISS;
+	http->entry = clientCreateStoreEntry(http, r->method, null_request_flags);
+	if (videoSegmentStart(r, http->entry)) {
+	    http->log_type = LOG_TCP_HIT;
+	    http->flags.hit = 1;
+	}
+	return;
     } else {
 	http->log_type = clientProcessRequest2(http);
     }
@@ -3933,12 +4112,14 @@ clientTryParseRequest(ConnStateData * conn)
     int parser_return_code = 0;
     request_t *request = NULL;
     HttpMsgBuf msg;
+    size_t i;
 
 
     /* Skip leading (and trailing) whitespace */
-    while (conn->in.offset > 0 && xisspace(conn->in.buf[0])) {
-	xmemmove(conn->in.buf, conn->in.buf + 1, conn->in.offset - 1);
-	conn->in.offset--;
+    for (i = 0; i < conn->in.offset && xisspace(conn->in.buf[i]); i++);
+    if (i > 0) {
+	xmemmove(conn->in.buf, conn->in.buf + i, conn->in.offset - i);
+	conn->in.offset -= i;
     }
     conn->in.buf[conn->in.offset] = '\0';	/* Terminate the string */
     if (conn->in.offset == 0)
@@ -4042,6 +4223,7 @@ clientTryParseRequest(ConnStateData * conn)
 #if FOLLOW_X_FORWARDED_FOR
 	request->indirect_client_addr = request->client_addr;
 #endif /* FOLLOW_X_FORWARDED_FOR */
+	request->flags.worker = workerRequestCheck(request, conn->port->worker);
 	request->my_addr = conn->me.sin_addr;
 	request->my_port = ntohs(conn->me.sin_port);
 	request->http_ver = http->http_ver;
@@ -4662,9 +4844,11 @@ clientNegotiateSSL(int fd, void *data)
 	int ssl_error = SSL_get_error(ssl, ret);
 	switch (ssl_error) {
 	case SSL_ERROR_WANT_READ:
+	    fd_table[fd].flags.read_ready = 0;
 	    commSetSelect(fd, COMM_SELECT_READ, clientNegotiateSSL, conn, 0);
 	    return;
 	case SSL_ERROR_WANT_WRITE:
+	    fd_table[fd].flags.write_ready = 0;
 	    commSetSelect(fd, COMM_SELECT_WRITE, clientNegotiateSSL, conn, 0);
 	    return;
 	case SSL_ERROR_SYSCALL:
@@ -4936,6 +5120,53 @@ checkFailureRatio(err_type etype, hier_code hcode)
     request_failure_ratio = 0.8;	/* reset to something less than 1.0 */
 }
 
+/*
+ * Open the loopback port the other workers forward requests for the
+ * objects in our cache to.  The port is picked by the kernel and
+ * published in the shared cache index.
+ */
+static void
+clientWorkerConnectionOpen(void)
+{
+    CBDATA_TYPE(http_port_list);
+    static http_port_list *s = NULL;
+    socklen_t len = sizeof(struct sockaddr_in);
+    int fd;
+    if (s == NULL) {
+	CBDATA_INIT_TYPE(http_port_list);
+	s = cbdataAlloc(http_port_list);
+	s->name = xstrdup("worker");
+	s->protocol = xstrdup("http");
+	s->worker = 1;
+    }
+    if (MAXHTTPPORTS == NHttpSockets) {
+	debug(1, 1) ("WARNING: No room left for the worker HTTP port\n");
+	return;
+    }
+    fd = comm_open(SOCK_STREAM,
+	IPPROTO_TCP,
+	local_addr,
+	0,
+	COMM_NONBLOCKING,
+	"Worker HTTP Socket");
+    if (fd < 0)
+	return;
+    if (getsockname(fd, (struct sockaddr *) &s->s, &len) < 0) {
+	debug(1, 0) ("clientWorkerConnectionOpen: FD %d: getsockname: %s\n", fd, xstrerror());
+	comm_close(fd);
+	return;
+    }
+    comm_listen(fd);
+    commSetSelect(fd, COMM_SELECT_READ, httpAccept, s, 0);
+    commSetDefer(fd, httpAcceptDefer, NULL);
+    debug(1, 1) ("Accepting requests from the other workers at %s, port %d, FD %d.\n",
+	inet_ntoa(s->s.sin_addr),
+	(int) ntohs(s->s.sin_port),
+	fd);
+    HttpSockets[NHttpSockets++] = fd;
+    workerSetPort(ntohs(s->s.sin_port));
+}
+
 static void
 clientHttpConnectionsOpen(void)
 {
@@ -4966,7 +5197,7 @@ clientHttpConnectionsOpen(void)
 		IPPROTO_TCP,
 		s->s.sin_addr,
 		ntohs(s->s.sin_port),
-		COMM_NONBLOCKING,
+		COMM_NONBLOCKING | (worker_id ? COMM_REUSEPORT : 0),
 		"HTTP Socket");
 	    leave_suid();
 	}
@@ -4988,6 +5219,8 @@ clientHttpConnectionsOpen(void)
 	    fd);
 	HttpSockets[NHttpSockets++] = fd;
     }
+    if (worker_id)
+	clientWorkerConnectionOpen();
 }
 
 #if USE_SSL
@@ -5009,7 +5242,7 @@ clientHttpsConnectionsOpen(void)
 	    IPPROTO_TCP,
 	    s->http.s.sin_addr,
 	    ntohs(s->http.s.sin_port),
-	    COMM_NONBLOCKING,
+	    COMM_NONBLOCKING | (worker_id ? COMM_REUSEPORT : 0),
 	    "HTTPS Socket");
 	leave_suid();
 	if (fd < 0)
@@ -53,7 +53,8 @@ void
 clientRedirectStart(clientHttpRequest * http)
 {
     debug(33, 5) ("clientRedirectStart: '%s'\n", http->uri);
-    if (Config.Program.url_rewrite.command == NULL) {
+    /* the worker a request is forwarded by has rewritten it already */
+    if (Config.Program.url_rewrite.command == NULL || http->request->flags.worker) {
 	clientRedirectDone(http, NULL);
 	return;
     }
@@ -63,6 +63,7 @@ typedef struct {
 /* STATIC */
 static int commBind(int s, struct in_addr, u_short port);
 static void commSetReuseAddr(int);
+static void commSetReusePort(int);
 static void commSetNoLinger(int);
 static void CommWriteStateCallbackAndFree(int fd, int code);
 #ifdef TCP_NODELAY
@@ -98,6 +99,7 @@ CommWriteStateCallbackAndFree(int fd, int code)
 	CommWriteState->buf = NULL;
 	free_func(free_buf);
     }
+    CommWriteState->file = -1;
     callback = CommWriteState->handler;
     data = CommWriteState->handler_data;
     CommWriteState->handler = NULL;
@@ -239,10 +241,13 @@ comm_fdopenex(int new_socket,
     F = &fd_table[new_socket];
     F->local_addr = addr;
     F->tos = tos;
+    F->flags.stream = sock_type == SOCK_STREAM;
     if (!(flags & COMM_NOCLOEXEC))
 	commSetCloseOnExec(new_socket);
     if ((flags & COMM_REUSEADDR))
 	commSetReuseAddr(new_socket);
+    if ((flags & COMM_REUSEPORT))
+	commSetReusePort(new_socket);
     if (port > (u_short) 0) {
 #ifdef _SQUID_MSWIN_
 	if (sock_type != SOCK_DGRAM)
@@ -395,7 +400,7 @@ commResetFD(ConnectStateData * cs)
 	return 0;
     }
     /* We are about to close the fd (dup2 over it). Unregister from the event loop */
-    commSetEvents(cs->fd, 0, 0);
+    commClose(cs->fd);
 #ifdef _SQUID_MSWIN_
     /* On Windows dup2() can't work correctly on Sockets, the          */
     /* workaround is to close the destination Socket before call them. */
@@ -409,6 +414,7 @@ commResetFD(ConnectStateData * cs)
 	return 0;
     }
     close(fd2);
+    commOpen(cs->fd);
     F = &fd_table[cs->fd];
     fd_table[cs->fd].flags.called_connect = 0;
     /*
@@ -535,8 +541,10 @@ comm_connect_addr(int sock, const struct sockaddr_in *address)
 	F->flags.called_connect = 1;
 	statCounter.syscalls.sock.connects++;
 	x = connect(sock, (struct sockaddr *) address, sizeof(*address));
-	if (x < 0)
+	if (x < 0) {
 	    debug(5, 9) ("connect FD %d: %s\n", sock, xstrerror());
+	    F->flags.write_ready = 0;	/* wait for the connect to complete */
+	}
     } else {
 #if defined(_SQUID_NEWSOS6_)
 	/* Makoto MATSUSHITA <matusita@ics.es.osaka-u.ac.jp> */
@@ -594,6 +602,8 @@ comm_accept(int fd, struct sockaddr_in *pn, struct sockaddr_in *me)
     Slen = sizeof(P);
     statCounter.syscalls.sock.accepts++;
     if ((sock = accept(fd, (struct sockaddr *) &P, &Slen)) < 0) {
+	if (errno == EAGAIN)
+	    fd_table[fd].flags.read_ready = 0;
 	if (ignoreErrno(errno) || errno == ECONNREFUSED || errno == ECONNABORTED) {
 	    debug(5, 5) ("comm_accept: FD %d: %s\n", fd, xstrerror());
 	    return COMM_NOMESSAGE;
@@ -619,6 +629,7 @@ comm_accept(int fd, struct sockaddr_in *pn, struct sockaddr_in *me)
     xstrncpy(F->ipaddr, xinet_ntoa(P.sin_addr), 16);
     F->remote_port = htons(P.sin_port);
     F->local_port = htons(M.sin_port);
+    F->flags.stream = 1;
     commSetNonBlocking(sock);
     return sock;
 }
@@ -978,6 +989,19 @@ commSetReuseAddr(int fd)
 	debug(5, 1) ("commSetReuseAddr: FD %d: %s\n", fd, xstrerror());
 }
 
+/* Let the workers each bind the same port, the kernel sharing out connections */
+static void
+commSetReusePort(int fd)
+{
+#ifdef SO_REUSEPORT
+    int on = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (char *) &on, sizeof(on)) < 0)
+	debug(5, 1) ("commSetReusePort: FD %d: %s\n", fd, xstrerror());
+#else
+    debug(5, 1) ("commSetReusePort: FD %d: SO_REUSEPORT not supported on this platform\n", fd);
+#endif
+}
+
 static void
 commSetTcpRcvbuf(int fd, int size)
 {
@@ -1174,7 +1198,7 @@ static void
 commHandleWrite(int fd, void *data)
 {
     int len = 0;
-    int nleft;
+    size_t nleft;
     CommWriteStateData *state = &fd_table[fd].rwstate;
 
     assert(state->valid);
@@ -1183,6 +1207,21 @@ commHandleWrite(int fd, void *data)
 	fd, (long int) state->offset, (long int) state->header_size, (long int) state->size);
 
     nleft = state->size + state->header_size - state->offset;
+#if HAVE_SYS_SENDFILE_H
+    if (state->file >= 0) {
+	off_t off = state->file_offset + state->offset;
+	len = sendfile(fd, state->file, &off, XMIN(nleft, COMM_SENDFILE_MAX));
+	if (len < 0 ? errno == EAGAIN : (size_t) len < XMIN(nleft, COMM_SENDFILE_MAX))
+	    fd_table[fd].flags.write_ready = 0;
+    } else
+#endif
+#if HAVE_SYS_UIO_H
+    if (state->iov) {
+	len = writev(fd, state->iov, state->iovcnt);
+	if (len < 0 ? errno == EAGAIN : (size_t) len < nleft)
+	    fd_table[fd].flags.write_ready = 0;
+    } else
+#endif
     if (state->offset < state->header_size)
 	len = FD_WRITE_METHOD(fd, state->header + state->offset, state->header_size - state->offset);
     else
@@ -1195,7 +1234,7 @@ commHandleWrite(int fd, void *data)
 	/* Note we even call write if nleft == 0 */
 	/* We're done */
 	if (nleft != 0)
-	    debug(5, 1) ("commHandleWrite: FD %d: write failure: connection closed with %d bytes remaining.\n", fd, nleft);
+	    debug(5, 1) ("commHandleWrite: FD %d: write failure: connection closed with %ld bytes remaining.\n", fd, (long int) nleft);
 	CommWriteStateCallbackAndFree(fd, nleft ? COMM_ERROR : COMM_OK);
     } else if (len < 0) {
 	/* An error */
@@ -1220,6 +1259,18 @@ commHandleWrite(int fd, void *data)
 	/* A successful write, continue */
 	state->offset += len;
 	if (state->offset < state->size + state->header_size) {
+#if HAVE_SYS_UIO_H
+	    /* skip what was written of the vector */
+	    while (state->iov && (size_t) len >= state->iov->iov_len) {
+		len -= state->iov->iov_len;
+		state->iov++;
+		state->iovcnt--;
+	    }
+	    if (state->iov) {
+		state->iov->iov_base = (char *) state->iov->iov_base + len;
+		state->iov->iov_len -= len;
+	    }
+#endif
 	    /* Not done, reinstall the write handler and write some more */
 	    commSetSelect(fd,
 		COMM_SELECT_WRITE,
@@ -1249,6 +1300,10 @@ comm_write(int fd, const char *buf, int size, CWCB * handler, void *handler_data
     state->buf = (char *) buf;
     state->size = size;
     state->header_size = 0;
+    state->file = -1;
+#if HAVE_SYS_UIO_H
+    state->iov = NULL;
+#endif
     state->offset = 0;
     state->handler = handler;
     state->handler_data = handler_data;
@@ -1272,6 +1327,10 @@ comm_write_header(int fd, const char *buf, int size, const char *header, size_t
     }
     state->buf = (char *) buf;
     state->size = size;
+    state->file = -1;
+#if HAVE_SYS_UIO_H
+    state->iov = NULL;
+#endif
     state->offset = 0;
     state->handler = handler;
     state->handler_data = handler_data;
@@ -1298,6 +1357,78 @@ comm_write_mbuf_header(int fd, MemBuf mb, const char *header, size_t header_size
     comm_write_header(fd, mb.buf, mb.size, header, header_size, handler, handler_data, memBufFreeFunc(&mb));
 }
 
+#if HAVE_SYS_SENDFILE_H
+/*
+ * Like comm_write, but send size bytes of the open file from offset
+ * without copying them through user space.  The file stays open, the
+ * caller closes it when it is done with it.
+ */
+void
+comm_sendfile(int fd, int file, squid_off_t offset, size_t size, CWCB * handler, void *handler_data)
+{
+    CommWriteStateData *state = &fd_table[fd].rwstate;
+    debug(5, 5) ("comm_sendfile: FD %d: file %d, off %" PRINTF_OFF_T ", sz %ld: hndl %p: data %p.\n",
+	fd, file, offset, (long int) size, handler, handler_data);
+    assert(fd_table[fd].write_method == &default_write_method);
+    if (state->valid) {
+	debug(5, 1) ("comm_sendfile: fd_table[%d].rwstate.valid == true!\n", fd);
+	fd_table[fd].rwstate.valid = 0;
+    }
+    state->buf = NULL;
+    state->size = size;
+    state->header_size = 0;
+    state->file = file;
+    state->file_offset = offset;
+#if HAVE_SYS_UIO_H
+    state->iov = NULL;
+#endif
+    state->offset = 0;
+    state->handler = handler;
+    state->handler_data = handler_data;
+    state->free_func = NULL;
+    state->valid = 1;
+    cbdataLock(handler_data);
+    commSetSelect(fd, COMM_SELECT_WRITE, commHandleWrite, NULL, 0);
+}
+#endif
+
+#if HAVE_SYS_UIO_H
+/*
+ * Like comm_write, but gather the data from iovcnt buffers with
+ * writev().  The vector is used in place, so must stay with comm until
+ * the callback; free_func is called with free_buf once it is written.
+ */
+void
+comm_writev(int fd, struct iovec *iov, int iovcnt, CWCB * handler, void *handler_data, FREE * free_func, void *free_buf)
+{
+    CommWriteStateData *state = &fd_table[fd].rwstate;
+    size_t size = 0;
+    int i;
+    for (i = 0; i < iovcnt; i++)
+	size += iov[i].iov_len;
+    debug(5, 5) ("comm_writev: FD %d: %d buffers, sz %ld: hndl %p: data %p.\n",
+	fd, iovcnt, (long int) size, handler, handler_data);
+    assert(fd_table[fd].write_method == &default_write_method);
+    if (state->valid) {
+	debug(5, 1) ("comm_writev: fd_table[%d].rwstate.valid == true!\n", fd);
+	fd_table[fd].rwstate.valid = 0;
+    }
+    state->buf = free_buf;
+    state->size = size;
+    state->header_size = 0;
+    state->file = -1;
+    state->iov = iov;
+    state->iovcnt = iovcnt;
+    state->offset = 0;
+    state->handler = handler;
+    state->handler_data = handler_data;
+    state->free_func = free_func;
+    state->valid = 1;
+    cbdataLock(handler_data);
+    commSetSelect(fd, COMM_SELECT_WRITE, commHandleWrite, NULL, 0);
+}
+#endif
+
 /*
  * hm, this might be too general-purpose for all the places we'd
  * like to use it.
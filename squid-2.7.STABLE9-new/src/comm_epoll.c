@@ -36,13 +36,30 @@
 
 #include <sys/epoll.h>
 
-#define MAX_EVENTS	256	/* max events to process in one go */
+#define MIN_EVENTS	256	/* events to process in one go, at least.. */
+#define MAX_EVENTS	4096	/* ..and at most */
 
 /* epoll structs */
 static int kdpfd;
-static struct epoll_event events[MAX_EVENTS];
+static struct epoll_event *events;
+static int max_events;
 static int epoll_fds = 0;
 static unsigned *epoll_state;	/* keep track of the epoll state */
+static int epoll_ctl_calls = 0;
+static int epoll_edge_fds = 0;
+
+/*
+ * Edge triggered sockets are added once with EPOLLIN|EPOLLOUT|EPOLLET.
+ * epoll_state then holds EPOLLET plus the events the handlers currently
+ * want, and readiness is remembered in fd_table[fd].flags.read_ready /
+ * write_ready until a read or write comes up short. Sockets which are
+ * ready for what their handlers want are queued here and dispatched
+ * without asking the kernel again.
+ */
+static int *epoll_ready;
+static int *epoll_ready_next;
+static int n_epoll_ready = 0;
+static char *epoll_queued;
 
 #include "comm_generic.c"
 
@@ -75,6 +92,17 @@ do_select_init()
     commSetCloseOnExec(kdpfd);
 
     epoll_state = xcalloc(Squid_MaxFD, sizeof(*epoll_state));
+
+    max_events = Squid_MaxFD >> 2;
+    if (max_events < MIN_EVENTS)
+	max_events = MIN_EVENTS;
+    if (max_events > MAX_EVENTS)
+	max_events = MAX_EVENTS;
+    events = xcalloc(max_events, sizeof(*events));
+
+    epoll_ready = xcalloc(Squid_MaxFD, sizeof(*epoll_ready));
+    epoll_ready_next = xcalloc(Squid_MaxFD, sizeof(*epoll_ready_next));
+    epoll_queued = xcalloc(Squid_MaxFD, sizeof(*epoll_queued));
 }
 
 void
@@ -90,12 +118,20 @@ do_select_shutdown()
     close(kdpfd);
     kdpfd = -1;
     safe_free(epoll_state);
+    safe_free(events);
+    safe_free(epoll_ready);
+    safe_free(epoll_ready_next);
+    safe_free(epoll_queued);
+    n_epoll_ready = 0;
 }
 
 void
 comm_select_status(StoreEntry * sentry)
 {
     storeAppendPrintf(sentry, "\tIO loop method:                     epoll\n");
+    storeAppendPrintf(sentry, "\tepoll events per wait:              %d\n", max_events);
+    storeAppendPrintf(sentry, "\tepoll_ctl calls:                    %d\n", epoll_ctl_calls);
+    storeAppendPrintf(sentry, "\tEdge triggered sockets:             %d\n", epoll_edge_fds);
 }
 
 void
@@ -103,10 +139,75 @@ commOpen(int fd)
 {
 }
 
+static void
+commEpollQueue(int fd)
+{
+    if (epoll_queued[fd])
+	return;
+    epoll_queued[fd] = 1;
+    epoll_ready[n_epoll_ready++] = fd;
+}
+
 void
 commClose(int fd)
 {
-    commSetEvents(fd, 0, 0);
+    fde *F = &fd_table[fd];
+    struct epoll_event ev;
+
+    if (!(epoll_state[fd] & EPOLLET)) {
+	commSetEvents(fd, 0, 0);
+	return;
+    }
+    /* The fd may still be shared with a child process, so don't rely on close() */
+    memset(&ev, 0, sizeof(ev));
+    epoll_ctl_calls++;
+    if (epoll_ctl(kdpfd, EPOLL_CTL_DEL, fd, &ev) < 0)
+	debug(5, 1) ("commClose: epoll_ctl(EPOLL_CTL_DEL): failed on fd=%d: %s\n", fd, xstrerror());
+    if (epoll_state[fd] & (EPOLLIN | EPOLLOUT))
+	epoll_fds--;
+    epoll_edge_fds--;
+    epoll_state[fd] = 0;
+    F->flags.read_ready = 0;
+    F->flags.write_ready = 0;
+    /* a queued entry is skipped, or serves the next user of this fd */
+}
+
+static void
+commSetEventsEdge(int fd, int need_read, int need_write)
+{
+    fde *F = &fd_table[fd];
+    unsigned state = EPOLLET;
+
+    if (need_read)
+	state |= EPOLLIN;
+    if (need_write)
+	state |= EPOLLOUT;
+
+    if (!epoll_state[fd]) {
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+	ev.data.fd = fd;
+	F->flags.read_ready = 0;
+	F->flags.write_ready = 0;
+	epoll_ctl_calls++;
+	if (epoll_ctl(kdpfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+	    debug(5, 1) ("commSetEvents: epoll_ctl(EPOLL_CTL_ADD): failed on fd=%d: %s\n",
+		fd, xstrerror());
+	    return;
+	}
+	epoll_edge_fds++;
+    }
+    if ((state & (EPOLLIN | EPOLLOUT)) && !(epoll_state[fd] & (EPOLLIN | EPOLLOUT)))
+	epoll_fds++;
+    else if (!(state & (EPOLLIN | EPOLLOUT)) && (epoll_state[fd] & (EPOLLIN | EPOLLOUT)))
+	epoll_fds--;
+    epoll_state[fd] = state;
+
+    if ((need_read && F->flags.read_ready) || (need_write && F->flags.write_ready))
+	commEpollQueue(fd);
+    else if ((need_read || need_write) && (F->read_pending == COMM_PENDING_NOW || F->write_pending == COMM_PENDING_NOW))
+	commEpollQueue(fd);
 }
 
 void
@@ -118,6 +219,15 @@ commSetEvents(int fd, int need_read, int need_write)
     assert(fd >= 0);
     debug(5, 8) ("commSetEvents(fd=%d)\n", fd);
 
+    if (epoll_state[fd] & EPOLLET) {
+	commSetEventsEdge(fd, need_read, need_write);
+	return;
+    }
+    if (!epoll_state[fd] && (need_read || need_write) && fd_table[fd].flags.stream && Config.onoff.epoll_edge_triggered) {
+	commSetEventsEdge(fd, need_read, need_write);
+	return;
+    }
+
     if (RUNNING_ON_VALGRIND) {
 	/* Keep valgrind happy.. complains about uninitialized bytes otherwise */
 	memset(&ev, 0, sizeof(ev));
@@ -147,6 +257,7 @@ commSetEvents(int fd, int need_read, int need_write)
 	/* Update the state */
 	epoll_state[fd] = ev.events;
 
+	epoll_ctl_calls++;
 	if (epoll_ctl(kdpfd, epoll_ctl_type, fd, &ev) < 0) {
 	    debug(5, 1) ("commSetEvents: epoll_ctl(%s): failed on fd=%d: %s\n",
 		epolltype_atoi(epoll_ctl_type), fd, xstrerror());
@@ -164,6 +275,30 @@ commSetEvents(int fd, int need_read, int need_write)
     }
 }
 
+/* Call the handlers of the edge triggered sockets queued so far */
+static void
+comm_call_ready(void)
+{
+    int *ready = epoll_ready;
+    int n = n_epoll_ready;
+    int i;
+
+    /* Sockets requeued by their handlers wait for the next round */
+    epoll_ready = epoll_ready_next;
+    epoll_ready_next = ready;
+    n_epoll_ready = 0;
+
+    for (i = 0; i < n; i++) {
+	int fd = ready[i];
+	fde *F = &fd_table[fd];
+	unsigned state = epoll_state[fd];
+	epoll_queued[fd] = 0;
+	if (!(state & EPOLLET))
+	    continue;		/* closed since */
+	comm_call_handlers(fd, (state & EPOLLIN) && F->flags.read_ready, (state & EPOLLOUT) && F->flags.write_ready);
+    }
+}
+
 static int
 do_comm_select(int msec)
 {
@@ -174,8 +309,11 @@ do_comm_select(int msec)
 	assert(shutting_down);
 	return COMM_SHUTDOWN;
     }
+    /* Don't sleep while queued sockets can make progress */
+    if (n_epoll_ready)
+	msec = 0;
     statCounter.syscalls.polls++;
-    num = epoll_wait(kdpfd, events, MAX_EVENTS, msec);
+    num = epoll_wait(kdpfd, events, max_events, msec);
     saved_errno = errno;
     getCurrentTime();
     debug(5, 5) ("do_comm_select: %d fds ready\n", num);
@@ -188,12 +326,36 @@ do_comm_select(int msec)
     }
     statHistCount(&statCounter.select_fds_hist, num);
 
-    if (num == 0)
+    if (num == 0 && !n_epoll_ready)
 	return COMM_TIMEOUT;
 
+    /*
+     * Note the readiness of all edge triggered sockets first, so that
+     * handlers called during this round see the whole batch.
+     */
     for (i = 0; i < num; i++) {
-	comm_call_handlers(events[i].data.fd, events[i].events & ~EPOLLOUT, events[i].events & ~EPOLLIN);
+	int fd = events[i].data.fd;
+	unsigned ev = events[i].events;
+	fde *F;
+	if (!(epoll_state[fd] & EPOLLET))
+	    continue;
+	F = &fd_table[fd];
+	if (ev & (EPOLLIN | EPOLLHUP | EPOLLERR))
+	    F->flags.read_ready = 1;
+	if (ev & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+	    F->flags.write_ready = 1;
+	if ((epoll_state[fd] & EPOLLIN && F->flags.read_ready) || (epoll_state[fd] & EPOLLOUT && F->flags.write_ready))
+	    commEpollQueue(fd);
     }
 
+    for (i = 0; i < num; i++) {
+	int fd = events[i].data.fd;
+	if (epoll_state[fd] & EPOLLET)
+	    continue;
+	comm_call_handlers(fd, events[i].events & ~EPOLLOUT, events[i].events & ~EPOLLIN);
+    }
+
+    comm_call_ready();
+
     return COMM_OK;
 }
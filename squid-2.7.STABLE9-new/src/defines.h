@@ -93,6 +93,7 @@
 #define COMM_NONBLOCKING	0x01
 #define COMM_NOCLOEXEC		0x02
 #define COMM_REUSEADDR		0x04
+#define COMM_REUSEPORT		0x08
 
 #define do_debug(SECTION, LEVEL) \
 	((_db_level = (LEVEL)) <= debugLevels[SECTION])
@@ -168,6 +169,9 @@
 
 #define SM_PAGE_SIZE 4096
 
+/* mem_node pages are carved from chunks of this size, the usual huge page */
+#define STMEM_CHUNK_SIZE (2 << 20)
+
 #define EBIT_SET(flag, bit) 	((void)((flag) |= ((1L<<(bit)))))
 #define EBIT_CLR(flag, bit) 	((void)((flag) &= ~((1L<<(bit)))))
 #define EBIT_TEST(flag, bit) 	((flag) & ((1L<<(bit))))
@@ -301,6 +305,17 @@
 
 #define STORE_CLIENT_BUF_SZ 4096
 
+/* Most a single sendfile() call is asked to send, so one client does not
+ * hold up the others while the kernel reads its file */
+#define COMM_SENDFILE_MAX (256 << 10)
+
+/* Most of a swap file handed to one comm_sendfile(), so that the write
+ * size fits a size_t and the callback's byte count on any platform */
+#define CLIENT_SENDFILE_MAX (64 << 20)
+
+/* Most memory pages written to a client in one go */
+#define MEM_IOVEC_MAX 64
+
 #define URI_WHITESPACE_STRIP 0
 #define URI_WHITESPACE_ALLOW 1
 #define URI_WHITESPACE_ENCODE 2
@@ -357,9 +372,30 @@
 #define FILE_MODE(x) ((x)&(O_RDONLY|O_WRONLY|O_RDWR))
 #endif
 
-/* swap_filen is 25 bits, signed */
-#define FILEMAP_MAX_SIZE (1<<24)
+/*
+ * swap_filen is a full sfileno.  Stay well clear of INT_MAX so
+ * "filen + count" arithmetic in the store modules cannot overflow.
+ */
+#define STORE_FILEN_MAX 0x3FFFFFFF
+#define FILEMAP_MAX_SIZE (1<<30)
 #define FILEMAP_MAX (FILEMAP_MAX_SIZE - 65536)
+/*
+ * swap.state format.  Version 1 and headerless logs may carry a 2.4-era
+ * cache_dir index above the low 24 bits of swap_filen, which is masked
+ * off when they are read.  From version 2 on swap_filen is stored whole.
+ */
+#define STORE_SWAP_LOG_VERSION 2
+/* swap_dirn is 19 bits, signed */
+#define STORE_DIRN_MAX ((1<<18) - 1)
+
+/*
+ * StoreEntry times are 32-bit offsets from STORE_TIME_BASE, which
+ * covers 1936 to 2072.  Negative times (usually -1, "unknown") are
+ * kept as STORE_TIME_UNSET.
+ */
+#define STORE_TIME_BASE ((time_t) 1 << 30)
+#define STORE_TIME_UNSET (-2147483647 - 1)
+#define storeTime(t) ((t) == STORE_TIME_UNSET ? (time_t) -1 : STORE_TIME_BASE + (time_t) (t))
 
 #define	DLINK_ISEMPTY(n)	( (n).head == NULL )
 #define	DLINK_HEAD(n)		( (n).head->data )
@@ -337,6 +337,7 @@ typedef enum {
     USERHASH_PARENT,
     SOURCEHASH_PARENT,
     PINNED,
+    WORKER_HIT,
     HIER_MAX
 } hier_code;
 
@@ -602,6 +603,7 @@ typedef enum {
     MEM_AUTH_USER_HASH,
     MEM_ACL_PROXY_AUTH_MATCH,
     MEM_ACL_USER_DATA,
+    MEM_ACL_IP_LIST,
     MEM_ACL_TIME_DATA,
 #if USE_CACHE_DIGESTS
     MEM_CACHE_DIGEST,
@@ -627,7 +629,9 @@ typedef enum {
     MEM_IPCACHE_ENTRY,
     MEM_MD5_DIGEST,
     MEM_MEMOBJECT,
-    MEM_MEM_NODE,
+#if HAVE_SYS_UIO_H
+    MEM_MEM_IOVEC,
+#endif
     MEM_NETDBENTRY,
     MEM_NET_DB_NAME,
     MEM_RELIST,
@@ -128,16 +128,26 @@ file_write_method(int fd, const char *buf, int len)
 }
 #endif
 
+/*
+ * A short read or write, or EAGAIN, means the socket buffer has been
+ * exhausted. Edge triggered comm loops wait for a new event after that.
+ */
 int
 default_read_method(int fd, char *buf, int len)
 {
-    return (read(fd, buf, len));
+    int x = read(fd, buf, len);
+    if (x < 0 ? errno == EAGAIN : x < len)
+	fd_table[fd].flags.read_ready = 0;
+    return x;
 }
 
 int
 default_write_method(int fd, const char *buf, int len)
 {
-    return (write(fd, buf, len));
+    int x = write(fd, buf, len);
+    if (x < 0 ? errno == EAGAIN : x < len)
+	fd_table[fd].flags.write_ready = 0;
+    return x;
 }
 
 void
@@ -75,7 +75,7 @@ file_map_grow(fileMap * fm)
     int old_sz = fm->nwords * sizeof(*fm->file_map);
     void *old_map = fm->file_map;
     fm->max_n_files <<= 1;
-    assert(fm->max_n_files <= FILEMAP_MAX_SIZE);	/* swap_filen is 25 bits, signed */
+    assert(fm->max_n_files <= FILEMAP_MAX_SIZE);
     fm->nwords = fm->max_n_files >> LONG_BIT_SHIFT;
     debug(8, 3) ("file_map_grow: creating space for %d files\n", fm->max_n_files);
     fm->file_map = xcalloc(fm->nwords, sizeof(*fm->file_map));
@@ -150,6 +150,8 @@ file_map_allocate(fileMap * fm, int suggestion)
 void
 filemapFreeMemory(fileMap * fm)
 {
+    if (fm == NULL)
+	return;		/* cache_dir never initialised */
     safe_free(fm->file_map);
     safe_free(fm);
 }
@@ -234,9 +234,11 @@ fwdNegotiateSSL(int fd, void *data)
 	int ssl_error = SSL_get_error(ssl, ret);
 	switch (ssl_error) {
 	case SSL_ERROR_WANT_READ:
+	    fd_table[fd].flags.read_ready = 0;
 	    commSetSelect(fd, COMM_SELECT_READ, fwdNegotiateSSL, fwdState, 0);
 	    return;
 	case SSL_ERROR_WANT_WRITE:
+	    fd_table[fd].flags.write_ready = 0;
 	    commSetSelect(fd, COMM_SELECT_WRITE, fwdNegotiateSSL, fwdState, 0);
 	    return;
 	default:
@@ -1013,7 +1015,7 @@ fwdCheckDeferRead(int fd, void *data)
 	 * is disk clients pending on a too large object being fetched and a
 	 * few other corner cases.
 	 */
-	if (fd >= 0 && mem->inmem_hi - mem->inmem_lo > SM_PAGE_SIZE + Config.Store.maxInMemObjSize + Config.readAheadGap) {
+	if (fd >= 0 && mem->inmem_hi - mem->inmem_lo > mem_page_size + Config.Store.maxInMemObjSize + Config.readAheadGap) {
 	    storeDeferRead(e, fd);
 	    return 1;
 	}
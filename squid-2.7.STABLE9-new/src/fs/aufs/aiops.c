@@ -336,6 +336,11 @@ squidaio_init(void)
 	    j = 3;
 	}
 #endif
+	j = 8;
+	for (i = 0; i < n_extent_dirs; i++) {
+	    squidaio_nthreads += j;
+	    j = 4;
+	}
     }
     if (squidaio_nthreads == 0)
 	squidaio_nthreads = THREAD_FACTOR;
@@ -0,0 +1,1021 @@
+/*
+ * $Id$
+ *
+ * DEBUG: section 43    AIOPS
+ *
+ * SQUID Web Proxy Cache          http://www.squid-cache.org/
+ * ----------------------------------------------------------
+ *
+ *  Squid is the result of efforts by numerous individuals from
+ *  the Internet community; see the CONTRIBUTORS file for full
+ *  details.   Many organizations have provided support for Squid's
+ *  development; see the SPONSORS file for full details.  Squid is
+ *  Copyrighted (C) 2001 by the Regents of the University of
+ *  California; see the COPYRIGHT file for full details.  Squid
+ *  incorporates software developed and/or copyrighted by other
+ *  sources; see the CREDITS file for full details.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111, USA.
+ *
+ */
+
+/*
+ * The squidaio interface of aiops.c done through a Linux io_uring
+ * instead of a pool of threads.  Requests are put on the submission
+ * ring as they come and handed to the kernel all at once, from the
+ * main loop or when the ring fills.  Completions are read straight
+ * off the completion ring; the ring descriptor itself is what wakes
+ * up the main loop.  Operations the running kernel lacks are done
+ * synchronously.
+ */
+
+#include "squid.h"
+#include "async_io.h"
+
+#if !HAVE_LINUX_IO_URING_H
+#error "--with-aufs-io-uring needs <linux/io_uring.h>"
+#endif
+
+#include	<stdio.h>
+#include	<sys/types.h>
+#include	<sys/stat.h>
+#include	<sys/syscall.h>
+#include	<sys/sysmacros.h>
+#include	<sys/uio.h>
+#include	<fcntl.h>
+#include	<errno.h>
+#include	<linux/io_uring.h>
+
+#define RIDICULOUS_LENGTH	4096
+
+/* Submission ring size, the completion ring being twice that */
+#define URING_ENTRIES		256
+/* Registered memory for read buffers */
+#define URING_FIXED_BYTES	(4 << 20)
+#define URING_FIXED_MIN		16
+
+int squidaio_nthreads = 0;	/* no threads here */
+int squidaio_magic1 = 1;	/* dummy initializer value */
+int squidaio_magic2 = 1;	/* real value set in squidaio_init */
+
+enum _squidaio_request_type {
+    _AIO_OP_NONE = 0,
+    _AIO_OP_OPEN,
+    _AIO_OP_READ,
+    _AIO_OP_WRITE,
+    _AIO_OP_CLOSE,
+    _AIO_OP_UNLINK,
+    _AIO_OP_TRUNCATE,
+    _AIO_OP_OPENDIR,
+    _AIO_OP_STAT
+};
+typedef enum _squidaio_request_type squidaio_request_type;
+
+typedef struct squidaio_request_t {
+    struct squidaio_request_t *next;
+    squidaio_request_type request_type;
+    int cancelled;
+    char *path;
+    int oflag;
+    mode_t mode;
+    int fd;
+    char *bufferp;
+    int buflen;
+    off_t offset;
+    int whence;
+    int ret;
+    int err;
+    struct stat *tmpstatp;
+    struct stat *statp;
+    struct statx *statxp;
+    squidaio_result_t *resultp;
+} squidaio_request_t;
+
+typedef struct {
+    squidaio_request_t *head, **tailp;
+} squidaio_request_queue_t;
+
+static struct {
+    int fd;
+    unsigned int sq_entries;
+    unsigned int cq_entries;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_array;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_sz;
+    void *cq_ring;
+    size_t cq_ring_sz;
+    size_t sqes_sz;
+    unsigned int inflight;	/* in the kernel's hands */
+    int submit_scheduled;
+    unsigned char supported[IORING_OP_LAST];
+} ring;
+
+/* The registered read buffers, in mem_page_size slots */
+static struct {
+    char *base;
+    size_t size;
+    size_t slot_size;
+    int slots;
+    int *free_slots;
+    int n_free;
+    unsigned char *state;
+} fixed;
+
+#define SLOT_INFLIGHT	1	/* the kernel is reading into it */
+#define SLOT_RELEASED	2	/* freed while in flight */
+
+static struct {
+    unsigned long enters;
+    unsigned long submitted;
+    unsigned long waits;
+    unsigned long fixed_reads;
+    unsigned long synchronous;
+    unsigned long deferred;
+} squidaio_uring_counts;
+
+static void squidaio_queue_request(squidaio_request_t *);
+static void squidaio_cleanup_request(squidaio_request_t *);
+static void squidaio_do_sync(squidaio_request_t *);
+static void squidaio_debug(squidaio_request_t *);
+static void squidaio_poll_queues(void);
+
+static int squidaio_initialised = 0;
+
+#define AIO_LARGE_BUFS  16384
+#define AIO_MEDIUM_BUFS	AIO_LARGE_BUFS >> 1
+#define AIO_SMALL_BUFS	AIO_LARGE_BUFS >> 2
+#define AIO_TINY_BUFS	AIO_LARGE_BUFS >> 3
+#define AIO_MICRO_BUFS	128
+
+static MemPool *squidaio_large_bufs = NULL;	/* 16K */
+static MemPool *squidaio_medium_bufs = NULL;	/* 8K */
+static MemPool *squidaio_small_bufs = NULL;	/* 4K */
+static MemPool *squidaio_tiny_bufs = NULL;	/* 2K */
+static MemPool *squidaio_micro_bufs = NULL;	/* 128K */
+
+static int request_queue_len = 0;
+static MemPool *squidaio_request_pool = NULL;
+/* waiting for room on the rings */
+static squidaio_request_queue_t request_queue =
+{NULL, &request_queue.head};
+static squidaio_request_queue_t done_requests =
+{NULL, &done_requests.head};
+
+static int
+io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int
+io_uring_register(int fd, unsigned int opcode, void *arg, unsigned int nr_args)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static MemPool *
+squidaio_get_pool(int size)
+{
+    MemPool *p;
+    if (size <= AIO_LARGE_BUFS) {
+	if (size <= AIO_MICRO_BUFS)
+	    p = squidaio_micro_bufs;
+	else if (size <= AIO_TINY_BUFS)
+	    p = squidaio_tiny_bufs;
+	else if (size <= AIO_SMALL_BUFS)
+	    p = squidaio_small_bufs;
+	else if (size <= AIO_MEDIUM_BUFS)
+	    p = squidaio_medium_bufs;
+	else
+	    p = squidaio_large_bufs;
+    } else
+	p = NULL;
+    return p;
+}
+
+static int
+squidaio_fixed_slot(const void *p)
+{
+    if (!fixed.base || (const char *) p < fixed.base || (const char *) p >= fixed.base + fixed.size)
+	return -1;
+    return ((const char *) p - fixed.base) / fixed.slot_size;
+}
+
+static void
+squidaio_fixed_release(int slot)
+{
+    fixed.state[slot] = 0;
+    fixed.free_slots[fixed.n_free++] = slot;
+}
+
+/*
+ * Buffers of more than AIO_TINY_BUFS and up to a memory page come
+ * from the registered slots while there are any; aioRead() reads
+ * into these.
+ */
+void *
+squidaio_xmalloc(int size)
+{
+    void *p;
+    MemPool *pool;
+
+    if (fixed.n_free && size > AIO_TINY_BUFS && size <= fixed.slot_size)
+	return fixed.base + fixed.free_slots[--fixed.n_free] * fixed.slot_size;
+    if ((pool = squidaio_get_pool(size)) != NULL) {
+	p = memPoolAlloc(pool);
+    } else
+	p = xmalloc(size);
+
+    return p;
+}
+
+static char *
+squidaio_xstrdup(const char *str)
+{
+    char *p;
+    int len = strlen(str) + 1;
+
+    p = squidaio_xmalloc(len);
+    strncpy(p, str, len);
+
+    return p;
+}
+
+void
+squidaio_xfree(void *p, int size)
+{
+    MemPool *pool;
+    int slot;
+
+    if ((slot = squidaio_fixed_slot(p)) >= 0) {
+	/* a cancelled read may still be going on into it */
+	if (fixed.state[slot] & SLOT_INFLIGHT)
+	    fixed.state[slot] |= SLOT_RELEASED;
+	else
+	    squidaio_fixed_release(slot);
+    } else if ((pool = squidaio_get_pool(size)) != NULL) {
+	memPoolFree(pool, p);
+    } else
+	xfree(p);
+}
+
+static void
+squidaio_xstrfree(char *str)
+{
+    squidaio_xfree(str, strlen(str) + 1);
+}
+
+static void
+squidaio_fdhandler(int fd, void *data)
+{
+    /* completions are picked up by squidaio_poll_done() */
+    commSetSelect(fd, COMM_SELECT_READ, squidaio_fdhandler, NULL, 0);
+}
+
+static void
+squidaio_probe(void)
+{
+    struct io_uring_probe *probe;
+    size_t len = sizeof(*probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    int i;
+
+    probe = xcalloc(1, len);
+    if (io_uring_register(ring.fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0) {
+	debug(43, 1) ("squidaio_init: io_uring probe: %s\n", xstrerror());
+    } else {
+	for (i = 0; i < probe->ops_len && i < IORING_OP_LAST; i++)
+	    ring.supported[i] = (probe->ops[i].flags & IO_URING_OP_SUPPORTED) ? 1 : 0;
+    }
+    xfree(probe);
+}
+
+/*
+ * Register a run of mem_page_size slots for reads, so the kernel
+ * does not map the buffer in on each one.
+ */
+static void
+squidaio_fixed_init(void)
+{
+    struct iovec iov;
+    int i;
+
+    fixed.slot_size = mem_page_size;
+    fixed.slots = URING_FIXED_BYTES / fixed.slot_size;
+    if (fixed.slots < URING_FIXED_MIN)
+	fixed.slots = URING_FIXED_MIN;
+    fixed.size = fixed.slots * fixed.slot_size;
+    fixed.base = mmap(NULL, fixed.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (fixed.base == MAP_FAILED) {
+	debug(43, 1) ("squidaio_init: no registered buffers: mmap: %s\n", xstrerror());
+	fixed.base = NULL;
+	return;
+    }
+    iov.iov_base = fixed.base;
+    iov.iov_len = fixed.size;
+    if (io_uring_register(ring.fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+	debug(43, 1) ("squidaio_init: no registered buffers: %s\n", xstrerror());
+	munmap(fixed.base, fixed.size);
+	fixed.base = NULL;
+	return;
+    }
+    fixed.free_slots = xcalloc(fixed.slots, sizeof(int));
+    fixed.state = xcalloc(fixed.slots, 1);
+    for (i = fixed.slots - 1; i >= 0; i--)
+	fixed.free_slots[fixed.n_free++] = i;
+}
+
+void
+squidaio_init(void)
+{
+    struct io_uring_params p;
+
+    if (squidaio_initialised)
+	return;
+
+    memset(&p, 0, sizeof(p));
+    if ((ring.fd = io_uring_setup(URING_ENTRIES, &p)) < 0)
+	fatalf("squidaio_init: io_uring_setup: %s\n", xstrerror());
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP))
+	fatal("squidaio_init: this kernel's io_uring is too old");
+    ring.sq_entries = p.sq_entries;
+    ring.cq_entries = p.cq_entries;
+
+    /* the submission and completion rings share a mapping */
+    ring.sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    ring.cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (ring.cq_ring_sz > ring.sq_ring_sz)
+	ring.sq_ring_sz = ring.cq_ring_sz;
+    ring.sq_ring = mmap(NULL, ring.sq_ring_sz, PROT_READ | PROT_WRITE,
+	MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    if (ring.sq_ring == MAP_FAILED)
+	fatalf("squidaio_init: io_uring ring mmap: %s\n", xstrerror());
+    ring.cq_ring = ring.sq_ring;
+    ring.sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqes = mmap(NULL, ring.sqes_sz, PROT_READ | PROT_WRITE,
+	MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED)
+	fatalf("squidaio_init: io_uring sqe mmap: %s\n", xstrerror());
+    ring.sq_head = (unsigned int *) ((char *) ring.sq_ring + p.sq_off.head);
+    ring.sq_tail = (unsigned int *) ((char *) ring.sq_ring + p.sq_off.tail);
+    ring.sq_mask = (unsigned int *) ((char *) ring.sq_ring + p.sq_off.ring_mask);
+    ring.sq_array = (unsigned int *) ((char *) ring.sq_ring + p.sq_off.array);
+    ring.cq_head = (unsigned int *) ((char *) ring.cq_ring + p.cq_off.head);
+    ring.cq_tail = (unsigned int *) ((char *) ring.cq_ring + p.cq_off.tail);
+    ring.cq_mask = (unsigned int *) ((char *) ring.cq_ring + p.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *) ((char *) ring.cq_ring + p.cq_off.cqes);
+
+    squidaio_probe();
+    squidaio_fixed_init();
+
+    fd_open(ring.fd, FD_UNKNOWN, "async-io completion ring");
+    commSetCloseOnExec(ring.fd);
+    commSetSelect(ring.fd, COMM_SELECT_READ, squidaio_fdhandler, NULL, 0);
+
+    squidaio_magic1 = ring.sq_entries;
+    squidaio_magic2 = ring.sq_entries * 2;
+
+    /* Create request pool */
+    squidaio_request_pool = memPoolCreate("aio_request", sizeof(squidaio_request_t));
+    squidaio_large_bufs = memPoolCreate("squidaio_large_bufs", AIO_LARGE_BUFS);
+    squidaio_medium_bufs = memPoolCreate("squidaio_medium_bufs", AIO_MEDIUM_BUFS);
+    squidaio_small_bufs = memPoolCreate("squidaio_small_bufs", AIO_SMALL_BUFS);
+    squidaio_tiny_bufs = memPoolCreate("squidaio_tiny_bufs", AIO_TINY_BUFS);
+    squidaio_micro_bufs = memPoolCreate("squidaio_micro_bufs", AIO_MICRO_BUFS);
+
+    debug(43, 1) ("Using io_uring for async disk I/O: %u entries, %d KB registered for reads\n",
+	ring.sq_entries, (int) (fixed.base ? fixed.size >> 10 : 0));
+    squidaio_initialised = 1;
+}
+
+void
+squidaio_shutdown(void)
+{
+    if (!squidaio_initialised)
+	return;
+
+    squidaio_sync();
+
+    fd_close(ring.fd);
+    close(ring.fd);
+    munmap(ring.sqes, ring.sqes_sz);
+    munmap(ring.sq_ring, ring.sq_ring_sz);
+    if (fixed.base) {
+	munmap(fixed.base, fixed.size);
+	safe_free(fixed.free_slots);
+	safe_free(fixed.state);
+	memset(&fixed, 0, sizeof(fixed));
+    }
+    squidaio_initialised = 0;
+}
+
+/*
+ * Hand the prepared entries to the kernel.  The submission ring head
+ * moves as it takes them, whatever io_uring_enter() returns.
+ */
+static void
+squidaio_submit(void)
+{
+    unsigned int pending;
+    int n;
+
+    ring.submit_scheduled = 0;
+    pending = *ring.sq_tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+    if (pending == 0)
+	return;
+    squidaio_uring_counts.enters++;
+    n = io_uring_enter(ring.fd, pending, 0, 0);
+    if (n < 0) {
+	if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+	    debug(43, 1) ("squidaio_submit: io_uring_enter: %s\n", xstrerror());
+	return;
+    }
+    squidaio_uring_counts.submitted += n;
+}
+
+static void
+squidaio_submit_event(void *unused)
+{
+    if (squidaio_initialised)
+	squidaio_submit();
+}
+
+/* Keep the main loop from sleeping until the next one */
+static void
+squidaio_schedule(void)
+{
+    if (ring.submit_scheduled)
+	return;
+    ring.submit_scheduled = 1;
+    eventAdd("squidaio_submit", squidaio_submit_event, NULL, 0.0, 0);
+}
+
+/* Put request on the submission ring, if it and the completion ring have room */
+static int
+squidaio_prep(squidaio_request_t * request)
+{
+    struct io_uring_sqe *sqe;
+    unsigned int tail = *ring.sq_tail;
+    unsigned int idx;
+    int slot;
+
+    if (ring.inflight >= ring.cq_entries)
+	return 0;
+    if (tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) >= ring.sq_entries) {
+	squidaio_submit();
+	if (tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) >= ring.sq_entries)
+	    return 0;
+    }
+    idx = tail & *ring.sq_mask;
+    sqe = &ring.sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = (unsigned long) request;
+    switch (request->request_type) {
+    case _AIO_OP_OPEN:
+	sqe->opcode = IORING_OP_OPENAT;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (unsigned long) request->path;
+	sqe->len = request->mode;
+	sqe->open_flags = request->oflag | O_CLOEXEC;
+	break;
+    case _AIO_OP_READ:
+	sqe->fd = request->fd;
+	sqe->addr = (unsigned long) request->bufferp;
+	sqe->len = request->buflen;
+	sqe->off = request->offset;
+	if ((slot = squidaio_fixed_slot(request->bufferp)) >= 0) {
+	    sqe->opcode = IORING_OP_READ_FIXED;
+	    sqe->buf_index = 0;
+	    fixed.state[slot] |= SLOT_INFLIGHT;
+	    squidaio_uring_counts.fixed_reads++;
+	} else
+	    sqe->opcode = IORING_OP_READ;
+	break;
+    case _AIO_OP_WRITE:
+	assert(request->offset >= 0);
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = request->fd;
+	sqe->addr = (unsigned long) request->bufferp;
+	sqe->len = request->buflen;
+	sqe->off = request->offset;
+	break;
+    case _AIO_OP_CLOSE:
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->fd = request->fd;
+	break;
+    case _AIO_OP_UNLINK:
+	sqe->opcode = IORING_OP_UNLINKAT;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (unsigned long) request->path;
+	break;
+    case _AIO_OP_STAT:
+	sqe->opcode = IORING_OP_STATX;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (unsigned long) request->path;
+	sqe->len = STATX_BASIC_STATS;
+	sqe->off = (unsigned long) request->statxp;
+	break;
+    default:
+	fatal_dump("squidaio_prep: bad request type");
+    }
+    ring.sq_array[idx] = idx;
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring.inflight++;
+    /* the kernel gets them all at once on the next loop */
+    squidaio_schedule();
+    return 1;
+}
+
+static int
+squidaio_ring_op(squidaio_request_t * request)
+{
+    switch (request->request_type) {
+    case _AIO_OP_OPEN:
+	return ring.supported[IORING_OP_OPENAT];
+    case _AIO_OP_READ:
+	return ring.supported[IORING_OP_READ] && ring.supported[IORING_OP_READ_FIXED];
+    case _AIO_OP_WRITE:
+	return ring.supported[IORING_OP_WRITE];
+    case _AIO_OP_CLOSE:
+	return ring.supported[IORING_OP_CLOSE];
+    case _AIO_OP_UNLINK:
+	return ring.supported[IORING_OP_UNLINKAT];
+    case _AIO_OP_STAT:
+	return ring.supported[IORING_OP_STATX];
+    default:
+	return 0;
+    }
+}
+
+static void
+squidaio_queue_request(squidaio_request_t * request)
+{
+    debug(43, 9) ("squidaio_queue_request: %p type=%d result=%p\n",
+	request, request->request_type, request->resultp);
+    /* Mark it as not executed (failing result, no error) */
+    request->ret = -1;
+    request->err = 0;
+    /* Internal housekeeping */
+    request_queue_len += 1;
+    request->resultp->_data = request;
+    request->next = NULL;
+    if (!squidaio_ring_op(request)) {
+	squidaio_uring_counts.synchronous++;
+	squidaio_do_sync(request);
+	*done_requests.tailp = request;
+	done_requests.tailp = &request->next;
+	request_queue_len -= 1;
+	squidaio_schedule();
+    } else if (request_queue.head || !squidaio_prep(request)) {
+	squidaio_uring_counts.deferred++;
+	*request_queue.tailp = request;
+	request_queue.tailp = &request->next;
+    }
+    /* Warn if seriously overloaded */
+    if (request_queue_len > RIDICULOUS_LENGTH) {
+	debug(43, 0) ("squidaio_queue_request: Async request queue growing uncontrollably!\n");
+	debug(43, 0) ("squidaio_queue_request: Syncing pending I/O operations.. (blocking)\n");
+	squidaio_sync();
+	debug(43, 0) ("squidaio_queue_request: Synced\n");
+    }
+}				/* squidaio_queue_request */
+
+static void
+squidaio_statx_to_stat(const struct statx *stx, struct stat *sb)
+{
+    memset(sb, 0, sizeof(*sb));
+    sb->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    sb->st_ino = stx->stx_ino;
+    sb->st_mode = stx->stx_mode;
+    sb->st_nlink = stx->stx_nlink;
+    sb->st_uid = stx->stx_uid;
+    sb->st_gid = stx->stx_gid;
+    sb->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+    sb->st_size = stx->stx_size;
+    sb->st_blksize = stx->stx_blksize;
+    sb->st_blocks = stx->stx_blocks;
+    sb->st_atime = stx->stx_atime.tv_sec;
+    sb->st_mtime = stx->stx_mtime.tv_sec;
+    sb->st_ctime = stx->stx_ctime.tv_sec;
+}
+
+/* A completion taken off the ring */
+static void
+squidaio_complete(squidaio_request_t * request, int res)
+{
+    int slot;
+
+    ring.inflight--;
+    request_queue_len -= 1;
+    if (res < 0) {
+	request->ret = -1;
+	request->err = -res;
+    } else {
+	request->ret = res;
+	request->err = 0;
+    }
+    switch (request->request_type) {
+    case _AIO_OP_OPEN:
+	if (request->ret >= 0)
+	    fd_table[request->ret].flags.close_on_exec = 1;
+	break;
+    case _AIO_OP_READ:
+	if ((slot = squidaio_fixed_slot(request->bufferp)) >= 0) {
+	    fixed.state[slot] &= ~SLOT_INFLIGHT;
+	    if (fixed.state[slot] & SLOT_RELEASED)
+		squidaio_fixed_release(slot);
+	}
+	break;
+    case _AIO_OP_STAT:
+	if (request->ret == 0)
+	    squidaio_statx_to_stat(request->statxp, request->tmpstatp);
+	break;
+    default:
+	break;
+    }
+    *done_requests.tailp = request;
+    done_requests.tailp = &request->next;
+}
+
+/* The operations the ring cannot do, the way aiops.c threads do them */
+static void
+squidaio_do_sync(squidaio_request_t * request)
+{
+    errno = 0;
+    switch (request->request_type) {
+    case _AIO_OP_OPEN:
+	request->ret = open(request->path, request->oflag, request->mode);
+	if (request->ret >= 0)
+	    commSetCloseOnExec(request->ret);
+	break;
+    case _AIO_OP_READ:
+	request->ret = pread(request->fd, request->bufferp, request->buflen, request->offset);
+	break;
+    case _AIO_OP_WRITE:
+	assert(request->offset >= 0);
+	request->ret = pwrite(request->fd, request->bufferp, request->buflen, request->offset);
+	break;
+    case _AIO_OP_CLOSE:
+	request->ret = close(request->fd);
+	break;
+    case _AIO_OP_UNLINK:
+	request->ret = unlink(request->path);
+	break;
+#if USE_TRUNCATE
+    case _AIO_OP_TRUNCATE:
+	request->ret = truncate(request->path, request->offset);
+	break;
+#endif
+    case _AIO_OP_STAT:
+	request->ret = stat(request->path, request->tmpstatp);
+	break;
+    default:
+	request->ret = -1;
+	errno = EINVAL;
+	break;
+    }
+    request->err = errno;
+}
+
+static void
+squidaio_cleanup_request(squidaio_request_t * requestp)
+{
+    squidaio_result_t *resultp = requestp->resultp;
+    int cancelled = requestp->cancelled;
+
+    /* Free allocated structures and copy data back to user space if the */
+    /* request hasn't been cancelled */
+    switch (requestp->request_type) {
+    case _AIO_OP_STAT:
+	if (!cancelled && requestp->ret == 0)
+	    xmemcpy(requestp->statp, requestp->tmpstatp, sizeof(struct stat));
+	squidaio_xfree(requestp->tmpstatp, sizeof(struct stat));
+	squidaio_xfree(requestp->statxp, sizeof(struct statx));
+	squidaio_xstrfree(requestp->path);
+	break;
+    case _AIO_OP_OPEN:
+	if (cancelled && requestp->ret >= 0)
+	    /* The open() was cancelled but completed */
+	    close(requestp->ret);
+	squidaio_xstrfree(requestp->path);
+	break;
+    case _AIO_OP_UNLINK:
+    case _AIO_OP_TRUNCATE:
+    case _AIO_OP_OPENDIR:
+	squidaio_xstrfree(requestp->path);
+	break;
+    default:
+	/* a close is never cancelled once queued here */
+	break;
+    }
+    if (resultp != NULL && !cancelled) {
+	resultp->aio_return = requestp->ret;
+	resultp->aio_errno = requestp->err;
+    }
+    memPoolFree(squidaio_request_pool, requestp);
+}				/* squidaio_cleanup_request */
+
+
+int
+squidaio_cancel(squidaio_result_t * resultp)
+{
+    squidaio_request_t *request = resultp->_data;
+
+    if (request && request->resultp == resultp) {
+	debug(43, 9) ("squidaio_cancel: %p type=%d result=%p\n",
+	    request, request->request_type, request->resultp);
+	request->cancelled = 1;
+	request->resultp = NULL;
+	resultp->_data = NULL;
+	return 0;
+    }
+    return 1;
+}				/* squidaio_cancel */
+
+
+int
+squidaio_open(const char *path, int oflag, mode_t mode, squidaio_result_t * resultp)
+{
+    squidaio_request_t *requestp;
+
+    requestp = memPoolAlloc(squidaio_request_pool);
+    requestp->path = (char *) squidaio_xstrdup(path);
+    requestp->oflag = oflag;
+    requestp->mode = mode;
+    requestp->resultp = resultp;
+    requestp->request_type = _AIO_OP_OPEN;
+    requestp->cancelled = 0;
+
+    squidaio_queue_request(requestp);
+    return 0;
+}
+
+
+int
+squidaio_read(int fd, char *bufp, int bufs, off_t offset, int whence, squidaio_result_t * resultp)
+{
+    squidaio_request_t *requestp;
+
+    requestp = memPoolAlloc(squidaio_request_pool);
+    requestp->fd = fd;
+    requestp->bufferp = bufp;
+    requestp->buflen = bufs;
+    requestp->offset = offset;
+    requestp->whence = whence;
+    requestp->resultp = resultp;
+    requestp->request_type = _AIO_OP_READ;
+    requestp->cancelled = 0;
+
+    squidaio_queue_request(requestp);
+    return 0;
+}
+
+
+int
+squidaio_write(int fd, char *bufp, int bufs, off_t offset, int whence, squidaio_result_t * resultp)
+{
+    squidaio_request_t *requestp;
+
+    requestp = memPoolAlloc(squidaio_request_pool);
+    requestp->fd = fd;
+    requestp->bufferp = bufp;
+    requestp->buflen = bufs;
+    requestp->offset = offset;
+    requestp->whence = whence;
+    requestp->resultp = resultp;
+    requestp->request_type = _AIO_OP_WRITE;
+    requestp->cancelled = 0;
+
+    squidaio_queue_request(requestp);
+    return 0;
+}
+
+
+int
+squidaio_close(int fd, squidaio_result_t * resultp)
+{
+    squidaio_request_t *requestp;
+
+    requestp = memPoolAlloc(squidaio_request_pool);
+    requestp->fd = fd;
+    requestp->resultp = resultp;
+    requestp->request_type = _AIO_OP_CLOSE;
+    requestp->cancelled = 0;
+
+    squidaio_queue_request(requestp);
+    return 0;
+}
+
+
+int
+squidaio_stat(const char *path, struct stat *sb, squidaio_result_t * resultp)
+{
+    squidaio_request_t *requestp;
+
+    requestp = memPoolAlloc(squidaio_request_pool);
+    requestp->path = (char *) squidaio_xstrdup(path);
+    requestp->statp = sb;
+    requestp->tmpstatp = (struct stat *) squidaio_xmalloc(sizeof(struct stat));
+    requestp->statxp = (struct statx *) squidaio_xmalloc(sizeof(struct statx));
+    requestp->resultp = resultp;
+    requestp->request_type = _AIO_OP_STAT;
+    requestp->cancelled = 0;
+
+    squidaio_queue_request(requestp);
+    return 0;
+}
+
+
+int
+squidaio_unlink(const char *path, squidaio_result_t * resultp)
+{
+    squidaio_request_t *requestp;
+
+    requestp = memPoolAlloc(squidaio_request_pool);
+    requestp->path = squidaio_xstrdup(path);
+    requestp->resultp = resultp;
+    requestp->request_type = _AIO_OP_UNLINK;
+    requestp->cancelled = 0;
+
+    squidaio_queue_request(requestp);
+    return 0;
+}
+
+
+#if USE_TRUNCATE
+int
+squidaio_truncate(const char *path, off_t length, squidaio_result_t * resultp)
+{
+    squidaio_request_t *requestp;
+
+    requestp = memPoolAlloc(squidaio_request_pool);
+    requestp->path = (char *) squidaio_xstrdup(path);
+    requestp->offset = length;
+    requestp->resultp = resultp;
+    requestp->request_type = _AIO_OP_TRUNCATE;
+    requestp->cancelled = 0;
+
+    squidaio_queue_request(requestp);
+    return 0;
+}
+
+#endif
+
+static void
+squidaio_poll_queues(void)
+{
+    squidaio_request_t *request;
+    unsigned int head, tail;
+
+    /* reap the completion ring */
+    head = *ring.cq_head;
+    tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+	struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+	squidaio_complete((squidaio_request_t *) (unsigned long) cqe->user_data, cqe->res);
+	head++;
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    /* move the waiting requests onto the ring as room comes free */
+    while ((request = request_queue.head) != NULL && squidaio_prep(request)) {
+	request_queue.head = request->next;
+	request->next = NULL;
+	if (!request_queue.head)
+	    request_queue.tailp = &request_queue.head;
+    }
+    squidaio_submit();
+}
+
+squidaio_result_t *
+squidaio_poll_done(void)
+{
+    squidaio_request_t *request;
+    squidaio_result_t *resultp;
+    int cancelled;
+    int polled = 0;
+
+  AIO_REPOLL:
+    request = done_requests.head;
+    if (request == NULL && !polled) {
+	squidaio_poll_queues();
+	polled = 1;
+	request = done_requests.head;
+    }
+    if (!request) {
+	return NULL;
+    }
+    debug(43, 9) ("squidaio_poll_done: %p type=%d result=%p\n",
+	request, request->request_type, request->resultp);
+    done_requests.head = request->next;
+    if (!done_requests.head)
+	done_requests.tailp = &done_requests.head;
+    resultp = request->resultp;
+    cancelled = request->cancelled;
+    squidaio_debug(request);
+    debug(43, 5) ("DONE: %d -> %d\n", request->ret, request->err);
+    squidaio_cleanup_request(request);
+    if (cancelled)
+	goto AIO_REPOLL;
+    return resultp;
+}				/* squidaio_poll_done */
+
+int
+squidaio_operations_pending(void)
+{
+    return request_queue_len + (done_requests.head ? 1 : 0);
+}
+
+int
+squidaio_sync(void)
+{
+    squidaio_poll_queues();
+    while (request_queue_len > 0) {
+	squidaio_uring_counts.waits++;
+	if (io_uring_enter(ring.fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+	    debug(43, 0) ("squidaio_sync: io_uring_enter: %s\n", xstrerror());
+	    break;
+	}
+	squidaio_poll_queues();
+    }
+    return squidaio_operations_pending();
+}
+
+int
+squidaio_get_queue_len(void)
+{
+    return request_queue_len;
+}
+
+static void
+squidaio_debug(squidaio_request_t * request)
+{
+    switch (request->request_type) {
+    case _AIO_OP_OPEN:
+	debug(43, 5) ("OPEN of %s to FD %d\n", request->path, request->ret);
+	break;
+    case _AIO_OP_READ:
+	debug(43, 5) ("READ on fd: %d\n", request->fd);
+	break;
+    case _AIO_OP_WRITE:
+	debug(43, 5) ("WRITE on fd: %d\n", request->fd);
+	break;
+    case _AIO_OP_CLOSE:
+	debug(43, 5) ("CLOSE of fd: %d\n", request->fd);
+	break;
+    case _AIO_OP_UNLINK:
+	debug(43, 5) ("UNLINK of %s\n", request->path);
+	break;
+    case _AIO_OP_TRUNCATE:
+	debug(43, 5) ("UNLINK of %s\n", request->path);
+	break;
+    default:
+	break;
+    }
+}
+
+void
+squidaio_stats(StoreEntry * sentry)
+{
+    if (!squidaio_initialised)
+	return;
+
+    storeAppendPrintf(sentry, "\n\nio_uring Status:\n");
+    storeAppendPrintf(sentry, "Ring entries\t%u submission, %u completion\n",
+	ring.sq_entries, ring.cq_entries);
+    storeAppendPrintf(sentry, "In flight\t%u\n", ring.inflight);
+    storeAppendPrintf(sentry, "Submit calls\t%lu\n", squidaio_uring_counts.enters);
+    storeAppendPrintf(sentry, "Submitted\t%lu\n", squidaio_uring_counts.submitted);
+    storeAppendPrintf(sentry, "Per call\t%.1f\n", squidaio_uring_counts.enters ?
+	(double) squidaio_uring_counts.submitted / squidaio_uring_counts.enters : 0.0);
+    storeAppendPrintf(sentry, "Blocking waits\t%lu\n", squidaio_uring_counts.waits);
+    storeAppendPrintf(sentry, "Waited for room\t%lu\n", squidaio_uring_counts.deferred);
+    storeAppendPrintf(sentry, "Done synchronously\t%lu\n", squidaio_uring_counts.synchronous);
+    storeAppendPrintf(sentry, "Registered reads\t%lu\n", squidaio_uring_counts.fixed_reads);
+    storeAppendPrintf(sentry, "Registered buffers\t%d of %d KB, %d in use\n",
+	fixed.slots, (int) (fixed.slot_size >> 10), fixed.slots - fixed.n_free);
+}
@@ -250,14 +250,14 @@ storeCossRemove(SwapDir * sd, StoreEntry * e)
 #if 0
     debug(1, 1) ("storeCossRemove: %x: %d/%d\n", e, (int) e->swap_dirn, (e) e->swap_filen);
 #endif
-    CossIndexNode *coss_node = e->repl.data;
+    CossIndexNode *coss_node = e->repl.u.data;
     /* Do what the LRU and HEAP repl policies do.. */
-    if (e->repl.data == NULL) {
+    if (e->repl.u.data == NULL) {
 	return;
     }
     assert(sd->index == e->swap_dirn);
     assert(e->swap_filen >= 0);
-    e->repl.data = NULL;
+    e->repl.u.data = NULL;
     stripe = storeCossFilenoToStripe(cs, e->swap_filen);
     dlinkDelete(&coss_node->node, &cs->stripes[stripe].objlist);
     memPoolFree(coss_index_pool, coss_node);
@@ -270,11 +270,11 @@ storeCossAdd(SwapDir * sd, StoreEntry * e, int curstripe)
     CossInfo *cs = (CossInfo *) sd->fsdata;
     CossStripe *cstripe = &cs->stripes[curstripe];
     CossIndexNode *coss_node = memPoolAlloc(coss_index_pool);
-    assert(!e->repl.data);
+    assert(!e->repl.u.data);
     assert(sd->index == e->swap_dirn);
     /* Make sure the object exists in the current stripe, it should do! */
     assert(curstripe == storeCossFilenoToStripe(cs, e->swap_filen));
-    e->repl.data = coss_node;
+    e->repl.u.data = coss_node;
     dlinkAddTail(e, &coss_node->node, &cstripe->objlist);
     cs->count += 1;
 }
@@ -462,14 +462,14 @@ storeCossDirWriteCleanEntry(SwapDir * sd, const StoreEntry * e)
     memset(&s, '\0', ss);
     s.op = (char) SWAP_LOG_ADD;
     s.swap_filen = e->swap_filen;
-    s.timestamp = e->timestamp;
-    s.lastref = e->lastref;
-    s.expires = e->expires;
-    s.lastmod = e->lastmod;
+    s.timestamp = storeTime(e->timestamp);
+    s.lastref = storeTime(e->lastref);
+    s.expires = storeTime(e->expires);
+    s.lastmod = storeTime(e->lastmod);
     s.swap_file_sz = e->swap_file_sz;
     s.refcount = e->refcount;
     s.flags = e->flags;
-    xmemcpy(&s.key, e->hash.key, SQUID_MD5_DIGEST_LENGTH);
+    xmemcpy(&s.key, e->key, SQUID_MD5_DIGEST_LENGTH);
     xmemcpy(state->outbuf + state->outbuf_offset, &s, ss);
     state->outbuf_offset += ss;
     /* buffered write */
@@ -553,14 +553,14 @@ storeCossDirSwapLog(const SwapDir * sd, const StoreEntry * e, int op)
     storeSwapLogData *s = memAllocate(MEM_SWAP_LOG_DATA);
     s->op = (char) op;
     s->swap_filen = e->swap_filen;
-    s->timestamp = e->timestamp;
-    s->lastref = e->lastref;
-    s->expires = e->expires;
-    s->lastmod = e->lastmod;
+    s->timestamp = storeTime(e->timestamp);
+    s->lastref = storeTime(e->lastref);
+    s->expires = storeTime(e->expires);
+    s->lastmod = storeTime(e->lastmod);
     s->swap_file_sz = e->swap_file_sz;
     s->refcount = e->refcount;
     s->flags = e->flags;
-    xmemcpy(s->key, e->hash.key, SQUID_MD5_DIGEST_LENGTH);
+    xmemcpy(s->key, e->key, SQUID_MD5_DIGEST_LENGTH);
     file_write(cs->swaplog_fd,
 	-1,
 	s,
@@ -856,11 +856,10 @@ storeCossDirParse(SwapDir * sd, int index, char *path)
     if (sd->max_objsize > COSS_MEMBUF_SZ)
 	fatalf("COSS max-size option must be less than COSS_MEMBUF_SZ (%d)\n", COSS_MEMBUF_SZ);
     /*
-     * check that we won't overflow sfileno later.  0xFFFFFF is the
-     * largest possible sfileno, assuming sfileno is a 25-bit
-     * signed integer, as defined in structs.h.
+     * check that we won't overflow sfileno later.  STORE_FILEN_MAX
+     * is the largest file number the store accepts, see defines.h.
      */
-    max_offset = (off_t) 0xFFFFFF << cs->blksz_bits;
+    max_offset = (off_t) STORE_FILEN_MAX << cs->blksz_bits;
     if ((sd->max_size + (cs->nummemstripes * (COSS_MEMBUF_SZ >> 10))) > (unsigned long) (max_offset >> 10)) {
 	debug(47, 1) ("COSS block-size = %d bytes\n", 1 << cs->blksz_bits);
 	debug(47, 1) ("COSS largest file offset = %lu KB\n", (unsigned long) max_offset >> 10);
@@ -1311,7 +1310,7 @@ storeDirCoss_ParseStripeBuffer(RebuildState * rb)
 		    debug(47, 1) ("COSS: %s: stripe %d: offset %d has invalid STORE_META_STD length. Ignoring object.\n", stripePath(SD), cs->rebuild.curstripe, j);
 		    goto nextobject;
 		}
-		xmemcpy(&tmpe.timestamp, t->value, STORE_HDR_METASIZE);
+		storeSwapMetaUnpackStd(&tmpe, t->value);
 		break;
 #else
 	    case STORE_META_STD_LFS:
@@ -1319,7 +1318,7 @@ storeDirCoss_ParseStripeBuffer(RebuildState * rb)
 		    debug(47, 1) ("COSS: %s: stripe %d: offset %d has invalid STORE_META_STD_LFS length. Ignoring object.\n", stripePath(SD), cs->rebuild.curstripe, j);
 		    goto nextobject;
 		}
-		xmemcpy(&tmpe.timestamp, t->value, STORE_HDR_METASIZE);
+		storeSwapMetaUnpackStd(&tmpe, t->value);
 		break;
 	    case STORE_META_STD:
 		if (t->length != STORE_HDR_METASIZE_OLD) {
@@ -1336,10 +1335,10 @@ storeDirCoss_ParseStripeBuffer(RebuildState * rb)
 			u_short flags;
 		    }     *tmp = t->value;
 		    assert(sizeof(*tmp) == STORE_HDR_METASIZE_OLD);
-		    tmpe.timestamp = tmp->timestamp;
-		    tmpe.lastref = tmp->lastref;
-		    tmpe.expires = tmp->expires;
-		    tmpe.lastmod = tmp->lastmod;
+		    tmpe.timestamp = storeTimeRel(tmp->timestamp);
+		    tmpe.lastref = storeTimeRel(tmp->lastref);
+		    tmpe.expires = storeTimeRel(tmp->expires);
+		    tmpe.lastmod = storeTimeRel(tmp->lastmod);
 		    tmpe.swap_file_sz = tmp->swap_file_sz;
 		    tmpe.refcount = tmp->refcount;
 		    tmpe.flags = tmp->flags;
@@ -1369,7 +1368,7 @@ storeDirCoss_ParseStripeBuffer(RebuildState * rb)
 	    goto nextobject;
 	}
 	rb->counts.scancount++;
-	tmpe.hash.key = key;
+	storeKeyCopy(tmpe.key, key);
 	/* Check sizes */
 	if (tmpe.swap_file_sz == 0) {
 	    tmpe.swap_file_sz = len + bl;
@@ -1436,8 +1435,8 @@ storeCoss_AddStoreEntry(RebuildState * rb, const cache_key * key, StoreEntry * e
     storeHashInsert(ne, key);	/* do it after we clear KEY_PRIVATE */
     storeCossAdd(SD, ne, cs->rebuild.curstripe);
     storeEntryDump(ne, 5);
-    assert(ne->repl.data != NULL);
-    assert(e->repl.data == NULL);
+    assert(ne->repl.u.data != NULL);
+    assert(e->repl.u.data == NULL);
 }
 
 static void
@@ -1482,7 +1481,7 @@ storeCoss_ConsiderStoreEntry(RebuildState * rb, const cache_key * key, StoreEntr
 
     /* Fresher? Its a new object: deallocate the old one, reallocate the new one */
     if (e->lastref > oe->lastref) {
-	debug(47, 3) ("COSS: fresher object for filen %d found (%ld -> %ld)\n", oe->swap_filen, (long int) oe->timestamp, (long int) e->timestamp);
+	debug(47, 3) ("COSS: fresher object for filen %d found (%ld -> %ld)\n", oe->swap_filen, (long int) storeTime(oe->timestamp), (long int) storeTime(e->timestamp));
 	rb->cosscounts.fresher++;
 	storeCoss_DeleteStoreEntry(rb, key, oe);
 	oe = NULL;
@@ -58,6 +58,7 @@ struct _RebuildState {
     struct {
 	unsigned int clean:1;
 	unsigned int init:1;
+	unsigned int old_filen:1;	/* swap_filen may carry a 2.4 cache_dir index */
     } flags;
     int done;
     int in_dir;
@@ -399,7 +400,11 @@ storeDiskdDirInit(SwapDir * sd)
 	debug(50, 0) ("storeDiskdInit: msgget: %s\n", xstrerror());
 	fatal("msgget failed");
     }
-    diskdinfo->shm.nbufs = diskdinfo->magic2 * 1.3;
+    if (mem_page_size > DISKD_MAX_WRITE_CHUNKS * SHMBUF_BLKSZ)
+	fatalf("cache_dir %s: diskd supports a memory_page_size of at most %d KB",
+	    sd->path, DISKD_MAX_WRITE_CHUNKS * SHMBUF_BLKSZ >> 10);
+    diskdinfo->shm.nbufs = diskdinfo->magic2 * 1.3 +
+	(mem_page_size + SHMBUF_BLKSZ - 1) / SHMBUF_BLKSZ;
     diskdinfo->shm.id = shmget((key_t) (ikey + 2),
 	diskdinfo->shm.nbufs * SHMBUF_BLKSZ, 0600 | IPC_CREAT);
     if (diskdinfo->shm.id < 0) {
@@ -413,6 +418,7 @@ storeDiskdDirInit(SwapDir * sd)
     }
     diskdinfo->shm.inuse_map = xcalloc((diskdinfo->shm.nbufs + 7) / 8, 1);
     diskd_stats.shmbuf_count += diskdinfo->shm.nbufs;
+    diskdinfo->shm.inuse = diskdinfo->shm.nbufs;
     for (i = 0; i < diskdinfo->shm.nbufs; i++) {
 	CBIT_SET(diskdinfo->shm.inuse_map, i);
 	storeDiskdShmPut(sd, i * SHMBUF_BLKSZ);
@@ -651,12 +657,12 @@ storeDiskdDirRebuildFromDirectory(void *data)
 #if SIZEOF_SQUID_FILE_SZ == SIZEOF_SIZE_T
 	    case STORE_META_STD:
 		assert(t->length == STORE_HDR_METASIZE);
-		xmemcpy(&tmpe.timestamp, t->value, STORE_HDR_METASIZE);
+		storeSwapMetaUnpackStd(&tmpe, t->value);
 		break;
 #else
 	    case STORE_META_STD_LFS:
 		assert(t->length == STORE_HDR_METASIZE);
-		xmemcpy(&tmpe.timestamp, t->value, STORE_HDR_METASIZE);
+		storeSwapMetaUnpackStd(&tmpe, t->value);
 		break;
 	    case STORE_META_STD:
 		assert(t->length == STORE_HDR_METASIZE_OLD);
@@ -671,10 +677,10 @@ storeDiskdDirRebuildFromDirectory(void *data)
 			u_short flags;
 		    }     *tmp = t->value;
 		    assert(sizeof(*tmp) == STORE_HDR_METASIZE_OLD);
-		    tmpe.timestamp = tmp->timestamp;
-		    tmpe.lastref = tmp->lastref;
-		    tmpe.expires = tmp->expires;
-		    tmpe.lastmod = tmp->lastmod;
+		    tmpe.timestamp = storeTimeRel(tmp->timestamp);
+		    tmpe.lastref = storeTimeRel(tmp->lastref);
+		    tmpe.expires = storeTimeRel(tmp->expires);
+		    tmpe.lastmod = storeTimeRel(tmp->lastmod);
 		    tmpe.swap_file_sz = tmp->swap_file_sz;
 		    tmpe.refcount = tmp->refcount;
 		    tmpe.flags = tmp->flags;
@@ -692,7 +698,7 @@ storeDiskdDirRebuildFromDirectory(void *data)
 	    storeDiskdDirUnlinkFile(SD, filn);
 	    continue;
 	}
-	tmpe.hash.key = key;
+	storeKeyCopy(tmpe.key, key);
 	/* check sizes */
 	if (tmpe.swap_file_sz == 0) {
 	    tmpe.swap_file_sz = sb.st_size;
@@ -726,10 +732,10 @@ storeDiskdDirRebuildFromDirectory(void *data)
 	e = storeDiskdDirAddDiskRestore(SD, key,
 	    filn,
 	    tmpe.swap_file_sz,
-	    tmpe.expires,
-	    tmpe.timestamp,
-	    tmpe.lastref,
-	    tmpe.lastmod,
+	    storeTime(tmpe.expires),
+	    storeTime(tmpe.timestamp),
+	    storeTime(tmpe.lastref),
+	    storeTime(tmpe.lastmod),
 	    tmpe.refcount,	/* refcount */
 	    tmpe.flags,		/* flags */
 	    (int) rb->flags.clean);
@@ -764,9 +770,11 @@ storeDiskdDirRebuildFromSwapLog(void *data)
 	 * to encode the SD index number.  There used to be a call
 	 * to storeDirProperFileno here that re-assigned the index
 	 * bits.  Now, for backwards compatibility, we just need
-	 * to mask it off.
+	 * to mask it off in logs older than STORE_SWAP_LOG_VERSION,
+	 * newer ones hold the full file number.
 	 */
-	s.swap_filen &= 0x00FFFFFF;
+	if (rb->flags.old_filen)
+	    s.swap_filen &= 0x00FFFFFF;
 	debug(20, 3) ("storeDiskdDirRebuildFromSwapLog: %s %s %08X\n",
 	    swap_log_op_str[(int) s.op],
 	    storeKeyText(s.key),
@@ -800,7 +808,7 @@ storeDiskdDirRebuildFromSwapLog(void *data)
 	    }
 	} else if (s.op == SWAP_LOG_DEL) {
 	    /* Delete unless we already have a newer copy */
-	    if ((e = storeGet(s.key)) != NULL && s.lastref >= e->lastref) {
+	    if ((e = storeGet(s.key)) != NULL && s.lastref >= storeTime(e->lastref)) {
 		/*
 		 * Make sure we don't unlink the file, it might be
 		 * in use by a subsequent entry.  Also note that
@@ -839,7 +847,7 @@ storeDiskdDirRebuildFromSwapLog(void *data)
 	/* If this URL already exists in the cache, does the swap log
 	 * appear to have a newer entry?  Compare 'lastref' from the
 	 * swap log to e->lastref. */
-	disk_entry_newer = e ? (s.lastref > e->lastref ? 1 : 0) : 0;
+	disk_entry_newer = e ? (s.lastref > storeTime(e->lastref) ? 1 : 0) : 0;
 	if (used && !disk_entry_newer) {
 	    /* log entry is old, ignore it */
 	    rb->counts.clashcount++;
@@ -847,10 +855,10 @@ storeDiskdDirRebuildFromSwapLog(void *data)
 	} else if (used && e && e->swap_filen == s.swap_filen && e->swap_dirn == SD->index) {
 	    /* swapfile taken, same URL, newer, update meta */
 	    if (e->store_status == STORE_OK) {
-		e->lastref = s.timestamp;
-		e->timestamp = s.timestamp;
-		e->expires = s.expires;
-		e->lastmod = s.lastmod;
+		e->lastref = storeTimeRel(s.timestamp);
+		e->timestamp = storeTimeRel(s.timestamp);
+		e->expires = storeTimeRel(s.expires);
+		e->lastmod = storeTimeRel(s.lastmod);
 		e->flags = s.flags;
 		e->refcount += s.refcount;
 		storeDiskdDirUnrefObj(SD, e);
@@ -937,9 +945,11 @@ storeDiskdDirRebuildFromSwapLogOld(void *data)
 	 * to encode the SD index number.  There used to be a call
 	 * to storeDirProperFileno here that re-assigned the index
 	 * bits.  Now, for backwards compatibility, we just need
-	 * to mask it off.
+	 * to mask it off in logs older than STORE_SWAP_LOG_VERSION,
+	 * newer ones hold the full file number.
 	 */
-	s.swap_filen &= 0x00FFFFFF;
+	if (rb->flags.old_filen)
+	    s.swap_filen &= 0x00FFFFFF;
 	debug(20, 3) ("storeDiskdDirRebuildFromSwapLog: %s %s %08X\n",
 	    swap_log_op_str[(int) s.op],
 	    storeKeyText(s.key),
@@ -1099,12 +1109,15 @@ storeDiskdDirRebuildFromSwapLogCheckVersion(void *data)
 	    storeDiskdDirRebuildComplete(rb);
 	    return;
 	}
-	if (hdr.version == 1 && hdr.record_size == sizeof(storeSwapLogData)) {
+	rb->flags.old_filen = hdr.version < STORE_SWAP_LOG_VERSION;
+	if (hdr.version >= 1 && hdr.version <= STORE_SWAP_LOG_VERSION && hdr.record_size == sizeof(storeSwapLogData)) {
+	    if (rb->flags.old_filen)
+		debug(47, 1) ("storeDiskdDirRebuildFromSwapLog: Found version %d. Upgrading\n", hdr.version);
 	    eventAdd("storeRebuild", storeDiskdDirRebuildFromSwapLog, rb, 0.0, 1);
 	    return;
 	}
 #if SIZEOF_SQUID_FILE_SZ != SIZEOF_SIZE_T
-	if (hdr.version == 1 && hdr.record_size == sizeof(storeSwapLogDataOld)) {
+	if (hdr.version >= 1 && hdr.version <= STORE_SWAP_LOG_VERSION && hdr.record_size == sizeof(storeSwapLogDataOld)) {
 	    debug(47, 1) ("storeDiskdDirRebuildFromSwapLog: Found current version but without large file support. Upgrading\n");
 	    eventAdd("storeRebuild", storeDiskdDirRebuildFromSwapLogOld, rb, 0.0, 1);
 	    return;
@@ -1116,6 +1129,7 @@ storeDiskdDirRebuildFromSwapLogCheckVersion(void *data)
 	return;
     }
     rewind(rb->log);
+    rb->flags.old_filen = 1;
     debug(47, 1) ("storeDiskdDirRebuildFromSwapLog: Old version detected. Upgrading\n");
 #if SIZEOF_SQUID_FILE_SZ == SIZEOF_SIZE_T
     eventAdd("storeRebuild", storeDiskdDirRebuildFromSwapLog, rb, 0.0, 1);
@@ -1237,10 +1251,10 @@ storeDiskdDirAddDiskRestore(SwapDir * SD, const cache_key * key,
     e->swap_dirn = SD->index;
     e->swap_file_sz = swap_file_sz;
     e->lock_count = 0;
-    e->lastref = lastref;
-    e->timestamp = timestamp;
-    e->expires = expires;
-    e->lastmod = lastmod;
+    e->lastref = storeTimeRel(lastref);
+    e->timestamp = storeTimeRel(timestamp);
+    e->expires = storeTimeRel(expires);
+    e->lastmod = storeTimeRel(lastmod);
     e->refcount = refcount;
     e->flags = flags;
     EBIT_SET(e->flags, ENTRY_CACHABLE);
@@ -1323,7 +1337,7 @@ storeDiskdWriteSwapLogheader(int fd)
 {
     storeSwapLogHeader *hdr = memAllocate(MEM_SWAP_LOG_DATA);
     hdr->op = SWAP_LOG_VERSION;
-    hdr->version = 1;
+    hdr->version = STORE_SWAP_LOG_VERSION;
     hdr->record_size = sizeof(storeSwapLogData);
     /* The header size is a full log record to keep some level of backward
      * compatibility even if the actual header is smaller
@@ -1464,14 +1478,14 @@ storeDiskdDirWriteCleanEntry(SwapDir * sd, const StoreEntry * e)
     memset(&s, '\0', ss);
     s.op = (char) SWAP_LOG_ADD;
     s.swap_filen = e->swap_filen;
-    s.timestamp = e->timestamp;
-    s.lastref = e->lastref;
-    s.expires = e->expires;
-    s.lastmod = e->lastmod;
+    s.timestamp = storeTime(e->timestamp);
+    s.lastref = storeTime(e->lastref);
+    s.expires = storeTime(e->expires);
+    s.lastmod = storeTime(e->lastmod);
     s.swap_file_sz = e->swap_file_sz;
     s.refcount = e->refcount;
     s.flags = e->flags;
-    xmemcpy(&s.key, e->hash.key, SQUID_MD5_DIGEST_LENGTH);
+    xmemcpy(&s.key, e->key, SQUID_MD5_DIGEST_LENGTH);
     xmemcpy(state->outbuf + state->outbuf_offset, &s, ss);
     state->outbuf_offset += ss;
     /* buffered write */
@@ -1550,14 +1564,14 @@ storeDiskdDirSwapLog(const SwapDir * sd, const StoreEntry * e, int op)
     storeSwapLogData *s = memAllocate(MEM_SWAP_LOG_DATA);
     s->op = (char) op;
     s->swap_filen = e->swap_filen;
-    s->timestamp = e->timestamp;
-    s->lastref = e->lastref;
-    s->expires = e->expires;
-    s->lastmod = e->lastmod;
+    s->timestamp = storeTime(e->timestamp);
+    s->lastref = storeTime(e->lastref);
+    s->expires = storeTime(e->expires);
+    s->lastmod = storeTime(e->lastmod);
     s->swap_file_sz = e->swap_file_sz;
     s->refcount = e->refcount;
     s->flags = e->flags;
-    xmemcpy(s->key, e->hash.key, SQUID_MD5_DIGEST_LENGTH);
+    xmemcpy(s->key, e->key, SQUID_MD5_DIGEST_LENGTH);
     file_write(diskdinfo->swaplog_fd,
 	-1,
 	s,
@@ -1918,6 +1932,7 @@ storeDiskdShmGet(SwapDir * sd, int *shm_offset)
     assert(buf);
     assert(buf >= diskdinfo->shm.buf);
     assert(buf < diskdinfo->shm.buf + (diskdinfo->shm.nbufs * SHMBUF_BLKSZ));
+    diskdinfo->shm.inuse++;
     diskd_stats.shmbuf_count++;
     if (diskd_stats.max_shmuse < diskd_stats.shmbuf_count)
 	diskd_stats.max_shmuse = diskd_stats.shmbuf_count;
@@ -1935,6 +1950,7 @@ storeDiskdShmPut(SwapDir * sd, int offset)
     assert(i < diskdinfo->shm.nbufs);
     assert(CBIT_TEST(diskdinfo->shm.inuse_map, i));
     CBIT_CLR(diskdinfo->shm.inuse_map, i);
+    diskdinfo->shm.inuse--;
     diskd_stats.shmbuf_count--;
 }
 
@@ -2241,6 +2257,7 @@ storeDiskdDirParse(SwapDir * sd, int index, char *path)
     sd->obj.write = storeDiskdWrite;
     sd->obj.unlink = storeDiskdUnlink;
     sd->obj.recycle = storeDiskdRecycle;
+    sd->obj.path = storeDiskdDirFullPath;
     sd->log.open = storeDiskdDirOpenSwapLog;
     sd->log.close = storeDiskdDirCloseSwapLog;
     sd->log.write = storeDiskdDirSwapLog;
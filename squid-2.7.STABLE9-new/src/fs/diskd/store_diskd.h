@@ -32,6 +32,7 @@ struct _diskdinfo_t {
 	char *inuse_map;
 	int id;
 	int nbufs;
+	int inuse;
     } shm;
     int magic1;
     int magic2;
@@ -43,8 +44,12 @@ struct _diskdstate_t {
 	unsigned int close_request:1;
 	unsigned int reading:1;
 	unsigned int writing:1;
+	unsigned int write_queueing:1;
+	unsigned int write_error:1;
     } flags;
     char *read_buf;
+    int writes_away;		/* storeDiskdWrite() calls not yet done */
+    int chunks_away;		/* their messages not yet answered */
 };
 
 enum {
@@ -116,6 +121,8 @@ extern STOBJUNLINK storeDiskdUnlink;
 extern STOBJRECYCLE storeDiskdRecycle;
 
 #define SHMBUF_BLKSZ SM_PAGE_SIZE
+/* a memory page is written as at most this many shared memory buffers */
+#define DISKD_MAX_WRITE_CHUNKS 16
 
 extern diskd_stats_t diskd_stats;
 
@@ -44,6 +44,8 @@
 
 static int storeDiskdSend(int, SwapDir *, int, storeIOState *, int, off_t, int);
 static void storeDiskdIOCallback(storeIOState * sio, int errflag);
+static void storeDiskdShmWait(SwapDir * sd);
+static void storeDiskdWriteFinish(storeIOState * sio);
 static CBDUNL storeDiskdIOFreeEntry;
 
 CBDATA_TYPE(storeIOState);
@@ -239,6 +241,7 @@ storeDiskdWrite(SwapDir * SD, storeIOState * sio, char *buf, size_t size, squid_
     int x;
     char *sbuf;
     int shm_offset;
+    size_t done, len;
     diskdstate_t *diskdstate = sio->fsstate;
     debug(79, 3) ("storeDiskdWrite: dirno %d, fileno %08X\n", SD->index, sio->swap_filen);
     assert(!diskdstate->flags.close_request);
@@ -252,23 +255,44 @@ storeDiskdWrite(SwapDir * SD, storeIOState * sio, char *buf, size_t size, squid_
 	return;
     }
     diskdstate->flags.writing = 1;
-    sbuf = storeDiskdShmGet(SD, &shm_offset);
-    xmemcpy(sbuf, buf, size);
+    diskdstate->writes_away++;
+    diskd_stats.write.ops++;
+    /*
+     * Memory pages may be larger than a shared memory buffer, so the
+     * page goes out as several messages.  Replies handled while we
+     * wait for buffers must not finish the write before all of them
+     * are queued.
+     */
+    diskdstate->flags.write_queueing = 1;
+    cbdataLock(sio);
+    for (done = 0; done < size; done += len) {
+	len = XMIN(size - done, SHMBUF_BLKSZ);
+	storeDiskdShmWait(SD);
+	if (!cbdataValid(sio) || diskdstate->flags.write_error)
+	    break;
+	sbuf = storeDiskdShmGet(SD, &shm_offset);
+	xmemcpy(sbuf, buf + done, len);
+	x = storeDiskdSend(_MQD_WRITE,
+	    SD,
+	    diskdstate->id,
+	    sio,
+	    len,
+	    (off_t) (offset + done),
+	    shm_offset);
+	if (x < 0) {
+	    debug(79, 1) ("storeDiskdSend WRITE: %s\n", xstrerror());
+	    storeDiskdShmPut(SD, shm_offset);
+	    diskdstate->flags.write_error = 1;
+	    break;
+	}
+	diskdstate->chunks_away++;
+    }
+    diskdstate->flags.write_queueing = 0;
     if (free_func)
 	free_func(buf);
-    x = storeDiskdSend(_MQD_WRITE,
-	SD,
-	diskdstate->id,
-	sio,
-	size,
-	(off_t) offset,
-	shm_offset);
-    if (x < 0) {
-	debug(79, 1) ("storeDiskdSend WRITE: %s\n", xstrerror());
-	storeDiskdShmPut(SD, shm_offset);
-	storeDiskdIOCallback(sio, DISK_ERROR);
-    }
-    diskd_stats.write.ops++;
+    if (cbdataValid(sio) && diskdstate->chunks_away == 0)
+	storeDiskdWriteFinish(sio);
+    cbdataUnlock(sio);
 }
 
 void
@@ -405,23 +429,42 @@ storeDiskdReadDone(diomsg * M)
     }
 }
 
+/*
+ * All messages of the outstanding writes have been answered. Account
+ * for the writes as a whole and report a failure of any of them.
+ */
 static void
-storeDiskdWriteDone(diomsg * M)
+storeDiskdWriteFinish(storeIOState * sio)
 {
-    storeIOState *sio = M->callback_data;
     diskdstate_t *diskdstate = sio->fsstate;
-    statCounter.syscalls.disk.writes++;
     diskdstate->flags.writing = 0;
-    debug(79, 3) ("storeDiskdWriteDone: dirno %d, fileno %08x status %d\n",
-	sio->swap_dirn, sio->swap_filen, M->status);
-    if (M->status < 0) {
-	diskd_stats.write.fail++;
+    if (diskdstate->flags.write_error) {
+	diskd_stats.write.fail += diskdstate->writes_away;
+	diskdstate->writes_away = 0;
 	if (!diskdstate->flags.close_request)
 	    storeDiskdIOCallback(sio, DISK_ERROR);
 	return;
     }
-    diskd_stats.write.success++;
-    sio->offset += M->status;
+    diskd_stats.write.success += diskdstate->writes_away;
+    diskdstate->writes_away = 0;
+}
+
+static void
+storeDiskdWriteDone(diomsg * M)
+{
+    storeIOState *sio = M->callback_data;
+    diskdstate_t *diskdstate = sio->fsstate;
+    statCounter.syscalls.disk.writes++;
+    debug(79, 3) ("storeDiskdWriteDone: dirno %d, fileno %08x status %d\n",
+	sio->swap_dirn, sio->swap_filen, M->status);
+    assert(diskdstate->chunks_away > 0);
+    diskdstate->chunks_away--;
+    if (M->status < 0)
+	diskdstate->flags.write_error = 1;
+    else
+	sio->offset += M->status;
+    if (diskdstate->chunks_away == 0 && !diskdstate->flags.write_queueing)
+	storeDiskdWriteFinish(sio);
 }
 
 static void
@@ -568,6 +611,24 @@ storeDiskdSend(int mtype, SwapDir * sd, int id, storeIOState * sio, int size, of
 }
 
 
+/*
+ * Wait for a free shared memory buffer, handling replies meanwhile the
+ * same way storeDiskdSend() waits for queue space.
+ */
+static void
+storeDiskdShmWait(SwapDir * sd)
+{
+    diskdinfo_t *diskdinfo = sd->fsdata;
+    struct timeval delay =
+    {0, 1};
+    while (diskdinfo->shm.inuse >= diskdinfo->shm.nbufs) {
+	select(0, NULL, NULL, NULL, &delay);
+	storeDirCallback();
+	if (delay.tv_usec < 1000000)
+	    delay.tv_usec <<= 1;
+    }
+}
+
 /*
  * We can't pass memFree() as a free function here, because we need to free
  * the fsstate variable ..
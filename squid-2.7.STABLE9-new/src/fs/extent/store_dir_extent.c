@@ -0,0 +1,1445 @@
+
+/*
+ * $Id$
+ *
+ * DEBUG: section 47    Store Extent Directory Routines
+ *
+ * SQUID Web Proxy Cache          http://www.squid-cache.org/
+ * ----------------------------------------------------------
+ *
+ *  Squid is the result of efforts by numerous individuals from
+ *  the Internet community; see the CONTRIBUTORS file for full
+ *  details.   Many organizations have provided support for Squid's
+ *  development; see the SPONSORS file for full details.  Squid is
+ *  Copyrighted (C) 2001 by the Regents of the University of
+ *  California; see the COPYRIGHT file for full details.  Squid
+ *  incorporates software developed and/or copyrighted by other
+ *  sources; see the CREDITS file for full details.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111, USA.
+ *
+ */
+
+/*
+ * The extent store keeps large objects in one big preallocated file
+ * or raw block device.  The space is cut into fixed size blocks and
+ * every object occupies one contiguous run of them, so an object is
+ * written and read back with a few large sequential I/Os.  The first
+ * block of the run is the swap file number.  The run begins with the
+ * usual swap metadata, so the store key is checked on every swap-in,
+ * and swap.state records the placement and size of each object.
+ */
+
+#include "squid.h"
+
+#include "store_extent.h"
+#include "../aufs/async_io.h"
+
+typedef struct _RebuildState RebuildState;
+struct _RebuildState {
+    SwapDir *sd;
+    int n_read;
+    FILE *log;
+    int speed;
+    struct {
+	unsigned int clean:1;
+    } flags;
+    struct _store_rebuild_data counts;
+};
+
+static int extent_initialised = 0;
+MemPool *extent_state_pool = NULL;
+MemPool *extent_chunk_pool = NULL;
+struct _extent_stats extent_stats;
+
+static const char *storeExtentDirFilePath(SwapDir *);
+static char *storeExtentDirSwapLogFile(SwapDir *, const char *);
+static EVH storeExtentDirRebuildFromSwapLog;
+static EVH storeExtentDirRebuildFromSwapLogCheckVersion;
+static StoreEntry *storeExtentDirAddDiskRestore(SwapDir * SD, const cache_key * key,
+    sfileno file_number,
+    squid_file_sz swap_file_sz,
+    time_t expires,
+    time_t timestamp,
+    time_t lastref,
+    time_t lastmod,
+    u_num32 refcount,
+    u_short flags,
+    int clean);
+static void storeExtentDirRebuild(SwapDir * sd);
+static void storeExtentDirCloseTmpSwapLog(SwapDir * sd);
+static FILE *storeExtentDirOpenTmpSwapLog(SwapDir *, int *, int *);
+static STLOGOPEN storeExtentDirOpenSwapLog;
+static STINIT storeExtentDirInit;
+static STFREE storeExtentDirFree;
+static STLOGCLEANSTART storeExtentDirWriteCleanStart;
+static STLOGCLEANNEXTENTRY storeExtentDirCleanLogNextEntry;
+static STLOGCLEANWRITE storeExtentDirWriteCleanEntry;
+static STLOGCLEANDONE storeExtentDirWriteCleanDone;
+static STLOGCLOSE storeExtentDirCloseSwapLog;
+static STLOGWRITE storeExtentDirSwapLog;
+static STNEWFS storeExtentDirNewfs;
+static STDUMP storeExtentDirDump;
+static STMAINTAINFS storeExtentDirMaintain;
+static STCHECKOBJ storeExtentDirCheckObj;
+static STCHECKLOADAV storeExtentDirCheckLoadAv;
+static STREFOBJ storeExtentDirRefObj;
+static STUNREFOBJ storeExtentDirUnrefObj;
+static STFSPARSE storeExtentDirParse;
+static STFSRECONFIGURE storeExtentDirReconfigure;
+static void storeExtentDirStats(SwapDir *, StoreEntry *);
+static void storeExtentDirParseBlkSize(SwapDir *, const char *, const char *, int);
+static void storeExtentDirParseIOSize(SwapDir *, const char *, const char *, int);
+static void storeExtentDirParseReserve(SwapDir *, const char *, const char *, int);
+static void storeExtentDirDumpBlkSize(StoreEntry *, const char *, SwapDir *);
+static void storeExtentDirDumpIOSize(StoreEntry *, const char *, SwapDir *);
+static void storeExtentDirDumpReserve(StoreEntry *, const char *, SwapDir *);
+static OBJH storeExtentStats;
+
+/* The MAIN externally visible function */
+STSETUP storeFsSetup_extent;
+
+static struct cache_dir_option options[] =
+{
+    {"block-size", storeExtentDirParseBlkSize, storeExtentDirDumpBlkSize},
+    {"io-size", storeExtentDirParseIOSize, storeExtentDirDumpIOSize},
+    {"reserve-size", storeExtentDirParseReserve, storeExtentDirDumpReserve},
+    {NULL, NULL}
+};
+
+/*
+ * Block map.  One bit per block, set while the block belongs to an
+ * object or to a run that is still being written.
+ */
+
+#define EXTENT_MAP_TEST(ei, b) ((ei)->map[(b) >> 3] & (1 << ((b) & 7)))
+
+static void
+storeExtentMapSet(ExtentInfo * ei, int first, int n)
+{
+    int b;
+    for (b = first; b < first + n; b++) {
+	assert(!EXTENT_MAP_TEST(ei, b));
+	ei->map[b >> 3] |= 1 << (b & 7);
+    }
+    ei->free_blocks -= n;
+}
+
+static void
+storeExtentMapClear(ExtentInfo * ei, int first, int n)
+{
+    int b;
+    for (b = first; b < first + n; b++) {
+	assert(EXTENT_MAP_TEST(ei, b));
+	ei->map[b >> 3] &= ~(1 << (b & 7));
+    }
+    ei->free_blocks += n;
+}
+
+/* Are blocks first .. first + n - 1 all on the disk and unused? */
+static int
+storeExtentMapFree(ExtentInfo * ei, int first, int n)
+{
+    int b;
+    if (first < 1 || n < 0 || first + n > ei->nblocks)
+	return 0;
+    for (b = first; b < first + n; b++)
+	if (EXTENT_MAP_TEST(ei, b))
+	    return 0;
+    return 1;
+}
+
+/* First fit search for n free blocks in [from, to) */
+static int
+storeExtentMapSearch(ExtentInfo * ei, int from, int to, int n)
+{
+    int b = from;
+    int run = 0;
+    while (b < to) {
+	if ((b & 7) == 0 && ei->map[b >> 3] == 0xFF) {
+	    run = 0;
+	    b += 8;
+	    continue;
+	}
+	if (EXTENT_MAP_TEST(ei, b))
+	    run = 0;
+	else if (++run == n)
+	    return b - n + 1;
+	b++;
+    }
+    return -1;
+}
+
+static int
+storeExtentMapLargestRun(ExtentInfo * ei)
+{
+    int b;
+    int run = 0;
+    int largest = 0;
+    for (b = 1; b < ei->nblocks; b++) {
+	if (EXTENT_MAP_TEST(ei, b)) {
+	    run = 0;
+	    continue;
+	}
+	if (++run > largest)
+	    largest = run;
+    }
+    return largest;
+}
+
+off_t
+storeExtentDiskOffset(ExtentInfo * ei, sfileno filn, squid_off_t offset)
+{
+    return ((off_t) filn << ei->blksz_bits) + (off_t) offset;
+}
+
+int
+storeExtentBlocks(ExtentInfo * ei, squid_off_t size)
+{
+    return (int) ((size + ei->blksz - 1) >> ei->blksz_bits);
+}
+
+/*
+ * The number of bytes an object will take on disk, swap metadata
+ * included, or -1 if the reply did not say.
+ */
+squid_off_t
+storeExtentObjectSize(const StoreEntry * e)
+{
+    MemObject *mem = e->mem_obj;
+    squid_off_t size = objectLen(e);
+    if (size < 0 && mem->reply->content_length >= 0)
+	size = mem->reply->hdr_sz + mem->reply->content_length;
+    if (size < 0)
+	return -1;
+    return size + mem->swap_hdr_sz;
+}
+
+/*
+ * Find a run of nblocks free blocks.  If the disk is too fragmented
+ * objects are purged through the replacement policy until a run
+ * turns up, but never more than EXTENT_MAX_PURGE for one allocation.
+ */
+sfileno
+storeExtentAllocate(SwapDir * SD, int nblocks)
+{
+    ExtentInfo *ei = SD->fsdata;
+    RemovalPurgeWalker *walker = NULL;
+    StoreEntry *e;
+    int purged = 0;
+    int filn;
+    if (nblocks >= ei->nblocks)
+	return -1;
+    for (;;) {
+	filn = storeExtentMapSearch(ei, ei->suggest, ei->nblocks, nblocks);
+	if (filn < 0)
+	    filn = storeExtentMapSearch(ei, 1, ei->suggest + nblocks - 1, nblocks);
+	if (filn >= 0)
+	    break;
+	/* storeRelease() does not unlink anything while rebuilding */
+	if (store_dirs_rebuilding || purged >= EXTENT_MAX_PURGE)
+	    break;
+	if (walker == NULL)
+	    walker = SD->repl->PurgeInit(SD->repl, EXTENT_MAX_PURGE * 4);
+	if ((e = walker->Next(walker)) == NULL)
+	    break;
+	storeRelease(e);
+	purged++;
+    }
+    if (walker)
+	walker->Done(walker);
+    extent_stats.purged += purged;
+    if (filn < 0) {
+	extent_stats.alloc_fail++;
+	debug(47, 2) ("storeExtentAllocate: %s: no run of %d blocks (%d free)\n",
+	    SD->path, nblocks, ei->free_blocks);
+	return -1;
+    }
+    storeExtentMapSet(ei, filn, nblocks);
+    ei->suggest = filn + nblocks;
+    if (ei->suggest >= ei->nblocks)
+	ei->suggest = 1;
+    extent_stats.allocs++;
+    return filn;
+}
+
+/* Extend the run at filn, nblocks long, in place by more blocks */
+int
+storeExtentGrow(SwapDir * SD, sfileno filn, int nblocks, int more)
+{
+    ExtentInfo *ei = SD->fsdata;
+    if (!storeExtentMapFree(ei, filn + nblocks, more))
+	return 0;
+    storeExtentMapSet(ei, filn + nblocks, more);
+    if (ei->suggest < filn + nblocks + more && ei->suggest >= filn) {
+	ei->suggest = filn + nblocks + more;
+	if (ei->suggest >= ei->nblocks)
+	    ei->suggest = 1;
+    }
+    return 1;
+}
+
+void
+storeExtentRelease(SwapDir * SD, sfileno filn, int nblocks)
+{
+    ExtentInfo *ei = SD->fsdata;
+    if (nblocks <= 0)
+	return;
+    debug(47, 5) ("storeExtentRelease: %s: blocks %d-%d\n", SD->path,
+	filn, filn + nblocks - 1);
+    storeExtentMapClear(ei, filn, nblocks);
+}
+
+static const char *
+storeExtentDirFilePath(SwapDir * sd)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    char pathtmp[SQUID_MAXPATHLEN];
+    struct stat st;
+
+    if (!ei->extent_path) {
+	xstrncpy(pathtmp, sd->path, SQUID_MAXPATHLEN - 16);
+	if (stat(sd->path, &st) == 0 && S_ISDIR(st.st_mode))
+	    strcat(pathtmp, "/extents");
+	ei->extent_path = xstrdup(pathtmp);
+    }
+    return ei->extent_path;
+}
+
+static char *
+storeExtentDirSwapLogFile(SwapDir * sd, const char *ext)
+{
+    LOCAL_ARRAY(char, path, SQUID_MAXPATHLEN);
+    LOCAL_ARRAY(char, pathtmp, SQUID_MAXPATHLEN);
+    char *pathtmp2;
+    struct stat st;
+
+    if (Config.Log.swap) {
+	xstrncpy(pathtmp, sd->path, SQUID_MAXPATHLEN - 64);
+	pathtmp2 = pathtmp;
+	while ((pathtmp2 = strchr(pathtmp2, '/')) != NULL)
+	    *pathtmp2 = '.';
+	while (strlen(pathtmp) && pathtmp[strlen(pathtmp) - 1] == '.')
+	    pathtmp[strlen(pathtmp) - 1] = '\0';
+	for (pathtmp2 = pathtmp; *pathtmp2 == '.'; pathtmp2++);
+	snprintf(path, SQUID_MAXPATHLEN - 64, Config.Log.swap, pathtmp2);
+	if (strncmp(path, Config.Log.swap, SQUID_MAXPATHLEN - 64) == 0) {
+	    size_t len = strlen(path);
+	    snprintf(path + len, SQUID_MAXPATHLEN - len, ".%02d", sd->index);
+	}
+    } else {
+	if (stat(sd->path, &st) == 0 && S_ISDIR(st.st_mode)) {
+	    xstrncpy(path, sd->path, SQUID_MAXPATHLEN - 64);
+	    strcat(path, "/swap.state");
+	} else
+	    fatalf("storeExtentDirSwapLogFile: %s is not a directory, 'cache_swap_log' is needed for it.", sd->path);
+    }
+    if (ext)
+	strncat(path, ext, 16);
+    return path;
+}
+
+static void
+storeExtentDirOpenSwapLog(SwapDir * sd)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    char *path;
+    int fd;
+    path = storeExtentDirSwapLogFile(sd, NULL);
+    if (ei->swaplog_fd >= 0) {
+	debug(50, 1) ("storeExtentDirOpenSwapLog: %s already open\n", path);
+	return;
+    }
+    fd = file_open(path, O_WRONLY | O_CREAT | O_BINARY);
+    if (fd < 0) {
+	debug(50, 1) ("%s: %s\n", path, xstrerror());
+	fatal("storeExtentDirOpenSwapLog: Failed to open swap log.");
+    }
+    debug(50, 3) ("Cache Extent Dir #%d log opened on FD %d\n", sd->index, fd);
+    ei->swaplog_fd = fd;
+}
+
+static void
+storeExtentDirCloseSwapLog(SwapDir * sd)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    if (ei->swaplog_fd < 0)	/* not open */
+	return;
+    file_close(ei->swaplog_fd);
+    debug(47, 3) ("Cache Extent Dir #%d log closed on FD %d\n",
+	sd->index, ei->swaplog_fd);
+    ei->swaplog_fd = -1;
+}
+
+static void
+storeExtentCheckConfig(SwapDir * sd)
+{
+    if (!opt_create_swap_dirs)
+	requirePathnameExists("cache_dir", sd->path);
+}
+
+static int
+storeExtentReadSuperblock(int fd, struct _extent_superblock *sb)
+{
+    memset(sb, '\0', sizeof(*sb));
+    if (pread(fd, sb, sizeof(*sb), 0) != sizeof(*sb))
+	return -1;
+    if (memcmp(sb->magic, EXTENT_MAGIC, sizeof(sb->magic)) != 0)
+	return -1;
+    if (sb->version != EXTENT_VERSION)
+	return -1;
+    return 0;
+}
+
+static void
+storeExtentWriteSuperblock(SwapDir * sd, int fd)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    struct _extent_superblock sb;
+    memset(&sb, '\0', sizeof(sb));
+    memcpy(sb.magic, EXTENT_MAGIC, sizeof(sb.magic));
+    sb.version = EXTENT_VERSION;
+    sb.blksz = ei->blksz;
+    sb.nblocks = ei->nblocks;
+    if (pwrite(fd, &sb, sizeof(sb), 0) != sizeof(sb))
+	fatalf("Failed to write the extent superblock of %s: %s\n",
+	    storeExtentDirFilePath(sd), xstrerror());
+}
+
+static void
+storeExtentDirInit(SwapDir * sd)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    struct _extent_superblock sb;
+
+    /* Multi-gigabyte extent files need 64 bit file offsets */
+    if (sizeof(off_t) < 8)
+	fatalf("The extent store will not function without large file support (off_t is %d bytes long). Please reconsider recompiling squid with --with-large-files\n", (int) sizeof(off_t));
+    ei->fd = file_open(storeExtentDirFilePath(sd), O_RDWR | O_BINARY);
+    if (ei->fd < 0) {
+	debug(47, 1) ("%s: %s\n", storeExtentDirFilePath(sd), xstrerror());
+	fatal("storeExtentDirInit: Failed to open the extent file. Run 'squid -z' to create it.");
+    }
+    if (storeExtentReadSuperblock(ei->fd, &sb) < 0)
+	fatalf("%s is not an extent store. Run 'squid -z' to create it.\n",
+	    storeExtentDirFilePath(sd));
+    if (sb.blksz != ei->blksz)
+	fatalf("%s was created with block-size=%d. Run 'squid -z' to reformat it with block-size=%d.\n",
+	    storeExtentDirFilePath(sd), sb.blksz, ei->blksz);
+    if (sb.nblocks != ei->nblocks) {
+	debug(47, 1) ("%s: resized from %d to %d blocks\n",
+	    storeExtentDirFilePath(sd), sb.nblocks, ei->nblocks);
+	storeExtentWriteSuperblock(sd, ei->fd);
+    }
+    aioInit();
+    squidaio_init();
+    storeExtentDirOpenSwapLog(sd);
+    storeExtentDirRebuild(sd);
+    /*
+     * fs.blksize is used for accounting the store size, which is
+     * done in whole blocks here.
+     */
+    sd->fs.blksize = ei->blksz;
+}
+
+static void
+storeExtentDirRebuildComplete(RebuildState * rb)
+{
+    ExtentInfo *ei = (ExtentInfo *) rb->sd->fsdata;
+    if (rb->log) {
+	debug(47, 1) ("Done reading %s swaplog (%d entries)\n",
+	    rb->sd->path, rb->n_read);
+	fclose(rb->log);
+	rb->log = NULL;
+    }
+    ei->flags.rebuilding = 0;
+    store_dirs_rebuilding--;
+    storeExtentDirCloseTmpSwapLog(rb->sd);
+    storeRebuildComplete(&rb->counts);
+    cbdataFree(rb);
+}
+
+static void
+storeExtentDirRebuildFromSwapLog(void *data)
+{
+    RebuildState *rb = data;
+    SwapDir *SD = rb->sd;
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    StoreEntry *e = NULL;
+    storeSwapLogData s;
+    size_t ss = sizeof(storeSwapLogData);
+    int count;
+    int nblocks;
+    int used;			/* are the blocks already in use? */
+    int disk_entry_newer;	/* is the log entry newer than current entry? */
+    double x;
+    assert(rb != NULL);
+    /* load a number of objects per invocation */
+    for (count = 0; count < rb->speed; count++) {
+	if (fread(&s, ss, 1, rb->log) != 1) {
+	    storeExtentDirRebuildComplete(rb);
+	    return;
+	}
+	rb->n_read++;
+	debug(47, 3) ("storeExtentDirRebuildFromSwapLog: %s %s %08X\n",
+	    swap_log_op_str[(int) s.op],
+	    storeKeyText(s.key),
+	    s.swap_filen);
+	if (s.op == SWAP_LOG_ADD) {
+	    (void) 0;
+	} else if (s.op == SWAP_LOG_DEL) {
+	    /* Delete unless we already have a newer copy */
+	    if ((e = storeGet(s.key)) != NULL && s.lastref >= storeTime(e->lastref)) {
+		storeRecycle(e);
+		rb->counts.cancelcount++;
+	    }
+	    continue;
+	} else {
+	    x = log(++rb->counts.bad_log_op) / log(10.0);
+	    if (0.0 == x - (double) (int) x)
+		debug(47, 1) ("WARNING: %d invalid swap log entries found\n",
+		    rb->counts.bad_log_op);
+	    rb->counts.invalid++;
+	    continue;
+	}
+	if ((++rb->counts.scancount & 0xFFF) == 0) {
+	    struct stat sb;
+	    if (0 == fstat(fileno(rb->log), &sb))
+		storeRebuildProgress(SD->index,
+		    (int) sb.st_size / ss, rb->n_read);
+	}
+	nblocks = storeExtentBlocks(ei, s.swap_file_sz);
+	if (s.swap_filen < 1 || nblocks < 1 || s.swap_filen + nblocks > ei->nblocks) {
+	    rb->counts.invalid++;
+	    continue;
+	}
+	if (EBIT_TEST(s.flags, KEY_PRIVATE)) {
+	    rb->counts.badflags++;
+	    continue;
+	}
+	e = storeGet(s.key);
+	used = !storeExtentMapFree(ei, s.swap_filen, nblocks);
+	/* If this URL already exists in the cache, does the swap log
+	 * appear to have a newer entry?  Compare 'lastref' from the
+	 * swap log to e->lastref. */
+	disk_entry_newer = e ? (s.lastref > storeTime(e->lastref) ? 1 : 0) : 0;
+	if (used && !disk_entry_newer) {
+	    /* log entry is old, ignore it */
+	    rb->counts.clashcount++;
+	    continue;
+	} else if (used && e && e->swap_filen == s.swap_filen && e->swap_dirn == SD->index) {
+	    /* same run, same URL, newer, update meta */
+	    if (e->store_status == STORE_OK && e->swap_file_sz == s.swap_file_sz) {
+		e->lastref = storeTimeRel(s.timestamp);
+		e->timestamp = storeTimeRel(s.timestamp);
+		e->expires = storeTimeRel(s.expires);
+		e->lastmod = storeTimeRel(s.lastmod);
+		e->flags = s.flags;
+		e->refcount += s.refcount;
+		storeExtentDirUnrefObj(SD, e);
+	    } else {
+		debug_trap("storeExtentDirRebuildFromSwapLog: bad condition");
+		debug(47, 1) ("\tSee %s:%d\n", __FILE__, __LINE__);
+	    }
+	    continue;
+	} else if (used) {
+	    /* run overlaps another object and the log entry is newer */
+	    debug(47, 1) ("WARNING: newer swaplog entry for dirno %d, fileno %08X overlaps another object\n",
+		SD->index, s.swap_filen);
+	    rb->counts.clashcount++;
+	    continue;
+	} else if (e && !disk_entry_newer) {
+	    /* key already exists, current entry is newer */
+	    /* keep old, ignore new */
+	    rb->counts.dupcount++;
+	    continue;
+	} else if (e) {
+	    /* key already exists, this run not being used */
+	    /* junk old, load new */
+	    storeRecycle(e);
+	    rb->counts.dupcount++;
+	} else {
+	    /* URL doesnt exist, run not in use */
+	    /* load new */
+	    (void) 0;
+	}
+	/* update store_swap_size */
+	rb->counts.objcount++;
+	e = storeExtentDirAddDiskRestore(SD, s.key,
+	    s.swap_filen,
+	    s.swap_file_sz,
+	    s.expires,
+	    s.timestamp,
+	    s.lastref,
+	    s.lastmod,
+	    s.refcount,
+	    s.flags,
+	    (int) rb->flags.clean);
+	storeDirSwapLog(e, SWAP_LOG_ADD);
+    }
+    eventAdd("storeRebuild", storeExtentDirRebuildFromSwapLog, rb, 0.0, 1);
+}
+
+static void
+storeExtentDirRebuildFromSwapLogCheckVersion(void *data)
+{
+    RebuildState *rb = data;
+    storeSwapLogHeader hdr;
+
+    if (rb->log == NULL || fread(&hdr, sizeof(hdr), 1, rb->log) != 1) {
+	storeExtentDirRebuildComplete(rb);
+	return;
+    }
+    if (hdr.op == SWAP_LOG_VERSION && hdr.version >= 1 && hdr.version <= STORE_SWAP_LOG_VERSION && hdr.record_size == sizeof(storeSwapLogData)) {
+	if (fseek(rb->log, hdr.record_size, SEEK_SET) != 0) {
+	    storeExtentDirRebuildComplete(rb);
+	    return;
+	}
+	eventAdd("storeRebuild", storeExtentDirRebuildFromSwapLog, rb, 0.0, 1);
+	return;
+    }
+    /* There are no older extent logs to upgrade */
+    debug(47, 1) ("storeExtentDirRebuildFromSwapLog: Unsupported swap.state version %d size %d\n",
+	hdr.version, hdr.record_size);
+    storeExtentDirRebuildComplete(rb);
+}
+
+/* Add a new object to the cache with empty memory copy and pointer to disk
+ * use to rebuild store from disk. */
+static StoreEntry *
+storeExtentDirAddDiskRestore(SwapDir * SD, const cache_key * key,
+    sfileno file_number,
+    squid_file_sz swap_file_sz,
+    time_t expires,
+    time_t timestamp,
+    time_t lastref,
+    time_t lastmod,
+    u_num32 refcount,
+    u_short flags,
+    int clean)
+{
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    StoreEntry *e = NULL;
+    debug(47, 5) ("storeExtentAddDiskRestore: %s, fileno=%08X\n", storeKeyText(key), file_number);
+    /* if you call this you'd better be sure the blocks are not
+     * already in use! */
+    e = new_StoreEntry(STORE_ENTRY_WITHOUT_MEMOBJ, NULL);
+    e->store_status = STORE_OK;
+    storeSetMemStatus(e, NOT_IN_MEMORY);
+    e->swap_status = SWAPOUT_DONE;
+    e->swap_filen = file_number;
+    e->swap_dirn = SD->index;
+    e->swap_file_sz = swap_file_sz;
+    e->lock_count = 0;
+    e->lastref = storeTimeRel(lastref);
+    e->timestamp = storeTimeRel(timestamp);
+    e->expires = storeTimeRel(expires);
+    e->lastmod = storeTimeRel(lastmod);
+    e->refcount = refcount;
+    e->flags = flags;
+    EBIT_SET(e->flags, ENTRY_CACHABLE);
+    EBIT_CLR(e->flags, RELEASE_REQUEST);
+    EBIT_CLR(e->flags, KEY_PRIVATE);
+    e->ping_status = PING_NONE;
+    EBIT_CLR(e->flags, ENTRY_VALIDATED);
+    storeExtentMapSet(ei, file_number, storeExtentBlocks(ei, swap_file_sz));
+    storeHashInsert(e, key);	/* do it after we clear KEY_PRIVATE */
+    storeExtentDirReplAdd(SD, e);
+    return e;
+}
+
+CBDATA_TYPE(RebuildState);
+
+static void
+storeExtentDirRebuild(SwapDir * sd)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    RebuildState *rb;
+    int clean = 0;
+    int zero = 0;
+    FILE *fp;
+    CBDATA_INIT_TYPE(RebuildState);
+    rb = cbdataAlloc(RebuildState);
+    rb->sd = sd;
+    rb->speed = opt_foreground_rebuild ? 1 << 30 : 50;
+    ei->flags.rebuilding = 1;
+    /*
+     * Objects are only found through swap.state.  Without one the
+     * store starts out empty; the data in the extent file is not
+     * scanned because a run's metadata does not record its length
+     * when the object was swapped out while still arriving.
+     */
+    fp = storeExtentDirOpenTmpSwapLog(sd, &clean, &zero);
+    if (fp != NULL && !zero) {
+	rb->log = fp;
+	rb->flags.clean = (unsigned int) clean;
+    } else if (fp != NULL)
+	fclose(fp);
+    debug(47, 1) ("Rebuilding extent storage in %s (%s)\n",
+	sd->path, clean ? "CLEAN" : "DIRTY");
+    store_dirs_rebuilding++;
+    eventAdd("storeRebuild", storeExtentDirRebuildFromSwapLogCheckVersion, rb, 0.0, 1);
+}
+
+static void
+storeExtentDirCloseTmpSwapLog(SwapDir * sd)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    char *swaplog_path = xstrdup(storeExtentDirSwapLogFile(sd, NULL));
+    char *new_path = xstrdup(storeExtentDirSwapLogFile(sd, ".new"));
+    int fd;
+    file_close(ei->swaplog_fd);
+    if (xrename(new_path, swaplog_path) < 0) {
+	fatal("storeExtentDirCloseTmpSwapLog: rename failed");
+    }
+    fd = file_open(swaplog_path, O_WRONLY | O_CREAT | O_BINARY);
+    if (fd < 0) {
+	debug(50, 1) ("%s: %s\n", swaplog_path, xstrerror());
+	fatal("storeExtentDirCloseTmpSwapLog: Failed to open swap log.");
+    }
+    safe_free(swaplog_path);
+    safe_free(new_path);
+    ei->swaplog_fd = fd;
+    debug(47, 3) ("Cache Extent Dir #%d log opened on FD %d\n", sd->index, fd);
+}
+
+static void
+storeSwapLogDataFree(void *s)
+{
+    memFree(s, MEM_SWAP_LOG_DATA);
+}
+
+static void
+storeExtentWriteSwapLogheader(int fd)
+{
+    storeSwapLogHeader *hdr = memAllocate(MEM_SWAP_LOG_DATA);
+    hdr->op = SWAP_LOG_VERSION;
+    hdr->version = STORE_SWAP_LOG_VERSION;
+    hdr->record_size = sizeof(storeSwapLogData);
+    /* The header size is a full log record to keep some level of backward
+     * compatibility even if the actual header is smaller
+     */
+    file_write(fd,
+	-1,
+	hdr,
+	sizeof(storeSwapLogData),
+	NULL,
+	NULL,
+	(FREE *) storeSwapLogDataFree);
+}
+
+static FILE *
+storeExtentDirOpenTmpSwapLog(SwapDir * sd, int *clean_flag, int *zero_flag)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    char *swaplog_path = xstrdup(storeExtentDirSwapLogFile(sd, NULL));
+    char *clean_path = xstrdup(storeExtentDirSwapLogFile(sd, ".last-clean"));
+    char *new_path = xstrdup(storeExtentDirSwapLogFile(sd, ".new"));
+    struct stat log_sb;
+    struct stat clean_sb;
+    FILE *fp;
+    int fd;
+    if (stat(swaplog_path, &log_sb) < 0) {
+	debug(47, 1) ("Cache Extent Dir #%d: No log file\n", sd->index);
+	log_sb.st_size = 0;
+	log_sb.st_mtime = 0;
+    }
+    *zero_flag = log_sb.st_size == 0 ? 1 : 0;
+    /* close the existing write-only FD */
+    if (ei->swaplog_fd >= 0)
+	file_close(ei->swaplog_fd);
+    /* open a write-only FD for the new log */
+    fd = file_open(new_path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY);
+    if (fd < 0) {
+	debug(50, 1) ("%s: %s\n", new_path, xstrerror());
+	fatal("storeDirOpenTmpSwapLog: Failed to open swap log.");
+    }
+    ei->swaplog_fd = fd;
+    storeExtentWriteSwapLogheader(fd);
+    if (*zero_flag) {
+	safe_free(swaplog_path);
+	safe_free(clean_path);
+	safe_free(new_path);
+	return NULL;
+    }
+    /* open a read-only stream of the old log */
+    fp = fopen(swaplog_path, "rb");
+    if (fp == NULL) {
+	debug(50, 0) ("%s: %s\n", swaplog_path, xstrerror());
+	fatal("Failed to open swap log for reading");
+    }
+    memset(&clean_sb, '\0', sizeof(struct stat));
+    if (stat(clean_path, &clean_sb) < 0)
+	*clean_flag = 0;
+    else if (clean_sb.st_mtime < log_sb.st_mtime)
+	*clean_flag = 0;
+    else
+	*clean_flag = 1;
+    safeunlink(clean_path, 1);
+    safe_free(swaplog_path);
+    safe_free(clean_path);
+    safe_free(new_path);
+    return fp;
+}
+
+struct _clean_state {
+    char *cur;
+    char *new;
+    char *cln;
+    char *outbuf;
+    int outbuf_offset;
+    int fd;
+    RemovalPolicyWalker *walker;
+};
+
+#define CLEAN_BUF_SZ 16384
+/*
+ * Begin the process to write clean cache state.  For the extent store
+ * this means opening some log files and allocating write buffers.
+ * Return 0 if we succeed.
+ */
+static int
+storeExtentDirWriteCleanStart(SwapDir * sd)
+{
+    struct _clean_state *state = xcalloc(1, sizeof(*state));
+#if HAVE_FCHMOD
+    struct stat sb;
+#endif
+    sd->log.clean.write = NULL;
+    sd->log.clean.state = NULL;
+    state->new = xstrdup(storeExtentDirSwapLogFile(sd, ".clean"));
+    state->fd = file_open(state->new, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY);
+    if (state->fd < 0) {
+	debug(50, 0) ("storeDirWriteCleanStart: %s: open: %s\n",
+	    state->new, xstrerror());
+	debug(50, 0) ("storeDirWriteCleanStart: Current swap logfile "
+	    "not replaced.\n");
+	xfree(state->new);
+	xfree(state);
+	return -1;
+    }
+    storeExtentWriteSwapLogheader(state->fd);
+    state->cur = xstrdup(storeExtentDirSwapLogFile(sd, NULL));
+    state->cln = xstrdup(storeExtentDirSwapLogFile(sd, ".last-clean"));
+    state->outbuf = xcalloc(CLEAN_BUF_SZ, 1);
+    state->outbuf_offset = 0;
+    state->walker = sd->repl->WalkInit(sd->repl);
+    unlink(state->cln);
+    debug(47, 3) ("storeDirWriteCleanLogs: opened %s, FD %d\n",
+	state->new, state->fd);
+#if HAVE_FCHMOD
+    if (stat(state->cur, &sb) == 0)
+	fchmod(state->fd, sb.st_mode);
+#endif
+    sd->log.clean.write = storeExtentDirWriteCleanEntry;
+    sd->log.clean.state = state;
+    return 0;
+}
+
+/*
+ * Get the next entry that is a candidate for clean log writing
+ */
+static const StoreEntry *
+storeExtentDirCleanLogNextEntry(SwapDir * sd)
+{
+    const StoreEntry *entry = NULL;
+    struct _clean_state *state = sd->log.clean.state;
+    if (state->walker)
+	entry = state->walker->Next(state->walker);
+    return entry;
+}
+
+/*
+ * "write" an entry to the clean log file.
+ */
+static void
+storeExtentDirWriteCleanEntry(SwapDir * sd, const StoreEntry * e)
+{
+    storeSwapLogData s;
+    static size_t ss = sizeof(storeSwapLogData);
+    struct _clean_state *state = sd->log.clean.state;
+    memset(&s, '\0', ss);
+    s.op = (char) SWAP_LOG_ADD;
+    s.swap_filen = e->swap_filen;
+    s.timestamp = storeTime(e->timestamp);
+    s.lastref = storeTime(e->lastref);
+    s.expires = storeTime(e->expires);
+    s.lastmod = storeTime(e->lastmod);
+    s.swap_file_sz = e->swap_file_sz;
+    s.refcount = e->refcount;
+    s.flags = e->flags;
+    xmemcpy(&s.key, e->key, SQUID_MD5_DIGEST_LENGTH);
+    xmemcpy(state->outbuf + state->outbuf_offset, &s, ss);
+    state->outbuf_offset += ss;
+    /* buffered write */
+    if (state->outbuf_offset + ss > CLEAN_BUF_SZ) {
+	if (FD_WRITE_METHOD(state->fd, state->outbuf, state->outbuf_offset) < 0) {
+	    debug(50, 0) ("storeDirWriteCleanLogs: %s: write: %s\n",
+		state->new, xstrerror());
+	    debug(50, 0) ("storeDirWriteCleanLogs: Current swap logfile not replaced.\n");
+	    file_close(state->fd);
+	    state->fd = -1;
+	    unlink(state->new);
+	    safe_free(state);
+	    sd->log.clean.state = NULL;
+	    sd->log.clean.write = NULL;
+	    return;
+	}
+	state->outbuf_offset = 0;
+    }
+}
+
+static void
+storeExtentDirWriteCleanDone(SwapDir * sd)
+{
+    int fd;
+    struct _clean_state *state = sd->log.clean.state;
+    if (NULL == state)
+	return;
+    if (state->fd < 0)
+	return;
+    state->walker->Done(state->walker);
+    if (FD_WRITE_METHOD(state->fd, state->outbuf, state->outbuf_offset) < 0) {
+	debug(50, 0) ("storeDirWriteCleanLogs: %s: write: %s\n",
+	    state->new, xstrerror());
+	debug(50, 0) ("storeDirWriteCleanLogs: Current swap logfile "
+	    "not replaced.\n");
+	file_close(state->fd);
+	state->fd = -1;
+	unlink(state->new);
+    }
+    safe_free(state->outbuf);
+    /*
+     * You can't rename open files on Microsoft "operating systems"
+     * so we have to close before renaming.
+     */
+    storeExtentDirCloseSwapLog(sd);
+    /* save the fd value for a later test */
+    fd = state->fd;
+    /* rename */
+    if (state->fd >= 0) {
+#if defined(_SQUID_OS2_) || defined(_SQUID_WIN32_)
+	file_close(state->fd);
+	state->fd = -1;
+#endif
+	xrename(state->new, state->cur);
+    }
+    /* touch a timestamp file if we're not still validating */
+    if (store_dirs_rebuilding)
+	(void) 0;
+    else if (fd < 0)
+	(void) 0;
+    else
+	file_close(file_open(state->cln, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY));
+    /* close */
+    safe_free(state->cur);
+    safe_free(state->new);
+    safe_free(state->cln);
+    if (state->fd >= 0)
+	file_close(state->fd);
+    state->fd = -1;
+    safe_free(state);
+    sd->log.clean.state = NULL;
+    sd->log.clean.write = NULL;
+}
+
+static void
+storeExtentDirSwapLog(const SwapDir * sd, const StoreEntry * e, int op)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    storeSwapLogData *s = memAllocate(MEM_SWAP_LOG_DATA);
+    s->op = (char) op;
+    s->swap_filen = e->swap_filen;
+    s->timestamp = storeTime(e->timestamp);
+    s->lastref = storeTime(e->lastref);
+    s->expires = storeTime(e->expires);
+    s->lastmod = storeTime(e->lastmod);
+    s->swap_file_sz = e->swap_file_sz;
+    s->refcount = e->refcount;
+    s->flags = e->flags;
+    xmemcpy(s->key, e->key, SQUID_MD5_DIGEST_LENGTH);
+    file_write(ei->swaplog_fd,
+	-1,
+	s,
+	sizeof(storeSwapLogData),
+	NULL,
+	NULL,
+	(FREE *) storeSwapLogDataFree);
+}
+
+/*
+ * Create the extent file, or check an existing file or block device.
+ * Regular files are preallocated to the full size so the runs end up
+ * contiguous on the underlying filesystem too.  An existing store
+ * with the same block size keeps its contents.
+ */
+static void
+storeExtentDirNewfs(SwapDir * sd)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    const char *path = storeExtentDirFilePath(sd);
+    struct _extent_superblock sb;
+    off_t size = (off_t) ei->nblocks << ei->blksz_bits;
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CREAT | O_BINARY, 0600);
+    if (fd < 0)
+	fatalf("Failed to create extent file %s: %s\n", path, xstrerror());
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size < size) {
+	debug(47, 1) ("Preallocating %d MB for extent file %s\n",
+	    (int) (size >> 20), path);
+#if HAVE_POSIX_FALLOCATE
+	errno = posix_fallocate(fd, 0, size);
+	if (errno != 0)
+#endif
+	    if (ftruncate(fd, size) < 0)
+		fatalf("Failed to size extent file %s: %s\n", path, xstrerror());
+    }
+    if (storeExtentReadSuperblock(fd, &sb) == 0 && sb.blksz == ei->blksz) {
+	debug(47, 1) ("%s is already an extent store\n", path);
+    } else {
+	debug(47, 1) ("Creating extent store in %s\n", path);
+	/* whatever swap.state describes is no longer on the disk */
+	if (Config.Log.swap || (stat(sd->path, &st) == 0 && S_ISDIR(st.st_mode)))
+	    safeunlink(storeExtentDirSwapLogFile(sd, NULL), 1);
+    }
+    storeExtentWriteSuperblock(sd, fd);
+    close(fd);
+}
+
+static void
+storeExtentDirMaintain(SwapDir * SD)
+{
+    StoreEntry *e = NULL;
+    int removed = 0;
+    int max_scan;
+    int max_remove;
+    double f;
+    RemovalPurgeWalker *walker;
+    /* We can't delete objects while rebuilding swap */
+    if (store_dirs_rebuilding) {
+	return;
+    } else {
+	f = (double) (SD->cur_size - SD->low_size) / (SD->max_size - SD->low_size);
+	f = f < 0.0 ? 0.0 : f > 1.0 ? 1.0 : f;
+	max_scan = (int) (f * 400.0 + 100.0);
+	max_remove = (int) (f * 70.0 + 10.0);
+    }
+    debug(47, 3) ("storeMaintainSwapSpace: f=%f, max_scan=%d, max_remove=%d\n",
+	f, max_scan, max_remove);
+    walker = SD->repl->PurgeInit(SD->repl, max_scan);
+    while (1) {
+	if (SD->cur_size < SD->low_size)
+	    break;
+	if (removed >= max_remove)
+	    break;
+	e = walker->Next(walker);
+	if (!e)
+	    break;		/* no more objects */
+	removed++;
+	storeRelease(e);
+    }
+    walker->Done(walker);
+    debug(47, (removed ? 2 : 3)) ("storeExtentDirMaintain: %s removed %d/%d f=%.03f max_scan=%d\n",
+	SD->path, removed, max_remove, f, max_scan);
+}
+
+/*
+ * storeExtentDirCheckObj
+ *
+ * This routine is called by storeDirSelectSwapDir to see if the given
+ * object is able to be stored on this filesystem.  Objects whose
+ * reply announces a length below min-size go elsewhere, even though
+ * the upper layers let unknown (-1) sizes through.
+ */
+static int
+storeExtentDirCheckObj(SwapDir * SD, const StoreEntry * e)
+{
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    squid_off_t size;
+    if (EBIT_TEST(e->flags, ENTRY_SPECIAL))
+	return 0;
+    if (ei->flags.rebuilding)
+	return 0;
+    size = storeExtentObjectSize(e);
+    if (size >= 0 && size < SD->min_objsize)
+	return 0;
+    if (size >= 0 && storeExtentBlocks(ei, size) >= ei->nblocks)
+	return 0;
+    return 1;
+}
+
+static int
+storeExtentDirCheckLoadAv(SwapDir * SD, store_op_t op)
+{
+    int loadav, ql;
+
+    ql = aioQueueSize();
+    if (ql == 0)
+	return AUFS_LOAD_BASE;
+    loadav = AUFS_LOAD_BASE + (ql * AUFS_LOAD_QUEUE_WEIGHT / MAGIC1);
+    return loadav;
+}
+
+static void
+storeExtentDirRefObj(SwapDir * SD, StoreEntry * e)
+{
+    debug(47, 3) ("storeExtentDirRefObj: referencing %p %d/%d\n", e, e->swap_dirn,
+	e->swap_filen);
+    if (SD->repl->Referenced)
+	SD->repl->Referenced(SD->repl, e, &e->repl);
+}
+
+static void
+storeExtentDirUnrefObj(SwapDir * SD, StoreEntry * e)
+{
+    debug(47, 3) ("storeExtentDirUnrefObj: referencing %p %d/%d\n", e, e->swap_dirn,
+	e->swap_filen);
+    if (SD->repl->Dereferenced)
+	SD->repl->Dereferenced(SD->repl, e, &e->repl);
+}
+
+void
+storeExtentDirReplAdd(SwapDir * SD, StoreEntry * e)
+{
+    debug(47, 4) ("storeExtentDirReplAdd: added node %p to dir %d\n", e,
+	SD->index);
+    SD->repl->Add(SD->repl, e, &e->repl);
+}
+
+void
+storeExtentDirReplRemove(StoreEntry * e)
+{
+    SwapDir *SD = INDEXSD(e->swap_dirn);
+    debug(47, 4) ("storeExtentDirReplRemove: remove node %p from dir %d\n", e,
+	SD->index);
+    SD->repl->Remove(SD->repl, e, &e->repl);
+}
+
+/* ========== LOCAL FUNCTIONS ABOVE, GLOBAL FUNCTIONS BELOW ========== */
+
+static void
+storeExtentDirStats(SwapDir * SD, StoreEntry * sentry)
+{
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    storeAppendPrintf(sentry, "Extent file: %s\n", storeExtentDirFilePath(SD));
+    storeAppendPrintf(sentry, "Maximum Size: %d KB\n", SD->max_size);
+    storeAppendPrintf(sentry, "Current Size: %d KB\n", SD->cur_size);
+    storeAppendPrintf(sentry, "Percent Used: %0.2f%%\n",
+	100.0 * SD->cur_size / SD->max_size);
+    storeAppendPrintf(sentry, "Current load metric: %d / %d\n", storeExtentDirCheckLoadAv(SD, ST_OP_CREATE), MAX_LOAD_VALUE);
+    storeAppendPrintf(sentry, "Block size: %d KB, I/O size: %d KB\n",
+	ei->blksz >> 10, ei->io_size >> 10);
+    storeAppendPrintf(sentry, "Blocks in use: %d of %d (%d%%)\n",
+	ei->nblocks - 1 - ei->free_blocks, ei->nblocks - 1,
+	percent(ei->nblocks - 1 - ei->free_blocks, ei->nblocks - 1));
+    storeAppendPrintf(sentry, "Largest free run: %d blocks\n",
+	storeExtentMapLargestRun(ei));
+    storeAppendPrintf(sentry, "Flags:");
+    if (SD->flags.selected)
+	storeAppendPrintf(sentry, " SELECTED");
+    if (SD->flags.read_only)
+	storeAppendPrintf(sentry, " READ-ONLY");
+    if (ei->flags.rebuilding)
+	storeAppendPrintf(sentry, " REBUILDING");
+    storeAppendPrintf(sentry, "\n");
+}
+
+/* Parse a byte count with an optional KB, MB or GB suffix */
+static int
+storeExtentDirParseSize(const char *name, const char *value)
+{
+    char *end;
+    long v = strtol(value, &end, 10);
+    switch (xtoupper(*end)) {
+    case 'G':
+	v <<= 10;
+	/* FALLTHROUGH */
+    case 'M':
+	v <<= 10;
+	/* FALLTHROUGH */
+    case 'K':
+	v <<= 10;
+	break;
+    case '\0':
+	break;
+    default:
+	fatalf("extent cache_dir: bad %s value '%s'\n", name, value);
+    }
+    if (v <= 0 || v > 1 << 30)
+	fatalf("extent cache_dir: %s value '%s' out of range\n", name, value);
+    return (int) v;
+}
+
+static void
+storeExtentDirParseBlkSize(SwapDir * sd, const char *name, const char *value, int reconfiguring)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    int blksz = storeExtentDirParseSize(name, value);
+    int nbits;
+    if (blksz == ei->blksz)
+	/* no change */
+	return;
+    if (reconfiguring) {
+	debug(47, 0) ("WARNING: cannot change extent block-size while Squid is running\n");
+	return;
+    }
+    for (nbits = 0; (1 << nbits) < blksz; nbits++);
+    if ((1 << nbits) != blksz)
+	fatal("extent block-size must be a power of 2\n");
+    if (blksz < 4096)
+	fatal("extent block-size must be 4096 or larger\n");
+    ei->blksz = blksz;
+    ei->blksz_bits = nbits;
+}
+
+static void
+storeExtentDirParseIOSize(SwapDir * sd, const char *name, const char *value, int reconfiguring)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    int size = storeExtentDirParseSize(name, value);
+    if (size < 65536)
+	fatal("extent io-size must be 64 KB or larger\n");
+    ei->io_size = size;
+}
+
+static void
+storeExtentDirParseReserve(SwapDir * sd, const char *name, const char *value, int reconfiguring)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    /* kept in bytes until the block size is known */
+    ei->reserve_blocks = storeExtentDirParseSize(name, value);
+}
+
+static void
+storeExtentDirDumpBlkSize(StoreEntry * e, const char *option, SwapDir * sd)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    storeAppendPrintf(e, " block-size=%dKB", ei->blksz >> 10);
+}
+
+static void
+storeExtentDirDumpIOSize(StoreEntry * e, const char *option, SwapDir * sd)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    storeAppendPrintf(e, " io-size=%dKB", ei->io_size >> 10);
+}
+
+static void
+storeExtentDirDumpReserve(StoreEntry * e, const char *option, SwapDir * sd)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    storeAppendPrintf(e, " reserve-size=%dKB", (ei->reserve_blocks * ei->blksz) >> 10);
+}
+
+static void
+storeExtentDirApplyOptions(SwapDir * sd, int reserve)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    ei->reserve_blocks = storeExtentBlocks(ei, ei->reserve_blocks ? ei->reserve_blocks : reserve);
+    if (ei->reserve_blocks < 1)
+	ei->reserve_blocks = 1;
+}
+
+/*
+ * storeExtentDirReconfigure
+ *
+ * This routine is called when the given swapdir needs reconfiguring
+ */
+static void
+storeExtentDirReconfigure(SwapDir * sd, int index, char *path)
+{
+    ExtentInfo *ei = (ExtentInfo *) sd->fsdata;
+    int i;
+    int size;
+    int reserve = ei->reserve_blocks * ei->blksz;
+
+    i = GetInteger();
+    size = i << 10;		/* Mbytes to kbytes */
+    if (size <= 0)
+	fatal("storeExtentDirReconfigure: invalid size value");
+    if (size == sd->max_size)
+	debug(3, 1) ("Cache extent dir '%s' size remains unchanged at %d KB\n",
+	    path, size);
+    else
+	debug(3, 1) ("WARNING: cannot change extent cache_dir '%s' size while Squid is running\n",
+	    path);
+    ei->reserve_blocks = 0;
+    parse_cachedir_options(sd, options, 1);
+    storeExtentDirApplyOptions(sd, reserve);
+}
+
+static void
+storeExtentDirDump(StoreEntry * entry, SwapDir * s)
+{
+    storeAppendPrintf(entry, " %d", s->max_size >> 10);
+    dump_cachedir_options(entry, options, s);
+}
+
+/*
+ * Only "free" the filesystem specific stuff here
+ */
+static void
+storeExtentDirFree(SwapDir * s)
+{
+    ExtentInfo *ei = (ExtentInfo *) s->fsdata;
+    if (ei->swaplog_fd > -1) {
+	file_close(ei->swaplog_fd);
+	ei->swaplog_fd = -1;
+    }
+    if (ei->fd > -1) {
+	file_close(ei->fd);
+	ei->fd = -1;
+    }
+    safe_free(ei->map);
+    xfree((void *) ei->extent_path);
+    xfree(ei);
+    s->fsdata = NULL;		/* Will aid debugging... */
+}
+
+/*
+ * storeExtentDirParse *
+ * Called when a *new* fs is being setup.
+ */
+static void
+storeExtentDirParse(SwapDir * sd, int index, char *path)
+{
+    int i;
+    int size;
+    squid_off_t blocks;
+    ExtentInfo *ei;
+
+    i = GetInteger();
+    size = i << 10;		/* Mbytes to kbytes */
+    if (size <= 0)
+	fatal("storeExtentDirParse: invalid size value");
+
+    ei = xcalloc(1, sizeof(ExtentInfo));
+    sd->index = index;
+    sd->path = xstrdup(path);
+    sd->max_size = size;
+    sd->fsdata = ei;
+    ei->fd = -1;
+    ei->swaplog_fd = -1;
+    ei->blksz = EXTENT_DEFAULT_BLKSZ;
+    for (ei->blksz_bits = 0; (1 << ei->blksz_bits) < ei->blksz; ei->blksz_bits++);
+    ei->io_size = EXTENT_DEFAULT_IOSZ;
+    sd->checkconfig = storeExtentCheckConfig;
+    sd->init = storeExtentDirInit;
+    sd->newfs = storeExtentDirNewfs;
+    sd->dump = storeExtentDirDump;
+    sd->freefs = storeExtentDirFree;
+    sd->dblcheck = NULL;
+    sd->statfs = storeExtentDirStats;
+    sd->maintainfs = storeExtentDirMaintain;
+    sd->checkobj = storeExtentDirCheckObj;
+    sd->checkload = storeExtentDirCheckLoadAv;
+    sd->refobj = storeExtentDirRefObj;
+    sd->unrefobj = storeExtentDirUnrefObj;
+    sd->callback = aioCheckCallbacks;
+    sd->sync = aioSync;
+    sd->obj.create = storeExtentCreate;
+    sd->obj.open = storeExtentOpen;
+    sd->obj.close = storeExtentClose;
+    sd->obj.read = storeExtentRead;
+    sd->obj.write = storeExtentWrite;
+    sd->obj.unlink = storeExtentUnlink;
+    sd->obj.recycle = storeExtentRecycle;
+    sd->obj.path = NULL;	/* objects do not live in files of their own */
+    sd->log.open = storeExtentDirOpenSwapLog;
+    sd->log.close = storeExtentDirCloseSwapLog;
+    sd->log.write = storeExtentDirSwapLog;
+    sd->log.clean.start = storeExtentDirWriteCleanStart;
+    sd->log.clean.nextentry = storeExtentDirCleanLogNextEntry;
+    sd->log.clean.done = storeExtentDirWriteCleanDone;
+
+    parse_cachedir_options(sd, options, 0);
+    storeExtentDirApplyOptions(sd, EXTENT_DEFAULT_RESERVE);
+
+    /* One extra block for the superblock */
+    blocks = (((squid_off_t) size << 10) >> ei->blksz_bits) + 1;
+    if (blocks > EXTENT_MAX_BLOCKS) {
+	debug(47, 1) ("extent block-size = %d bytes\n", ei->blksz);
+	debug(47, 1) ("extent cache_dir size = %d KB\n", sd->max_size);
+	fatalf("extent cache_dir size needs more than %d blocks, increase block-size\n", EXTENT_MAX_BLOCKS);
+    }
+    if (blocks < 2)
+	fatal("extent cache_dir size must be at least one block\n");
+    ei->nblocks = (int) blocks;
+    ei->free_blocks = ei->nblocks - 1;
+    ei->map = xcalloc((ei->nblocks + 7) / 8, 1);
+    ei->map[0] = 1;		/* the superblock */
+    ei->suggest = 1;
+
+    /* Initialise replacement policy stuff */
+    sd->repl = createRemovalPolicy(Config.replPolicy);
+
+    n_extent_dirs++;
+}
+
+/*
+ * Initial setup / end destruction
+ */
+static void
+storeExtentDirDone(void)
+{
+    memPoolDestroy(extent_state_pool);
+    memPoolDestroy(extent_chunk_pool);
+    extent_initialised = 0;
+}
+
+static void
+storeExtentStats(StoreEntry * sentry)
+{
+    const char *tbl_fmt = "%10s %10d %10d %10d\n";
+    storeAppendPrintf(sentry, "\n                   OPS     SUCCESS        FAIL\n");
+    storeAppendPrintf(sentry, tbl_fmt,
+	"open", extent_stats.open.ops, extent_stats.open.success, extent_stats.open.fail);
+    storeAppendPrintf(sentry, tbl_fmt,
+	"create", extent_stats.create.ops, extent_stats.create.success, extent_stats.create.fail);
+    storeAppendPrintf(sentry, tbl_fmt,
+	"close", extent_stats.close.ops, extent_stats.close.success, extent_stats.close.fail);
+    storeAppendPrintf(sentry, tbl_fmt,
+	"unlink", extent_stats.unlink.ops, extent_stats.unlink.success, extent_stats.unlink.fail);
+    storeAppendPrintf(sentry, tbl_fmt,
+	"read", extent_stats.read.ops, extent_stats.read.success, extent_stats.read.fail);
+    storeAppendPrintf(sentry, tbl_fmt,
+	"write", extent_stats.write.ops, extent_stats.write.success, extent_stats.write.fail);
+    storeAppendPrintf(sentry, "\n");
+    storeAppendPrintf(sentry, "alloc:            %d\n", extent_stats.allocs);
+    storeAppendPrintf(sentry, "alloc_fail:       %d\n", extent_stats.alloc_fail);
+    storeAppendPrintf(sentry, "grow:             %d\n", extent_stats.grows);
+    storeAppendPrintf(sentry, "grow_fail:        %d\n", extent_stats.grow_fail);
+    storeAppendPrintf(sentry, "purged:           %d\n", extent_stats.purged);
+    storeAppendPrintf(sentry, "blocks_trimmed:   %d\n", extent_stats.blocks_trimmed);
+    storeAppendPrintf(sentry, "readahead_hits:   %d\n", extent_stats.ra_hits);
+    storeAppendPrintf(sentry, "readahead_misses: %d\n", extent_stats.ra_misses);
+    storeAppendPrintf(sentry, "bytes_read:       %" PRINTF_OFF_T "\n", extent_stats.bytes_read);
+    storeAppendPrintf(sentry, "bytes_written:    %" PRINTF_OFF_T "\n", extent_stats.bytes_written);
+}
+
+void
+storeFsSetup_extent(storefs_entry_t * storefs)
+{
+    assert(!extent_initialised);
+    storefs->parsefunc = storeExtentDirParse;
+    storefs->reconfigurefunc = storeExtentDirReconfigure;
+    storefs->donefunc = storeExtentDirDone;
+    extent_state_pool = memPoolCreate("Extent IO State data", sizeof(ExtentState));
+    extent_chunk_pool = memPoolCreate("Extent write chunks", sizeof(ExtentChunk));
+    cachemgrRegister(SWAPDIR_EXTENT, "Extent Store Stats", storeExtentStats, 0, 1);
+    extent_initialised = 1;
+}
@@ -0,0 +1,130 @@
+/*
+ * store_extent.h
+ *
+ * Internal declarations for the extent routines
+ */
+
+#ifndef __STORE_EXTENT_H__
+#define __STORE_EXTENT_H__
+
+#define SWAPDIR_EXTENT "extent"
+
+/*
+ * Block 0 of the extent file holds a small superblock so a
+ * mismatching block-size or an unformatted file is caught at startup.
+ * Objects are stored as one contiguous run of blocks starting at
+ * block 1, and the run's first block number is the swap file number.
+ */
+#define EXTENT_MAGIC "SQUIDEXT"
+#define EXTENT_VERSION 1
+
+#define EXTENT_DEFAULT_BLKSZ	(1 << 20)
+#define EXTENT_DEFAULT_IOSZ	(1 << 20)
+#define EXTENT_DEFAULT_RESERVE	(64 << 20)
+
+/* Most objects the allocator may purge to find room for one new run */
+#define EXTENT_MAX_PURGE 50
+
+/* Largest swap file number */
+#define EXTENT_MAX_BLOCKS STORE_FILEN_MAX
+
+struct _extent_superblock {
+    char magic[8];
+    int version;
+    int blksz;
+    int nblocks;
+};
+
+struct _extent_stats {
+    int allocs;
+    int alloc_fail;
+    int grows;
+    int grow_fail;
+    int purged;
+    int blocks_trimmed;
+    int ra_hits;
+    int ra_misses;
+    squid_off_t bytes_read;
+    squid_off_t bytes_written;
+    struct {
+	int ops;
+	int success;
+	int fail;
+    } open, create, close, unlink, read, write;
+};
+
+/* Per-storedir info */
+struct _extentinfo {
+    int fd;
+    int swaplog_fd;
+    const char *extent_path;
+    int blksz;
+    int blksz_bits;
+    int io_size;
+    int reserve_blocks;
+    int nblocks;		/* including the superblock */
+    int free_blocks;
+    int suggest;
+    unsigned char *map;		/* one bit per block */
+    struct {
+	unsigned int rebuilding:1;
+    } flags;
+};
+
+/* Per-storeiostate info */
+struct _extentstate {
+    int nblocks;		/* blocks currently reserved for this run */
+    char *buf;			/* write-behind or read-ahead buffer */
+    int buf_len;
+    int buf_size;
+    squid_off_t buf_offset;	/* object offset of buf[0] when reading */
+    link_list *pending_writes;
+    squid_off_t queued_offset;	/* end of the data handed to aioWrite */
+    int write_len;		/* size of the write in progress */
+    struct {
+	unsigned int close_request:1;
+	unsigned int reading:1;
+	unsigned int writing:1;
+	unsigned int write_error:1;
+	unsigned int inreaddone:1;
+    } flags;
+    char *read_buf;		/* the caller's buffer for a pending read */
+    size_t read_size;
+    squid_off_t read_offset;
+};
+
+struct _extent_chunk {
+    char *buf;
+    int len;
+    squid_off_t offset;
+};
+
+typedef struct _extentinfo ExtentInfo;
+typedef struct _extentstate ExtentState;
+typedef struct _extent_chunk ExtentChunk;
+
+extern MemPool *extent_state_pool;
+extern MemPool *extent_chunk_pool;
+extern struct _extent_stats extent_stats;
+
+extern off_t storeExtentDiskOffset(ExtentInfo *, sfileno, squid_off_t);
+extern int storeExtentBlocks(ExtentInfo *, squid_off_t);
+extern squid_off_t storeExtentObjectSize(const StoreEntry *);
+extern sfileno storeExtentAllocate(SwapDir *, int nblocks);
+extern int storeExtentGrow(SwapDir *, sfileno, int nblocks, int more);
+extern void storeExtentRelease(SwapDir *, sfileno, int nblocks);
+extern void storeExtentDirReplAdd(SwapDir *, StoreEntry *);
+extern void storeExtentDirReplRemove(StoreEntry *);
+
+/*
+ * Store IO stuff
+ */
+extern STOBJCREATE storeExtentCreate;
+extern STOBJOPEN storeExtentOpen;
+extern STOBJCLOSE storeExtentClose;
+extern STOBJREAD storeExtentRead;
+extern STOBJWRITE storeExtentWrite;
+extern STOBJUNLINK storeExtentUnlink;
+extern STOBJRECYCLE storeExtentRecycle;
+
+#endif
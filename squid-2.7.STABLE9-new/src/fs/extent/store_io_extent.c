@@ -0,0 +1,533 @@
+
+/*
+ * $Id$
+ *
+ * DEBUG: section 79    Storage Manager Extent Interface
+ *
+ * SQUID Web Proxy Cache          http://www.squid-cache.org/
+ * ----------------------------------------------------------
+ *
+ *  Squid is the result of efforts by numerous individuals from
+ *  the Internet community; see the CONTRIBUTORS file for full
+ *  details.   Many organizations have provided support for Squid's
+ *  development; see the SPONSORS file for full details.  Squid is
+ *  Copyrighted (C) 2001 by the Regents of the University of
+ *  California; see the COPYRIGHT file for full details.  Squid
+ *  incorporates software developed and/or copyrighted by other
+ *  sources; see the CREDITS file for full details.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111, USA.
+ *
+ */
+
+/*
+ * Writes are collected in an io-size buffer and handed to the aufs
+ * threads one full buffer at a time, in order.  The block run grows
+ * in place when the object turns out to be larger than reserved and
+ * is trimmed to the final size on close.  Reads fetch at least
+ * io-size bytes and serve the following reads from that buffer.
+ */
+
+#include "squid.h"
+
+#include "store_extent.h"
+#include "../aufs/async_io.h"
+
+static AIOCB storeExtentReadDone;
+static AIOCB storeExtentWriteDone;
+static void storeExtentIOCallback(storeIOState * sio, int errflag);
+static void storeExtentCloseDone(storeIOState * sio);
+static int storeExtentFlush(storeIOState * sio);
+static int storeExtentKickWriteQueue(storeIOState * sio);
+static int storeExtentNeedCompletion(storeIOState * sio);
+static CBDUNL storeExtentIOFreeEntry;
+
+CBDATA_TYPE(storeIOState);
+
+static storeIOState *
+storeExtentNewSio(SwapDir * SD, StoreEntry * e, sfileno filn, int mode, STIOCB * callback, void *callback_data)
+{
+    storeIOState *sio;
+    CBDATA_INIT_TYPE_FREECB(storeIOState, storeExtentIOFreeEntry);
+    sio = cbdataAlloc(storeIOState);
+    sio->fsstate = memPoolAlloc(extent_state_pool);
+    sio->swap_filen = filn;
+    sio->swap_dirn = SD->index;
+    sio->mode = mode;
+    sio->callback = callback;
+    sio->callback_data = callback_data;
+    sio->e = e;
+    cbdataLock(callback_data);
+    return sio;
+}
+
+/*
+ * How far into the object a reader may go.  An object still being
+ * swapped out may only be read up to what has reached the disk.
+ */
+static squid_off_t
+storeExtentReadLimit(storeIOState * sio)
+{
+    StoreEntry *e = sio->e;
+    if (e->swap_status == SWAPOUT_DONE)
+	return e->swap_file_sz;
+    if (e->swap_status == SWAPOUT_WRITING && e->mem_obj && e->mem_obj->swapout.sio)
+	return storeOffset(e->mem_obj->swapout.sio);
+    return -1;
+}
+
+/* === PUBLIC =========================================================== */
+
+/* open for reading */
+storeIOState *
+storeExtentOpen(SwapDir * SD, StoreEntry * e, STFNCB * file_callback,
+    STIOCB * callback, void *callback_data)
+{
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    storeIOState *sio;
+    ExtentState *es;
+    debug(79, 3) ("storeExtentOpen: fileno %08X\n", e->swap_filen);
+    extent_stats.open.ops++;
+#ifdef MAGIC2
+    if (aioQueueSize() > MAGIC2) {
+	extent_stats.open.fail++;
+	return NULL;
+    }
+#endif
+    sio = storeExtentNewSio(SD, e, e->swap_filen, O_RDONLY | O_BINARY, callback, callback_data);
+    es = (ExtentState *) sio->fsstate;
+    es->nblocks = storeExtentBlocks(ei, e->swap_file_sz);
+    extent_stats.open.success++;
+    return sio;
+}
+
+/* open for creating */
+storeIOState *
+storeExtentCreate(SwapDir * SD, StoreEntry * e, STFNCB * file_callback, STIOCB * callback, void *callback_data)
+{
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    storeIOState *sio;
+    ExtentState *es;
+    squid_off_t size = storeExtentObjectSize(e);
+    int nblocks;
+    sfileno filn;
+
+    extent_stats.create.ops++;
+#ifdef MAGIC2
+    if (aioQueueSize() > MAGIC2) {
+	extent_stats.create.fail++;
+	return NULL;
+    }
+#endif
+    /*
+     * Reserve the whole object up front when the length is known,
+     * otherwise reserve-size and grow the run as the data arrives.
+     */
+    if (size >= 0)
+	nblocks = storeExtentBlocks(ei, size);
+    else
+	nblocks = ei->reserve_blocks;
+    if (nblocks >= ei->nblocks)
+	nblocks = ei->nblocks - 1;
+    if (nblocks < 1)
+	nblocks = 1;
+    filn = storeExtentAllocate(SD, nblocks);
+    if (filn < 0 && size < 0 && nblocks > 1) {
+	nblocks = 1;
+	filn = storeExtentAllocate(SD, nblocks);
+    }
+    if (filn < 0) {
+	extent_stats.create.fail++;
+	return NULL;
+    }
+    debug(79, 3) ("storeExtentCreate: fileno %08X, %d blocks\n", filn, nblocks);
+    sio = storeExtentNewSio(SD, e, filn, O_WRONLY | O_BINARY, callback, callback_data);
+    es = (ExtentState *) sio->fsstate;
+    es->nblocks = nblocks;
+    extent_stats.create.success++;
+
+    /* now insert into the replacement policy */
+    storeExtentDirReplAdd(SD, e);
+    return sio;
+}
+
+/* Close */
+void
+storeExtentClose(SwapDir * SD, storeIOState * sio)
+{
+    ExtentState *es = (ExtentState *) sio->fsstate;
+    debug(79, 3) ("storeExtentClose: dirno %d, fileno %08X\n",
+	sio->swap_dirn, sio->swap_filen);
+    extent_stats.close.ops++;
+    if (FILE_MODE(sio->mode) == O_WRONLY && !es->flags.write_error) {
+	/* the error is reported by the flush, now or when the write completes */
+	if (!storeExtentFlush(sio))
+	    return;
+    }
+    if (storeExtentNeedCompletion(sio)) {
+	es->flags.close_request = 1;
+	return;
+    }
+    storeExtentCloseDone(sio);
+}
+
+/* Read */
+void
+storeExtentRead(SwapDir * SD, storeIOState * sio, char *buf, size_t size, squid_off_t offset, STRCB * callback, void *callback_data)
+{
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    ExtentState *es = (ExtentState *) sio->fsstate;
+    squid_off_t limit = storeExtentReadLimit(sio);
+    squid_off_t len;
+    assert(sio->read.callback == NULL);
+    assert(sio->read.callback_data == NULL);
+    assert(!es->flags.reading);
+    debug(79, 3) ("storeExtentRead: dirno %d, fileno %08X, offset %" PRINTF_OFF_T ", size %d\n",
+	sio->swap_dirn, sio->swap_filen, offset, (int) size);
+    extent_stats.read.ops++;
+    sio->offset = offset;
+    if (limit >= 0 && offset + (squid_off_t) size > limit)
+	size = offset < limit ? (size_t) (limit - offset) : 0;
+    if (es->buf && offset >= es->buf_offset && offset < es->buf_offset + es->buf_len) {
+	/* served from the read-ahead buffer */
+	len = es->buf_offset + es->buf_len - offset;
+	if (len > (squid_off_t) size)
+	    len = size;
+	xmemcpy(buf, es->buf + (offset - es->buf_offset), (size_t) len);
+	sio->offset += len;
+	extent_stats.ra_hits++;
+	extent_stats.read.success++;
+	callback(callback_data, buf, (ssize_t) len);
+	return;
+    }
+    if (size == 0) {
+	extent_stats.read.success++;
+	callback(callback_data, buf, 0);
+	return;
+    }
+    extent_stats.ra_misses++;
+    len = size > (size_t) ei->io_size ? (squid_off_t) size : ei->io_size;
+    if (limit >= 0 && offset + len > limit)
+	len = limit - offset;
+    sio->read.callback = callback;
+    sio->read.callback_data = callback_data;
+    cbdataLock(callback_data);
+    es->read_buf = buf;
+    es->read_size = size;
+    es->read_offset = offset;
+    es->flags.reading = 1;
+    aioRead(ei->fd, storeExtentDiskOffset(ei, sio->swap_filen, offset), (int) len,
+	storeExtentReadDone, sio);
+    statCounter.syscalls.disk.reads++;
+}
+
+/* Write */
+void
+storeExtentWrite(SwapDir * SD, storeIOState * sio, char *buf, size_t size, squid_off_t offset, FREE * free_func)
+{
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    ExtentState *es = (ExtentState *) sio->fsstate;
+    size_t done = 0;
+    size_t n;
+    debug(79, 3) ("storeExtentWrite: dirno %d, fileno %08X, offset %" PRINTF_OFF_T ", size %d\n",
+	sio->swap_dirn, sio->swap_filen, offset, (int) size);
+    assert(offset == es->queued_offset + es->buf_len);
+    /* cbdataLock to protect us from the storeExtentIOCallback in the flush */
+    cbdataLock(sio);
+    while (done < size && !es->flags.write_error) {
+	if (es->buf == NULL) {
+	    es->buf = xmalloc(ei->io_size);
+	    es->buf_size = ei->io_size;
+	}
+	n = size - done;
+	if (n > (size_t) (es->buf_size - es->buf_len))
+	    n = es->buf_size - es->buf_len;
+	xmemcpy(es->buf + es->buf_len, buf + done, n);
+	es->buf_len += n;
+	done += n;
+	if (es->buf_len == es->buf_size)
+	    if (!storeExtentFlush(sio))
+		break;
+    }
+    cbdataUnlock(sio);
+    if (free_func)
+	free_func(buf);
+}
+
+/* Unlink */
+void
+storeExtentUnlink(SwapDir * SD, StoreEntry * e)
+{
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    debug(79, 3) ("storeExtentUnlink: dirno %d, fileno %08X\n", SD->index, e->swap_filen);
+    extent_stats.unlink.ops++;
+    storeExtentDirReplRemove(e);
+    storeExtentRelease(SD, e->swap_filen, storeExtentBlocks(ei, e->swap_file_sz));
+    extent_stats.unlink.success++;
+}
+
+void
+storeExtentRecycle(SwapDir * SD, StoreEntry * e)
+{
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    debug(79, 3) ("storeExtentRecycle: fileno %08X\n", e->swap_filen);
+
+    /* detach from the underlying physical object */
+    if (e->swap_filen > -1) {
+	storeExtentDirReplRemove(e);
+	storeExtentRelease(SD, e->swap_filen, storeExtentBlocks(ei, e->swap_file_sz));
+	e->swap_filen = -1;
+	e->swap_dirn = -1;
+    }
+}
+
+/*  === STATIC =========================================================== */
+
+/*
+ * Queue the write-behind buffer for the disk, growing the run first
+ * if it does not reach that far yet.  Returns 0 if the run could not
+ * grow; the error is then reported right away, or once the write in
+ * progress has completed.
+ */
+static int
+storeExtentFlush(storeIOState * sio)
+{
+    SwapDir *SD = INDEXSD(sio->swap_dirn);
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    ExtentState *es = (ExtentState *) sio->fsstate;
+    ExtentChunk *q;
+    int need;
+    if (es->buf_len == 0)
+	return 1;
+    need = storeExtentBlocks(ei, es->queued_offset + es->buf_len);
+    if (need > es->nblocks) {
+	int more = need - es->nblocks;
+	extent_stats.grows++;
+	if (more < ei->reserve_blocks && storeExtentGrow(SD, sio->swap_filen, es->nblocks, ei->reserve_blocks))
+	    more = ei->reserve_blocks;
+	else if (!storeExtentGrow(SD, sio->swap_filen, es->nblocks, more)) {
+	    debug(79, 2) ("storeExtentFlush: fileno %08X cannot grow past %d blocks\n",
+		sio->swap_filen, es->nblocks);
+	    extent_stats.grow_fail++;
+	    es->flags.write_error = 1;
+	    if (!es->flags.writing)
+		storeExtentIOCallback(sio, DISK_ERROR);
+	    return 0;
+	}
+	es->nblocks += more;
+    }
+    q = memPoolAlloc(extent_chunk_pool);
+    q->buf = es->buf;
+    q->len = es->buf_len;
+    q->offset = es->queued_offset;
+    linklistPush(&es->pending_writes, q);
+    es->queued_offset += es->buf_len;
+    es->buf = NULL;
+    es->buf_len = 0;
+    es->buf_size = 0;
+    if (!es->flags.writing)
+	storeExtentKickWriteQueue(sio);
+    return 1;
+}
+
+static int
+storeExtentKickWriteQueue(storeIOState * sio)
+{
+    ExtentInfo *ei = (ExtentInfo *) INDEXSD(sio->swap_dirn)->fsdata;
+    ExtentState *es = (ExtentState *) sio->fsstate;
+    ExtentChunk *q = linklistShift(&es->pending_writes);
+    if (NULL == q)
+	return 0;
+    debug(79, 3) ("storeExtentKickWriteQueue: writing %d bytes at %" PRINTF_OFF_T "\n",
+	q->len, q->offset);
+    extent_stats.write.ops++;
+    es->flags.writing = 1;
+    es->write_len = q->len;
+    aioWrite(ei->fd, storeExtentDiskOffset(ei, sio->swap_filen, q->offset), q->buf, q->len,
+	storeExtentWriteDone, sio, xfree);
+    statCounter.syscalls.disk.writes++;
+    memPoolFree(extent_chunk_pool, q);
+    return 1;
+}
+
+static void
+storeExtentReadDone(int fd, void *my_data, const char *buf, int len, int errflag)
+{
+    storeIOState *sio = my_data;
+    ExtentState *es = (ExtentState *) sio->fsstate;
+    STRCB *callback = sio->read.callback;
+    void *their_data = sio->read.callback_data;
+    ssize_t rlen;
+    int inreaddone = es->flags.inreaddone;	/* Protect from callback loops */
+    debug(79, 3) ("storeExtentReadDone: dirno %d, fileno %08X, len %d\n",
+	sio->swap_dirn, sio->swap_filen, len);
+    es->flags.inreaddone = 1;
+    es->flags.reading = 0;
+    if (errflag || len < 0) {
+	debug(79, 3) ("storeExtentReadDone: got failure (%d)\n", errflag);
+	extent_stats.read.fail++;
+	rlen = -1;
+	errflag = DISK_ERROR;
+    } else {
+	/* keep the whole read for the next requests */
+	if (es->buf_size < len) {
+	    safe_free(es->buf);
+	    es->buf = xmalloc(len);
+	    es->buf_size = len;
+	}
+	if (len > 0)
+	    xmemcpy(es->buf, buf, len);
+	es->buf_len = len;
+	es->buf_offset = es->read_offset;
+	rlen = len < (int) es->read_size ? len : (ssize_t) es->read_size;
+	sio->offset += rlen;
+	extent_stats.read.success++;
+	extent_stats.bytes_read += len;
+	errflag = DISK_OK;
+    }
+    assert(callback);
+    assert(their_data);
+    sio->read.callback = NULL;
+    sio->read.callback_data = NULL;
+    if (!es->flags.close_request && cbdataValid(their_data)) {
+	if (rlen > 0)
+	    xmemcpy(es->read_buf, buf, rlen);
+	callback(their_data, es->read_buf, rlen);
+    }
+    cbdataUnlock(their_data);
+    es->flags.inreaddone = 0;
+    if (es->flags.close_request && !inreaddone)
+	storeExtentIOCallback(sio, errflag);
+}
+
+static void
+storeExtentWriteDone(int fd, void *my_data, const char *buf, int aio_return, int aio_errno)
+{
+    storeIOState *sio = my_data;
+    ExtentState *es = (ExtentState *) sio->fsstate;
+    debug(79, 3) ("storeExtentWriteDone: dirno %d, fileno %08X, len %d, err=%d\n",
+	sio->swap_dirn, sio->swap_filen, aio_return, aio_errno);
+    es->flags.writing = 0;
+    if (aio_errno || aio_return != es->write_len) {
+	debug(79, 0) ("storeExtentWriteDone: got failure (%d)\n", aio_errno);
+	extent_stats.write.fail++;
+	storeExtentIOCallback(sio, aio_errno == ENOSPC ? DISK_NO_SPACE_LEFT : DISK_ERROR);
+	return;
+    }
+    extent_stats.write.success++;
+    extent_stats.bytes_written += aio_return;
+    sio->offset += aio_return;
+    if (es->flags.write_error)
+	storeExtentIOCallback(sio, DISK_ERROR);
+    else if (storeExtentKickWriteQueue(sio))
+	(void) 0;
+    else if (es->flags.close_request)
+	storeExtentCloseDone(sio);
+}
+
+/*
+ * All I/O has completed.  A swapout is only good if the whole object
+ * made it to the disk; the unused tail of the run is given back.
+ */
+static void
+storeExtentCloseDone(storeIOState * sio)
+{
+    SwapDir *SD = INDEXSD(sio->swap_dirn);
+    ExtentInfo *ei = (ExtentInfo *) SD->fsdata;
+    ExtentState *es = (ExtentState *) sio->fsstate;
+    StoreEntry *e = sio->e;
+    int used;
+    if (FILE_MODE(sio->mode) != O_WRONLY) {
+	storeExtentIOCallback(sio, DISK_OK);
+	return;
+    }
+    if (e->store_status != STORE_OK || EBIT_TEST(e->flags, ENTRY_ABORTED) ||
+	sio->offset != objectLen(e) + e->mem_obj->swap_hdr_sz) {
+	debug(79, 3) ("storeExtentCloseDone: fileno %08X incomplete at %" PRINTF_OFF_T "\n",
+	    sio->swap_filen, sio->offset);
+	storeExtentIOCallback(sio, DISK_ERROR);
+	return;
+    }
+    used = storeExtentBlocks(ei, sio->offset);
+    if (es->nblocks > used) {
+	storeExtentRelease(SD, sio->swap_filen + used, es->nblocks - used);
+	extent_stats.blocks_trimmed += es->nblocks - used;
+	es->nblocks = used;
+    }
+    storeExtentIOCallback(sio, DISK_OK);
+}
+
+static void
+storeExtentIOCallback(storeIOState * sio, int errflag)
+{
+    STIOCB *callback = sio->callback;
+    void *their_data = sio->callback_data;
+    ExtentState *es = (ExtentState *) sio->fsstate;
+    debug(79, 3) ("storeExtentIOCallback: errflag=%d\n", errflag);
+    if (FILE_MODE(sio->mode) == O_WRONLY && errflag != DISK_OK) {
+	/* storeUnlink() finds swap_file_sz still 0 and releases nothing */
+	storeExtentRelease(INDEXSD(sio->swap_dirn), sio->swap_filen, es->nblocks);
+	es->nblocks = 0;
+    }
+    if (errflag == DISK_OK)
+	extent_stats.close.success++;
+    else
+	extent_stats.close.fail++;
+    sio->callback = NULL;
+    sio->callback_data = NULL;
+    if (callback)
+	if (NULL == their_data || cbdataValid(their_data))
+	    callback(their_data, errflag, sio);
+    cbdataUnlock(their_data);
+    cbdataFree(sio);
+}
+
+static int
+storeExtentNeedCompletion(storeIOState * sio)
+{
+    ExtentState *es = (ExtentState *) sio->fsstate;
+
+    if (es->flags.writing)
+	return 1;
+    if (es->flags.reading)
+	return 1;
+    if (es->flags.inreaddone)
+	return 1;
+
+    return 0;
+}
+
+/*
+ * Clean up references from the SIO before it gets released.
+ * The actual SIO is managed by cbdata so we do not need
+ * to bother with that.
+ */
+static void
+storeExtentIOFreeEntry(void *siop)
+{
+    storeIOState *sio = (storeIOState *) siop;
+    ExtentState *es = (ExtentState *) sio->fsstate;
+    ExtentChunk *q;
+    while ((q = linklistShift(&es->pending_writes))) {
+	xfree(q->buf);
+	memPoolFree(extent_chunk_pool, q);
+    }
+    safe_free(es->buf);
+    if (sio->read.callback_data)
+	cbdataUnlock(sio->read.callback_data);
+    if (sio->callback_data)
+	cbdataUnlock(sio->callback_data);
+    memPoolFree(extent_state_pool, es);
+}
@@ -52,6 +52,7 @@ struct _RebuildState {
     struct {
 	unsigned int clean:1;
 	unsigned int init:1;
+	unsigned int old_filen:1;	/* swap_filen may carry a 2.4 cache_dir index */
     } flags;
     int done;
     int in_dir;
@@ -479,12 +480,12 @@ storeUfsDirRebuildFromDirectory(void *data)
 #if SIZEOF_SQUID_FILE_SZ == SIZEOF_SIZE_T
 	    case STORE_META_STD:
 		assert(t->length == STORE_HDR_METASIZE);
-		xmemcpy(&tmpe.timestamp, t->value, STORE_HDR_METASIZE);
+		storeSwapMetaUnpackStd(&tmpe, t->value);
 		break;
 #else
 	    case STORE_META_STD_LFS:
 		assert(t->length == STORE_HDR_METASIZE);
-		xmemcpy(&tmpe.timestamp, t->value, STORE_HDR_METASIZE);
+		storeSwapMetaUnpackStd(&tmpe, t->value);
 		break;
 	    case STORE_META_STD:
 		assert(t->length == STORE_HDR_METASIZE_OLD);
@@ -499,10 +500,10 @@ storeUfsDirRebuildFromDirectory(void *data)
 			u_short flags;
 		    }     *tmp = t->value;
 		    assert(sizeof(*tmp) == STORE_HDR_METASIZE_OLD);
-		    tmpe.timestamp = tmp->timestamp;
-		    tmpe.lastref = tmp->lastref;
-		    tmpe.expires = tmp->expires;
-		    tmpe.lastmod = tmp->lastmod;
+		    tmpe.timestamp = storeTimeRel(tmp->timestamp);
+		    tmpe.lastref = storeTimeRel(tmp->lastref);
+		    tmpe.expires = storeTimeRel(tmp->expires);
+		    tmpe.lastmod = storeTimeRel(tmp->lastmod);
 		    tmpe.swap_file_sz = tmp->swap_file_sz;
 		    tmpe.refcount = tmp->refcount;
 		    tmpe.flags = tmp->flags;
@@ -520,7 +521,7 @@ storeUfsDirRebuildFromDirectory(void *data)
 	    storeUfsDirUnlinkFile(SD, filn);
 	    continue;
 	}
-	tmpe.hash.key = key;
+	storeKeyCopy(tmpe.key, key);
 	/* check sizes */
 	if (tmpe.swap_file_sz == 0) {
 	    tmpe.swap_file_sz = sb.st_size;
@@ -554,10 +555,10 @@ storeUfsDirRebuildFromDirectory(void *data)
 	e = storeUfsDirAddDiskRestore(SD, key,
 	    filn,
 	    tmpe.swap_file_sz,
-	    tmpe.expires,
-	    tmpe.timestamp,
-	    tmpe.lastref,
-	    tmpe.lastmod,
+	    storeTime(tmpe.expires),
+	    storeTime(tmpe.timestamp),
+	    storeTime(tmpe.lastref),
+	    storeTime(tmpe.lastmod),
 	    tmpe.refcount,	/* refcount */
 	    tmpe.flags,		/* flags */
 	    (int) rb->flags.clean);
@@ -592,9 +593,11 @@ storeUfsDirRebuildFromSwapLog(void *data)
 	 * to encode the SD index number.  There used to be a call
 	 * to storeDirProperFileno here that re-assigned the index 
 	 * bits.  Now, for backwards compatibility, we just need
-	 * to mask it off.
+	 * to mask it off in logs older than STORE_SWAP_LOG_VERSION,
+	 * newer ones hold the full file number.
 	 */
-	s.swap_filen &= 0x00FFFFFF;
+	if (rb->flags.old_filen)
+	    s.swap_filen &= 0x00FFFFFF;
 	debug(47, 3) ("storeUfsDirRebuildFromSwapLog: %s %s %08X\n",
 	    swap_log_op_str[(int) s.op],
 	    storeKeyText(s.key),
@@ -603,7 +606,7 @@ storeUfsDirRebuildFromSwapLog(void *data)
 	    (void) 0;
 	} else if (s.op == SWAP_LOG_DEL) {
 	    /* Delete unless we already have a newer copy */
-	    if ((e = storeGet(s.key)) != NULL && s.lastref >= e->lastref) {
+	    if ((e = storeGet(s.key)) != NULL && s.lastref >= storeTime(e->lastref)) {
 		/*
 		 * Make sure we don't unlink the file, it might be
 		 * in use by a subsequent entry.  Also note that
@@ -642,7 +645,7 @@ storeUfsDirRebuildFromSwapLog(void *data)
 	/* If this URL already exists in the cache, does the swap log
 	 * appear to have a newer entry?  Compare 'lastref' from the
 	 * swap log to e->lastref. */
-	disk_entry_newer = e ? (s.lastref > e->lastref ? 1 : 0) : 0;
+	disk_entry_newer = e ? (s.lastref > storeTime(e->lastref) ? 1 : 0) : 0;
 	if (used && !disk_entry_newer) {
 	    /* log entry is old, ignore it */
 	    rb->counts.clashcount++;
@@ -650,10 +653,10 @@ storeUfsDirRebuildFromSwapLog(void *data)
 	} else if (used && e && e->swap_filen == s.swap_filen && e->swap_dirn == SD->index) {
 	    /* swapfile taken, same URL, newer, update meta */
 	    if (e->store_status == STORE_OK) {
-		e->lastref = s.timestamp;
-		e->timestamp = s.timestamp;
-		e->expires = s.expires;
-		e->lastmod = s.lastmod;
+		e->lastref = storeTimeRel(s.timestamp);
+		e->timestamp = storeTimeRel(s.timestamp);
+		e->expires = storeTimeRel(s.expires);
+		e->lastmod = storeTimeRel(s.lastmod);
 		e->flags = s.flags;
 		e->refcount += s.refcount;
 		storeUfsDirUnrefObj(SD, e);
@@ -740,9 +743,11 @@ storeUfsDirRebuildFromSwapLogOld(void *data)
 	 * to encode the SD index number.  There used to be a call
 	 * to storeDirProperFileno here that re-assigned the index 
 	 * bits.  Now, for backwards compatibility, we just need
-	 * to mask it off.
+	 * to mask it off in logs older than STORE_SWAP_LOG_VERSION,
+	 * newer ones hold the full file number.
 	 */
-	s.swap_filen &= 0x00FFFFFF;
+	if (rb->flags.old_filen)
+	    s.swap_filen &= 0x00FFFFFF;
 	debug(47, 3) ("storeUfsDirRebuildFromSwapLog: %s %s %08X\n",
 	    swap_log_op_str[(int) s.op],
 	    storeKeyText(s.key),
@@ -877,12 +882,15 @@ storeUfsDirRebuildFromSwapLogCheckVersion(void *data)
 	    storeUfsDirRebuildComplete(rb);
 	    return;
 	}
-	if (hdr.version == 1 && hdr.record_size == sizeof(storeSwapLogData)) {
+	rb->flags.old_filen = hdr.version < STORE_SWAP_LOG_VERSION;
+	if (hdr.version >= 1 && hdr.version <= STORE_SWAP_LOG_VERSION && hdr.record_size == sizeof(storeSwapLogData)) {
+	    if (rb->flags.old_filen)
+		debug(47, 1) ("storeUfsDirRebuildFromSwapLog: Found version %d. Upgrading\n", hdr.version);
 	    eventAdd("storeRebuild", storeUfsDirRebuildFromSwapLog, rb, 0.0, 1);
 	    return;
 	}
 #if SIZEOF_SQUID_FILE_SZ != SIZEOF_SIZE_T
-	if (hdr.version == 1 && hdr.record_size == sizeof(storeSwapLogDataOld)) {
+	if (hdr.version >= 1 && hdr.version <= STORE_SWAP_LOG_VERSION && hdr.record_size == sizeof(storeSwapLogDataOld)) {
 	    debug(47, 1) ("storeUfsDirRebuildFromSwapLog: Found current version but without large file support. Upgrading\n");
 	    eventAdd("storeRebuild", storeUfsDirRebuildFromSwapLogOld, rb, 0.0, 1);
 	    return;
@@ -894,6 +902,7 @@ storeUfsDirRebuildFromSwapLogCheckVersion(void *data)
 	return;
     }
     rewind(rb->log);
+    rb->flags.old_filen = 1;
     debug(47, 1) ("storeUfsDirRebuildFromSwapLog: Old version detected. Upgrading\n");
 #if SIZEOF_SQUID_FILE_SZ == SIZEOF_SIZE_T
     eventAdd("storeRebuild", storeUfsDirRebuildFromSwapLog, rb, 0.0, 1);
@@ -1015,10 +1024,10 @@ storeUfsDirAddDiskRestore(SwapDir * SD, const cache_key * key,
     e->swap_dirn = SD->index;
     e->swap_file_sz = swap_file_sz;
     e->lock_count = 0;
-    e->lastref = lastref;
-    e->timestamp = timestamp;
-    e->expires = expires;
-    e->lastmod = lastmod;
+    e->lastref = storeTimeRel(lastref);
+    e->timestamp = storeTimeRel(timestamp);
+    e->expires = storeTimeRel(expires);
+    e->lastmod = storeTimeRel(lastmod);
     e->refcount = refcount;
     e->flags = flags;
     EBIT_SET(e->flags, ENTRY_CACHABLE);
@@ -1100,7 +1109,7 @@ storeUfsWriteSwapLogheader(int fd)
 {
     storeSwapLogHeader *hdr = memAllocate(MEM_SWAP_LOG_DATA);
     hdr->op = SWAP_LOG_VERSION;
-    hdr->version = 1;
+    hdr->version = STORE_SWAP_LOG_VERSION;
     hdr->record_size = sizeof(storeSwapLogData);
     /* The header size is a full log record to keep some level of backward
      * compatibility even if the actual header is smaller
@@ -1243,14 +1252,14 @@ storeUfsDirWriteCleanEntry(SwapDir * sd, const StoreEntry * e)
     memset(&s, '\0', ss);
     s.op = (char) SWAP_LOG_ADD;
     s.swap_filen = e->swap_filen;
-    s.timestamp = e->timestamp;
-    s.lastref = e->lastref;
-    s.expires = e->expires;
-    s.lastmod = e->lastmod;
+    s.timestamp = storeTime(e->timestamp);
+    s.lastref = storeTime(e->lastref);
+    s.expires = storeTime(e->expires);
+    s.lastmod = storeTime(e->lastmod);
     s.swap_file_sz = e->swap_file_sz;
     s.refcount = e->refcount;
     s.flags = e->flags;
-    xmemcpy(&s.key, e->hash.key, SQUID_MD5_DIGEST_LENGTH);
+    xmemcpy(&s.key, e->key, SQUID_MD5_DIGEST_LENGTH);
     xmemcpy(state->outbuf + state->outbuf_offset, &s, ss);
     state->outbuf_offset += ss;
     /* buffered write */
@@ -1332,14 +1341,14 @@ storeUfsDirSwapLog(const SwapDir * sd, const StoreEntry * e, int op)
     storeSwapLogData *s = memAllocate(MEM_SWAP_LOG_DATA);
     s->op = (char) op;
     s->swap_filen = e->swap_filen;
-    s->timestamp = e->timestamp;
-    s->lastref = e->lastref;
-    s->expires = e->expires;
-    s->lastmod = e->lastmod;
+    s->timestamp = storeTime(e->timestamp);
+    s->lastref = storeTime(e->lastref);
+    s->expires = storeTime(e->expires);
+    s->lastmod = storeTime(e->lastmod);
     s->swap_file_sz = e->swap_file_sz;
     s->refcount = e->refcount;
     s->flags = e->flags;
-    xmemcpy(s->key, e->hash.key, SQUID_MD5_DIGEST_LENGTH);
+    xmemcpy(s->key, e->key, SQUID_MD5_DIGEST_LENGTH);
     file_write(ufsinfo->swaplog_fd,
 	-1,
 	s,
@@ -1920,6 +1929,7 @@ storeUfsDirParse(SwapDir * sd, int index, char *path)
     sd->obj.write = storeUfsWrite;
     sd->obj.unlink = storeUfsUnlink;
     sd->obj.recycle = storeUfsRecycle;
+    sd->obj.path = storeUfsDirFullPath;
     sd->log.open = storeUfsDirOpenSwapLog;
     sd->log.close = storeUfsDirCloseSwapLog;
     sd->log.write = storeUfsDirSwapLog;
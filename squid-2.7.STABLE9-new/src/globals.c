@@ -109,8 +109,6 @@ time_t hit_only_mode_until = 0;
 StatCounters statCounter;
 double request_failure_ratio = 0.0;
 double current_dtime;
-int store_hash_buckets = 0;
-hash_table *store_table = NULL;
 dlink_list ClientActiveRequests;
 const String StringNull = { 0, 0, NULL };
 const MemBuf MemBufNull = MemBufNULL;
@@ -136,6 +134,7 @@ storerepl_entry_t *storerepl_list = NULL;
 int store_swap_low = 0;
 int store_swap_high = 0;
 int store_pages_max = 0;
+size_t mem_page_size = SM_PAGE_SIZE;
 squid_off_t store_maxobjsize = -1;
 RemovalPolicy *mem_policy;
 hash_table *proxy_auth_username_cache = NULL;
@@ -159,7 +158,9 @@ int opt_no_daemon = 0;
 int need_linux_tproxy = 0;
 #endif
 int opt_parse_cfg_only = 0;
+int worker_id = 0;
 int n_coss_dirs = 0;
+int n_extent_dirs = 0;
 #ifdef LOG_LOCAL4
 int syslog_facility = LOG_LOCAL4;
 #endif
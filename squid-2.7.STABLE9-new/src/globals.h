@@ -127,8 +127,6 @@ extern const char *swap_log_op_str[];
 extern const char *lookup_t_str[];
 extern double request_failure_ratio;	/* 0.0 */
 extern double current_dtime;
-extern int store_hash_buckets;	/* 0 */
-extern hash_table *store_table;	/* NULL */
 extern dlink_list ClientActiveRequests;
 extern const String StringNull;	/* { 0, 0, NULL } */
 extern const MemBuf MemBufNull;	/* MemBufNULL */
@@ -155,6 +153,7 @@ extern storerepl_entry_t *storerepl_list;	/* NULL */
 extern int store_swap_low;	/* 0 */
 extern int store_swap_high;	/* 0 */
 extern int store_pages_max;	/* 0 */
+extern size_t mem_page_size;	/* SM_PAGE_SIZE */
 extern squid_off_t store_maxobjsize;	/* -1 */
 extern RemovalPolicy *mem_policy;
 extern hash_table *proxy_auth_username_cache;	/* NULL */
@@ -178,7 +177,9 @@ extern int opt_no_daemon;	/* 0 */
 extern int need_linux_tproxy;	/* 0 */
 #endif
 extern int opt_parse_cfg_only;	/* 0 */
+extern int worker_id;		/* 0 */
 extern int n_coss_dirs;		/* 0 */
+extern int n_extent_dirs;	/* 0 */
 #ifdef LOG_LOCAL4
 extern int syslog_facility;	/* LOG_LOCAL4 */
 #endif
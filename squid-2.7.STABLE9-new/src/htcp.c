@@ -664,17 +664,17 @@ htcpTstReply(htcpDataHeader * dhdr, StoreEntry * e, htcpSpecifier * spec, struct
 	stuff.S.version = spec->version;
 	stuff.S.req_hdrs = spec->req_hdrs;
 	httpHeaderPutInt(&hdr, HDR_AGE,
-	    e->timestamp <= squid_curtime ?
-	    squid_curtime - e->timestamp : 0);
+	    storeTime(e->timestamp) <= squid_curtime ?
+	    squid_curtime - storeTime(e->timestamp) : 0);
 	httpHeaderPackInto(&hdr, &p);
 	stuff.D.resp_hdrs = xstrdup(mb.buf);
 	debug(31, 3) ("htcpTstReply: resp_hdrs = {%s}\n", stuff.D.resp_hdrs);
 	memBufReset(&mb);
 	httpHeaderReset(&hdr);
-	if (e->expires > -1)
-	    httpHeaderPutTime(&hdr, HDR_EXPIRES, e->expires);
-	if (e->lastmod > -1)
-	    httpHeaderPutTime(&hdr, HDR_LAST_MODIFIED, e->lastmod);
+	if (storeTime(e->expires) > -1)
+	    httpHeaderPutTime(&hdr, HDR_EXPIRES, storeTime(e->expires));
+	if (storeTime(e->lastmod) > -1)
+	    httpHeaderPutTime(&hdr, HDR_LAST_MODIFIED, storeTime(e->lastmod));
 	httpHeaderPackInto(&hdr, &p);
 	stuff.D.entity_hdrs = xstrdup(mb.buf);
 	debug(31, 3) ("htcpTstReply: entity_hdrs = {%s}\n", stuff.D.entity_hdrs);
@@ -1202,7 +1202,7 @@ htcpQuery(StoreEntry * e, request_t * req, peer * p)
     htcpSend(pkt, (int) pktlen, &p->in_addr);
     queried_id[stuff.msg_id % N_QUERIED_KEYS] = stuff.msg_id;
     save_key = queried_keys[stuff.msg_id % N_QUERIED_KEYS];
-    storeKeyCopy(save_key, e->hash.key);
+    storeKeyCopy(save_key, e->key);
     queried_addr[stuff.msg_id % N_QUERIED_KEYS] = p->in_addr;
     debug(31, 3) ("htcpQuery: key (%p) %s\n", save_key, storeKeyText(save_key));
 }
@@ -131,7 +131,7 @@ httpCacheNegatively(StoreEntry * entry)
     storeNegativeCache(entry);
     if (EBIT_TEST(entry->flags, ENTRY_CACHABLE))
 	storeSetPublicKey(entry);
-    if (entry->expires <= squid_curtime)
+    if (storeTime(entry->expires) <= squid_curtime)
 	storeRelease(entry);
 }
 
@@ -227,6 +227,7 @@ httpCachableReply(HttpStateData * httpState)
     HttpHeader *hdr = &rep->header;
     const int cc_mask = (rep->cache_control) ? rep->cache_control->mask : 0;
     const char *v;
+    http_status status;
 #if HTTP_VIOLATIONS
     const refresh_t *R = NULL;
     /* This strange looking define first looks up the frefresh pattern
@@ -271,7 +272,15 @@ httpCachableReply(HttpStateData * httpState)
     if ((v = httpHeaderGetStr(hdr, HDR_CONTENT_TYPE)))
 	if (!strncasecmp(v, "multipart/x-mixed-replace", 25))
 	    return 0;
-    switch (httpState->entry->mem_obj->reply->sline.status) {
+    status = rep->sline.status;
+    if (httpState->orig_request->video.segment) {
+	/* A video segment is the range asked for, and only that */
+	if (status == HTTP_PARTIAL_CONTENT)
+	    status = HTTP_OK;
+	else if (status == HTTP_OK)
+	    return 0;
+    }
+    switch (status) {
 	/* Responses that are cacheable */
     case HTTP_OK:
     case HTTP_NON_AUTHORITATIVE_INFORMATION:
@@ -423,7 +432,7 @@ httpProcessReplyHeader(HttpStateData * httpState, const char *buf, int size)
     HttpReply *reply = entry->mem_obj->reply;
     Ctx ctx = ctx_enter(entry->mem_obj->url);
     debug(11, 3) ("httpProcessReplyHeader: key '%s'\n",
-	storeKeyText(entry->hash.key));
+	storeKeyText(entry->key));
     if (memBufIsNull(&httpState->reply_hdr))
 	memBufDefInit(&httpState->reply_hdr);
     assert(httpState->reply_hdr_state == 0);
@@ -1111,7 +1120,7 @@ httpBuildRequestHeader(request_t * request,
 	we_do_ranges = 0;
     else if (orig_request->flags.auth)
 	we_do_ranges = 0;
-    else if (httpHdrRangeOffsetLimit(orig_request->range))
+    else if (httpHdrRangeOffsetLimit(orig_request->range) && !videoCacheRangeFromFull(orig_request))
 	we_do_ranges = 0;
     else
 	we_do_ranges = 1;
@@ -1258,6 +1267,9 @@ httpBuildRequestHeader(request_t * request,
 	httpHeaderPutStr(hdr_out, HDR_X_FORWARDED_FOR, strBuf(strFwd));
 	stringClean(&strFwd);
     }
+    /* vouch for the request to the other worker */
+    if (flags.worker)
+	workerRequestHeader(orig_request, hdr_out);
     /* append Host if not there already */
     if (!httpHeaderHas(hdr_out, HDR_HOST)) {
 	if (orig_request->peer_domain) {
@@ -1466,6 +1478,7 @@ httpSendRequest(HttpStateData * httpState)
 	    !httpState->peer->options.allow_miss)
 	    httpState->flags.only_if_cached = 1;
 	httpState->flags.front_end_https = httpState->peer->front_end_https;
+	httpState->flags.worker = httpState->peer->options.worker;
     }
     if (httpState->peer)
 	httpState->flags.http11 = httpState->peer->options.http11;
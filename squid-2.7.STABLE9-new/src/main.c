@@ -35,8 +35,6 @@
 
 #include "squid.h"
 
-#define KEYWORDS "/etc/squid/keyword.txt"
-#define EXCLUSIONS "/etc/squid/exclusions.txt"
 
 #if defined(USE_WIN32_SERVICE) && defined(_SQUID_WIN32_)
 #include <windows.h>
@@ -339,10 +337,12 @@ serverConnectionsOpen(void)
     snmpConnectionOpen();
 #endif
 #if USE_WCCP
-    wccpConnectionOpen();
+    if (worker_id <= 1)
+	wccpConnectionOpen();
 #endif
 #if USE_WCCPv2
-    wccp2ConnectionOpen();
+    if (worker_id <= 1)
+	wccp2ConnectionOpen();
 #endif
     clientdbInit();
     icmpOpen();
@@ -436,6 +436,7 @@ mainReconfigure(void)
     authenticateInit(&Config.authConfig);
     externalAclInit();
     refreshCheckInit();
+    videoCacheConfigure();
 #if USE_WCCP
     wccpInit();
 #endif
@@ -457,7 +458,8 @@ mainReconfigure(void)
 	    eventDelete(start_announce, NULL);
     }
     eventCleanup();
-    writePidFile();		/* write PID file */
+    if (!worker_id)
+	writePidFile();		/* write PID file */
     debug(1, 1) ("Ready to serve requests.\n");
     reconfiguring = 0;
 }
@@ -550,7 +552,7 @@ mainInitialize(void)
     squid_signal(SIGCHLD, sig_child, SA_NODEFER | SA_RESTART);
 
     setEffectiveUser();
-    if (icpPortNumOverride != 1)
+    if (icpPortNumOverride != 1 && worker_id <= 1)
 	Config.Port.icp = (u_short) icpPortNumOverride;
 
     _db_init(Config.Log.log, Config.debugOptions);
@@ -599,6 +601,7 @@ mainInitialize(void)
     authenticateInit(&Config.authConfig);
     externalAclInit();
     refreshCheckInit();
+    videoCacheConfigure();
     useragentOpenLog();
     refererOpenLog();
     httpHeaderInitModule();	/* must go before any header processing (e.g. the one in errorInitialize) */
@@ -629,6 +632,7 @@ mainInitialize(void)
 	mimeInit(Config.mimeTablePathname);
 	pconnInit();
 	refreshInit();
+	videoCacheInit();
 #if DELAY_POOLS
 	delayPoolsInit();
 #endif
@@ -644,7 +648,7 @@ mainInitialize(void)
     neighbors_init();
     if (Config.chroot_dir)
 	no_suid();
-    if (!configured_once)
+    if (!configured_once && !worker_id)
 	writePidFile();		/* write PID file */
 
 #ifdef _SQUID_LINUX_THREADS_
@@ -690,10 +694,6 @@ main(int argc, char **argv)
     int WIN32_init_err;
 #endif
 
-  printf("AC initialization\n");
-	init_acsm(0,KEYWORDS);
-	init_acsm(1,EXCLUSIONS);
-    
 #if HAVE_SBRK
     sbrk_start = sbrk(0);
 #endif
@@ -813,7 +813,10 @@ main(int argc, char **argv)
 	}
 	setEffectiveUser();
 	debug(0, 0) ("Creating Swap Directories\n");
-	storeCreateSwapDirectories();
+	if (Config.workers > 1)
+	    workersCreateSwapDirectories();
+	else
+	    storeCreateSwapDirectories();
 	return 0;
     }
     if (!opt_no_daemon)
@@ -822,6 +825,8 @@ main(int argc, char **argv)
 
     /* init comm module */
     comm_init();
+    if (Config.workers > 1)
+	workersStart();		/* returns in each worker */
     comm_select_init();
 
     if (opt_no_daemon) {
@@ -1151,7 +1156,7 @@ SquidShutdown(void *unused)
 #endif
     storeDirSync();		/* Flush log close */
     storeFsDone();
-    if (Config.pidFilename && strcmp(Config.pidFilename, "none") != 0) {
+    if (Config.pidFilename && strcmp(Config.pidFilename, "none") != 0 && !worker_id) {
 	enter_suid();
 	safeunlink(Config.pidFilename, 0);
 	leave_suid();
@@ -332,6 +332,7 @@ memInit(void)
 	sizeof(acl_proxy_auth_match_cache), 0);
     memDataInit(MEM_ACL_USER_DATA, "acl_user_data",
 	sizeof(acl_user_data), 0);
+    memDataInit(MEM_ACL_IP_LIST, "acl_ip_list", sizeof(acl_ip_list), 0);
 #if USE_CACHE_DIGESTS
     memDataInit(MEM_CACHE_DIGEST, "CacheDigest", sizeof(CacheDigest), 0);
 #endif
@@ -349,8 +350,10 @@ memInit(void)
     memDataInit(MEM_INTLIST, "intlist", sizeof(intlist), 0);
     memDataInit(MEM_MEMOBJECT, "MemObject", sizeof(MemObject),
 	Squid_MaxFD >> 3);
-    memDataInit(MEM_MEM_NODE, "mem_node", sizeof(mem_node), 0);
-    memDataNonZero(MEM_MEM_NODE);
+#if HAVE_SYS_UIO_H
+    memDataInit(MEM_MEM_IOVEC, "mem_iovec", sizeof(mem_iovec), 0);
+    memDataNonZero(MEM_MEM_IOVEC);
+#endif
     memDataInit(MEM_NETDBENTRY, "netdbEntry", sizeof(netdbEntry), 0);
     memDataInit(MEM_NET_DB_NAME, "net_db_name", sizeof(net_db_name), 0);
     memDataInit(MEM_RELIST, "relist", sizeof(relist), 0);
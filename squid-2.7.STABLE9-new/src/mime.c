@@ -114,39 +114,27 @@ mime_get_header_field(const char *mime, const char *name, const char *prefix)
     return NULL;
 }
 
+/*
+ * Returns the length of the headers including the terminating blank
+ * line, or 0 if that has not arrived yet.  Lines are found with
+ * memchr(), which is vectorised in the C library, and only the bytes
+ * right after each newline are looked at.
+ */
 size_t
 headersEnd(const char *mime, size_t l)
 {
-    size_t e = 0;
-    int state = 1;
-    while (e < l && state < 3) {
-	switch (state) {
-	case 0:
-	    if ('\n' == mime[e])
-		state = 1;
-	    break;
-	case 1:
-	    if ('\r' == mime[e])
-		state = 2;
-	    else if ('\n' == mime[e])
-		state = 3;
-	    else
-		state = 0;
-	    break;
-	case 2:
-	    if ('\n' == mime[e])
-		state = 3;
-	    else
-		state = 0;
-	    break;
-	default:
-	    break;
-	}
-	e++;
+    const char *p = mime;
+    const char *end = mime + l;
+    for (;;) {
+	/* p is at the start of a line */
+	if (p < end && *p == '\n')
+	    return p + 1 - mime;
+	if (p + 1 < end && p[0] == '\r' && p[1] == '\n')
+	    return p + 2 - mime;
+	if (p >= end || (p = memchr(p, '\n', end - p)) == NULL)
+	    return 0;
+	p++;
     }
-    if (3 == state)
-	return e;
-    return 0;
 }
 
 const char *
@@ -181,8 +181,8 @@ static time_t
 peerDigestNewDelay(const StoreEntry * e)
 {
     assert(e);
-    if (e->expires > 0)
-	return e->expires + PeerDigestReqMinGap - squid_curtime;
+    if (storeTime(e->expires) > 0)
+	return storeTime(e->expires) + PeerDigestReqMinGap - squid_curtime;
     return PeerDigestReqMinGap;
 }
 
@@ -712,14 +712,14 @@ peerDigestFetchSetStats(DigestFetchState * fetch)
     fetch->recv.bytes = fetch->entry->store_status == STORE_PENDING ?
 	mem->inmem_hi : mem->object_sz;
     fetch->sent.msg = fetch->recv.msg = 1;
-    fetch->expires = fetch->entry->expires;
+    fetch->expires = storeTime(fetch->entry->expires);
     fetch->resp_time = squid_curtime - fetch->start_time;
 
     debug(72, 3) ("peerDigestFetchSetStats: recv %d bytes in %d secs\n",
 	fetch->recv.bytes, (int) fetch->resp_time);
     debug(72, 3) ("peerDigestFetchSetStats: expires: %ld (%+d), lmt: %ld (%+d)\n",
 	(long int) fetch->expires, (int) (fetch->expires - squid_curtime),
-	(long int) fetch->entry->lastmod, (int) (fetch->entry->lastmod - squid_curtime));
+	(long int) storeTime(fetch->entry->lastmod), (int) (storeTime(fetch->entry->lastmod) - squid_curtime));
 }
 
 
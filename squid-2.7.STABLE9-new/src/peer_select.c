@@ -62,6 +62,7 @@ const char *hier_strings[] =
     "USERHASH_PARENT",
     "SOURCEHASH_PARENT",
     "PINNED",
+    "WORKER_HIT",
     "INVALID CODE"
 };
 
@@ -89,6 +90,7 @@ static void peerHandleHtcpReply(peer *, peer_t, htcpReplyData *, void *);
 #endif
 static int peerCheckNetdbDirect(ps_state * psstate);
 static void peerGetPinned(ps_state * ps);
+static void peerGetWorker(ps_state * ps);
 static void peerGetSomeNeighbor(ps_state *);
 static void peerGetSomeNeighborReplies(ps_state *);
 static void peerGetSomeDirect(ps_state *);
@@ -278,8 +280,10 @@ peerSelectFoo(ps_state * ps)
 	debug(44, 3) ("peerSelectFoo: direct = %s\n",
 	    DirectStr[ps->direct]);
     }
-    if (!entry || entry->ping_status == PING_NONE)
+    if (!entry || entry->ping_status == PING_NONE) {
 	peerGetPinned(ps);
+	peerGetWorker(ps);
+    }
     if (entry == NULL) {
 	(void) 0;
     } else if (entry->ping_status == PING_NONE) {
@@ -335,6 +339,22 @@ peerGetPinned(ps_state * ps)
     }
 }
 
+/*
+ * peerGetWorker
+ *
+ * Selects the worker holding the object in its cache
+ */
+static void
+peerGetWorker(ps_state * ps)
+{
+    peer *p;
+    if ((p = workerPeerSelect(ps->request)) == NULL)
+	return;
+    peerAddFwdServer(&ps->servers, p, WORKER_HIT);
+    if (ps->entry)
+	ps->entry->ping_status = PING_DONE;	/* Skip ICP */
+}
+
 /*
  * peerGetSomeNeighbor
  * 
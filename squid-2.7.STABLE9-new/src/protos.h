@@ -68,6 +68,7 @@ extern void aclDestroyAclList(acl_list **);
 extern void aclParseAccessLine(struct _acl_access **);
 extern void aclParseAclList(acl_list **);
 extern void aclParseAclLine(acl **);
+extern void aclConfigure(void);
 extern int aclIsProxyAuth(const char *name);
 extern err_type aclGetDenyInfoPage(acl_deny_info_list ** head, const char *name, int redirect_allowed);
 extern void aclParseDenyInfoLine(struct _acl_deny_info_list **);
@@ -195,6 +196,12 @@ extern void comm_write_header(int fd,
     void *handler_data,
     FREE *);
 extern void comm_write_mbuf_header(int fd, MemBuf mb, const char *header, size_t header_size, CWCB * handler, void *handler_data);
+#if HAVE_SYS_SENDFILE_H
+extern void comm_sendfile(int fd, int file, squid_off_t offset, size_t size, CWCB * handler, void *handler_data);
+#endif
+#if HAVE_SYS_UIO_H
+extern void comm_writev(int fd, struct iovec *iov, int iovcnt, CWCB * handler, void *handler_data, FREE * free_func, void *free_buf);
+#endif
 extern void commCallCloseHandlers(int fd);
 extern int commSetTimeout(int fd, int, PF *, void *);
 extern void commSetDefer(int fd, DEFER * func, void *);
@@ -282,6 +289,7 @@ extern int eventFind(EVH *, void *);
 extern void fd_init(void);
 extern void fd_close(int fd);
 extern void fd_open(int fd, unsigned int type, const char *);
+extern int default_write_method(int, const char *, int);
 extern void fd_note(int fd, const char *);
 extern void fd_note_static(int fd, const char *);
 extern void fd_bytes(int fd, int len, unsigned int type);
@@ -825,6 +833,7 @@ extern int refreshCheckDigest(const StoreEntry *, time_t delta);
 extern refresh_cc refreshCC(const StoreEntry *, request_t *);
 extern time_t getMaxAge(const char *url);
 extern void refreshInit(void);
+extern void refreshConfigure(void);
 extern const refresh_t *refreshLimits(const char *url);
 
 extern void serverConnectionsClose(void);
@@ -921,6 +930,13 @@ extern void stmemFree(mem_hdr *);
 extern void stmemFreeData(mem_hdr *);
 extern void stmemNodeFree(void *);
 extern char *stmemNodeGet(mem_node *);
+extern void stmemConfigure(void);
+extern int stmemPagesInUse(void);
+extern OBJH stmemStats;
+#if HAVE_SYS_UIO_H
+extern ssize_t stmemRef(const mem_hdr *, squid_off_t, size_t, mem_iovec *);
+extern void stmemIovecFree(void *);
+#endif
 
 /* ----------------------------------------------------------------- */
 
@@ -931,6 +947,7 @@ extern StoreEntry *new_StoreEntry(int, const char *);
 extern void storeEntrySetStoreUrl(StoreEntry * e, const char *store_url);
 extern StoreEntry *storeGet(const cache_key *);
 extern StoreEntry *storeGetPublic(const char *uri, const method_t method);
+extern StoreEntry *storeGetPublicUrlRequest(const char *uri, const method_t method, const request_t * request);
 extern StoreEntry *storeGetPublicByRequest(request_t * request);
 extern StoreEntry *storeGetPublicByRequestMethod(request_t * request, const method_t method);
 extern StoreEntry *storeCreateEntry(const char *, request_flags, method_t);
@@ -956,6 +973,7 @@ extern void storeFreeMemory(void);
 extern int expiresMoreThan(time_t, time_t);
 extern int storeEntryValidToSend(StoreEntry *);
 extern void storeTimestampsSet(StoreEntry *);
+extern store_time_t storeTimeRel(time_t);
 extern void storeRegisterAbort(StoreEntry * e, STABH * cb, void *);
 extern void storeUnregisterAbort(StoreEntry * e);
 extern void storeMemObjectDump(MemObject * mem);
@@ -988,6 +1006,7 @@ extern void storeFsDone(void);
 extern void storeFsAdd(const char *, STSETUP *);
 extern void storeReplAdd(const char *, REMOVALPOLICYCREATE *);
 void storeDeferRead(StoreEntry *, int fd);
+void storeDeferProducer(StoreEntry *, STABH *, void *);
 void storeResumeRead(StoreEntry *);
 void storeResetDefer(StoreEntry *);
 extern int memHaveHeaders(const MemObject * mem);
@@ -1007,6 +1026,7 @@ extern void storeClose(storeIOState *);
 extern void storeRead(storeIOState *, char *, size_t, squid_off_t, STRCB *, void *);
 extern void storeWrite(storeIOState *, char *, size_t, FREE *);
 extern void storeUnlink(StoreEntry *);
+extern char *storeSwapFilePath(const StoreEntry *);
 extern void storeRecycle(StoreEntry *);
 extern squid_off_t storeOffset(storeIOState *);
 
@@ -1019,6 +1039,27 @@ extern void storeLogClose(void);
 extern void storeLogOpen(void);
 
 
+/*
+ * regex_set.c
+ */
+extern RegexSet *regexSetCreate(void);
+extern void regexSetAdd(RegexSet *, const char *pattern, regex_t *, void *data);
+extern void regexSetCompile(RegexSet *);
+extern void *regexSetMatch(const RegexSet *, const char *);
+extern void regexSetDestroy(RegexSet *);
+
+/*
+ * store_index.c
+ */
+extern void storeIndexInit(int nobjects);
+extern void storeIndexFree(void);
+extern StoreEntry *storeIndexGet(const cache_key *);
+extern void storeIndexAdd(StoreEntry *);
+extern void storeIndexDelete(StoreEntry *);
+extern int storeIndexSlots(void);
+extern StoreEntry *storeIndexSlot(int);
+extern int storeIndexGeneration(void);
+
 /*
  * store_key_*.c
  */
@@ -1028,6 +1069,7 @@ extern void storeKeyFree(const cache_key *);
 extern const cache_key *storeKeyScan(const char *);
 extern const char *storeKeyText(const cache_key *);
 extern const cache_key *storeKeyPublic(const char *, const method_t);
+extern const cache_key *storeKeyPublicUrlRequest(const char *, const method_t, const request_t *);
 extern const cache_key *storeKeyPublicByRequest(request_t *);
 extern const cache_key *storeKeyPublicByRequestMethod(request_t *, const method_t);
 extern const cache_key *storeKeyPrivate(const char *, method_t, int);
@@ -1037,6 +1079,31 @@ extern void storeKeyInit(void);
 extern HASHHASH storeKeyHashHash;
 extern HASHCMP storeKeyHashCmp;
 
+/* videocache.c */
+extern int videoCacheClassify(const char *url, videoId * id);
+extern int videoCacheKeyed(const videoId * id, const request_t * request);
+extern void requestVideoClassify(request_t *);
+extern int videoCacheRangeFromFull(const request_t *);
+extern void videoCacheInit(void);
+extern void videoCacheConfigure(void);
+extern const char videoFlvSeekHeader[13];
+
+/* videosegment.c */
+extern int videoSegmentable(const request_t *);
+extern int videoSegmentStart(request_t *, StoreEntry *);
+
+/* worker.c */
+extern void workersStart(void);
+extern void workersCreateSwapDirectories(void);
+extern void workerConfigure(void);
+extern char *workerSwapDirPath(char *path);
+extern void workerSetPort(u_short port);
+extern void workerIndexAdd(const cache_key *);
+extern void workerIndexDelete(const cache_key *);
+extern peer *workerPeerSelect(request_t *);
+extern void workerRequestHeader(request_t *, HttpHeader *);
+extern int workerRequestCheck(request_t *, int worker_port);
+
 /*
  * store_digest.c
  */
@@ -1084,6 +1151,8 @@ extern int storeDirGetUFSStats(const char *, int *, int *, int *, int *);
  */
 extern char *storeSwapMetaPack(tlv * tlv_list, int *length);
 extern tlv *storeSwapMetaBuild(StoreEntry * e);
+extern void storeSwapMetaPackStd(const StoreEntry * e, storeMetaStd * std);
+extern void storeSwapMetaUnpackStd(StoreEntry * e, const void *value);
 extern tlv *storeSwapMetaUnpack(const char *buf, int *hdrlen);
 extern void storeSwapTLVFree(tlv * n);
 
@@ -1112,6 +1181,9 @@ extern squid_off_t storeSwapOutObjectBytesOnDisk(const MemObject * mem);
  */
 extern store_client *storeClientRegister(StoreEntry * e, void *data);
 extern void storeClientCopy(store_client *, StoreEntry *, squid_off_t, squid_off_t, size_t, char *, STCB *, void *);
+#if HAVE_SYS_UIO_H
+extern mem_iovec *storeClientRef(store_client *, StoreEntry *, squid_off_t, size_t);
+#endif
 extern void storeClientCopyHeaders(store_client *, StoreEntry *, STHCB *, void *);
 extern int storeClientCopyPending(store_client *, StoreEntry * e, void *data);
 extern int storeClientUnregister(store_client * sc, StoreEntry * e, void *data);
@@ -1251,6 +1323,7 @@ extern void htcpSocketClose(void);
 /* String */
 #define strLen(s)     ((/* const */ int)(s).len)
 #define strBuf(s)     ((const char*)(s).buf)
+#define strBorrowed(s) ((s).buf && !(s).size)
 #define strChr(s,ch)  ((const char*)strchr(strBuf(s), (ch)))
 #define strRChr(s,ch) ((const char*)strrchr(strBuf(s), (ch)))
 #define strStr(s,str) ((const char*)strstr(strBuf(s), (str)))
@@ -1264,6 +1337,7 @@ extern void htcpSocketClose(void);
 #define strCat(s,str)  stringAppend(&(s), (str), strlen(str))
 extern void stringInit(String * s, const char *str);
 extern void stringLimitInit(String * s, const char *str, int len);
+extern void stringInitSlice(String * s, char *str, int len);
 extern String stringDup(const String * s);
 extern void stringClean(String * s);
 extern void stringReset(String * s, const char *str);
@@ -1471,7 +1545,7 @@ extern int errorMapStart(const errormap * map, request_t * req, HttpReply * repl
 /* ETag support */
 void storeLocateVaryDone(VaryData * data);
 void storeLocateVary(StoreEntry * e, int offset, const char *vary_data, String accept_encoding, STLVCB * callback, void *cbdata);
-void storeAddVary(const char *store_url, const char *url, const method_t method, const cache_key * key, const char *etag, const char *vary, const char *vary_headers, const char *accept_encoding);
+void storeAddVary(const char *store_url, const char *url, const method_t method, const cache_key * key, const char *etag, const char *vary, const char *vary_headers, const char *accept_encoding, const request_t * request);
 
 /* New HTTP message parsing support */
 extern void HttpMsgBufInit(HttpMsgBuf * hmsg, const char *buf, size_t size);
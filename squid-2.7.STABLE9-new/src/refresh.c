@@ -107,11 +107,33 @@ static OBJH refreshStats;
 static int refreshStaleness(const StoreEntry *, time_t, time_t, const refresh_t *, stale_flags *);
 
 static refresh_t DefaultRefresh;
+static RegexSet *RefreshSet = NULL;
+
+/*
+ * Build the combined matcher for the refresh_pattern list.  Called
+ * after every (re)configure, once Config.Refresh is final.
+ */
+void
+refreshConfigure(void)
+{
+    refresh_t *R;
+    if (RefreshSet)
+	regexSetDestroy(RefreshSet);
+    RefreshSet = NULL;
+    if (Config.Refresh == NULL)
+	return;
+    RefreshSet = regexSetCreate();
+    for (R = Config.Refresh; R; R = R->next)
+	regexSetAdd(RefreshSet, R->pattern, &R->compiled_pattern, R);
+    regexSetCompile(RefreshSet);
+}
 
 const refresh_t *
 refreshLimits(const char *url)
 {
     const refresh_t *R;
+    if (RefreshSet)
+	return regexSetMatch(RefreshSet, url);
     for (R = Config.Refresh; R; R = R->next) {
 	if (!regexec(&(R->compiled_pattern), url, 0, 0, 0))
 	    return R;
@@ -174,16 +196,16 @@ refreshStaleness(const StoreEntry * entry, time_t check_time, time_t age, const
     /*
      * Check for an explicit expiration time.
      */
-    if (entry->expires > -1) {
+    if (storeTime(entry->expires) > -1) {
 	sf->expires = 1;
-	if (entry->expires > check_time) {
+	if (storeTime(entry->expires) > check_time) {
 	    debug(22, 3) ("FRESH: expires %d >= check_time %d \n",
-		(int) entry->expires, (int) check_time);
+		(int) storeTime(entry->expires), (int) check_time);
 	    return -1;
 	} else {
 	    debug(22, 3) ("STALE: expires %d < check_time %d \n",
-		(int) entry->expires, (int) check_time);
-	    return (check_time - entry->expires);
+		(int) storeTime(entry->expires), (int) check_time);
+	    return (check_time - storeTime(entry->expires));
 	}
     }
     assert(age >= 0);
@@ -196,22 +218,22 @@ refreshStaleness(const StoreEntry * entry, time_t check_time, time_t age, const
 	sf->max = 1;
 	return (age - R->max);
     }
-    if (check_time < entry->timestamp) {
+    if (check_time < storeTime(entry->timestamp)) {
 	debug(22, 1) ("STALE: Entry's timestamp greater than check time. Clock going backwards?\n");
 	debug(22, 1) ("\tcheck_time:\t%s\n", mkrfc1123(check_time));
-	debug(22, 1) ("\tentry->timestamp:\t%s\n", mkrfc1123(entry->timestamp));
-	debug(22, 1) ("\tstaleness:\t%ld\n", (long int) entry->timestamp - check_time);
-	return (entry->timestamp - check_time);
+	debug(22, 1) ("\tentry->timestamp:\t%s\n", mkrfc1123(storeTime(entry->timestamp)));
+	debug(22, 1) ("\tstaleness:\t%ld\n", (long int) storeTime(entry->timestamp) - check_time);
+	return (storeTime(entry->timestamp) - check_time);
     }
     /*
      * Try the last-modified factor algorithm.
      */
-    if (entry->lastmod > -1 && entry->timestamp > entry->lastmod) {
+    if (storeTime(entry->lastmod) > -1 && entry->timestamp > entry->lastmod) {
 	/*
 	 * stale_age is the Age of the response when it became/becomes
 	 * stale according to the last-modified factor algorithm.
 	 */
-	time_t stale_age = (entry->timestamp - entry->lastmod) * R->pct;
+	time_t stale_age = (storeTime(entry->timestamp) - storeTime(entry->lastmod)) * R->pct;
 	sf->lmfactor = 1;
 	if (age >= stale_age) {
 	    debug(22, 3) ("STALE: age %d > stale_age %d\n",
@@ -259,8 +281,8 @@ refreshCheck(const StoreEntry * entry, request_t * request, time_t delta)
 
     if (delta > 0)
 	check_time += delta;
-    if (check_time > entry->timestamp)
-	age = check_time - entry->timestamp;
+    if (check_time > storeTime(entry->timestamp))
+	age = check_time - storeTime(entry->timestamp);
     R = uri ? refreshLimits(uri) : refreshUncompiledPattern(".");
     if (NULL == R)
 	R = &DefaultRefresh;
@@ -272,7 +294,7 @@ refreshCheck(const StoreEntry * entry, request_t * request, time_t delta)
 	R->pattern, (int) R->min, (int) (100.0 * R->pct), (int) R->max);
     debug(22, 3) ("refreshCheck: age = %d\n", (int) age);
     debug(22, 3) ("\tcheck_time:\t%s\n", mkrfc1123(check_time));
-    debug(22, 3) ("\tentry->timestamp:\t%s\n", mkrfc1123(entry->timestamp));
+    debug(22, 3) ("\tentry->timestamp:\t%s\n", mkrfc1123(storeTime(entry->timestamp)));
 
     if (EBIT_TEST(entry->flags, ENTRY_REVALIDATE) && staleness > -1) {
 	debug(22, 3) ("refreshCheck: YES: Must revalidate stale response\n");
@@ -392,7 +414,7 @@ refreshIsCachable(const StoreEntry * entry)
     if (reason < 200)
 	/* Does not need refresh. This is certainly cachable */
 	return 1;
-    if (entry->lastmod > 0)
+    if (storeTime(entry->lastmod) > 0)
 	can_revalidate = 1;
     if (entry->mem_obj && entry->mem_obj->reply) {
 	if (httpHeaderHas(&entry->mem_obj->reply->header, HDR_ETAG))
@@ -292,7 +292,7 @@ makeRefreshCheckRequest(StoreEntry * entry, refresh_check_format * format)
 	    str = entry->mem_obj->url;
 	    break;
 	case REFRESH_CHECK_AGE:
-	    snprintf(buf, sizeof(buf), "%ld", (long int) (squid_curtime - entry->timestamp));
+	    snprintf(buf, sizeof(buf), "%ld", (long int) (squid_curtime - storeTime(entry->timestamp)));
 	    str = buf;
 	    break;
 	case REFRESH_CHECK_RESP_HEADER:
@@ -407,16 +407,16 @@ refreshCheckHandleReply(void *data, char *reply)
 	    httpReplyUpdateOnNotModified(state->entry->mem_obj->reply, rep);
 	    storeTimestampsSet(state->entry);
 	    if (!httpHeaderHas(&rep->header, HDR_DATE)) {
-		state->entry->timestamp = squid_curtime;
-		state->entry->expires = squid_curtime + freshness;
+		state->entry->timestamp = storeTimeRel(squid_curtime);
+		state->entry->expires = storeTimeRel(squid_curtime + freshness);
 	    } else if (freshness) {
-		state->entry->expires = squid_curtime + freshness;
+		state->entry->expires = storeTimeRel(squid_curtime + freshness);
 	    }
 	    httpReplyDestroy(rep);
 	    storeUpdate(state->entry, NULL);
 	} else {
-	    state->entry->timestamp = squid_curtime;
-	    state->entry->expires = squid_curtime + freshness;
+	    state->entry->timestamp = storeTimeRel(squid_curtime);
+	    state->entry->expires = storeTimeRel(squid_curtime + freshness);
 	}
     }
     if (hdrs.buf)
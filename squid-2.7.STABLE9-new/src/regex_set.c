@@ -0,0 +1,445 @@
+/*
+ * $Id$
+ *
+ * DEBUG: section 28    Access Control
+ *
+ * SQUID Web Proxy Cache          http://www.squid-cache.org/
+ * ----------------------------------------------------------
+ *
+ *  Squid is the result of efforts by numerous individuals from
+ *  the Internet community; see the CONTRIBUTORS file for full
+ *  details.   Many organizations have provided support for Squid's
+ *  development; see the SPONSORS file for full details.  Squid is
+ *  Copyrighted (C) 2001 by the Regents of the University of
+ *  California; see the COPYRIGHT file for full details.  Squid
+ *  incorporates software developed and/or copyrighted by other
+ *  sources; see the CREDITS file for full details.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111, USA.
+ *
+ */
+
+/*
+ * A regex set answers "which is the first of these patterns that
+ * matches" without running every pattern.  For each pattern we look
+ * for literal strings that any match must contain (one per top level
+ * alternative).  All those literals go into one Aho-Corasick automaton,
+ * so a single pass over the subject tells which patterns can possibly
+ * match.  Only those, plus the patterns we could not find a literal
+ * for, are then handed to regexec(), in their original order.
+ *
+ * The literal scan is conservative: anything it does not understand
+ * ends the current literal, and a pattern it cannot parse at all is
+ * simply always tried.  Literals are folded to lower case, so the
+ * prefilter never rejects a case insensitive match.
+ */
+
+#include "squid.h"
+
+#define REGEX_SET_MIN_LITERAL 3
+#define REGEX_SET_MAX_LITERAL 64
+
+typedef struct {
+    regex_t *re;
+    void *data;
+} RegexSetEntry;
+
+struct _RegexSet {
+    int count;
+    int size;
+    RegexSetEntry *entries;
+    char **patterns;		/* only until regexSetCompile() */
+    unsigned char *always;	/* per entry: 1 if it has no literal */
+    unsigned char *hit;		/* scratch for regexSetMatch() */
+    int nliterals;
+    int *lit_entry;		/* literal -> entry */
+    int *lit_next;		/* next literal ending in the same state */
+    int nstates;
+    int nclasses;
+    unsigned char cls[256];
+    int *next;			/* nstates x nclasses transitions */
+    int *out;			/* first literal ending in the state, or -1 */
+    int *dict;			/* nearest suffix state with output, or 0 */
+};
+
+RegexSet *
+regexSetCreate(void)
+{
+    return xcalloc(1, sizeof(RegexSet));
+}
+
+void
+regexSetAdd(RegexSet * set, const char *pattern, regex_t * re, void *data)
+{
+    assert(set->next == NULL);
+    if (set->count == set->size) {
+	set->size = set->size ? set->size * 2 : 16;
+	set->entries = xrealloc(set->entries, set->size * sizeof(*set->entries));
+	set->patterns = xrealloc(set->patterns, set->size * sizeof(*set->patterns));
+    }
+    set->entries[set->count].re = re;
+    set->entries[set->count].data = data;
+    set->patterns[set->count] = xstrdup(pattern);
+    set->count++;
+}
+
+/*
+ * Return the character after the bracket expression starting at p,
+ * or NULL if it is not terminated.
+ */
+static const char *
+regexSetSkipBracket(const char *p, const char *end)
+{
+    p++;
+    if (p < end && *p == '^')
+	p++;
+    if (p < end && *p == ']')
+	p++;
+    while (p < end) {
+	if (*p == ']')
+	    return p + 1;
+	if (*p == '[' && p + 1 < end && strchr(":.=", p[1])) {
+	    char c = p[1];
+	    p += 2;
+	    while (p + 1 < end && !(p[0] == c && p[1] == ']'))
+		p++;
+	    if (p + 1 >= end)
+		return NULL;
+	    p += 2;
+	    continue;
+	}
+	p++;
+    }
+    return NULL;
+}
+
+/*
+ * Return the character after the group starting at p, or NULL if
+ * the parentheses do not balance.
+ */
+static const char *
+regexSetSkipGroup(const char *p, const char *end)
+{
+    int depth = 0;
+    while (p < end) {
+	switch (*p) {
+	case '\\':
+	    p += 2;
+	    continue;
+	case '[':
+	    if ((p = regexSetSkipBracket(p, end)) == NULL)
+		return NULL;
+	    continue;
+	case '(':
+	    depth++;
+	    break;
+	case ')':
+	    if (--depth == 0)
+		return p + 1;
+	    break;
+	}
+	p++;
+    }
+    return NULL;
+}
+
+/*
+ * Find the longest literal every match of the alternative [p, end)
+ * must contain.  It is stored lower cased in buf; returns its length,
+ * 0 if there is none, or -1 if the alternative could not be parsed.
+ */
+static int
+regexSetBranchLiteral(const char *p, const char *end, char *buf)
+{
+    char run[REGEX_SET_MAX_LITERAL];
+    int run_len = 0;
+    int best = 0;
+    int last_char = 0;
+    int c;
+    for (;;) {
+	int literal = 0;
+	if (p < end) {
+	    c = (unsigned char) *p;
+	    if (c == '\\' && p + 1 < end) {
+		c = (unsigned char) p[1];
+		/* \w, \b, backreferences and the like are not literals */
+		literal = !xisalnum(c) && !strchr("<>`'", c);
+	    } else if (c == '\\') {
+		return -1;
+	    } else {
+		literal = !strchr(".^$[]()*?+{|", c);
+	    }
+	    if (c >= 0x80)
+		literal = 0;	/* leave multibyte characters to the regex library */
+	}
+	if (literal) {
+	    p += *p == '\\' ? 2 : 1;
+	    if (run_len < REGEX_SET_MAX_LITERAL)
+		run[run_len++] = xtolower(c);
+	    last_char = 1;
+	    continue;
+	}
+	/* end of the current literal run */
+	if (p < end && last_char && strchr("*?{", *p))
+	    run_len--;		/* the last character was optional */
+	if (run_len > best) {
+	    memcpy(buf, run, run_len);
+	    best = run_len;
+	}
+	run_len = 0;
+	last_char = 0;
+	if (p >= end)
+	    return best;
+	switch (*p) {
+	case '[':
+	    if ((p = regexSetSkipBracket(p, end)) == NULL)
+		return -1;
+	    break;
+	case '(':
+	    if ((p = regexSetSkipGroup(p, end)) == NULL)
+		return -1;
+	    break;
+	case ')':
+	case '|':
+	    return -1;
+	case '{':
+	    while (p < end && *p != '}')
+		p++;
+	    if (p < end)
+		p++;
+	    break;
+	case '\\':
+	    p += 2;
+	    break;
+	default:
+	    p++;
+	}
+    }
+}
+
+/*
+ * Split the pattern into its top level alternatives and collect one
+ * literal for each.  Returns the number of literals, or 0 if some
+ * alternative has no usable literal.
+ */
+static int
+regexSetPatternLiterals(const char *pattern, char lits[][REGEX_SET_MAX_LITERAL], int *lens, int max)
+{
+    const char *p = pattern;
+    const char *end = pattern + strlen(pattern);
+    const char *start = p;
+    int n = 0;
+    while (p <= end) {
+	if (p == end || *p == '|') {
+	    if (n == max)
+		return 0;
+	    lens[n] = regexSetBranchLiteral(start, p, lits[n]);
+	    if (lens[n] < REGEX_SET_MIN_LITERAL)
+		return 0;
+	    n++;
+	    start = ++p;
+	    continue;
+	}
+	switch (*p) {
+	case '\\':
+	    if (p + 1 >= end)
+		return 0;
+	    p += 2;
+	    break;
+	case '[':
+	    if ((p = regexSetSkipBracket(p, end)) == NULL)
+		return 0;
+	    break;
+	case '(':
+	    if ((p = regexSetSkipGroup(p, end)) == NULL)
+		return 0;
+	    break;
+	default:
+	    p++;
+	}
+    }
+    return n;
+}
+
+#define REGEX_SET_MAX_BRANCHES 16
+
+void
+regexSetCompile(RegexSet * set)
+{
+    char (*lits)[REGEX_SET_MAX_LITERAL];
+    int *lens;
+    int *owner;
+    int nlits = 0;
+    int maxlits = 0;
+    int total = 0;
+    int i, j, c;
+    int *queue;
+    int *fail;
+    int head, tail;
+    assert(set->next == NULL);
+    set->always = xcalloc(set->count + 1, 1);
+    set->hit = xcalloc(set->count + 1, 1);
+    lits = NULL;
+    lens = NULL;
+    owner = NULL;
+    for (i = 0; i < set->count; i++) {
+	char l[REGEX_SET_MAX_BRANCHES][REGEX_SET_MAX_LITERAL];
+	int ll[REGEX_SET_MAX_BRANCHES];
+	int n = regexSetPatternLiterals(set->patterns[i], l, ll, REGEX_SET_MAX_BRANCHES);
+	if (n == 0) {
+	    debug(28, 3) ("regexSetCompile: no literal in '%s'\n", set->patterns[i]);
+	    set->always[i] = 1;
+	    continue;
+	}
+	if (nlits + n > maxlits) {
+	    maxlits = maxlits ? maxlits * 2 : 64;
+	    if (maxlits < nlits + n)
+		maxlits = nlits + n;
+	    lits = xrealloc(lits, maxlits * sizeof(*lits));
+	    lens = xrealloc(lens, maxlits * sizeof(*lens));
+	    owner = xrealloc(owner, maxlits * sizeof(*owner));
+	}
+	for (j = 0; j < n; j++) {
+	    debug(28, 5) ("regexSetCompile: '%.*s' required by '%s'\n",
+		ll[j], l[j], set->patterns[i]);
+	    memcpy(lits[nlits], l[j], ll[j]);
+	    lens[nlits] = ll[j];
+	    owner[nlits] = i;
+	    total += ll[j];
+	    nlits++;
+	}
+    }
+    for (i = 0; i < set->count; i++)
+	safe_free(set->patterns[i]);
+    safe_free(set->patterns);
+    /* Map the bytes used by the literals onto a compact alphabet;
+     * class 0 is everything else. Upper case shares the lower case class. */
+    memset(set->cls, 0, sizeof(set->cls));
+    set->nclasses = 1;
+    for (i = 0; i < nlits; i++) {
+	for (j = 0; j < lens[i]; j++) {
+	    c = (unsigned char) lits[i][j];
+	    if (set->cls[c] == 0)
+		set->cls[c] = set->nclasses++;
+	}
+    }
+    for (c = 'A'; c <= 'Z'; c++)
+	set->cls[c] = set->cls[xtolower(c)];
+    /* The trie */
+    set->nliterals = nlits;
+    set->lit_entry = xcalloc(nlits + 1, sizeof(int));
+    set->lit_next = xcalloc(nlits + 1, sizeof(int));
+    set->next = xcalloc((total + 1) * set->nclasses, sizeof(int));
+    set->out = xcalloc(total + 1, sizeof(int));
+    set->dict = xcalloc(total + 1, sizeof(int));
+    set->out[0] = -1;
+    set->nstates = 1;
+    for (i = 0; i < nlits; i++) {
+	int s = 0;
+	for (j = 0; j < lens[i]; j++) {
+	    int *t = &set->next[s * set->nclasses + set->cls[(unsigned char) lits[i][j]]];
+	    if (*t == 0) {
+		*t = set->nstates;
+		set->out[set->nstates] = -1;
+		set->nstates++;
+	    }
+	    s = *t;
+	}
+	set->lit_entry[i] = owner[i];
+	set->lit_next[i] = set->out[s];
+	set->out[s] = i;
+    }
+    safe_free(lits);
+    safe_free(lens);
+    safe_free(owner);
+    /* Failure links, breadth first; missing transitions are filled in
+     * from the failure state so matching is a single table lookup. */
+    queue = xcalloc(set->nstates, sizeof(int));
+    fail = xcalloc(set->nstates, sizeof(int));
+    head = tail = 0;
+    for (c = 0; c < set->nclasses; c++) {
+	int t = set->next[c];
+	if (t)
+	    queue[tail++] = t;
+    }
+    while (head < tail) {
+	int s = queue[head++];
+	for (c = 0; c < set->nclasses; c++) {
+	    int *t = &set->next[s * set->nclasses + c];
+	    int f = set->next[fail[s] * set->nclasses + c];
+	    if (*t == 0) {
+		*t = f;
+		continue;
+	    }
+	    fail[*t] = f;
+	    set->dict[*t] = set->out[f] >= 0 ? f : set->dict[f];
+	    queue[tail++] = *t;
+	}
+    }
+    safe_free(queue);
+    safe_free(fail);
+    debug(28, 2) ("regexSetCompile: %d patterns, %d literals, %d states, %d classes\n",
+	set->count, set->nliterals, set->nstates, set->nclasses);
+}
+
+/*
+ * Return the data of the first pattern matching subject, or NULL.
+ */
+void *
+regexSetMatch(const RegexSet * set, const char *subject)
+{
+    const unsigned char *p = (const unsigned char *) subject;
+    int i;
+    memcpy(set->hit, set->always, set->count);
+    if (set->nliterals) {
+	int s = 0;
+	for (; *p; p++) {
+	    int t;
+	    s = set->next[s * set->nclasses + set->cls[*p]];
+	    for (t = s; t; t = set->dict[t]) {
+		int l;
+		for (l = set->out[t]; l >= 0; l = set->lit_next[l])
+		    set->hit[set->lit_entry[l]] = 1;
+	    }
+	}
+    }
+    for (i = 0; i < set->count; i++) {
+	if (!set->hit[i])
+	    continue;
+	if (regexec(set->entries[i].re, subject, 0, 0, 0) == 0)
+	    return set->entries[i].data;
+    }
+    return NULL;
+}
+
+void
+regexSetDestroy(RegexSet * set)
+{
+    int i;
+    if (set->patterns) {
+	for (i = 0; i < set->count; i++)
+	    safe_free(set->patterns[i]);
+	safe_free(set->patterns);
+    }
+    safe_free(set->entries);
+    safe_free(set->always);
+    safe_free(set->hit);
+    safe_free(set->lit_entry);
+    safe_free(set->lit_next);
+    safe_free(set->next);
+    safe_free(set->out);
+    safe_free(set->dict);
+    xfree(set);
+}
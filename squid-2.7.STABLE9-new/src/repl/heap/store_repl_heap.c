@@ -76,8 +76,8 @@ heap_guessType(StoreEntry * entry, RemovalPolicyNode * node)
 }
 #define SET_POLICY_NODE(entry,value) \
     switch(heap->type) { \
-    case TYPE_STORE_ENTRY: entry->repl.data = value; break ; \
-    case TYPE_STORE_MEM: entry->mem_obj->repl.data = value ; break ; \
+    case TYPE_STORE_ENTRY: entry->repl.u.data = value; break ; \
+    case TYPE_STORE_MEM: entry->mem_obj->repl.u.data = value ; break ; \
     default: break; \
     }
 
@@ -85,10 +85,10 @@ static void
 heap_add(RemovalPolicy * policy, StoreEntry * entry, RemovalPolicyNode * node)
 {
     HeapPolicyData *heap = policy->_data;
-    assert(!node->data);
+    assert(!node->u.data);
     if (EBIT_TEST(entry->flags, ENTRY_SPECIAL))
 	return;			/* We won't manage these.. they messes things up */
-    node->data = heap_insert(heap->heap, entry);
+    node->u.data = heap_insert(heap->heap, entry);
     heap->count += 1;
     if (!heap->type)
 	heap->type = heap_guessType(entry, node);
@@ -101,11 +101,11 @@ heap_remove(RemovalPolicy * policy, StoreEntry * entry,
     RemovalPolicyNode * node)
 {
     HeapPolicyData *heap = policy->_data;
-    heap_node *hnode = node->data;
+    heap_node *hnode = node->u.data;
     if (!hnode)
 	return;
     heap_delete(heap->heap, hnode);
-    node->data = NULL;
+    node->u.data = NULL;
     heap->count -= 1;
 }
 
@@ -114,7 +114,7 @@ heap_referenced(RemovalPolicy * policy, const StoreEntry * entry,
     RemovalPolicyNode * node)
 {
     HeapPolicyData *heap = policy->_data;
-    heap_node *hnode = node->data;
+    heap_node *hnode = node->u.data;
     if (!hnode)
 	return;
     heap_update(heap->heap, hnode, (StoreEntry *) entry);
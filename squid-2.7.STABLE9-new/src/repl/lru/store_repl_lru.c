@@ -40,7 +40,8 @@ REMOVALPOLICYCREATE createRemovalPolicy_lru;
 typedef struct _LruPolicyData LruPolicyData;
 struct _LruPolicyData {
     RemovalPolicy *policy;
-    dlink_list list;
+    StoreEntry *head;
+    StoreEntry *tail;
     int count;
     int nwalkers;
     enum heap_entry_type {
@@ -49,7 +50,7 @@ struct _LruPolicyData {
 };
 
 /* Hack to avoid having to remember the RemovalPolicyNode location.
- * Needed by the purge walker to clear the policy information
+ * Needed to find the list links of the neighbouring entries
  */
 static enum heap_entry_type
 repl_guessType(StoreEntry * entry, RemovalPolicyNode * node)
@@ -61,55 +62,75 @@ repl_guessType(StoreEntry * entry, RemovalPolicyNode * node)
     fatal("Heap Replacement: Unknown StoreEntry node type");
     return TYPE_UNKNOWN;
 }
-#define SET_POLICY_NODE(entry,value) \
-    switch(lru->type) { \
-    case TYPE_STORE_ENTRY: entry->repl.data = value; break ; \
-    case TYPE_STORE_MEM: entry->mem_obj->repl.data = value ; break ; \
-    default: break; \
-    }
 
-typedef struct _LruNode LruNode;
-struct _LruNode {
-    /* Note: the dlink_node MUST be the first member of the LruNode
-     * structure. This member is later pointer typecasted to LruNode *.
-     */
-    dlink_node node;
-};
+/*
+ * The list is threaded through the RemovalPolicyNode of each entry,
+ * so an entry costs no memory beyond its own two links.
+ */
+static RemovalPolicyNode *
+lru_node(LruPolicyData * lru, const StoreEntry * entry)
+{
+    if (lru->type == TYPE_STORE_MEM)
+	return &entry->mem_obj->repl;
+    return (RemovalPolicyNode *) & entry->repl;
+}
+
+static int
+lru_linked(LruPolicyData * lru, const StoreEntry * entry, RemovalPolicyNode * node)
+{
+    return node->u.prev || node->next || lru->head == entry;
+}
+
+static void
+lru_link(LruPolicyData * lru, StoreEntry * entry, RemovalPolicyNode * node)
+{
+    node->u.prev = lru->tail;
+    node->next = NULL;
+    if (lru->tail)
+	lru_node(lru, lru->tail)->next = entry;
+    else
+	lru->head = entry;
+    lru->tail = entry;
+}
+
+static void
+lru_unlink(LruPolicyData * lru, RemovalPolicyNode * node)
+{
+    if (node->u.prev)
+	lru_node(lru, node->u.prev)->next = node->next;
+    else
+	lru->head = node->next;
+    if (node->next)
+	lru_node(lru, node->next)->u.prev = node->u.prev;
+    else
+	lru->tail = node->u.prev;
+    node->u.prev = node->next = NULL;
+}
 
-static MemPool *lru_node_pool = NULL;
 static int nr_lru_policies = 0;
 
 static void
 lru_add(RemovalPolicy * policy, StoreEntry * entry, RemovalPolicyNode * node)
 {
     LruPolicyData *lru = policy->_data;
-    LruNode *lru_node;
-    assert(!node->data);
-    node->data = lru_node = memPoolAlloc(lru_node_pool);
-    dlinkAddTail(entry, &lru_node->node, &lru->list);
-    lru->count += 1;
     if (!lru->type)
 	lru->type = repl_guessType(entry, node);
+    assert(!lru_linked(lru, entry, node));
+    lru_link(lru, entry, node);
+    lru->count += 1;
 }
 
 static void
 lru_remove(RemovalPolicy * policy, StoreEntry * entry, RemovalPolicyNode * node)
 {
     LruPolicyData *lru = policy->_data;
-    LruNode *lru_node = node->data;
-    if (!lru_node)
-	return;
     /*
      * It seems to be possible for an entry to exist in the hash
-     * but not be in the LRU list, so check for that case rather
-     * than suffer a NULL pointer access.
+     * but not be in the LRU list, so check for that case.
      */
-    if (NULL == lru_node->node.data)
+    if (!lru->type || !lru_linked(lru, entry, node))
 	return;
-    assert(lru_node->node.data == entry);
-    node->data = NULL;
-    dlinkDelete(&lru_node->node, &lru->list);
-    memPoolFree(lru_node_pool, lru_node);
+    lru_unlink(lru, node);
     lru->count -= 1;
 }
 
@@ -118,29 +139,29 @@ lru_referenced(RemovalPolicy * policy, const StoreEntry * entry,
     RemovalPolicyNode * node)
 {
     LruPolicyData *lru = policy->_data;
-    LruNode *lru_node = node->data;
-    if (!lru_node)
+    if (!lru->type || !lru_linked(lru, entry, node))
 	return;
-    dlinkDelete(&lru_node->node, &lru->list);
-    dlinkAddTail((void *) entry, &lru_node->node, &lru->list);
+    lru_unlink(lru, node);
+    lru_link(lru, (StoreEntry *) entry, node);
 }
 
 /** RemovalPolicyWalker **/
 
 typedef struct _LruWalkData LruWalkData;
 struct _LruWalkData {
-    LruNode *current;
+    StoreEntry *current;
 };
 
 static const StoreEntry *
 lru_walkNext(RemovalPolicyWalker * walker)
 {
     LruWalkData *lru_walk = walker->_data;
-    LruNode *lru_node = lru_walk->current;
-    if (!lru_node)
+    LruPolicyData *lru = walker->_policy->_data;
+    StoreEntry *entry = lru_walk->current;
+    if (!entry)
 	return NULL;
-    lru_walk->current = (LruNode *) lru_node->node.next;
-    return (StoreEntry *) lru_node->node.data;
+    lru_walk->current = lru_node(lru, entry)->next;
+    return entry;
 }
 
 static void
@@ -168,7 +189,7 @@ lru_walkInit(RemovalPolicy * policy)
     walker->_data = lru_walk;
     walker->Next = lru_walkNext;
     walker->Done = lru_walkDone;
-    lru_walk->current = (LruNode *) lru->list.head;
+    lru_walk->current = lru->head;
     return walker;
 }
 
@@ -176,8 +197,8 @@ lru_walkInit(RemovalPolicy * policy)
 
 typedef struct _LruPurgeData LruPurgeData;
 struct _LruPurgeData {
-    LruNode *current;
-    LruNode *start;
+    StoreEntry *current;
+    StoreEntry *start;
 };
 
 static StoreEntry *
@@ -186,29 +207,27 @@ lru_purgeNext(RemovalPurgeWalker * walker)
     LruPurgeData *lru_walker = walker->_data;
     RemovalPolicy *policy = walker->_policy;
     LruPolicyData *lru = policy->_data;
-    LruNode *lru_node;
+    RemovalPolicyNode *node;
     StoreEntry *entry;
   try_again:
-    lru_node = lru_walker->current;
-    if (!lru_node || walker->scanned >= walker->max_scan)
+    entry = lru_walker->current;
+    if (!entry || walker->scanned >= walker->max_scan)
 	return NULL;
     walker->scanned += 1;
-    lru_walker->current = (LruNode *) lru_node->node.next;
+    node = lru_node(lru, entry);
+    lru_walker->current = node->next;
     if (lru_walker->current == lru_walker->start) {
 	/* Last node found */
 	lru_walker->current = NULL;
     }
-    entry = (StoreEntry *) lru_node->node.data;
-    dlinkDelete(&lru_node->node, &lru->list);
+    lru_unlink(lru, node);
     if (storeEntryLocked(entry)) {
 	/* Shit, it is locked. we can't return this one */
 	walker->locked++;
-	dlinkAddTail(entry, &lru_node->node, &lru->list);
+	lru_link(lru, entry, node);
 	goto try_again;
     }
-    memPoolFree(lru_node_pool, lru_node);
     lru->count -= 1;
-    SET_POLICY_NODE(entry, NULL);
     return entry;
 }
 
@@ -238,7 +257,7 @@ lru_purgeInit(RemovalPolicy * policy, int max_scan)
     walker->max_scan = max_scan;
     walker->Next = lru_purgeNext;
     walker->Done = lru_purgeDone;
-    lru_walk->start = lru_walk->current = (LruNode *) lru->list.head;
+    lru_walk->start = lru_walk->current = lru->head;
     return walker;
 }
 
@@ -246,17 +265,12 @@ static void
 lru_stats(RemovalPolicy * policy, StoreEntry * sentry)
 {
     LruPolicyData *lru = policy->_data;
-    LruNode *lru_node = (LruNode *) lru->list.head;
+    StoreEntry *entry = lru->head;
 
-  again:
-    if (lru_node) {
-	StoreEntry *entry = (StoreEntry *) lru_node->node.data;
-	if (storeEntryLocked(entry)) {
-	    lru_node = (LruNode *) lru_node->node.next;
-	    goto again;
-	}
-	storeAppendPrintf(sentry, "LRU reference age: %.2f days\n", (double) (squid_curtime - entry->lastref) / (double) (24 * 60 * 60));
-    }
+    while (entry && storeEntryLocked(entry))
+	entry = lru_node(lru, entry)->next;
+    if (entry)
+	storeAppendPrintf(sentry, "LRU reference age: %.2f days\n", (double) (squid_curtime - storeTime(entry->lastref)) / (double) (24 * 60 * 60));
 }
 
 static void
@@ -280,9 +294,6 @@ createRemovalPolicy_lru(wordlist * args)
     LruPolicyData *lru_data;
     /* no arguments expected or understood */
     assert(!args);
-    /* Initialize */
-    if (!lru_node_pool)
-	lru_node_pool = memPoolCreate("LRU policy node", sizeof(LruNode));
     /* Allocate the needed structures */
     lru_data = xcalloc(1, sizeof(*lru_data));
     policy = cbdataAlloc(RemovalPolicy);
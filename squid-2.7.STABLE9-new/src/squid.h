@@ -187,6 +187,12 @@
 #if HAVE_SYS_STAT_H
 #include <sys/stat.h>
 #endif
+#if HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+#if HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 #if HAVE_SYS_UN_H
 #include <sys/un.h>
 #endif
@@ -242,6 +248,12 @@
 #if HAVE_SYS_MOUNT_H
 #include <sys/mount.h>
 #endif
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
 
 #if defined(HAVE_STDARG_H)
 #include <stdarg.h>
@@ -392,14 +404,13 @@ struct rusage {
 
 #include "defines.h"
 #include "enums.h"
+/*use for video cache*/
+#include "acsmDFA.h"
+#include <videoreg.h>
 #include "typedefs.h"
 #include "structs.h"
 #include "protos.h"
 #include "globals.h"
-/*use for video cache*/
-#include "acsmDFA.h"
-#include <videoreg.h>
-#define MAX_LEN	2048
 
 #include "util.h"
 
@@ -735,11 +735,13 @@ ssl_read_method(fd, buf, len)
 	    break;
 	case SSL_ERROR_WANT_READ:
 	    fd_table[fd].read_pending = COMM_PENDING_WANTS_READ;
+	    fd_table[fd].flags.read_ready = 0;
 	    i = -1;
 	    errno = EAGAIN;
 	    break;
 	case SSL_ERROR_WANT_WRITE:
 	    fd_table[fd].read_pending = COMM_PENDING_WANTS_WRITE;
+	    fd_table[fd].flags.write_ready = 0;
 	    i = -1;
 	    errno = EAGAIN;
 	    break;
@@ -785,11 +787,13 @@ ssl_write_method(fd, buf, len)
 	    break;
 	case SSL_ERROR_WANT_READ:
 	    fd_table[fd].write_pending = COMM_PENDING_WANTS_READ;
+	    fd_table[fd].flags.read_ready = 0;
 	    i = -1;
 	    errno = EAGAIN;
 	    break;
 	case SSL_ERROR_WANT_WRITE:
 	    fd_table[fd].write_pending = COMM_PENDING_WANTS_WRITE;
+	    fd_table[fd].flags.write_ready = 0;
 	    i = -1;
 	    errno = EAGAIN;
 	    break;
@@ -39,7 +39,7 @@
 typedef int STOBJFLT(const StoreEntry *);
 typedef struct {
     StoreEntry *sentry;
-    int bucket;
+    int slot;
     STOBJFLT *filter;
 } StatObjectsState;
 
@@ -232,10 +232,10 @@ describeTimestamps(const StoreEntry * entry)
 {
     LOCAL_ARRAY(char, buf, 256);
     snprintf(buf, 256, "LV:%-9d LU:%-9d LM:%-9d EX:%-9d",
-	(int) entry->timestamp,
-	(int) entry->lastref,
-	(int) entry->lastmod,
-	(int) entry->expires);
+	(int) storeTime(entry->timestamp),
+	(int) storeTime(entry->lastref),
+	(int) storeTime(entry->lastmod),
+	(int) storeTime(entry->expires));
     return buf;
 }
 
@@ -246,7 +246,7 @@ statStoreEntry(MemBuf * mb, StoreEntry * e)
     int i;
     struct _store_client *sc;
     dlink_node *node;
-    memBufPrintf(mb, "KEY %s\n", storeKeyText(e->hash.key));
+    memBufPrintf(mb, "KEY %s\n", storeKeyText(e->key));
     /* XXX should this url be escaped? */
     if (mem)
 	memBufPrintf(mb, "\t%s %s\n",
@@ -298,9 +298,9 @@ statObjects(void *data)
 {
     StatObjectsState *state = data;
     StoreEntry *e;
-    hash_link *link_ptr = NULL;
-    hash_link *link_next = NULL;
-    if (state->bucket >= store_hash_buckets) {
+    MemBuf mb;
+    int n;
+    if (state->slot >= storeIndexSlots()) {
 	storeComplete(state->sentry);
 	storeUnlockObject(state->sentry);
 	cbdataFree(state);
@@ -313,22 +313,19 @@ statObjects(void *data)
 	eventAdd("statObjects", statObjects, state, 0.1, 1);
 	return;
     }
-    debug(49, 3) ("statObjects: Bucket #%d\n", state->bucket);
-    link_next = hash_get_bucket(store_table, state->bucket);
-    if (link_next) {
-	MemBuf mb;
-	memBufDefInit(&mb);
-	while (NULL != (link_ptr = link_next)) {
-	    link_next = link_ptr->next;
-	    e = (StoreEntry *) link_ptr;
-	    if (state->filter && 0 == state->filter(e))
-		continue;
-	    statStoreEntry(&mb, e);
-	}
-	storeAppend(state->sentry, mb.buf, mb.size);
-	memBufClean(&mb);
+    debug(49, 3) ("statObjects: Slot #%d\n", state->slot);
+    memBufDefInit(&mb);
+    for (n = 0; n < 64 && state->slot < storeIndexSlots(); n++, state->slot++) {
+	e = storeIndexSlot(state->slot);
+	if (e == NULL)
+	    continue;
+	if (state->filter && 0 == state->filter(e))
+	    continue;
+	statStoreEntry(&mb, e);
     }
-    state->bucket++;
+    if (mb.size)
+	storeAppend(state->sentry, mb.buf, mb.size);
+    memBufClean(&mb);
     eventAdd("statObjects", statObjects, state, 0.0, 1);
 }
 
@@ -1500,9 +1497,9 @@ statClientRequests(StoreEntry * s)
 	    (long int) http->out.offset, (unsigned long int) http->out.size);
 	storeAppendPrintf(s, "req_sz %ld\n", (long int) http->req_sz);
 	e = http->entry;
-	storeAppendPrintf(s, "entry %p/%s\n", e, e ? storeKeyText(e->hash.key) : "N/A");
+	storeAppendPrintf(s, "entry %p/%s\n", e, e ? storeKeyText(e->key) : "N/A");
 	e = http->old_entry;
-	storeAppendPrintf(s, "old_entry %p/%s\n", e, e ? storeKeyText(e->hash.key) : "N/A");
+	storeAppendPrintf(s, "old_entry %p/%s\n", e, e ? storeKeyText(e->key) : "N/A");
 	storeAppendPrintf(s, "start %ld.%06d (%f seconds ago)\n",
 	    (long int) http->start.tv_sec,
 	    (int) http->start.tv_usec,
@@ -35,14 +35,180 @@
 
 #include "squid.h"
 
+/*
+ * A mem_node takes a whole mem_page_size slot, its data following the
+ * header.  Slots are carved out of STMEM_CHUNK_SIZE chunks aligned to
+ * their size, backed by huge pages if asked to, and go back on a free
+ * list rather than to the system.
+ */
+static struct {
+    char *freelist;		/* free slots, each holding the next */
+    int chunks;
+    int huge;			/* of the chunks, those on reserved huge pages */
+    int slots;
+    int used;
+} stmem_arena;
+
+static size_t stmem_data_size;	/* data a mem_node holds */
+
+static void
+stmemArenaGrow(void)
+{
+    char *chunk = NULL;
+    size_t i;
+#if HAVE_SYS_MMAN_H
+#ifdef MAP_HUGETLB
+    /* until the reserved huge pages run out */
+    if (Config.onoff.mem_huge_pages && stmem_arena.huge == stmem_arena.chunks) {
+	chunk = mmap(NULL, STMEM_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (chunk == MAP_FAILED) {
+	    debug(19, 1) ("stmemArenaGrow: out of reserved huge pages: %s\n", xstrerror());
+	    chunk = NULL;
+	} else
+	    stmem_arena.huge++;
+    }
+#endif
+    if (!chunk) {
+	/* map a chunk's worth more to align it, for transparent huge pages */
+	char *raw = mmap(NULL, STMEM_CHUNK_SIZE * 2, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	size_t head;
+	if (raw == MAP_FAILED)
+	    fatalf("stmemArenaGrow: mmap: %s\n", xstrerror());
+	head = STMEM_CHUNK_SIZE - ((size_t) raw & (STMEM_CHUNK_SIZE - 1));
+	if (head == STMEM_CHUNK_SIZE)
+	    head = 0;
+	chunk = raw + head;
+	if (head)
+	    munmap(raw, head);
+	munmap(chunk + STMEM_CHUNK_SIZE, STMEM_CHUNK_SIZE - head);
+#ifdef MADV_HUGEPAGE
+	if (Config.onoff.mem_huge_pages)
+	    madvise(chunk, STMEM_CHUNK_SIZE, MADV_HUGEPAGE);
+#endif
+    }
+#else
+    chunk = xmalloc(STMEM_CHUNK_SIZE);
+#endif
+    stmem_arena.chunks++;
+    for (i = 0; i < STMEM_CHUNK_SIZE; i += mem_page_size) {
+	*(char **) (chunk + i) = stmem_arena.freelist;
+	stmem_arena.freelist = chunk + i;
+	stmem_arena.slots++;
+    }
+}
+
+static mem_node *
+stmemNodeAlloc(void)
+{
+    mem_node *p;
+    if (!stmem_arena.freelist)
+	stmemArenaGrow();
+    p = (mem_node *) stmem_arena.freelist;
+    stmem_arena.freelist = *(char **) p;
+    stmem_arena.used++;
+    p->next = NULL;
+    p->len = 0;
+    p->uses = 0;
+    return p;
+}
+
+static void
+stmemNodeRelease(mem_node * p)
+{
+    if (p->uses) {
+	p->uses--;
+	return;
+    }
+    *(char **) p = stmem_arena.freelist;
+    stmem_arena.freelist = (char *) p;
+    stmem_arena.used--;
+}
+
+/*
+ * Fix the page size at the first configuration; the pages already in
+ * use are that size.
+ */
+void
+stmemConfigure(void)
+{
+    size_t size = SM_PAGE_SIZE;
+    while (size < Config.memPageSize && size < STMEM_CHUNK_SIZE)
+	size <<= 1;
+    if (size != Config.memPageSize)
+	debug(19, 1) ("WARNING: memory_page_size must be a power of two from 4 KB to 2 MB, using %d KB\n",
+	    (int) (size >> 10));
+    if (!stmem_data_size) {
+	mem_page_size = size;
+	stmem_data_size = mem_page_size - offsetof(mem_node, data);
+    } else if (size != mem_page_size)
+	debug(19, 1) ("WARNING: memory_page_size stays %d KB until restarted\n",
+	    (int) (mem_page_size >> 10));
+}
+
+int
+stmemPagesInUse(void)
+{
+    return stmem_arena.used;
+}
+
+void
+stmemStats(StoreEntry * sentry)
+{
+    storeAppendPrintf(sentry, "Page size: %d KB, %d bytes of data\n",
+	(int) (mem_page_size >> 10), (int) stmem_data_size);
+    storeAppendPrintf(sentry, "Chunks: %d of %d KB, %d on reserved huge pages\n",
+	stmem_arena.chunks, STMEM_CHUNK_SIZE >> 10, stmem_arena.huge);
+    storeAppendPrintf(sentry, "Pages: %d, %d in use\n",
+	stmem_arena.slots, stmem_arena.used);
+}
+
+/*
+ * Every node but the tail holds a full page, so the node holding an
+ * offset is found by its page number in mem->index rather than by
+ * walking the list from the head.
+ */
+static void
+stmemIndexAppend(mem_hdr * mem, mem_node * p)
+{
+    if (mem->index.first + mem->index.count == mem->index.size) {
+	if (mem->index.first > 0 && mem->index.first >= mem->index.size / 2) {
+	    /* reuse the slots of the pages freed at the front */
+	    xmemmove(mem->index.node, mem->index.node + mem->index.first,
+		mem->index.count * sizeof(mem_node *));
+	    mem->index.first = 0;
+	} else {
+	    mem->index.size = mem->index.size ? mem->index.size * 2 : 16;
+	    mem->index.node = xrealloc(mem->index.node, mem->index.size * sizeof(mem_node *));
+	}
+    }
+    mem->index.node[mem->index.first + mem->index.count++] = p;
+}
+
+/* The node holding offset, with *skip set to where in it, or NULL */
+static mem_node *
+stmemIndexFind(const mem_hdr * mem, squid_off_t offset, size_t * skip)
+{
+    squid_off_t page;
+    mem_node *p;
+    if (offset < mem->origin_offset)
+	return NULL;
+    page = (offset - mem->origin_offset) / stmem_data_size;
+    if (page >= mem->index.count)
+	return NULL;
+    p = mem->index.node[mem->index.first + page];
+    *skip = (offset - mem->origin_offset) % stmem_data_size;
+    if (*skip >= p->len)
+	return NULL;
+    return p;
+}
+
+/* Release a page handed out by stmemNodeGet() */
 void
 stmemNodeFree(void *buf)
 {
-    mem_node *p = (mem_node *) buf;
-    if (!p->uses)
-	memFree(p, MEM_MEM_NODE);
-    else
-	p->uses--;
+    stmemNodeRelease((mem_node *) ((char *) buf - offsetof(mem_node, data)));
 }
 
 char *
@@ -58,11 +224,13 @@ stmemFree(mem_hdr * mem)
     mem_node *p;
     while ((p = mem->head)) {
 	mem->head = p->next;
-	store_mem_size -= SM_PAGE_SIZE;
-	stmemNodeFree(p);
+	store_mem_size -= mem_page_size;
+	stmemNodeRelease(p);
     }
     mem->head = mem->tail = NULL;
     mem->origin_offset = 0;
+    safe_free(mem->index.node);
+    memset(&mem->index, 0, sizeof(mem->index));
 }
 
 squid_off_t
@@ -70,20 +238,22 @@ stmemFreeDataUpto(mem_hdr * mem, squid_off_t target_offset)
 {
     squid_off_t current_offset = mem->origin_offset;
     mem_node *p = mem->head;
+    int freed = 0;
     while (p && ((current_offset + p->len) <= target_offset)) {
 	if (p == mem->tail) {
 	    /* keep the last one to avoid change to other part of code */
-	    mem->head = mem->tail;
-	    mem->origin_offset = current_offset;
-	    return current_offset;
+	    break;
 	} else {
 	    mem_node *lastp = p;
 	    p = p->next;
 	    current_offset += lastp->len;
-	    store_mem_size -= SM_PAGE_SIZE;
-	    stmemNodeFree(lastp);
+	    store_mem_size -= mem_page_size;
+	    stmemNodeRelease(lastp);
+	    freed++;
 	}
     }
+    mem->index.first += freed;
+    mem->index.count -= freed;
     mem->head = p;
     mem->origin_offset = current_offset;
     if (current_offset < target_offset) {
@@ -105,8 +275,8 @@ stmemAppend(mem_hdr * mem, const char *data, int len)
     /* Does the last block still contain empty space? 
      * If so, fill out the block before dropping into the
      * allocation loop */
-    if (mem->head && mem->tail && (mem->tail->len < SM_PAGE_SIZE)) {
-	avail_len = SM_PAGE_SIZE - (mem->tail->len);
+    if (mem->head && mem->tail && (mem->tail->len < stmem_data_size)) {
+	avail_len = stmem_data_size - (mem->tail->len);
 	len_to_copy = XMIN(avail_len, len);
 	xmemcpy((mem->tail->data + mem->tail->len), data, len_to_copy);
 	/* Adjust the ptr and len according to what was deposited in the page */
@@ -115,12 +285,10 @@ stmemAppend(mem_hdr * mem, const char *data, int len)
 	mem->tail->len += len_to_copy;
     }
     while (len > 0) {
-	len_to_copy = XMIN(len, SM_PAGE_SIZE);
-	p = memAllocate(MEM_MEM_NODE);	/* This is a non-zero'ed buffer; make sure you fully initialise it */
-	p->next = NULL;
+	len_to_copy = XMIN(len, stmem_data_size);
+	p = stmemNodeAlloc();
 	p->len = len_to_copy;
-	p->uses = 0;
-	store_mem_size += SM_PAGE_SIZE;
+	store_mem_size += mem_page_size;
 	xmemcpy(p->data, data, len_to_copy);
 	if (!mem->head) {
 	    /* The chain is empty */
@@ -130,37 +298,69 @@ stmemAppend(mem_hdr * mem, const char *data, int len)
 	    mem->tail->next = p;
 	    mem->tail = p;
 	}
+	stmemIndexAppend(mem, p);
 	len -= len_to_copy;
 	data += len_to_copy;
     }
 }
 
+#if HAVE_SYS_UIO_H
+/*
+ * Point v at up to size bytes of mem from offset where they lie in its
+ * pages, pinning the pages until stmemIovecFree(v).  Returns the number
+ * of bytes referenced, which is short of size at the end of mem or when
+ * v is full.
+ */
+ssize_t
+stmemRef(const mem_hdr * mem, squid_off_t offset, size_t size, mem_iovec * v)
+{
+    mem_node *p;
+    size_t bytes_to_go = size;
+    size_t skip;
+    debug(19, 6) ("stmemRef: offset %" PRINTF_OFF_T ": size %d\n", offset, (int) size);
+    v->n = 0;
+    p = stmemIndexFind(mem, offset, &skip);
+    while (p && bytes_to_go > 0 && v->n < MEM_IOVEC_MAX) {
+	size_t len = XMIN(bytes_to_go, p->len - skip);
+	v->iov[v->n].iov_base = stmemNodeGet(p) + skip;
+	v->iov[v->n].iov_len = len;
+	v->node[v->n++] = p;
+	bytes_to_go -= len;
+	skip = 0;
+	p = p->next;
+    }
+    return size - bytes_to_go;
+}
+
+void
+stmemIovecFree(void *data)
+{
+    mem_iovec *v = data;
+    int i;
+    for (i = 0; i < v->n; i++)
+	stmemNodeRelease(v->node[i]);
+    memFree(v, MEM_MEM_IOVEC);
+}
+#endif
+
 ssize_t
 stmemCopy(const mem_hdr * mem, squid_off_t offset, char *buf, size_t size)
 {
-    mem_node *p = mem->head;
-    squid_off_t t_off = mem->origin_offset;
+    mem_node *p;
     size_t bytes_to_go = size;
     char *ptr_to_buf = NULL;
     int bytes_from_this_packet = 0;
-    int bytes_into_this_packet = 0;
+    size_t bytes_into_this_packet = 0;
     debug(19, 6) ("stmemCopy: offset %" PRINTF_OFF_T ": size %d\n", offset, (int) size);
-    if (p == NULL)
+    if (mem->head == NULL)
 	return 0;
     assert(size > 0);
-    /* Seek our way into store */
-    while ((t_off + p->len) < offset) {
-	t_off += p->len;
-	if (!p->next) {
-	    debug(19, 1) ("stmemCopy: p->next == NULL\n");
-	    return 0;
-	}
-	assert(p->next);
-	p = p->next;
+    if ((p = stmemIndexFind(mem, offset, &bytes_into_this_packet)) == NULL) {
+	debug(19, 1) ("stmemCopy: offset %" PRINTF_OFF_T " not in memory\n", offset);
+	return 0;
     }
     /* Start copying begining with this block until
      * we're satiated */
-    bytes_into_this_packet = offset - t_off;
     bytes_from_this_packet = XMIN(bytes_to_go, p->len - bytes_into_this_packet);
     xmemcpy(buf, p->data + bytes_into_this_packet, bytes_from_this_packet);
     bytes_to_go -= bytes_from_this_packet;
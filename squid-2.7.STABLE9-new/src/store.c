@@ -146,7 +146,7 @@ new_StoreEntry(int mem_obj_flag, const char *url)
     if (mem_obj_flag)
 	e->mem_obj = new_MemObject(url);
     debug(20, 3) ("new_StoreEntry: returning %p\n", e);
-    e->expires = e->lastmod = e->lastref = e->timestamp = -1;
+    e->expires = e->lastmod = e->lastref = e->timestamp = STORE_TIME_UNSET;
     e->swap_filen = -1;
     e->swap_dirn = -1;
     return e;
@@ -211,27 +211,31 @@ destroy_StoreEntry(void *data)
     if (e->mem_obj)
 	destroy_MemObject(e);
     storeHashDelete(e);
-    assert(e->hash.key == NULL);
+    assert(!e->hashed);
     memFree(e, MEM_STOREENTRY);
 }
 
-/* ----- INTERFACE BETWEEN STORAGE MANAGER AND HASH TABLE FUNCTIONS --------- */
+/* ----- INTERFACE BETWEEN STORAGE MANAGER AND THE STORE INDEX --------- */
 
 void
 storeHashInsert(StoreEntry * e, const cache_key * key)
 {
     debug(20, 3) ("storeHashInsert: Inserting Entry %p key '%s'\n",
 	e, storeKeyText(key));
-    e->hash.key = storeKeyDup(key);
-    hash_join(store_table, &e->hash);
+    storeKeyCopy(e->key, key);
+    storeIndexAdd(e);
+    if (!EBIT_TEST(e->flags, KEY_PRIVATE))
+	workerIndexAdd(key);
 }
 
 static void
 storeHashDelete(StoreEntry * e)
 {
-    hash_remove_link(store_table, &e->hash);
-    storeKeyFree(e->hash.key);
-    e->hash.key = NULL;
+    if (!e->hashed)
+	return;
+    if (!EBIT_TEST(e->flags, KEY_PRIVATE))
+	workerIndexDelete(e->key);
+    storeIndexDelete(e);
 }
 
 /* -------------------------------------------------------------------------- */
@@ -245,7 +249,7 @@ storePurgeMem(StoreEntry * e)
     if (e->mem_obj == NULL)
 	return;
     debug(20, 3) ("storePurgeMem: Freeing memory-copy of %s\n",
-	storeKeyText(e->hash.key));
+	storeKeyText(e->key));
     storeSetMemStatus(e, NOT_IN_MEMORY);
     destroy_MemObject(e);
     if (e->swap_status != SWAPOUT_DONE)
@@ -293,8 +297,8 @@ storeLockObjectDebug(StoreEntry * e, const char *file, const int line)
 {
     e->lock_count++;
     debug(20, 3) ("storeLockObject: (%s:%d): key '%s' count=%d\n", file, line,
-	storeKeyText(e->hash.key), (int) e->lock_count);
-    e->lastref = squid_curtime;
+	storeKeyText(e->key), (int) e->lock_count);
+    e->lastref = storeTimeRel(squid_curtime);
     storeEntryReferenced(e);
 }
 
@@ -303,7 +307,7 @@ storeReleaseRequest(StoreEntry * e)
 {
     if (EBIT_TEST(e->flags, RELEASE_REQUEST))
 	return;
-    debug(20, 3) ("storeReleaseRequest: '%s'\n", storeKeyText(e->hash.key));
+    debug(20, 3) ("storeReleaseRequest: '%s'\n", storeKeyText(e->key));
     EBIT_SET(e->flags, RELEASE_REQUEST);
     /*
      * Clear cachable flag here because we might get called before
@@ -321,7 +325,7 @@ storeUnlockObjectDebug(StoreEntry * e, const char *file, const int line)
 {
     e->lock_count--;
     debug(20, 3) ("storeUnlockObject: (%s:%d): key '%s' count=%d\n", file, line,
-	storeKeyText(e->hash.key), e->lock_count);
+	storeKeyText(e->key), e->lock_count);
     if (e->lock_count)
 	return (int) e->lock_count;
     if (e->store_status == STORE_PENDING)
@@ -350,7 +354,7 @@ storeGet(const cache_key * key)
 {
     //debug(20, 3) ("storeGet: looking up %s\n", storeKeyText(key));
      debug(20, 9) ("storeGet: looking up %s\n", storeKeyText(key));
-    return (StoreEntry *) hash_lookup(store_table, key);
+    return storeIndexGet(key);
 }
 
 StoreEntry *
@@ -359,6 +363,12 @@ storeGetPublic(const char *uri, const method_t method)
     return storeGet(storeKeyPublic(uri, method));
 }
 
+StoreEntry *
+storeGetPublicUrlRequest(const char *uri, const method_t method, const request_t * request)
+{
+    return storeGet(storeKeyPublicUrlRequest(uri, method, request));
+}
+
 StoreEntry *
 storeGetPublicByRequestMethod(request_t * req, const method_t method)
 {
@@ -396,9 +406,9 @@ storeSetPrivateKey(StoreEntry * e)
 {
     const cache_key *newkey;
     MemObject *mem = e->mem_obj;
-    if (e->hash.key && EBIT_TEST(e->flags, KEY_PRIVATE))
+    if (e->hashed && EBIT_TEST(e->flags, KEY_PRIVATE))
 	return;			/* is already private */
-    if (e->hash.key) {
+    if (e->hashed) {
 	if (e->swap_filen > -1)
 	    storeDirSwapLog(e, SWAP_LOG_DEL);
 	storeHashDelete(e);
@@ -409,7 +419,7 @@ storeSetPrivateKey(StoreEntry * e)
     } else {
 	newkey = storeKeyPrivate("JUNK", METHOD_NONE, getKeyCounter());
     }
-    assert(hash_lookup(store_table, newkey) == NULL);
+    assert(storeIndexGet(newkey) == NULL);
     EBIT_SET(e->flags, KEY_PRIVATE);
     storeHashInsert(e, newkey);
 }
@@ -714,7 +724,7 @@ storeAddVaryReadOld(void *data, char *buf, ssize_t size)
  * At leas one of key or etag must be specified, preferably both.
  */
 void
-storeAddVary(const char *store_url, const char *url, const method_t method, const cache_key * key, const char *etag, const char *vary, const char *vary_headers, const char *accept_encoding)
+storeAddVary(const char *store_url, const char *url, const method_t method, const cache_key * key, const char *etag, const char *vary, const char *vary_headers, const char *accept_encoding, const request_t * request)
 {
     AddVaryState *state;
     request_flags flags = null_request_flags;
@@ -728,7 +738,7 @@ storeAddVary(const char *store_url, const char *url, const method_t method, cons
 	state->accept_encoding = xstrdup(accept_encoding);
     if (etag)
 	state->etag = xstrdup(etag);
-    state->oe = storeGetPublic(store_url ? store_url : url, method);
+    state->oe = storeGetPublicUrlRequest(store_url ? store_url : url, method, request);
     debug(11, 2) ("storeAddVary: %s (%s) %s %s\n",
 	state->url, state->key, state->vary_headers, state->etag);
     if (state->oe)
@@ -976,7 +986,7 @@ storeLocateVary(StoreEntry * e, int offset, const char *vary_data, String accept
     if (!strLen(e->mem_obj->reply->content_type) || strCmp(e->mem_obj->reply->content_type, "x-squid-internal/vary") != 0) {
 	/* This is not our Vary marker object. Bail out. */
 	debug(33, 1) ("storeLocateVary: Not our vary marker object, %s = '%s', '%s'/'%s'\n",
-	    storeKeyText(e->hash.key), e->mem_obj->url, vary_data, strBuf(accept_encoding) ? strBuf(accept_encoding) : "-");
+	    storeKeyText(e->key), e->mem_obj->url, vary_data, strBuf(accept_encoding) ? strBuf(accept_encoding) : "-");
 	storeLocateVaryCallback(state);
 	return;
     }
@@ -995,7 +1005,7 @@ storeSetPublicKey(StoreEntry * e)
     StoreEntry *e2 = NULL;
     const cache_key *newkey;
     MemObject *mem = e->mem_obj;
-    if (e->hash.key && !EBIT_TEST(e->flags, KEY_PRIVATE)) {
+    if (e->hashed && !EBIT_TEST(e->flags, KEY_PRIVATE)) {
 	if (EBIT_TEST(e->flags, KEY_EARLY_PUBLIC)) {
 	    EBIT_CLR(e->flags, KEY_EARLY_PUBLIC);
 	    storeSetPrivateKey(e);	/* wasn't really public yet, reset the key */
@@ -1017,7 +1027,7 @@ storeSetPublicKey(StoreEntry * e)
 #if MORE_DEBUG_OUTPUT
     if (EBIT_TEST(e->flags, RELEASE_REQUEST))
 	debug(20, 1) ("assertion failed: RELEASE key %s, url %s\n",
-	    e->hash.key, mem->url);
+	    e->key, mem->url);
 #endif
     assert(!EBIT_TEST(e->flags, RELEASE_REQUEST));
     if (mem->request) {
@@ -1032,7 +1042,7 @@ storeSetPublicKey(StoreEntry * e)
 		 * to record the new variance key
 		 */
 		safe_free(request->vary_headers);	/* free old "bad" variance key */
-		pe = storeGetPublic(storeLookupUrl(e), mem->method);
+		pe = storeGetPublicUrlRequest(storeLookupUrl(e), mem->method, request);
 		if (pe)
 		    storeRelease(pe);
 	    }
@@ -1060,13 +1070,13 @@ storeSetPublicKey(StoreEntry * e)
 		strListAdd(&vary, strBuf(varyhdr), ',');
 	    stringClean(&varyhdr);
 #endif
-	    storeAddVary(mem->store_url, mem->url, mem->method, newkey, httpHeaderGetStr(&mem->reply->header, HDR_ETAG), strBuf(vary), mem->vary_headers, mem->vary_encoding);
+	    storeAddVary(mem->store_url, mem->url, mem->method, newkey, httpHeaderGetStr(&mem->reply->header, HDR_ETAG), strBuf(vary), mem->vary_headers, mem->vary_encoding, mem->request);
 	    stringClean(&vary);
 	}
     } else {
 	newkey = storeKeyPublic(storeLookupUrl(e), mem->method);
     }
-    if ((e2 = (StoreEntry *) hash_lookup(store_table, newkey))) {
+    if ((e2 = storeIndexGet(newkey))) {
 	debug(20, 3) ("storeSetPublicKey: Making old '%s' private.\n", mem->url);
 	storeSetPrivateKey(e2);
 	storeRelease(e2);
@@ -1075,8 +1085,7 @@ storeSetPublicKey(StoreEntry * e)
 	else
 	    newkey = storeKeyPublic(storeLookupUrl(e), mem->method);
     }
-    if (e->hash.key)
-	storeHashDelete(e);
+    storeHashDelete(e);
     EBIT_CLR(e->flags, KEY_PRIVATE);
     storeHashInsert(e, newkey);
     if (e->swap_filen > -1)
@@ -1094,18 +1103,11 @@ storeCreateEntry(const char *url, request_flags flags, method_t method)
     e->lock_count = 1;		/* Note lock here w/o calling storeLock() */
     mem = e->mem_obj;
     mem->method = method;
-    /*Add for youku video cache*/
-    char query_str[MAX_LEN];
-    int ret = -1;
-		memset(query_str, 0, sizeof(query_str));
-		ConvertCaseEX((unsigned char *)query_str, (unsigned char *)url, strlen(url));
-    ret = acsmSearch_cap(acsm_cap[0], (unsigned char *)query_str, strlen(query_str));
-		
-		if ( (ret-100) >=0) {
-			storeSetPublicKey(e);
-	  	debug(20, 8) ("in order to video cache,we need set to public key: '%s'\n", url);
-		}		 
-    else if (neighbors_do_private_keys || !flags.hierarchical)
+    /*
+     * Video objects are published under the request's video ID once the
+     * reply headers arrive, rather than classifying the URL again here.
+     */
+    if (flags.video_cache || neighbors_do_private_keys || !flags.hierarchical)
 	storeSetPrivateKey(e);
     else
 	storeSetPublicKey(e);
@@ -1122,8 +1124,8 @@ storeCreateEntry(const char *url, request_flags flags, method_t method)
     e->swap_filen = -1;
     e->swap_dirn = -1;
     e->refcount = 0;
-    e->lastref = squid_curtime;
-    e->timestamp = -1;		/* set in storeTimestampsSet() */
+    e->lastref = storeTimeRel(squid_curtime);
+    e->timestamp = STORE_TIME_UNSET;		/* set in storeTimestampsSet() */
     e->ping_status = PING_NONE;
     EBIT_SET(e->flags, ENTRY_VALIDATED);
     return e;
@@ -1133,8 +1135,8 @@ storeCreateEntry(const char *url, request_flags flags, method_t method)
 void
 storeExpireNow(StoreEntry * e)
 {
-    debug(20, 3) ("storeExpireNow: '%s'\n", storeKeyText(e->hash.key));
-    e->expires = squid_curtime;
+    debug(20, 3) ("storeExpireNow: '%s'\n", storeKeyText(e->key));
+    e->expires = storeTimeRel(squid_curtime);
 }
 
 /* Append incoming data from a primary server to an entry. */
@@ -1149,7 +1151,7 @@ storeAppend(StoreEntry * e, const char *buf, int len)
     if (len) {
 	debug(20, 5) ("storeAppend: appending %d bytes for '%s'\n",
 	    len,
-	    storeKeyText(e->hash.key));
+	    storeKeyText(e->key));
 	storeGetMemSpace(len);
 	stmemAppend(&mem->data_hdr, buf, len);
 	mem->inmem_hi += len;
@@ -1326,7 +1328,7 @@ storeCheckCachableStats(StoreEntry * sentry)
 void
 storeComplete(StoreEntry * e)
 {
-    debug(20, 3) ("storeComplete: '%s'\n", storeKeyText(e->hash.key));
+    debug(20, 3) ("storeComplete: '%s'\n", storeKeyText(e->key));
     if (e->store_status != STORE_PENDING) {
 	/*
 	 * if we're not STORE_PENDING, then probably we got aborted
@@ -1369,7 +1371,7 @@ storeRequestFailed(StoreEntry * e, ErrorState * err)
     MemObject *mem = e->mem_obj;
     assert(e->store_status == STORE_PENDING);
     assert(mem != NULL);
-    debug(20, 6) ("storeAbort: %s\n", storeKeyText(e->hash.key));
+    debug(20, 6) ("storeAbort: %s\n", storeKeyText(e->key));
     storeLockObject(e);		/* lock while aborting */
     storeExpireNow(e);
     storeReleaseRequest(e);
@@ -1401,7 +1403,7 @@ storeAbort(StoreEntry * e)
     MemObject *mem = e->mem_obj;
     assert(e->store_status == STORE_PENDING);
     assert(mem != NULL);
-    debug(20, 6) ("storeAbort: %s\n", storeKeyText(e->hash.key));
+    debug(20, 6) ("storeAbort: %s\n", storeKeyText(e->key));
     storeLockObject(e);		/* lock while aborting */
     storeExpireNow(e);
     storeReleaseRequest(e);
@@ -1442,8 +1444,8 @@ storeGetMemSpace(int size)
     if (squid_curtime == last_check)
 	return;
     last_check = squid_curtime;
-    pages_needed = (size / SM_PAGE_SIZE) + 1;
-    if (memInUse(MEM_MEM_NODE) + pages_needed < store_pages_max)
+    pages_needed = (size / mem_page_size) + 1;
+    if (stmemPagesInUse() + pages_needed < store_pages_max)
 	return;
     debug(20, 3) ("storeGetMemSpace: Starting, need %d pages\n", pages_needed);
     /* XXX what to set as max_scan here? */
@@ -1452,7 +1454,7 @@ storeGetMemSpace(int size)
 	debug(20, 3) ("storeGetMemSpace: purging %p\n", e);
 	storePurgeMem(e);
 	released++;
-	if (memInUse(MEM_MEM_NODE) + pages_needed < store_pages_max) {
+	if (stmemPagesInUse() + pages_needed < store_pages_max) {
 	    debug(20, 3) ("storeGetMemSpace: we finally have enough free memory!\n");
 	    break;
 	}
@@ -1507,7 +1509,7 @@ storeMaintainSwapSpace(void *datanotused)
 void
 storeRelease(StoreEntry * e)
 {
-    debug(20, 3) ("storeRelease: Releasing: '%s'\n", storeKeyText(e->hash.key));
+    debug(20, 3) ("storeRelease: Releasing: '%s'\n", storeKeyText(e->key));
     /* If, for any reason we can't discard this object because of an
      * outstanding request, mark it for pending release */
     if (storeEntryLocked(e)) {
@@ -1602,7 +1604,7 @@ storeEntryValidLength(const StoreEntry * e)
     const HttpReply *reply;
     assert(e->mem_obj != NULL);
     reply = e->mem_obj->reply;
-    debug(20, 3) ("storeEntryValidLength: Checking '%s'\n", storeKeyText(e->hash.key));
+    debug(20, 3) ("storeEntryValidLength: Checking '%s'\n", storeKeyText(e->key));
     debug(20, 5) ("storeEntryValidLength:     object_len = %" PRINTF_OFF_T "\n",
 	objectLen(e));
     debug(20, 5) ("storeEntryValidLength:         hdr_sz = %d\n",
@@ -1612,7 +1614,7 @@ storeEntryValidLength(const StoreEntry * e)
 	clen);
     if (clen < 0) {
 	debug(20, 5) ("storeEntryValidLength: Unspecified content length: %s\n",
-	    storeKeyText(e->hash.key));
+	    storeKeyText(e->key));
 	return 1;
     }
     diff = reply->hdr_sz + clen - objectLen(e);
@@ -1621,7 +1623,7 @@ storeEntryValidLength(const StoreEntry * e)
     debug(20, 2) ("storeEntryValidLength: %" PRINTF_OFF_T " bytes too %s; '%s'\n",
 	diff < 0 ? -diff : diff,
 	diff < 0 ? "big" : "small",
-	storeKeyText(e->hash.key));
+	storeKeyText(e->key));
     return 0;
 }
 
@@ -1629,16 +1631,13 @@ static void
 storeInitHashValues(void)
 {
     long int i;
-    /* Calculate size of hash table (maximum currently 64k buckets).  */
+    /* Size the store index for the expected number of objects */
     i = (Config.Swap.maxSize + (Config.memMaxSize >> 10)) / Config.Store.avgObjectSize;
     debug(20, 1) ("Swap maxSize %lu + %lu KB, estimated %ld objects\n",
 	(unsigned long int) Config.Swap.maxSize, (unsigned long int) (Config.memMaxSize >> 10), i);
-    i /= Config.Store.objectsPerBucket;
-    debug(20, 1) ("Target number of buckets: %ld\n", i);
-    /* ideally the full scan period should be configurable, for the
-     * moment it remains at approximately 24 hours.  */
-    store_hash_buckets = storeKeyHashBuckets(i);
-    debug(20, 1) ("Using %d Store buckets\n", store_hash_buckets);
+    if (i > (1 << 29))
+	i = 1 << 29;
+    storeIndexInit((int) i);
     debug(20, 1) ("Max Mem  size: %lu KB\n", (unsigned long int) (Config.memMaxSize >> 10));
     debug(20, 1) ("Max Swap size: %lu KB\n", (unsigned long int) Config.Swap.maxSize);
 }
@@ -1648,8 +1647,6 @@ storeInit(void)
 {
     storeKeyInit();
     storeInitHashValues();
-    store_table = hash_create(storeKeyHashCmp,
-	store_hash_buckets, storeKeyHashHash);
     mem_policy = createRemovalPolicy(Config.memPolicy);
     storeDigestInit();
     storeLogOpen();
@@ -1666,6 +1663,9 @@ storeInit(void)
     cachemgrRegister("store_io",
 	"Store IO Interface Stats",
 	storeIOStats, 0, 1);
+    cachemgrRegister("mem_pages",
+	"Memory Cache Page Stats",
+	stmemStats, 0, 1);
 }
 
 void
@@ -1675,7 +1675,8 @@ storeConfigure(void)
 	    (float) Config.Swap.highWaterMark) / (float) 100);
     store_swap_low = (long) (((float) Config.Swap.maxSize *
 	    (float) Config.Swap.lowWaterMark) / (float) 100);
-    store_pages_max = Config.memMaxSize / SM_PAGE_SIZE;
+    stmemConfigure();
+    store_pages_max = Config.memMaxSize / mem_page_size;
 }
 
 static int
@@ -1693,7 +1694,7 @@ void
 storeNegativeCache(StoreEntry * e)
 {
     StoreEntry *oe = e->mem_obj->old_entry;
-    time_t expires = e->expires;
+    time_t expires = storeTime(e->expires);
     http_status status = e->mem_obj->reply->sline.status;
     refresh_cc cc = refreshCC(e, e->mem_obj->request);
     if (expires == -1)
@@ -1706,7 +1707,7 @@ storeNegativeCache(StoreEntry * e)
 	if (cc.max_stale >= 0) {
 	    time_t max_expires;
 	    storeTimestampsSet(oe);
-	    max_expires = oe->expires + cc.max_stale;
+	    max_expires = storeTime(oe->expires) + cc.max_stale;
 	    /* Bail out if beyond the stale-if-error staleness limit */
 	    if (max_expires <= squid_curtime)
 		goto cache_error_response;
@@ -1717,23 +1718,27 @@ storeNegativeCache(StoreEntry * e)
 	/* Block the new error from getting cached */
 	EBIT_CLR(e->flags, ENTRY_CACHABLE);
 	/* And negatively cache the old one */
-	if (oe->expires < expires)
-	    oe->expires = expires;
+	if (storeTime(oe->expires) < expires)
+	    oe->expires = storeTimeRel(expires);
 	EBIT_SET(oe->flags, REFRESH_FAILURE);
 	return;
     }
   cache_error_response:
-    if (e->expires < expires)
-	e->expires = expires;
+    if (storeTime(e->expires) < expires)
+	e->expires = storeTimeRel(expires);
     EBIT_SET(e->flags, ENTRY_NEGCACHED);
 }
 
 void
 storeFreeMemory(void)
 {
-    hashFreeItems(store_table, destroy_StoreEntry);
-    hashFreeMemory(store_table);
-    store_table = NULL;
+    StoreEntry *e;
+    int i;
+    for (i = 0; i < storeIndexSlots(); i++) {
+	if ((e = storeIndexSlot(i)) != NULL)
+	    destroy_StoreEntry(e);
+    }
+    storeIndexFree();
 #if USE_CACHE_DIGESTS
     if (store_digest)
 	cacheDigestDestroy(store_digest);
@@ -1755,7 +1760,7 @@ storeEntryValidToSend(StoreEntry * e)
     if (EBIT_TEST(e->flags, RELEASE_REQUEST))
 	return 0;
     if (EBIT_TEST(e->flags, ENTRY_NEGCACHED))
-	if (e->expires <= squid_curtime)
+	if (storeTime(e->expires) <= squid_curtime)
 	    return 0;
     if (EBIT_TEST(e->flags, ENTRY_ABORTED))
 	return 0;
@@ -1769,6 +1774,20 @@ storeEntryValidToSend(StoreEntry * e)
     return 1;
 }
 
+/* convert a time to the 32-bit form kept in StoreEntry, see storeTime() */
+store_time_t
+storeTimeRel(time_t t)
+{
+    if (t < 0)
+	return STORE_TIME_UNSET;
+    t -= STORE_TIME_BASE;
+    if (t > INT_MAX)
+	return INT_MAX;
+    if (t <= STORE_TIME_UNSET)
+	return STORE_TIME_UNSET + 1;
+    return (store_time_t) t;
+}
+
 void
 storeTimestampsSet(StoreEntry * entry)
 {
@@ -1796,11 +1815,11 @@ storeTimestampsSet(StoreEntry * entry)
 	if (squid_curtime > age)
 	    served_date = squid_curtime - age;
     if (reply->expires > 0 && reply->date > -1)
-	entry->expires = served_date + (reply->expires - reply->date);
+	entry->expires = storeTimeRel(served_date + (reply->expires - reply->date));
     else
-	entry->expires = reply->expires;
-    entry->lastmod = reply->last_modified;
-    entry->timestamp = served_date;
+	entry->expires = storeTimeRel(reply->expires);
+    entry->lastmod = storeTimeRel(reply->last_modified);
+    entry->timestamp = storeTimeRel(served_date);
 }
 
 void
@@ -1851,13 +1870,13 @@ storeMemObjectDump(MemObject * mem)
 void
 storeEntryDump(const StoreEntry * e, int l)
 {
-    debug(20, l) ("StoreEntry->key: %s\n", storeKeyText(e->hash.key));
-    debug(20, l) ("StoreEntry->next: %p\n", e->hash.next);
+    debug(20, l) ("StoreEntry->key: %s\n", storeKeyText(e->key));
+    debug(20, l) ("StoreEntry->hashed: %d\n", (int) e->hashed);
     debug(20, l) ("StoreEntry->mem_obj: %p\n", e->mem_obj);
-    debug(20, l) ("StoreEntry->timestamp: %ld\n", (long int) e->timestamp);
-    debug(20, l) ("StoreEntry->lastref: %ld\n", (long int) e->lastref);
-    debug(20, l) ("StoreEntry->expires: %ld\n", (long int) e->expires);
-    debug(20, l) ("StoreEntry->lastmod: %ld\n", (long int) e->lastmod);
+    debug(20, l) ("StoreEntry->timestamp: %ld\n", (long int) storeTime(e->timestamp));
+    debug(20, l) ("StoreEntry->lastref: %ld\n", (long int) storeTime(e->lastref));
+    debug(20, l) ("StoreEntry->expires: %ld\n", (long int) storeTime(e->expires));
+    debug(20, l) ("StoreEntry->lastmod: %ld\n", (long int) storeTime(e->lastmod));
     debug(20, l) ("StoreEntry->swap_file_sz: %" PRINTF_OFF_T "\n", (squid_off_t) e->swap_file_sz);
     debug(20, l) ("StoreEntry->refcount: %d\n", e->refcount);
     debug(20, l) ("StoreEntry->flags: %s\n", storeEntryFlags(e));
@@ -1990,7 +2009,7 @@ storeEntryReset(StoreEntry * e)
     mem->inmem_hi = mem->inmem_lo = 0;
     httpReplyDestroy(mem->reply);
     mem->reply = httpReplyCreate();
-    e->expires = e->lastmod = e->timestamp = -1;
+    e->expires = e->lastmod = e->timestamp = STORE_TIME_UNSET;
 }
 
 /*
@@ -2109,6 +2128,16 @@ storeDeferRead(StoreEntry * e, int fd)
     }
 }
 
+/* Defer a producer which has no server-side fd, calling it back on resume */
+void
+storeDeferProducer(StoreEntry * e, STABH * callback, void *data)
+{
+    MemObject *mem = e->mem_obj;
+    EBIT_SET(e->flags, ENTRY_DEFER_READ);
+    mem->resume.callback = callback;
+    mem->resume.data = data;
+}
+
 /* Resume reading from the server-side */
 void
 storeResumeRead(StoreEntry * e)
@@ -2119,6 +2148,15 @@ storeResumeRead(StoreEntry * e)
 	commResumeFD(mem->serverfd);
 	mem->serverfd = -1;
     }
+    if (mem->resume.callback) {
+	eventAdd("mem->resume.callback",
+	    mem->resume.callback,
+	    mem->resume.data,
+	    0.0,
+	    1);
+	mem->resume.callback = NULL;
+	mem->resume.data = NULL;
+    }
 }
 
 /* Reset defer state when FD goes away under our feets */
@@ -2126,6 +2164,9 @@ void
 storeResetDefer(StoreEntry * e)
 {
     EBIT_CLR(e->flags, ENTRY_DEFER_READ);
-    if (e->mem_obj)
+    if (e->mem_obj) {
 	e->mem_obj->serverfd = -1;
+	e->mem_obj->resume.callback = NULL;
+	e->mem_obj->resume.data = NULL;
+    }
 }
@@ -170,7 +170,7 @@ storeClientCopy(store_client * sc,
     void *data)
 {
     debug(20, 3) ("storeClientCopy: %s, seen %" PRINTF_OFF_T ", want %" PRINTF_OFF_T ", size %d, cb %p, cbdata %p\n",
-	storeKeyText(e->hash.key),
+	storeKeyText(e->key),
 	seen_offset,
 	copy_offset,
 	(int) size,
@@ -198,6 +198,44 @@ storeClientCopy(store_client * sc,
     storeClientCopy2(e, sc);
 }
 
+#if HAVE_SYS_UIO_H
+/*
+ * Like storeClientCopy, but for data already in memory and without the
+ * copy: returns the pages holding up to size bytes from copy_offset,
+ * pinned until stmemIovecFree().  Returns NULL if what the client wants
+ * is not in memory, for storeClientCopy to wait for it or read it from
+ * disk.
+ */
+mem_iovec *
+storeClientRef(store_client * sc, StoreEntry * e, squid_off_t copy_offset, size_t size)
+{
+    MemObject *mem = e->mem_obj;
+    mem_iovec *v;
+    assert(sc->callback == NULL);
+    assert(sc->entry == e);
+    if (EBIT_TEST(e->flags, ENTRY_FWD_HDR_WAIT))
+	return NULL;
+    if (STORE_DISK_CLIENT == sc->type && NULL == sc->swapin_sio)
+	return NULL;
+    if (copy_offset < mem->inmem_lo || copy_offset >= mem->inmem_hi)
+	return NULL;
+    debug(20, 3) ("storeClientRef: %s, want %" PRINTF_OFF_T ", size %d\n",
+	storeKeyText(e->key), copy_offset, (int) size);
+    sc->seen_offset = copy_offset;
+    sc->copy_offset = copy_offset;
+    if (EBIT_TEST(e->flags, ENTRY_DEFER_READ))
+	storeSwapOut(e);
+    v = memAllocate(MEM_MEM_IOVEC);
+    if (stmemRef(&mem->data_hdr, copy_offset, XMIN(size, mem->inmem_hi - copy_offset), v) <= 0) {
+	stmemIovecFree(v);
+	return NULL;
+    }
+    if (EBIT_TEST(e->flags, RELEASE_REQUEST))
+	storeSwapOutMaintainMemObject(e);
+    return v;
+}
+#endif
+
 /*
  * This function is used below to decide if we have any more data to
  * send to the client.  If the store_status is STORE_PENDING, then we
@@ -237,7 +275,7 @@ storeClientCopy2(StoreEntry * e, store_client * sc)
     }
     cbdataLock(sc);		/* ick, prevent sc from getting freed */
     sc->flags.store_copying = 1;
-    debug(20, 3) ("storeClientCopy2: %s\n", storeKeyText(e->hash.key));
+    debug(20, 3) ("storeClientCopy2: %s\n", storeKeyText(e->key));
     assert(sc->callback != NULL);
     /*
      * We used to check for ENTRY_ABORTED here.  But there were some
@@ -411,10 +449,10 @@ storeClientReadHeader(void *data, const char *buf, ssize_t len)
 	case STORE_META_KEY:
 	    assert(t->length == SQUID_MD5_DIGEST_LENGTH);
 	    if (!EBIT_TEST(e->flags, KEY_PRIVATE) &&
-		memcmp(t->value, e->hash.key, SQUID_MD5_DIGEST_LENGTH)) {
+		memcmp(t->value, e->key, SQUID_MD5_DIGEST_LENGTH)) {
 		debug(20, 2) ("storeClientReadHeader: swapin MD5 mismatch\n");
 		debug(20, 2) ("\t%s\n", storeKeyText(t->value));
-		debug(20, 2) ("\t%s\n", storeKeyText(e->hash.key));
+		debug(20, 2) ("\t%s\n", storeKeyText(e->key));
 		if (isPowTen(++md5_mismatches))
 		    debug(20, 1) ("WARNING: %d swapin MD5 mismatches\n",
 			md5_mismatches);
@@ -545,7 +583,7 @@ storeClientUnregister(store_client * sc, StoreEntry * e, void *owner)
     MemObject *mem = e->mem_obj;
     if (sc == NULL)
 	return 0;
-    debug(20, 3) ("storeClientUnregister: called for '%s'\n", storeKeyText(e->hash.key));
+    debug(20, 3) ("storeClientUnregister: called for '%s'\n", storeKeyText(e->key));
 #if STORE_CLIENT_LIST_DEBUG
     assert(sc == storeClientListSearch(e->mem_obj, owner));
 #endif
@@ -615,7 +653,7 @@ InvokeHandlers(StoreEntry * e)
     dlink_node *nx = NULL;
     dlink_node *node;
 
-    debug(20, 3) ("InvokeHandlers: %s\n", storeKeyText(e->hash.key));
+    debug(20, 3) ("InvokeHandlers: %s\n", storeKeyText(e->key));
     /* walk the entire list looking for valid callbacks */
     for (node = mem->clients.head; node; node = nx) {
 	sc = node->data;
@@ -652,6 +690,11 @@ CheckQuickAbort2(StoreEntry * entry)
 	debug(20, 3) ("CheckQuickAbort2: YES !mem->request->flags.cachable\n");
 	return 1;
     }
+    if (mem->request && mem->request->video.segment) {
+	/* at most video_segment_size to go, and the next viewer wants it */
+	debug(20, 3) ("CheckQuickAbort2: NO video segment\n");
+	return 0;
+    }
     expectlen = httpReplyBodySize(mem->method, mem->reply) + mem->reply->hdr_sz;
     curlen = mem->inmem_hi;
     if (expectlen == curlen) {
@@ -135,17 +135,17 @@ storeDigestDel(const StoreEntry * entry)
     }
     assert(entry && store_digest);
     debug(71, 6) ("storeDigestDel: checking entry, key: %s\n",
-	storeKeyText(entry->hash.key));
+	storeKeyText(entry->key));
     if (!EBIT_TEST(entry->flags, KEY_PRIVATE)) {
-	if (!cacheDigestTest(store_digest, entry->hash.key)) {
+	if (!cacheDigestTest(store_digest, entry->key)) {
 	    sd_stats.del_lost_count++;
 	    debug(71, 6) ("storeDigestDel: lost entry, key: %s url: %s\n",
-		storeKeyText(entry->hash.key), storeUrl(entry));
+		storeKeyText(entry->key), storeUrl(entry));
 	} else {
 	    sd_stats.del_count++;
-	    cacheDigestDel(store_digest, entry->hash.key);
+	    cacheDigestDel(store_digest, entry->key);
 	    debug(71, 6) ("storeDigestDel: deled entry, key: %s\n",
-		storeKeyText(entry->hash.key));
+		storeKeyText(entry->key));
 	}
     }
 #endif
@@ -187,7 +187,7 @@ storeDigestAddable(const StoreEntry * e)
     /* add some stats! XXX */
 
     debug(71, 6) ("storeDigestAddable: checking entry, key: %s\n",
-	storeKeyText(e->hash.key));
+	storeKeyText(e->key));
 
     /* check various entry flags (mimics storeCheckCachable XXX) */
     if (!EBIT_TEST(e->flags, ENTRY_CACHABLE)) {
@@ -245,14 +245,14 @@ storeDigestAdd(const StoreEntry * entry)
 
     if (storeDigestAddable(entry)) {
 	sd_stats.add_count++;
-	if (cacheDigestTest(store_digest, entry->hash.key))
+	if (cacheDigestTest(store_digest, entry->key))
 	    sd_stats.add_coll_count++;
-	cacheDigestAdd(store_digest, entry->hash.key);
+	cacheDigestAdd(store_digest, entry->key);
 	debug(71, 6) ("storeDigestAdd: added entry, key: %s\n",
-	    storeKeyText(entry->hash.key));
+	    storeKeyText(entry->key));
     } else {
 	sd_stats.rej_count++;
-	if (cacheDigestTest(store_digest, entry->hash.key))
+	if (cacheDigestTest(store_digest, entry->key))
 	    sd_stats.rej_coll_count++;
     }
 }
@@ -305,26 +305,26 @@ storeDigestRebuildFinish(void)
 	storeDigestRewriteResume();
 }
 
-/* recalculate a few hash buckets per invocation; schedules next step */
+/* recalculate a few store index slots per invocation; schedules next step */
 static void
 storeDigestRebuildStep(void *datanotused)
 {
-    int bcount = (int) ceil((double) store_hash_buckets *
+    int nslots = storeIndexSlots();
+    int bcount = (int) ceil((double) nslots *
 	(double) Config.digest.rebuild_chunk_percentage / 100.0);
     assert(sd_state.rebuild_lock);
-    if (sd_state.rebuild_offset + bcount > store_hash_buckets)
-	bcount = store_hash_buckets - sd_state.rebuild_offset;
-    debug(71, 3) ("storeDigestRebuildStep: buckets: %d offset: %d chunk: %d buckets\n",
-	store_hash_buckets, sd_state.rebuild_offset, bcount);
-    while (bcount--) {
-	hash_link *link_ptr = hash_get_bucket(store_table, sd_state.rebuild_offset);
-	for (; link_ptr; link_ptr = link_ptr->next) {
-	    storeDigestAdd((StoreEntry *) link_ptr);
-	}
+    if (sd_state.rebuild_offset + bcount > nslots)
+	bcount = nslots - sd_state.rebuild_offset;
+    debug(71, 3) ("storeDigestRebuildStep: slots: %d offset: %d chunk: %d slots\n",
+	nslots, sd_state.rebuild_offset, bcount);
+    while (bcount-- > 0) {
+	StoreEntry *e = storeIndexSlot(sd_state.rebuild_offset);
+	if (e)
+	    storeDigestAdd(e);
 	sd_state.rebuild_offset++;
     }
     /* are we done ? */
-    if (sd_state.rebuild_offset >= store_hash_buckets)
+    if (sd_state.rebuild_offset >= nslots)
 	storeDigestRebuildFinish();
     else
 	eventAdd("storeDigestRebuildStep", storeDigestRebuildStep, NULL, 0.0, 1);
@@ -354,7 +354,7 @@ storeDigestRewriteStart(void *datanotused)
     assert(e);
     sd_state.rewrite_lock = cbdataAlloc(generic_cbdata);
     sd_state.rewrite_lock->data = e;
-    debug(71, 3) ("storeDigestRewriteStart: url: %s key: %s\n", url, storeKeyText(e->hash.key));
+    debug(71, 3) ("storeDigestRewriteStart: url: %s key: %s\n", url, storeKeyText(e->key));
     e->mem_obj->request = requestLink(urlParse(METHOD_GET, url));
     /* wait for rebuild (if any) to finish */
     if (sd_state.rebuild_lock) {
@@ -397,7 +397,7 @@ storeDigestRewriteFinish(StoreEntry * e)
     storeComplete(e);
     storeTimestampsSet(e);
     debug(71, 2) ("storeDigestRewriteFinish: digest expires at %ld (%+d)\n",
-	(long int) e->expires, (int) (e->expires - squid_curtime));
+	(long int) storeTime(e->expires), (int) (storeTime(e->expires) - squid_curtime));
     /* is this the write order? @?@ */
     requestUnlink(e->mem_obj->request);
     e->mem_obj->request = NULL;
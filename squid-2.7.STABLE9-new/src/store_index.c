@@ -0,0 +1,221 @@
+/*
+ * $Id$
+ *
+ * DEBUG: section 20    Storage Manager Index
+ *
+ * SQUID Web Proxy Cache          http://www.squid-cache.org/
+ * ----------------------------------------------------------
+ *
+ *  Squid is the result of efforts by numerous individuals from
+ *  the Internet community; see the CONTRIBUTORS file for full
+ *  details.   Many organizations have provided support for Squid's
+ *  development; see the SPONSORS file for full details.  Squid is
+ *  Copyrighted (C) 2001 by the Regents of the University of
+ *  California; see the COPYRIGHT file for full details.  Squid
+ *  incorporates software developed and/or copyrighted by other
+ *  sources; see the CREDITS file for full details.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111, USA.
+ *
+ */
+
+/*
+ * The store index maps cache keys to StoreEntries.  It is an open
+ * addressing table of entry pointers with linear probing; the key
+ * itself lives in the StoreEntry.  MD5 keys are already well mixed,
+ * so the first key bytes pick the home slot.
+ *
+ * Deleting leaves a tombstone behind, so an entry never changes slot
+ * except when the whole table is rehashed.  Code walking the index
+ * across events can use storeIndexGeneration() to notice that.
+ */
+
+#include "squid.h"
+
+#define STORE_INDEX_MIN_SLOTS 0x2000
+
+static char store_index_tombstone;
+#define DELETED ((StoreEntry *) &store_index_tombstone)
+
+static StoreEntry **slots = NULL;
+static int nslots = 0;
+static int nentries = 0;
+static int ndeleted = 0;
+static int generation = 0;
+static struct {
+    double lookups;
+    double probes;
+} stats;
+
+static OBJH storeIndexStats;
+
+static int
+storeIndexFull(int used, int size)
+{
+    /* more than 3/4 of the slots taken */
+    return used > size - (size >> 2);
+}
+
+static void
+storeIndexPlace(StoreEntry ** table, int size, StoreEntry * e)
+{
+    unsigned int i = storeKeyHashHash(e->key, size);
+    while (table[i] != NULL)
+	i = (i + 1) & (size - 1);
+    table[i] = e;
+}
+
+static void
+storeIndexRehash(int size)
+{
+    StoreEntry **old = slots;
+    int old_size = nslots;
+    int i;
+    debug(20, 2) ("storeIndexRehash: %d entries, %d deleted, %d -> %d slots\n",
+	nentries, ndeleted, old_size, size);
+    slots = xcalloc(size, sizeof(*slots));
+    nslots = size;
+    for (i = 0; i < old_size; i++) {
+	if (old[i] != NULL && old[i] != DELETED)
+	    storeIndexPlace(slots, nslots, old[i]);
+    }
+    ndeleted = 0;
+    generation++;
+    safe_free(old);
+}
+
+void
+storeIndexInit(int nobjects)
+{
+    int size = STORE_INDEX_MIN_SLOTS;
+    while (storeIndexFull(nobjects, size))
+	size <<= 1;
+    slots = xcalloc(size, sizeof(*slots));
+    nslots = size;
+    debug(20, 1) ("Using %d Store index slots\n", nslots);
+    cachemgrRegister("store_index",
+	"Store Index Stats",
+	storeIndexStats, 0, 1);
+}
+
+void
+storeIndexFree(void)
+{
+    safe_free(slots);
+    nslots = nentries = ndeleted = 0;
+}
+
+StoreEntry *
+storeIndexGet(const cache_key * key)
+{
+    unsigned int i = storeKeyHashHash(key, nslots);
+    StoreEntry *e;
+    stats.lookups++;
+    while ((e = slots[i]) != NULL) {
+	stats.probes++;
+	if (e != DELETED && memcmp(e->key, key, SQUID_MD5_DIGEST_LENGTH) == 0)
+	    return e;
+	i = (i + 1) & (nslots - 1);
+    }
+    return NULL;
+}
+
+void
+storeIndexAdd(StoreEntry * e)
+{
+    unsigned int i;
+    assert(!e->hashed);
+    if (storeIndexFull(nentries + ndeleted + 1, nslots)) {
+	int size = nslots;
+	/* grow unless it is mostly tombstones that fill the table */
+	while (nentries + 1 > size >> 1)
+	    size <<= 1;
+	storeIndexRehash(size);
+    }
+    i = storeKeyHashHash(e->key, nslots);
+    while (slots[i] != NULL && slots[i] != DELETED)
+	i = (i + 1) & (nslots - 1);
+    if (slots[i] == DELETED)
+	ndeleted--;
+    slots[i] = e;
+    nentries++;
+    e->hashed = 1;
+}
+
+void
+storeIndexDelete(StoreEntry * e)
+{
+    unsigned int i;
+    if (!e->hashed)
+	return;
+    i = storeKeyHashHash(e->key, nslots);
+    while (slots[i] != e) {
+	assert(slots[i] != NULL);
+	i = (i + 1) & (nslots - 1);
+    }
+    if (slots[(i + 1) & (nslots - 1)] == NULL) {
+	/* end of a probe run, drop the tombstones leading up to it too */
+	slots[i] = NULL;
+	i = (i - 1) & (nslots - 1);
+	while (slots[i] == DELETED) {
+	    slots[i] = NULL;
+	    ndeleted--;
+	    i = (i - 1) & (nslots - 1);
+	}
+    } else {
+	slots[i] = DELETED;
+	ndeleted++;
+    }
+    nentries--;
+    e->hashed = 0;
+}
+
+int
+storeIndexSlots(void)
+{
+    return nslots;
+}
+
+/* The entry in slot 'n', or NULL if the slot is free */
+StoreEntry *
+storeIndexSlot(int n)
+{
+    StoreEntry *e = slots[n];
+    return e == DELETED ? NULL : e;
+}
+
+int
+storeIndexGeneration(void)
+{
+    return generation;
+}
+
+static void
+storeIndexStats(StoreEntry * sentry)
+{
+    double index_bytes = nentries ? (double) nslots * sizeof(*slots) / nentries : 0.0;
+    storeAppendPrintf(sentry, "Store index:\n");
+    storeAppendPrintf(sentry, "\tEntries: %d\n", nentries);
+    storeAppendPrintf(sentry, "\tSlots: %d (%.1f%% used, %d deleted)\n",
+	nslots, 100.0 * nentries / nslots, ndeleted);
+    storeAppendPrintf(sentry, "\tRehashes: %d\n", generation);
+    storeAppendPrintf(sentry, "\tProbes per lookup: %.2f\n",
+	stats.lookups > 0 ? stats.probes / stats.lookups : 0.0);
+    storeAppendPrintf(sentry, "\n");
+    storeAppendPrintf(sentry, "Bytes per object, without in-memory data:\n");
+    storeAppendPrintf(sentry, "\tStoreEntry: %d\n", (int) sizeof(StoreEntry));
+    storeAppendPrintf(sentry, "\tIndex: %.1f\n", index_bytes);
+    storeAppendPrintf(sentry, "\tTotal: %.1f\n", sizeof(StoreEntry) + index_bytes);
+}
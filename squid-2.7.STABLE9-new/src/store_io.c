@@ -119,6 +119,22 @@ storeUnlink(StoreEntry * e)
     SD->obj.unlink(SD, e);
 }
 
+/*
+ * The path of the file holding e on disk, or NULL if e is not swapped
+ * out or its cache_dir does not keep one file per object.
+ */
+char *
+storeSwapFilePath(const StoreEntry * e)
+{
+    SwapDir *SD;
+    if (e->swap_dirn < 0 || e->swap_filen < 0)
+	return NULL;
+    SD = INDEXSD(e->swap_dirn);
+    if (!SD->obj.path)
+	return NULL;
+    return SD->obj.path(SD, e->swap_filen, NULL);
+}
+
 void
 storeRecycle(StoreEntry * e)
 {
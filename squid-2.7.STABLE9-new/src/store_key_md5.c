@@ -109,38 +109,46 @@ storeKeyPrivate(const char *url, method_t method, int id)
     return digest;
 }
 
+/*
+ * Hash the video ID of url the way requestVideoClassify() spells it,
+ * without copying it out of the URL
+ */
+static void
+storeKeyVideoId(SQUID_MD5_CTX * M, const char *url, const videoId * id)
+{
+    unsigned int i;
+    SQUID_MD5Update(M, (unsigned char *) url + id->id.off, id->id.len);
+    for (i = 0; i < id->nkeep; i++) {
+	SQUID_MD5Update(M, (unsigned char *) (i ? "&" : "?"), 1);
+	SQUID_MD5Update(M, (unsigned char *) url + id->keep[i].off, id->keep[i].len);
+    }
+}
+
 const cache_key *
 storeKeyPublic(const char *url, const method_t method)
+{
+    return storeKeyPublicUrlRequest(url, method, NULL);
+}
+
+/*
+ * The public key of url as fetched by request, which decides along with
+ * the URL whether the video ID keys it (see videoCacheKeyed())
+ */
+const cache_key *
+storeKeyPublicUrlRequest(const char *url, const method_t method, const request_t * request)
 {
     static cache_key digest[SQUID_MD5_DIGEST_LENGTH];
     unsigned char m = (unsigned char) method;
-     debug(20, 1) ("storeKeyPublic: %s %s\n",RequestMethods[method].str, url);
-    char videoID[MAX_LEN];
-    char query_str[MAX_LEN];
-    int ret = -1;
-		memset(query_str, 0, sizeof(query_str));
-		memset(videoID, 0, sizeof(videoID));
-		ConvertCaseEX( (unsigned char *)query_str, (unsigned char *)url, strlen((const char *)url) );
-		ret = acsmSearch_cap(acsm_cap[1], (unsigned char *)query_str, strlen(query_str));
-		if ( ret>0 && ret<100) {
-			debug(20, 1)("The url: %s is in the AC exclusions list!\n", url);
-		}
-		else{
-			ret = acsmSearch_cap(acsm_cap[0], (unsigned char *)query_str, strlen(query_str));
-			if ( (ret-100) >=0) {
-				debug(20, 1)("The url: %s is in the AC keywords list!\n",url);
-				if(selectFunc(url,videoID,ret)){
-					url=videoID;
-				 	debug(20, 1)("video_cache_url:%s\n",url);
-		  	}
-			}
-		}	
+    videoId id;
     SQUID_MD5_CTX M;
+    debug(20, 3) ("storeKeyPublic: %s %s\n", RequestMethods[method].str, url);
     SQUID_MD5Init(&M);
     SQUID_MD5Update(&M, &m, sizeof(m));
-    SQUID_MD5Update(&M, (unsigned char *) url, strlen(url));
+    if (videoCacheClassify(url, &id) && videoCacheKeyed(&id, request))
+	storeKeyVideoId(&M, url, &id);
+    else
+	SQUID_MD5Update(&M, (unsigned char *) url, strlen(url));
     SQUID_MD5Final(digest, &M);
-    debug(20, 1) ("video digest: %s\n",storeKeyText(digest));
     return digest;
 }
 
@@ -157,35 +165,13 @@ storeKeyPublicByRequestMethod(request_t * request, const method_t method)
     unsigned char m = (unsigned char) method;
     const char *url;
     SQUID_MD5_CTX M;
-    if (request->store_url) {
-	  url = request->store_url;
-    } else {
-	  url = urlCanonical(request);
-		 debug(20, 1) ("Canonical_url:%s\n", url);
-	  }
-	  
-		char videoID[MAX_LEN];
-    char query_str[MAX_LEN];
-    int ret = -1;
-		memset(query_str, 0, sizeof(query_str));
-		memset(videoID, 0, sizeof(videoID));
-		if(strlen(url)<=MAX_LEN){
-			ConvertCaseEX((unsigned char *)query_str, (unsigned char *)url, strlen(url));
-			ret = acsmSearch_cap(acsm_cap[1], (unsigned char *)query_str, strlen(query_str));
-		}
-		if ( ret>0 && ret<100) {
-			printf("The url: %s is in the AC exclusions list!\n", url);
-		}
-		else{
-			ret = acsmSearch_cap(acsm_cap[0], (unsigned char *)query_str, strlen(query_str));
-			if ( (ret-100) >=0) {
-				debug(20, 1)("The url: %s is in the AC keywords list!\n",url);
-				if(selectFunc(url,videoID,ret)){
-					url=videoID;
-				 	debug(20, 1)("video_cache_url:%s\n",url);
-		  	}
-			}
-		}		 
+    requestVideoClassify(request);
+    if (request->video.id)
+	url = request->video.id;
+    else if (request->store_url)
+	url = request->store_url;
+    else
+	url = urlCanonical(request);
     SQUID_MD5Init(&M);
     SQUID_MD5Update(&M, &m, sizeof(m));
     SQUID_MD5Update(&M, (unsigned char *) url, strlen(url));
@@ -201,8 +187,15 @@ storeKeyPublicByRequestMethod(request_t * request, const method_t method)
 		SQUID_MD5Update(&M, (unsigned char *) "\0G", 2);
 		SQUID_MD5Update(&M, (unsigned char *) request->urlgroup, strlen(request->urlgroup));
     }
+    if (request->video.segment) {
+	/* the segment size too, so resizing does not mix old segments in */
+	char seg[64];
+	int n = snprintf(seg, sizeof(seg), "%lu:%d",
+	    (unsigned long) Config.videoCache.segmentSize, request->video.segment - 1);
+	SQUID_MD5Update(&M, (unsigned char *) "\0S", 2);
+	SQUID_MD5Update(&M, (unsigned char *) seg, n);
+    }
     SQUID_MD5Final(digest, &M);
-     debug(20, 1) ("youku match storeKeyPublicByRequestMethod digest: %s\n",storeKeyText(digest));
     return digest;
 }
 
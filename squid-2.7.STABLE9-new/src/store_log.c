@@ -71,7 +71,7 @@ storeLog(int tag, const StoreEntry * e)
 	    storeLogTags[tag],
 	    e->swap_dirn,
 	    e->swap_filen,
-	    storeKeyText(e->hash.key),
+	    storeKeyText(e->key),
 	    reply->sline.status,
 	    (long int) reply->date,
 	    (long int) reply->last_modified,
@@ -91,7 +91,7 @@ storeLog(int tag, const StoreEntry * e)
 	    storeLogTags[tag],
 	    e->swap_dirn,
 	    e->swap_filen,
-	    storeKeyText(e->hash.key));
+	    storeKeyText(e->key));
 	logfileLineEnd(storelog);
     }
 }
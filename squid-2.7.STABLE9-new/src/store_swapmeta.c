@@ -58,6 +58,37 @@ storeSwapTLVFree(tlv * n)
     }
 }
 
+/*
+ * STORE_META_STD keeps full time_t values on disk, the StoreEntry
+ * only has the 32-bit offsets
+ */
+void
+storeSwapMetaPackStd(const StoreEntry * e, storeMetaStd * std)
+{
+    memset(std, '\0', sizeof(*std));
+    std->timestamp = storeTime(e->timestamp);
+    std->lastref = storeTime(e->lastref);
+    std->expires = storeTime(e->expires);
+    std->lastmod = storeTime(e->lastmod);
+    std->swap_file_sz = e->swap_file_sz;
+    std->refcount = e->refcount;
+    std->flags = e->flags;
+}
+
+void
+storeSwapMetaUnpackStd(StoreEntry * e, const void *value)
+{
+    storeMetaStd std;
+    xmemcpy(&std, value, STORE_HDR_METASIZE);
+    e->timestamp = storeTimeRel(std.timestamp);
+    e->lastref = storeTimeRel(std.lastref);
+    e->expires = storeTimeRel(std.expires);
+    e->lastmod = storeTimeRel(std.lastmod);
+    e->swap_file_sz = std.swap_file_sz;
+    e->refcount = std.refcount;
+    e->flags = std.flags;
+}
+
 /*
  * Build a TLV list for a StoreEntry
  */
@@ -69,15 +100,17 @@ storeSwapMetaBuild(StoreEntry * e)
     const char *url;
     const char *vary;
     const squid_off_t objsize = objectLen(e);
+    storeMetaStd std;
     assert(e->mem_obj != NULL);
     assert(e->swap_status == SWAPOUT_WRITING);
     url = storeUrl(e);
     debug(20, 3) ("storeSwapMetaBuild: %s\n", url);
-    T = storeSwapTLVAdd(STORE_META_KEY, e->hash.key, SQUID_MD5_DIGEST_LENGTH, T);
+    T = storeSwapTLVAdd(STORE_META_KEY, e->key, SQUID_MD5_DIGEST_LENGTH, T);
+    storeSwapMetaPackStd(e, &std);
 #if SIZEOF_SQUID_FILE_SZ == SIZEOF_SIZE_T
-    T = storeSwapTLVAdd(STORE_META_STD, &e->timestamp, STORE_HDR_METASIZE, T);
+    T = storeSwapTLVAdd(STORE_META_STD, &std, STORE_HDR_METASIZE, T);
 #else
-    T = storeSwapTLVAdd(STORE_META_STD_LFS, &e->timestamp, STORE_HDR_METASIZE, T);
+    T = storeSwapTLVAdd(STORE_META_STD_LFS, &std, STORE_HDR_METASIZE, T);
 #endif
     T = storeSwapTLVAdd(STORE_META_URL, url, strlen(url) + 1, T);
     if (objsize > -1) {
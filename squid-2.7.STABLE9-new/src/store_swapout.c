@@ -228,7 +228,7 @@ storeSwapOut(StoreEntry * e)
     }
     if (e->store_status == STORE_PENDING) {
 	/* wait for a full block to write */
-	if (swapout_size < SM_PAGE_SIZE)
+	if (swapout_size < mem_page_size)
 	    return;
 	/*
 	 * Wait until we are below the disk FD limit, only if the
@@ -290,7 +290,7 @@ storeSwapOut(StoreEntry * e)
 	    break;
 	swapout_size = mem->inmem_hi - mem->swapout.queue_offset;
 	if (e->store_status == STORE_PENDING)
-	    if (swapout_size < SM_PAGE_SIZE)
+	    if (swapout_size < mem_page_size)
 		break;
     } while (swapout_size > 0);
     if (NULL == mem->swapout.sio)
@@ -313,7 +313,7 @@ storeSwapOutFileClose(StoreEntry * e)
     MemObject *mem = e->mem_obj;
     storeIOState *sio = mem->swapout.sio;
     assert(mem != NULL);
-    debug(20, 3) ("storeSwapOutFileClose: %s\n", storeKeyText(e->hash.key));
+    debug(20, 3) ("storeSwapOutFileClose: %s\n", storeKeyText(e->key));
     debug(20, 3) ("storeSwapOutFileClose: sio = %p\n", mem->swapout.sio);
     if (sio == NULL)
 	return;
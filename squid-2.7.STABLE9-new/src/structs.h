@@ -80,6 +80,21 @@ struct _acl_ip_data {
     acl_ip_data *next;		/* used for parsing, not for storing */
 };
 
+/*
+ * src/dst/myip ACL data. The splay tree holds the entries as
+ * configured; aclConfigure() compiles them into sorted, disjoint
+ * address ranges which aclMatchIp() searches without modifying.
+ */
+struct _acl_ip_list {
+    splayNode *tree;
+    int nranges;
+    u_int32_t *lo;		/* host byte order */
+    u_int32_t *hi;
+    int *index;			/* first range for each /16, large lists only */
+    acl_ip_data **odd;		/* entries with a non-contiguous netmask */
+    int nodd;
+};
+
 struct _acl_time_data {
     int weekbits;
     int start;
@@ -223,7 +238,7 @@ struct _acl_arp_data {
 
 struct _String {
     /* never reference these directly! */
-    unsigned short int size;	/* buffer size; 64K limit */
+    unsigned short int size;	/* buffer size; 64K limit; 0 if buf is borrowed */
     unsigned short int len;	/* current length  */
     char *buf;
 };
@@ -325,6 +340,18 @@ struct _wordlist {
     wordlist *next;
 };
 
+/*
+ * Where the video ID of a URL lies, plus the query parameters a keyword
+ * rule keeps in it.  The ID as a string is the ID span followed by the
+ * kept parameters joined as a query string.
+ */
+struct _videoId {
+    videoIdSpan id;
+    unsigned int nkeep;
+    videoIdSpan keep[ACSM_RULE_MAXALT];
+    squid_off_t seek;		/* pseudo-streaming offset, 0 if none */
+};
+
 struct _intlist {
     int i;
     intlist *next;
@@ -345,6 +372,7 @@ struct _relist {
     char *pattern;
     regex_t regex;
     relist *next;
+    RegexSet *set;		/* list head only, see aclMatchRegex() */
 };
 
 struct _acl_request_type {
@@ -376,6 +404,7 @@ struct _http_port_list {
 #endif
     unsigned int act_as_origin;	/* Fake Date: headers in accelerator mode */
     unsigned int allow_direct:1;	/* Allow direct forwarding in accelerator mode */
+    unsigned int worker:1;	/* requests from the other workers */
     struct {
 	unsigned int enabled;
 	unsigned int idle;
@@ -441,6 +470,7 @@ struct _SquidConfig {
 	int lowWaterMark;
     } Swap;
     squid_off_t memMaxSize;
+    squid_off_t memPageSize;
     struct {
 	squid_off_t min;
 	int pct;
@@ -658,6 +688,7 @@ struct _SquidConfig {
 	int log_fqdn;
 	int announce;
 	int mem_pools;
+	int mem_huge_pages;
 	int test_reachability;
 	int half_closed_clients;
 #if HTTP_VIOLATIONS
@@ -673,6 +704,7 @@ struct _SquidConfig {
 	int ignore_unknown_nameservers;
 	int server_http11;
 	int client_pconns;
+	int client_sendfile;
 	int server_pconns;
 	int error_pconns;
 #if USE_CACHE_DIGESTS
@@ -703,6 +735,7 @@ struct _SquidConfig {
 	int update_headers;
 	int ignore_expect_100;
 	int WIN32_IpAddrChangeMonitor;
+	int epoll_edge_triggered;
     } onoff;
     acl *aclList;
     struct {
@@ -840,8 +873,17 @@ struct _SquidConfig {
     time_t refresh_stale_window;
     int umask;
     int max_filedescriptors;
+    int workers;
     char *accept_filter;
     int incoming_rate;
+    struct {
+	char *keywords;
+	char *exclusions;
+	wordlist *modules;
+	int seek;
+	wordlist *seekParams;
+	squid_off_t segmentSize;
+    } videoCache;
 };
 
 struct _SquidConfig2 {
@@ -887,6 +929,12 @@ struct _CommWriteStateData {
     FREE *free_func;
     char header[32];
     size_t header_size;
+    int file;			/* send size bytes of this file instead of buf, or -1 */
+    squid_off_t file_offset;
+#if HAVE_SYS_UIO_H
+    struct iovec *iov;		/* or of these, advanced as they are written */
+    int iovcnt;
+#endif
 };
 
 
@@ -921,6 +969,9 @@ struct _fde {
 	unsigned int nodelay:1;
 	unsigned int close_on_exec:1;
 	unsigned int backoff:1;	/* keep track of whether the fd is backed off */
+	unsigned int stream:1;	/* TCP socket, all I/O done via comm/FD_*_METHOD */
+	unsigned int read_ready:1;	/* edge triggered: may have data to read */
+	unsigned int write_ready:1;	/* edge triggered: may have room to write */
     } flags;
     comm_pending read_pending;
     comm_pending write_pending;
@@ -1089,6 +1140,16 @@ struct _HttpHeaderEntry {
     int active;
     String name;
     String value;
+    HttpHeaderBlock *block;	/* parsed slices of name and value live here */
+};
+
+/* private copy of a parsed header block, shared by the entries using it */
+struct _HttpHeaderBlock {
+    int refcount;
+    size_t size;		/* as allocated, including this struct */
+    int capacity;
+    int used;
+    char *buf;
 };
 
 struct _HttpHeader {
@@ -1134,6 +1195,7 @@ struct _http_state_flags {
     unsigned int chunked:1;
     unsigned int trailer:1;
     unsigned int http11:1;
+    unsigned int worker:1;
 };
 
 struct _HttpStateData {
@@ -1238,6 +1300,7 @@ struct _clientHttpRequest {
     struct {
 	squid_off_t offset;
 	squid_off_t size;
+	int file;		/* swap file held open by clientSendFile() */
     } out;
     HttpReply *reply;		/* it is important for clientHttpRequest
 				 * to have its own HttpReply for
@@ -1265,6 +1328,7 @@ struct _clientHttpRequest {
 	unsigned int done_copying:1;
 	unsigned int purging:1;
 	unsigned int hit:1;
+	unsigned int sendfile:1;	/* out.file is open */
     } flags;
     struct {
 	http_status status;
@@ -1487,6 +1551,7 @@ struct _peer {
 	unsigned int carp:1;
 #endif
 	unsigned int http11:1;	/* HTTP/1.1 support */
+	unsigned int worker:1;	/* another worker's loopback port */
     } options;
     int weight;
     struct {
@@ -1660,18 +1725,33 @@ struct _iostats {
 };
 
 struct _mem_node {
-    char data[SM_PAGE_SIZE];
+    mem_node *next;
     int len;
     int uses;
-    mem_node *next;
+    char data[1];		/* to the end of its mem_page_size slot */
 };
 
 struct _mem_hdr {
     mem_node *head;
     mem_node *tail;
     squid_off_t origin_offset;
+    struct {
+	mem_node **node;	/* node[first + i] is page i from origin_offset */
+	int first;
+	int count;
+	int size;
+    } index;
 };
 
+#if HAVE_SYS_UIO_H
+/* a run of a mem_hdr as it lies in its pages, pinned while referenced */
+struct _mem_iovec {
+    int n;
+    struct iovec iov[MEM_IOVEC_MAX];
+    mem_node *node[MEM_IOVEC_MAX];
+};
+#endif
+
 /* keep track each client receiving data from that particular StoreEntry */
 struct _store_client {
     int type;
@@ -1700,8 +1780,16 @@ struct _store_client {
 
 /* Removal policies */
 
+/*
+ * Policies that chain entries on an intrusive list use u.prev and
+ * next, the others hang a private node off u.data.
+ */
 struct _RemovalPolicyNode {
-    void *data;
+    union {
+	void *data;
+	StoreEntry *prev;
+    } u;
+    StoreEntry *next;
 };
 
 struct _RemovalPolicy {
@@ -1742,6 +1830,10 @@ struct _MemObject {
     squid_off_t inmem_lo;
     int serverfd;		/* Record the server's fd if we have too much
 				 * data waiting to send to the client */
+    struct {
+	STABH *callback;
+	void *data;
+    } resume;			/* or a producer without one to call back */
     dlink_list clients;
     int nclients;
     struct {
@@ -1774,26 +1866,34 @@ struct _MemObject {
     time_t stale_while_revalidate;
 };
 
+/*
+ * One of these exists for every object in the cache, so keep it small.
+ * The key is held inline and the entry is found through the open
+ * addressing table in store_index.c.  Times are 32-bit offsets, read
+ * them with storeTime() and set them with storeTimeRel().
+ */
 struct _StoreEntry {
-    hash_link hash;		/* must be first */
+    cache_key key[SQUID_MD5_DIGEST_LENGTH];
     MemObject *mem_obj;
     RemovalPolicyNode repl;
-    /* START OF ON-DISK STORE_META_STD TLV field */
-    time_t timestamp;
-    time_t lastref;
-    time_t expires;
-    time_t lastmod;
+    /* STORE_META_STD fields, see storeSwapMetaPackStd() */
+    store_time_t timestamp;
+    store_time_t lastref;
+    store_time_t expires;
+    store_time_t lastmod;
     squid_file_sz swap_file_sz;
     u_short refcount;
     u_short flags;
-    /* END OF ON-DISK STORE_META_STD */
-    sfileno swap_filen:25;
-    sdirno swap_dirn:7;
-    u_short lock_count;		/* Assume < 65536! */
+    /* END OF STORE_META_STD */
+    sfileno swap_filen;
+    /* swap_dirn and the status bits share one 32-bit word */
+    sdirno swap_dirn:19;
+    unsigned int hashed:1;	/* key is valid and in the store index */
     mem_status_t mem_status:3;
     ping_status_t ping_status:3;
     store_status_t store_status:3;
     swap_status_t swap_status:3;
+    u_short lock_count;		/* Assume < 65536! */
 };
 
 struct _SwapDir {
@@ -1835,6 +1935,7 @@ struct _SwapDir {
 	STOBJWRITE *write;
 	STOBJUNLINK *unlink;
 	STOBJRECYCLE *recycle;
+	STOBJPATH *path;	/* swap file path, NULL if objects are not files */
     } obj;
     struct {
 	STLOGOPEN *open;
@@ -1890,6 +1991,8 @@ struct _request_flags {
     unsigned int cache_validation:1;	/* This request is an internal cache validation */
     unsigned int no_direct:1;	/* Deny direct forwarding unless overriden by always_direct. Used in accelerator mode */
     unsigned int chunked_response:1;	/* Send the response using chunked encoding */
+    unsigned int video_cache:1;	/* URL matched a video site keyword */
+    unsigned int worker:1;	/* forwarded by another worker */
 };
 
 struct _link_list {
@@ -1971,6 +2074,13 @@ struct _request_t {
     String x_forwarded_for_iterator;
 #endif				/* FOLLOW_X_FORWARDED_FOR */
     ConnStateData *pinned_connection;	/* If set then this request is tighly tied to the corresponding client side connetion */
+    struct {
+	int siteflag;		/* video site flag, 0 if not a video URL */
+	char *id;		/* extracted video ID, used as the store key URL */
+	unsigned int classified:1;
+	unsigned int seek:1;	/* range is a pseudo-streaming offset */
+	int segment;		/* segment number + 1 when fetching a segment */
+    } video;
 };
 
 struct _cachemgr_passwd {
@@ -2188,6 +2298,17 @@ struct _tlv {
     tlv *next;
 };
 
+/* The first STORE_HDR_METASIZE bytes are the STORE_META_STD TLV value */
+struct _storeMetaStd {
+    time_t timestamp;
+    time_t lastref;
+    time_t expires;
+    time_t lastmod;
+    squid_file_sz swap_file_sz;
+    u_short refcount;
+    u_short flags;
+};
+
 /*
  * Do we need to have the dirn in here? I don't think so, since we already
  * know the dirn .. 
@@ -40,6 +40,7 @@ typedef unsigned int ping_status_t;
 typedef unsigned int swap_status_t;
 typedef signed int sfileno;
 typedef signed int sdirno;
+typedef signed int store_time_t;
 
 #if LARGE_CACHE_FILES
 typedef squid_off_t squid_file_sz;
@@ -81,6 +82,7 @@ typedef struct _authScheme authScheme;
 typedef struct _acl_cert_data acl_cert_data;
 #endif
 typedef struct _acl_user_data acl_user_data;
+typedef struct _acl_ip_list acl_ip_list;
 typedef struct _acl_user_ip_data acl_user_ip_data;
 typedef struct _acl_arp_data acl_arp_data;
 typedef struct _acl_request_type acl_request_type;
@@ -92,10 +94,12 @@ typedef struct _acl_address acl_address;
 typedef struct _acl_tos acl_tos;
 typedef struct _aclCheck_t aclCheck_t;
 typedef struct _wordlist wordlist;
+typedef struct _videoId videoId;
 typedef struct _intlist intlist;
 typedef struct _intrange intrange;
 typedef struct _ushortlist ushortlist;
 typedef struct _relist relist;
+typedef struct _RegexSet RegexSet;
 typedef struct _sockaddr_in_list sockaddr_in_list;
 typedef struct _http_port_list http_port_list;
 typedef struct _https_port_list https_port_list;
@@ -119,6 +123,7 @@ typedef struct _HttpHdrRangeIter HttpHdrRangeIter;
 typedef struct _HttpHdrContRange HttpHdrContRange;
 typedef struct _TimeOrTag TimeOrTag;
 typedef struct _HttpHeaderEntry HttpHeaderEntry;
+typedef struct _HttpHeaderBlock HttpHeaderBlock;
 typedef struct _HttpHeaderFieldStat HttpHeaderFieldStat;
 typedef struct _HttpHeaderStat HttpHeaderStat;
 typedef struct _HttpBody HttpBody;
@@ -151,6 +156,9 @@ typedef struct _iostats iostats;
 typedef struct _MemBuf MemBuf;
 typedef struct _mem_node mem_node;
 typedef struct _mem_hdr mem_hdr;
+#if HAVE_SYS_UIO_H
+typedef struct _mem_iovec mem_iovec;
+#endif
 typedef struct _store_client store_client;
 typedef struct _MemObject MemObject;
 typedef struct _StoreEntry StoreEntry;
@@ -211,6 +219,7 @@ typedef struct _RemovalPolicy RemovalPolicy;
 typedef struct _RemovalPolicyWalker RemovalPolicyWalker;
 typedef struct _RemovalPurgeWalker RemovalPurgeWalker;
 typedef struct _RemovalPolicyNode RemovalPolicyNode;
+typedef struct _storeMetaStd storeMetaStd;
 typedef struct _RemovalPolicySettings RemovalPolicySettings;
 typedef struct _errormap errormap;
 typedef struct _PeerMonitor PeerMonitor;
@@ -303,6 +312,7 @@ typedef void STOBJREAD(SwapDir *, storeIOState *, char *, size_t, squid_off_t, S
 typedef void STOBJWRITE(SwapDir *, storeIOState *, char *, size_t, squid_off_t, FREE *);
 typedef void STOBJUNLINK(SwapDir *, StoreEntry *);
 typedef void STOBJRECYCLE(SwapDir *, StoreEntry *);
+typedef char *STOBJPATH(SwapDir *, sfileno, char *);
 
 typedef void STLOGOPEN(SwapDir *);
 typedef void STLOGCLOSE(SwapDir *);
@@ -0,0 +1,423 @@
+
+/*
+ * $Id$
+ *
+ * DEBUG: section 86    Video Cache
+ *
+ * SQUID Web Proxy Cache          http://www.squid-cache.org/
+ * ----------------------------------------------------------
+ *
+ *  Squid is the result of efforts by numerous individuals from
+ *  the Internet community; see the CONTRIBUTORS file for full
+ *  details.   Many organizations have provided support for Squid's
+ *  development; see the SPONSORS file for full details.  Squid is
+ *  Copyrighted (C) 2001 by the Regents of the University of
+ *  California; see the COPYRIGHT file for full details.  Squid
+ *  incorporates software developed and/or copyrighted by other
+ *  sources; see the CREDITS file for full details.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111, USA.
+ *
+ */
+
+#include "squid.h"
+#include <dlfcn.h>
+
+#define VIDEO_FLAG_MIN 100
+#define VIDEO_FLAG_MAX 999
+#define VIDEO_FLAG_OK(f) ((f) >= VIDEO_FLAG_MIN && (f) <= VIDEO_FLAG_MAX)
+
+typedef struct _videoExtractorModule videoExtractorModule;
+struct _videoExtractorModule {
+    char *path;
+    void *handle;
+    const videoregModule *mod;
+    videoExtractorModule *next;
+};
+
+/* FLV file header (audio and video) and PreviousTagSize0 sent ahead of a
+ * pseudo-streaming seek, which starts at a tag boundary in the file */
+const char videoFlvSeekHeader[13] =
+{'F', 'L', 'V', 1, 5, 0, 0, 0, 9, 0, 0, 0, 0};
+
+static videoExtractorModule *videoModules = NULL;
+/* extractors provided by modules, indexed by site flag; these take
+ * precedence over the ones built into libvideoreg */
+static pfFun videoExtractors[VIDEO_FLAG_MAX - VIDEO_FLAG_MIN + 1];
+static videoExtractorModule *videoExtractorOwner[VIDEO_FLAG_MAX - VIDEO_FLAG_MIN + 1];
+
+static int
+videoCacheExtract(const char *url, size_t len, videoIdSpan * id, int flag)
+{
+    if (VIDEO_FLAG_OK(flag) && videoExtractors[flag - VIDEO_FLAG_MIN])
+	return videoExtractors[flag - VIDEO_FLAG_MIN] (url, len, id);
+    return selectFunc(url, len, id, flag);
+}
+
+/*
+ * The value of the first seek parameter in the query of url, or -1.
+ * *param is set to the span of the whole name=value pair.
+ */
+static squid_off_t
+videoCacheSeekParam(const char *url, size_t len, videoIdSpan * param)
+{
+    const char *end = url + len;
+    const char *p, *e;
+    wordlist *w;
+    size_t l;
+    if ((p = memchr(url, '?', len)) == NULL)
+	return -1;
+    for (p++; p < end; p = e + 1) {
+	if ((e = memchr(p, '&', end - p)) == NULL)
+	    e = end;
+	for (w = Config.videoCache.seekParams; w; w = w->next) {
+	    l = strlen(w->key);
+	    if (l < (size_t) (e - p) && p[l] == '=' && strncmp(p, w->key, l) == 0) {
+		param->off = p - url;
+		param->len = e - p;
+		return strto_off_t(p + l + 1, NULL, 10);
+	    }
+	}
+    }
+    return -1;
+}
+
+/*
+ * Can a seek into url be served from the whole object?  Only FLV has
+ * byte offset seeking that a slice of the file answers.
+ */
+static int
+videoCacheCanSeek(const char *url, size_t len)
+{
+    const char *q = memchr(url, '?', len);
+    if (q)
+	len = q - url;
+    return Config.videoCache.seek && len >= 4 && strncasecmp(url + len - 4, ".flv", 4) == 0;
+}
+
+/*
+ * Classify a URL against the exclusion and keyword automata.
+ *
+ * Returns the keyword site flag (>= 100) when the URL belongs to a known
+ * video site, or 0 otherwise.  If the URL is not excluded and the
+ * keyword's rule, or failing that the site extractor, recognises it, id
+ * is set to where the video ID lies in the URL; otherwise id->id.len is
+ * 0.  Nothing is copied: the automata fold case themselves and the
+ * extractors return spans, so the URL is scanned in place whatever its
+ * length.  A rule picks up from where the keyword match ends, so the
+ * keyword pass is not repeated to find the ID.  A URL with a seek
+ * offset gets the ID of the whole video, with the offset in id->seek,
+ * when the offset can be served from it; otherwise it gets no ID.
+ */
+int
+videoCacheClassify(const char *url, videoId * id)
+{
+    int len = strlen(url);
+    int excluded = 0;
+    int ret, found;
+    ACSM_PATTERN *kw;
+    uint32_t end;
+
+    memset(id, 0, sizeof(*id));
+    if (len <= 0 || !acsm_cap[0])
+	return 0;
+    ret = acsm_cap[1] ? acsmSearch_cap(acsm_cap[1], (unsigned char *) url, len) : 0;
+    if (ret > 0 && ret < 100) {
+	debug(86, 3) ("videoCacheClassify: '%s' is in the exclusions list\n", url);
+	excluded = 1;
+    }
+    kw = acsmSearchBest(acsm_cap[0], (unsigned char *) url, len, &end);
+    if (!kw || kw->urlflag < 100)
+	return 0;
+    ret = kw->urlflag;
+    debug(86, 3) ("videoCacheClassify: '%s' matches site flag %d\n", url, ret);
+    if (excluded)
+	found = 0;
+    else if (kw->rule)
+	found = acsmRuleExtract(kw->rule, url, len, end, &id->id, id->keep, &id->nkeep);
+    else
+	found = videoCacheExtract(url, len, &id->id, ret);
+    if (found && id->id.off + id->id.len <= (size_t) len) {
+	videoIdSpan param;
+	id->seek = videoCacheSeekParam(url, len, &param);
+	if (id->seek > 0 && !videoCacheCanSeek(url, len)) {
+	    debug(86, 3) ("videoCacheClassify: can not seek to %" PRINTF_OFF_T " in the whole video\n", id->seek);
+	    memset(id, 0, sizeof(*id));
+	    return ret;
+	}
+	if (id->seek < 0)
+	    id->seek = 0;
+	debug(86, 3) ("videoCacheClassify: video ID '%.*s' (%u parameters kept, seek %" PRINTF_OFF_T ")\n",
+	    (int) id->id.len, url + id->id.off, id->nkeep, id->seek);
+    } else
+	memset(id, 0, sizeof(*id));
+    return ret;
+}
+
+/*
+ * Turn a pseudo-streaming request into a range request for the whole
+ * video: drop the seek parameter from the URL sent upstream and ask for
+ * the bytes from the offset on.
+ */
+static void
+videoCacheSeekRequest(request_t * request, squid_off_t seek)
+{
+    const char *path = strBuf(request->urlpath);
+    size_t len = strLen(request->urlpath);
+    String s = StringNull;
+    LOCAL_ARRAY(char, range, 64);
+    videoIdSpan p;
+
+    if (videoCacheSeekParam(path, len, &p) >= 0) {
+	if (path[p.off - 1] == '&' || p.off + p.len == len)
+	    p.off--;		/* with the separator before it */
+	p.len++;		/* or the one after it */
+	stringLimitInit(&s, path, p.off);
+	stringAppend(&s, path + p.off + p.len, len - p.off - p.len);
+	stringClean(&request->urlpath);
+	request->urlpath = s;
+	safe_free(request->canonical);
+    }
+    snprintf(range, 64, "bytes=%" PRINTF_OFF_T "-", seek);
+    stringInit(&s, range);
+    request->range = httpHdrRangeParseCreate(&s);
+    stringClean(&s);
+    if (request->range) {
+	request->flags.range = 1;
+	request->video.seek = 1;
+    }
+    debug(86, 3) ("videoCacheSeekRequest: fetching '%s' for offset %" PRINTF_OFF_T "\n",
+	urlCanonical(request), seek);
+}
+
+/*
+ * Should Range requests for this object be served from the whole
+ * object, fetched in full if need be, regardless of range_offset_limit?
+ */
+int
+videoCacheRangeFromFull(const request_t * request)
+{
+    return Config.videoCache.seek && request->video.id != NULL;
+}
+
+/*
+ * Does the video ID in id key the URL it was classified from?  A seek
+ * offset together with an explicit Range from the client cannot be
+ * served from the whole video, so such a request keeps its URL as the
+ * key.  request may be NULL when there are no request headers.
+ */
+int
+videoCacheKeyed(const videoId * id, const request_t * request)
+{
+    if (!id->id.len)
+	return 0;
+    if (id->seek && request && request->range && !request->video.seek)
+	return 0;
+    return 1;
+}
+
+/*
+ * Classify the request URL once and remember the verdict on the request.
+ * Must be called after any store URL rewrite has been applied, and after
+ * the request headers have been interpreted.
+ */
+void
+requestVideoClassify(request_t * request)
+{
+    videoId id;
+    const char *url;
+    char *p;
+    size_t sz;
+    unsigned int i;
+    if (request->video.classified)
+	return;
+    request->video.classified = 1;
+    url = request->store_url ? request->store_url : urlCanonical(request);
+    request->video.siteflag = videoCacheClassify(url, &id);
+    if (request->video.siteflag)
+	request->flags.video_cache = 1;
+    if (!videoCacheKeyed(&id, request)) {
+	if (id.id.len)
+	    debug(86, 3) ("requestVideoClassify: both a Range and a seek offset, not keyed by video ID\n");
+	return;
+    }
+    /* spelled the way storeKeyPublic() hashes it */
+    sz = id.id.len + 1;
+    for (i = 0; i < id.nkeep; i++)
+	sz += id.keep[i].len + 1;
+    p = request->video.id = xmalloc(sz);
+    memcpy(p, url + id.id.off, id.id.len);
+    p += id.id.len;
+    for (i = 0; i < id.nkeep; i++) {
+	*p++ = i ? '&' : '?';
+	memcpy(p, url + id.keep[i].off, id.keep[i].len);
+	p += id.keep[i].len;
+    }
+    *p = '\0';
+    if (id.seek)
+	videoCacheSeekRequest(request, id.seek);
+}
+
+static void
+videoCacheKeywordStats(StoreEntry * sentry)
+{
+    static const char *names[ACSM_NUM] =
+    {"Keywords", "Exclusions"};
+    ACSM_PATTERN *p;
+    int i;
+    for (i = 0; i < ACSM_NUM; i++) {
+	if (!acsm_cap[i])
+	    continue;
+	storeAppendPrintf(sentry, "%s: %u states, %lu bytes\n", names[i],
+	    acsm_cap[i]->acsmNumState + 1, (unsigned long) acsmMemSize(acsm_cap[i]));
+	storeAppendPrintf(sentry, "\t%-40s %6s %8s %10s %5s\n",
+	    "Pattern", "Flag", "Priority", "Hits", "Rule");
+	for (p = acsm_cap[i]->acsmPatterns; p; p = p->next)
+	    storeAppendPrintf(sentry, "\t%-40s %6u %8u %10u %5s\n",
+		(const char *) p->patrn_cap, p->urlflag, p->priority, p->nmatch,
+		p->rule ? "yes" : "no");
+	storeAppendPrintf(sentry, "\n");
+    }
+}
+
+static void
+videoCacheUnloadModules(void)
+{
+    videoExtractorModule *m;
+    memset(videoExtractors, 0, sizeof(videoExtractors));
+    memset(videoExtractorOwner, 0, sizeof(videoExtractorOwner));
+    while ((m = videoModules)) {
+	videoModules = m->next;
+	debug(86, 2) ("videoCacheUnloadModules: unloading '%s'\n", m->path);
+	dlclose(m->handle);
+	xfree(m->path);
+	xfree(m);
+    }
+}
+
+/*
+ * Load one extractor module and register its handlers.  A module is
+ * registered whole or not at all: any invalid or already claimed site
+ * flag rejects it.
+ */
+static void
+videoCacheLoadModule(const char *path)
+{
+    void *handle;
+    const videoregModule *mod;
+    const videoProcessHandler *h, *h2;
+    videoExtractorModule *m, **T;
+    int n = 0;
+    if ((handle = dlopen(path, RTLD_NOW | RTLD_LOCAL)) == NULL) {
+	debug(86, 0) ("WARNING: video_extractor_module: %s\n", dlerror());
+	return;
+    }
+    mod = dlsym(handle, VIDEOREG_MODULE_SYMBOL);
+    if (mod == NULL || mod->abi != VIDEOREG_MODULE_ABI || mod->handlers == NULL) {
+	debug(86, 0) ("WARNING: video_extractor_module: '%s' is not a libvideoreg module (ABI %d)\n",
+	    path, VIDEOREG_MODULE_ABI);
+	dlclose(handle);
+	return;
+    }
+    for (h = mod->handlers; h->siteflag; h++, n++) {
+	if (!VIDEO_FLAG_OK(h->siteflag) || h->handler == NULL) {
+	    debug(86, 0) ("WARNING: video_extractor_module: '%s' has an invalid handler for site flag %d\n",
+		path, h->siteflag);
+	    break;
+	}
+	if ((m = videoExtractorOwner[h->siteflag - VIDEO_FLAG_MIN])) {
+	    debug(86, 0) ("WARNING: video_extractor_module: '%s' site flag %d is already handled by '%s'\n",
+		path, h->siteflag, m->path);
+	    break;
+	}
+	for (h2 = mod->handlers; h2 < h; h2++)
+	    if (h2->siteflag == h->siteflag)
+		break;
+	if (h2 < h) {
+	    debug(86, 0) ("WARNING: video_extractor_module: '%s' lists site flag %d twice\n",
+		path, h->siteflag);
+	    break;
+	}
+    }
+    if (h->siteflag) {
+	dlclose(handle);
+	return;
+    }
+    m = xcalloc(1, sizeof(*m));
+    m->path = xstrdup(path);
+    m->handle = handle;
+    m->mod = mod;
+    for (T = &videoModules; *T; T = &(*T)->next);
+    *T = m;
+    for (h = mod->handlers; h->siteflag; h++) {
+	if (pf[h->siteflag - VIDEO_FLAG_MIN])
+	    debug(86, 1) ("video_extractor_module: '%s' replaces the built-in extractor for site flag %d\n",
+		path, h->siteflag);
+	videoExtractors[h->siteflag - VIDEO_FLAG_MIN] = h->handler;
+	videoExtractorOwner[h->siteflag - VIDEO_FLAG_MIN] = m;
+    }
+    debug(86, 1) ("Loaded video extractor module '%s' (%s, %d site flags)\n",
+	path, mod->name ? mod->name : "unnamed", n);
+}
+
+static void
+videoCacheExtractorStats(StoreEntry * sentry)
+{
+    videoExtractorModule *m;
+    int i;
+    storeAppendPrintf(sentry, "%6s %-20s %s\n", "Flag", "Extractor", "Module");
+    for (i = 0; i <= VIDEO_FLAG_MAX - VIDEO_FLAG_MIN; i++) {
+	if ((m = videoExtractorOwner[i]))
+	    storeAppendPrintf(sentry, "%6d %-20s %s\n", i + VIDEO_FLAG_MIN,
+		m->mod->name ? m->mod->name : "unnamed", m->path);
+	else if (pf[i])
+	    storeAppendPrintf(sentry, "%6d %-20s %s\n", i + VIDEO_FLAG_MIN,
+		"built-in", "libvideoreg");
+    }
+}
+
+/*
+ * (Re)load the keyword and exclusion automata and the extractor modules
+ * from the configuration.
+ * Called after every configuration parse; in-flight requests keep the
+ * verdict they already have.
+ */
+void
+videoCacheConfigure(void)
+{
+    wordlist *w;
+    if (init_acsm(0, Config.videoCache.keywords) < 0)
+	debug(86, 0) ("WARNING: Could not load video keywords from '%s'%s\n",
+	    Config.videoCache.keywords, acsm_cap[0] ? ", keeping the old list" : "");
+    if (init_acsm(1, Config.videoCache.exclusions) < 0)
+	debug(86, 0) ("WARNING: Could not load video exclusions from '%s'%s\n",
+	    Config.videoCache.exclusions, acsm_cap[1] ? ", keeping the old list" : "");
+    /* the old modules must go first, or dlopen() would hand back the
+     * objects already mapped instead of reading the files again */
+    videoCacheUnloadModules();
+    for (w = Config.videoCache.modules; w; w = w->next)
+	videoCacheLoadModule(w->key);
+}
+
+void
+videoCacheInit(void)
+{
+    cachemgrRegister("video_keywords",
+	"Video Cache Keyword Hits",
+	videoCacheKeywordStats, 0, 1);
+    cachemgrRegister("video_extractors",
+	"Video Cache ID Extractors",
+	videoCacheExtractorStats, 0, 1);
+}
@@ -0,0 +1,500 @@
+
+/*
+ * $Id$
+ *
+ * DEBUG: section 86    Video Cache
+ *
+ * SQUID Web Proxy Cache          http://www.squid-cache.org/
+ * ----------------------------------------------------------
+ *
+ *  Squid is the result of efforts by numerous individuals from
+ *  the Internet community; see the CONTRIBUTORS file for full
+ *  details.   Many organizations have provided support for Squid's
+ *  development; see the SPONSORS file for full details.  Squid is
+ *  Copyrighted (C) 2001 by the Regents of the University of
+ *  California; see the COPYRIGHT file for full details.  Squid
+ *  incorporates software developed and/or copyrighted by other
+ *  sources; see the CREDITS file for full details.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111, USA.
+ *
+ */
+
+#include "squid.h"
+
+/*
+ * A video keyed by video ID is cached as segments of video_segment_size
+ * bytes, each fetched from the origin with a Range request and stored as
+ * an object of its own under the video ID and the segment number (see
+ * storeKeyPublicByRequestMethod()).  The client is handed a private
+ * object which is filled in here, segment by segment, with the reply it
+ * asked for.  A segment in transit is completed whether or not the
+ * client stays (see CheckQuickAbort2()), so the part of a video that was
+ * watched stays cached.
+ */
+
+typedef struct _VideoSegState VideoSegState;
+struct _VideoSegState {
+    request_t *request;		/* the client's request */
+    StoreEntry *entry;		/* the client's reply, built here */
+    HttpHdrRange *range;	/* the client's Range, taken off the request */
+    squid_off_t offset;		/* next byte of the video to send */
+    squid_off_t end;		/* where to stop, -1 until the length is known */
+    squid_off_t length;		/* of the video, -1 until a segment says */
+    time_t lastmod;		/* of the first segment, the rest must agree */
+    char *etag;
+    int seg;			/* segment being copied */
+    squid_off_t seg_end;	/* where it ends in the video */
+    StoreEntry *sentry;		/* and its object */
+    store_client *sc;
+    squid_off_t soffset;	/* copy offset in sentry, 0 before its reply */
+    char *buf;
+    struct {
+	unsigned int headers:1;	/* the reply headers are in entry */
+	unsigned int seek:1;	/* the range is a pseudo-streaming seek */
+	unsigned int passthru:1;	/* sentry is not a segment, copy it whole */
+	unsigned int refresh:1;	/* the client wants no cached segments */
+	unsigned int refetch:1;	/* the cached segment did not fit */
+	unsigned int hit:1;	/* sentry was found in the cache */
+    } flags;
+};
+
+CBDATA_TYPE(VideoSegState);
+
+static STCB videoSegmentRead;
+static STABH videoSegmentResume;
+static STABH videoSegmentAbort;
+
+/*
+ * Can the request be served from segments?  Only plain GETs and single
+ * ranges with a start offset are; anything else gets the whole object.
+ */
+int
+videoSegmentable(const request_t * r)
+{
+    const HttpHdrRangeSpec *spec;
+    if (!Config.videoCache.segmentSize || !r->video.id)
+	return 0;
+    if (r->method != METHOD_GET || !r->flags.cachable || r->pinned_connection)
+	return 0;
+    if (r->range) {
+	if (r->range->specs.count != 1)
+	    return 0;
+	spec = r->range->specs.items[0];
+	if (spec->offset < 0)
+	    return 0;
+    }
+    return 1;
+}
+
+/*
+ * The request for the current segment: the client's, with a Range for
+ * the segment instead of its own and no conditionals, as the segment is
+ * cached whatever the client has.
+ */
+static request_t *
+videoSegmentRequest(const VideoSegState * vs)
+{
+    const request_t *request = vs->request;
+    squid_off_t start = (squid_off_t) vs->seg * Config.videoCache.segmentSize;
+    request_t *r = urlParse(METHOD_GET, (char *) urlCanonical(vs->request));
+    LOCAL_ARRAY(char, range, 64);
+    String s = StringNull;
+    HttpHdrRange *hr;
+    assert(r != NULL);
+    httpHeaderAppend(&r->header, &request->header);
+    httpHeaderDelById(&r->header, HDR_REQUEST_RANGE);
+    httpHeaderDelById(&r->header, HDR_IF_RANGE);
+    httpHeaderDelById(&r->header, HDR_IF_MODIFIED_SINCE);
+    httpHeaderDelById(&r->header, HDR_IF_NONE_MATCH);
+    httpHeaderDelById(&r->header, HDR_IF_MATCH);
+    snprintf(range, 64, "bytes=%" PRINTF_OFF_T "-%" PRINTF_OFF_T,
+	start, start + Config.videoCache.segmentSize - 1);
+    stringInit(&s, range);
+    hr = httpHdrRangeParseCreate(&s);
+    stringClean(&s);
+    httpHeaderPutRange(&r->header, hr);
+    httpHdrRangeDestroy(hr);
+    r->flags = request->flags;
+    r->flags.range = 0;
+    r->http_ver = request->http_ver;
+    r->client_addr = request->client_addr;
+    r->client_port = request->client_port;
+    r->my_addr = request->my_addr;
+    r->my_port = request->my_port;
+    if (request->urlgroup)
+	r->urlgroup = xstrdup(request->urlgroup);
+    r->video.siteflag = request->video.siteflag;
+    r->video.id = xstrdup(request->video.id);
+    r->video.classified = 1;
+    r->video.segment = vs->seg + 1;
+    return r;
+}
+
+/*
+ * Find the current segment in the cache, or start fetching it.
+ */
+static void
+videoSegmentOpen(VideoSegState * vs)
+{
+    request_t *r = requestLink(videoSegmentRequest(vs));
+    StoreEntry *e = NULL;
+    if (!vs->flags.refresh && !vs->flags.refetch)
+	e = storeGetPublicByRequest(r);
+    if (e && !storeEntryValidToSend(e))
+	e = NULL;
+    if (e && e->store_status == STORE_OK && refreshCheckHTTP(e, r)) {
+	debug(86, 3) ("videoSegmentOpen: segment %d of '%s' is stale\n",
+	    vs->seg, r->video.id);
+	e = NULL;
+    }
+    vs->flags.refetch = 0;
+    vs->flags.hit = e != NULL;
+    if (e) {
+	debug(86, 3) ("videoSegmentOpen: segment %d of '%s' is cached\n",
+	    vs->seg, r->video.id);
+	storeLockObject(e);
+	storeCreateMemObject(e, urlCanonical(r));
+	e->mem_obj->method = METHOD_GET;
+	vs->sc = storeClientRegister(e, vs);
+    } else {
+	debug(86, 3) ("videoSegmentOpen: fetching segment %d of '%s'\n",
+	    vs->seg, r->video.id);
+	e = storeCreateEntry(urlCanonical(r), r->flags, METHOD_GET);
+	vs->sc = storeClientRegister(e, vs);
+	if (Config.onoff.collapsed_forwarding) {
+	    e->mem_obj->refresh_timestamp = squid_curtime;
+	    e->mem_obj->request = requestLink(r);
+	    EBIT_SET(e->flags, KEY_EARLY_PUBLIC);
+	    storeSetPublicKey(e);
+	}
+	fwdStart(-1, e, r);
+    }
+    vs->sentry = e;
+    vs->soffset = 0;
+    requestUnlink(r);
+}
+
+static void
+videoSegmentClose(VideoSegState * vs)
+{
+    store_client *sc = vs->sc;
+    if (sc == NULL)
+	return;
+    vs->sc = NULL;		/* a pending copy is called back, and ignored */
+    storeClientUnregister(sc, vs->sentry, vs);
+    storeUnlockObject(vs->sentry);
+    vs->sentry = NULL;
+}
+
+static void
+videoSegmentDone(VideoSegState * vs)
+{
+    MemObject *mem = vs->entry->mem_obj;
+    videoSegmentClose(vs);
+    storeUnregisterAbort(vs->entry);
+    if (mem->resume.data == vs) {
+	mem->resume.callback = NULL;
+	mem->resume.data = NULL;
+    }
+    storeUnlockObject(vs->entry);
+    if (vs->range)
+	httpHdrRangeDestroy(vs->range);
+    safe_free(vs->etag);
+    requestUnlink(vs->request);
+    memFree(vs->buf, MEM_STORE_CLIENT_BUF);
+    cbdataFree(vs);
+}
+
+static void
+videoSegmentComplete(VideoSegState * vs)
+{
+    debug(86, 3) ("videoSegmentComplete: '%s' done\n", vs->request->video.id);
+    storeComplete(vs->entry);
+    videoSegmentDone(vs);
+}
+
+static void
+videoSegmentFail(VideoSegState * vs)
+{
+    storeUnregisterAbort(vs->entry);
+    if (vs->flags.headers)
+	storeAbort(vs->entry);
+    else
+	errorAppendEntry(vs->entry, errorCon(ERR_READ_ERROR, HTTP_BAD_GATEWAY, vs->request));
+    videoSegmentDone(vs);
+}
+
+/*
+ * Copy the next chunk of the segment, unless the client has enough to
+ * chew on already.
+ */
+static void
+videoSegmentCopy(VideoSegState * vs)
+{
+    MemObject *mem = vs->entry->mem_obj;
+    if (vs->flags.headers && mem->inmem_hi - storeLowestMemReaderOffset(vs->entry) > Config.readAheadGap) {
+	storeDeferProducer(vs->entry, videoSegmentResume, vs);
+	return;
+    }
+    storeClientCopy(vs->sc, vs->sentry,
+	vs->soffset,
+	vs->soffset,
+	STORE_CLIENT_BUF_SZ,
+	vs->buf,
+	videoSegmentRead,
+	vs);
+}
+
+static void
+videoSegmentResume(void *data)
+{
+    VideoSegState *vs = data;
+    if (EBIT_TEST(vs->entry->flags, ENTRY_ABORTED))
+	return;
+    videoSegmentCopy(vs);
+}
+
+static void
+videoSegmentAbort(void *data)
+{
+    VideoSegState *vs = data;
+    debug(86, 3) ("videoSegmentAbort: '%s' aborted at %" PRINTF_OFF_T ", keeping segment %d\n",
+	vs->request->video.id, vs->offset, vs->seg);
+    videoSegmentDone(vs);
+}
+
+/*
+ * Start the client's reply: the first segment's headers, made into
+ * those of the whole video or of the range asked for.
+ */
+static void
+videoSegmentHeaders(VideoSegState * vs, const HttpReply * rep)
+{
+    HttpReply *reply = httpReplyClone((HttpReply *) rep);
+    HttpHdrRangeSpec spec;
+    http_status status = HTTP_OK;
+    squid_off_t clen = vs->end - vs->offset;
+    httpHeaderDelById(&reply->header, HDR_CONTENT_RANGE);
+    if (reply->content_range) {
+	httpHdrContRangeDestroy(reply->content_range);
+	reply->content_range = NULL;
+    }
+    if (vs->flags.seek) {
+	clen += sizeof(videoFlvSeekHeader);
+    } else if (vs->range) {
+	spec.offset = vs->offset;
+	spec.length = clen;
+	httpHeaderAddContRange(&reply->header, spec, vs->length);
+	reply->content_range = httpHeaderGetContRange(&reply->header);
+	status = HTTP_PARTIAL_CONTENT;
+    }
+    httpHeaderDelById(&reply->header, HDR_CONTENT_LENGTH);
+    httpHeaderPutSize(&reply->header, HDR_CONTENT_LENGTH, clen);
+    reply->content_length = clen;
+    httpStatusLineSet(&reply->sline, reply->sline.version, status, NULL);
+    httpReplySwapOut(reply, vs->entry);
+    if (vs->flags.seek)
+	storeAppend(vs->entry, videoFlvSeekHeader, sizeof(videoFlvSeekHeader));
+    storeBufferFlush(vs->entry);
+    vs->flags.headers = 1;
+}
+
+/*
+ * Hand the client whatever came back instead of a segment, as the
+ * client side would have: with its Range back, to be applied there.
+ */
+static void
+videoSegmentPassThru(VideoSegState * vs, const HttpReply * rep)
+{
+    debug(86, 2) ("videoSegmentPassThru: '%s' segment %d came back as %d, passed on uncached\n",
+	vs->request->video.id, vs->seg, rep->sline.status);
+    vs->flags.passthru = 1;
+    vs->request->range = vs->range;
+    vs->range = NULL;
+    httpReplySwapOut(httpReplyClone((HttpReply *) rep), vs->entry);
+    storeBufferFlush(vs->entry);
+    vs->flags.headers = 1;
+    vs->soffset = rep->hdr_sz;
+    videoSegmentCopy(vs);
+}
+
+static void
+videoSegmentRefetch(VideoSegState * vs)
+{
+    debug(86, 2) ("videoSegmentRefetch: cached segment %d of '%s' does not fit, fetching it again\n",
+	vs->seg, vs->request->video.id);
+    storeRelease(vs->sentry);
+    videoSegmentClose(vs);
+    vs->flags.refetch = 1;
+    videoSegmentOpen(vs);
+    videoSegmentCopy(vs);
+}
+
+/*
+ * Check the reply of the current segment against the video so far.
+ */
+static void
+videoSegmentReply(VideoSegState * vs, const HttpReply * rep)
+{
+    const HttpHdrContRange *cr = rep->content_range;
+    squid_off_t start = (squid_off_t) vs->seg * Config.videoCache.segmentSize;
+    const char *etag = httpHeaderGetStr(&rep->header, HDR_ETAG);
+    if (rep->sline.status != HTTP_PARTIAL_CONTENT || cr == NULL || cr->elength < 0 ||
+	cr->spec.offset != start ||
+	cr->spec.length != XMIN(Config.videoCache.segmentSize, cr->elength - start)) {
+	if (vs->flags.hit && rep->sline.status == HTTP_PARTIAL_CONTENT)
+	    videoSegmentRefetch(vs);
+	else if (!vs->flags.headers)
+	    videoSegmentPassThru(vs, rep);
+	else
+	    videoSegmentFail(vs);
+	return;
+    }
+    if (vs->length >= 0 && (cr->elength != vs->length || rep->last_modified != vs->lastmod ||
+	    strcmp(etag ? etag : "", vs->etag ? vs->etag : "") != 0)) {
+	debug(86, 2) ("videoSegmentReply: segment %d of '%s' is of another version\n",
+	    vs->seg, vs->request->video.id);
+	if (vs->flags.hit)
+	    videoSegmentRefetch(vs);
+	else
+	    videoSegmentFail(vs);
+	return;
+    }
+    vs->seg_end = start + cr->spec.length;
+    if (!vs->flags.headers) {
+	vs->length = cr->elength;
+	vs->lastmod = rep->last_modified;
+	vs->etag = etag ? xstrdup(etag) : NULL;
+	if (vs->offset >= vs->length) {
+	    /* as the client side does with a bad range: send it all */
+	    debug(86, 3) ("videoSegmentReply: '%s' offset %" PRINTF_OFF_T " is past the end\n",
+		vs->request->video.id, vs->offset);
+	    if (vs->range)
+		httpHdrRangeDestroy(vs->range);
+	    vs->range = NULL;
+	    vs->flags.seek = 0;
+	    vs->offset = 0;
+	    vs->end = -1;
+	    if (vs->seg) {
+		videoSegmentClose(vs);
+		vs->seg = 0;
+		videoSegmentOpen(vs);
+		videoSegmentCopy(vs);
+		return;
+	    }
+	}
+	if (vs->end < 0 || vs->end > vs->length)
+	    vs->end = vs->length;
+	videoSegmentHeaders(vs, rep);
+	if (EBIT_TEST(vs->entry->flags, ENTRY_ABORTED))
+	    return;
+    }
+    vs->soffset = rep->hdr_sz + vs->offset - start;
+    videoSegmentCopy(vs);
+}
+
+static void
+videoSegmentRead(void *data, char *buf, ssize_t size)
+{
+    VideoSegState *vs = data;
+    MemObject *mem;
+    squid_off_t stop;
+    size_t n;
+    if (vs->sc == NULL)
+	return;			/* being closed */
+    if (EBIT_TEST(vs->entry->flags, ENTRY_ABORTED))
+	return;			/* videoSegmentAbort() is on its way */
+    mem = vs->sentry->mem_obj;
+    if (vs->soffset == 0) {
+	if (size < 0 || !memHaveHeaders(mem)) {
+	    debug(86, 1) ("videoSegmentRead: no reply for segment %d of '%s'\n",
+		vs->seg, vs->request->video.id);
+	    videoSegmentFail(vs);
+	} else
+	    videoSegmentReply(vs, mem->reply);
+	return;
+    }
+    if (size <= 0) {
+	if (size == 0 && vs->flags.passthru) {
+	    videoSegmentComplete(vs);
+	} else {
+	    debug(86, 1) ("videoSegmentRead: segment %d of '%s' ended early\n",
+		vs->seg, vs->request->video.id);
+	    videoSegmentFail(vs);
+	}
+	return;
+    }
+    n = size;
+    if (!vs->flags.passthru) {
+	stop = XMIN(vs->seg_end, vs->end);
+	if ((squid_off_t) n > stop - vs->offset)
+	    n = stop - vs->offset;
+    }
+    storeAppend(vs->entry, buf, n);
+    vs->offset += n;
+    vs->soffset += n;
+    if (EBIT_TEST(vs->entry->flags, ENTRY_ABORTED))
+	return;
+    if (vs->flags.passthru) {
+	videoSegmentCopy(vs);
+    } else if (vs->offset >= vs->end) {
+	videoSegmentComplete(vs);
+    } else if (vs->offset >= vs->seg_end) {
+	videoSegmentClose(vs);
+	vs->seg++;
+	videoSegmentOpen(vs);
+	videoSegmentCopy(vs);
+    } else {
+	videoSegmentCopy(vs);
+    }
+}
+
+/*
+ * Fill entry with the reply to request from the video's segments.
+ * Returns true if the first segment needed was cached.
+ */
+int
+videoSegmentStart(request_t * request, StoreEntry * entry)
+{
+    VideoSegState *vs;
+    const HttpHdrRangeSpec *spec;
+    CBDATA_INIT_TYPE(VideoSegState);
+    vs = cbdataAlloc(VideoSegState);
+    vs->request = requestLink(request);
+    vs->entry = entry;
+    storeLockObject(entry);
+    vs->end = vs->length = -1;
+    vs->buf = memAllocate(MEM_STORE_CLIENT_BUF);
+    vs->flags.refresh = request->flags.nocache;
+    if (request->range) {
+	/* answered here; the client side gets the reply as it is */
+	spec = request->range->specs.items[0];
+	vs->offset = spec->offset;
+	if (spec->length >= 0)
+	    vs->end = spec->offset + spec->length;
+	vs->range = request->range;
+	vs->flags.seek = request->video.seek;
+	request->range = NULL;
+    }
+    vs->seg = vs->offset / Config.videoCache.segmentSize;
+    debug(86, 3) ("videoSegmentStart: '%s' from %" PRINTF_OFF_T " in segment %d\n",
+	request->video.id, vs->offset, vs->seg);
+    storeRegisterAbort(entry, videoSegmentAbort, vs);
+    videoSegmentOpen(vs);
+    /* the caller has yet to note whether this was a hit */
+    eventAdd("videoSegmentResume", videoSegmentResume, vs, 0.0, 1);
+    return vs->flags.hit;
+}
@@ -0,0 +1,535 @@
+/*
+ * $Id$
+ *
+ * DEBUG: section 87    SMP Workers
+ *
+ * SQUID Web Proxy Cache          http://www.squid-cache.org/
+ * ----------------------------------------------------------
+ *
+ *  Squid is the result of efforts by numerous individuals from
+ *  the Internet community; see the CONTRIBUTORS file for full
+ *  details.   Many organizations have provided support for Squid's
+ *  development; see the SPONSORS file for full details.  Squid is
+ *  Copyrighted (C) 2001 by the Regents of the University of
+ *  California; see the COPYRIGHT file for full details.  Squid
+ *  incorporates software developed and/or copyrighted by other
+ *  sources; see the CREDITS file for full details.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111, USA.
+ *
+ */
+
+#include "squid.h"
+
+/*
+ * With more than one worker configured, the process started forks the
+ * workers and stays behind to restart them and to pass signals on.
+ * Each worker is a whole Squid with its share of cache_mem and of each
+ * cache_dir, the latter in a subdirectory of its own, and accepts on
+ * http_port sockets bound with SO_REUSEPORT so the kernel spreads the
+ * connections over the workers.
+ *
+ * So that an object cached by one worker is a hit for all of them, the
+ * workers share an index of the public store keys each of them holds.
+ * A worker without an object another one has forwards the request to
+ * that worker's loopback port, as to a proxy-only parent.  Every worker
+ * writes only its own table of the index, and the others only read it,
+ * so no locking is needed: the index is a hint, and a stale entry costs
+ * no more than a forwarded miss.
+ *
+ * The loopback port is open to anyone on the host, so a forwarded
+ * request carries a secret picked when the workers are started, and
+ * the address of the client it came from.  Without the secret it is
+ * just another request from 127.0.0.1.  Either way http_access and the
+ * forwarding loop check apply as on any other port.
+ */
+
+#define WORKERS_MAX 64
+#define WORKER_INDEX_PROBES 16
+#define WORKER_SLOT_EMPTY 0
+#define WORKER_SLOT_DELETED 1
+#define WORKER_HEADER "X-Squid-Worker"
+#define WORKER_SECRET_LEN 32
+
+typedef struct {
+    int workers;
+    int slots;			/* of each worker's table, a power of two */
+    char secret[WORKER_SECRET_LEN + 1];	/* vouches for forwarded requests */
+    struct {
+	pid_t pid;
+	u_short port;		/* the loopback port for the other workers */
+	int entries;
+    } worker[WORKERS_MAX + 1];
+} WorkerIndex;
+
+static WorkerIndex *worker_index = NULL;
+static uint64_t *worker_table[WORKERS_MAX + 1];
+static peer *worker_peer[WORKERS_MAX + 1];
+static pid_t worker_master = 0;
+static int worker_forwarded = 0;
+static volatile int workers_signal = 0;
+
+static uint64_t
+workerIndexKey(const cache_key * key)
+{
+    uint64_t k;
+    xmemcpy(&k, key, sizeof(k));
+    return k > WORKER_SLOT_DELETED ? k : k + 2;
+}
+
+/* A fresh secret for this start, in hex */
+static void
+workerSecretCreate(char *secret)
+{
+    unsigned char buf[WORKER_SECRET_LEN / 2];
+    int fd, i;
+    int n = 0;
+    if ((fd = open("/dev/urandom", O_RDONLY)) >= 0) {
+	n = read(fd, buf, sizeof(buf));
+	close(fd);
+    }
+    if (n != sizeof(buf)) {
+	debug(87, 1) ("workers: /dev/urandom is not available, using squid_random()\n");
+	squid_srandom(time(NULL) ^ getpid());
+	for (i = 0; i < sizeof(buf); i++)
+	    buf[i] = squid_random() >> 7;
+    }
+    for (i = 0; i < sizeof(buf); i++)
+	snprintf(secret + 2 * i, 3, "%02x", buf[i]);
+}
+
+/* Map the index, shared by the workers forked after */
+static void
+workerIndexCreate(void)
+{
+    size_t hdr = (sizeof(WorkerIndex) + 63) & ~63;
+    double objects = (double) Config.Swap.maxSize / Config.Store.avgObjectSize / Config.workers;
+    int slots = 1024;
+    size_t size;
+    int k;
+    while (slots < 2 * objects && slots < (1 << 28))
+	slots <<= 1;
+    size = hdr + (size_t) slots * Config.workers * sizeof(uint64_t);
+#if HAVE_SYS_MMAN_H
+    worker_index = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (worker_index == MAP_FAILED)
+	fatalf("workers: can not map %d KB for the shared cache index: %s\n",
+	    (int) (size >> 10), xstrerror());
+#else
+    fatal("workers: shared memory is not supported on this platform");
+#endif
+    worker_index->workers = Config.workers;
+    worker_index->slots = slots;
+    workerSecretCreate(worker_index->secret);
+    for (k = 1; k <= Config.workers; k++)
+	worker_table[k] = (uint64_t *) ((char *) worker_index + hdr) + (size_t) (k - 1) * slots;
+    debug(87, 1) ("Shared cache index of %d entries for each of %d workers\n",
+	slots, Config.workers);
+}
+
+void
+workerIndexAdd(const cache_key * key)
+{
+    uint64_t k, *t;
+    int i, s, mask, slot = -1;
+    if (!worker_id)
+	return;
+    k = workerIndexKey(key);
+    t = worker_table[worker_id];
+    mask = worker_index->slots - 1;
+    for (i = 0, s = k & mask; i < WORKER_INDEX_PROBES; i++, s = (s + 1) & mask) {
+	if (t[s] == k)
+	    return;
+	if (t[s] <= WORKER_SLOT_DELETED && slot < 0)
+	    slot = s;
+	if (t[s] == WORKER_SLOT_EMPTY)
+	    break;
+    }
+    if (slot < 0)
+	return;			/* the others will miss it */
+    t[slot] = k;
+    worker_index->worker[worker_id].entries++;
+}
+
+void
+workerIndexDelete(const cache_key * key)
+{
+    uint64_t k, *t;
+    int i, s, mask;
+    if (!worker_id)
+	return;
+    k = workerIndexKey(key);
+    t = worker_table[worker_id];
+    mask = worker_index->slots - 1;
+    for (i = 0, s = k & mask; i < WORKER_INDEX_PROBES && t[s] != WORKER_SLOT_EMPTY; i++, s = (s + 1) & mask) {
+	if (t[s] == k) {
+	    t[s] = WORKER_SLOT_DELETED;
+	    worker_index->worker[worker_id].entries--;
+	    return;
+	}
+    }
+}
+
+/* The other worker holding key, or 0 */
+static int
+workerIndexFind(const cache_key * key)
+{
+    uint64_t k = workerIndexKey(key);
+    uint64_t *t;
+    int w, i, s;
+    int mask = worker_index->slots - 1;
+    for (w = 1; w <= worker_index->workers; w++) {
+	if (w == worker_id || !worker_index->worker[w].port)
+	    continue;
+	t = worker_table[w];
+	for (i = 0, s = k & mask; i < WORKER_INDEX_PROBES && t[s] != WORKER_SLOT_EMPTY; i++, s = (s + 1) & mask)
+	    if (t[s] == k)
+		return w;
+    }
+    return 0;
+}
+
+static peer *
+workerPeer(int w)
+{
+    peer *p = worker_peer[w];
+    char name[32];
+    if (p == NULL) {
+	p = worker_peer[w] = cbdataAlloc(peer);
+	snprintf(name, sizeof(name), "worker%d", w);
+	p->host = xstrdup(inet_ntoa(local_addr));
+	p->name = xstrdup(name);
+	p->type = PEER_PARENT;
+	p->weight = 1;
+	p->stats.logged_state = PEER_ALIVE;
+	p->monitor.state = PEER_ALIVE;
+	p->tcp_up = PEER_TCP_MAGIC_COUNT;
+	p->connection_auth = -1;
+	p->options.proxy_only = 1;
+	p->options.no_query = 1;
+	p->options.no_digest = 1;
+	p->options.no_netdb_exchange = 1;
+	p->options.worker = 1;
+	p->login = xstrdup("PASS");	/* for proxy_auth in http_access there */
+	p->icp.version = ICP_VERSION_CURRENT;
+	p->test_fd = -1;
+	p->addresses[0] = local_addr;
+	p->n_addresses = 1;
+    }
+    p->http_port = worker_index->worker[w].port;
+    return p;
+}
+
+/*
+ * The worker to forward request to, if another one has the object.
+ * Requests forwarded by a worker are never forwarded again, nor are
+ * those with connection oriented authentication, which is bound to
+ * the client connection.
+ */
+peer *
+workerPeerSelect(request_t * request)
+{
+    int w;
+    if (!worker_id || request->flags.worker || !request->flags.cachable)
+	return NULL;
+    if (request->flags.connection_auth || request->flags.connection_proxy_auth)
+	return NULL;
+    if (request->method != METHOD_GET && request->method != METHOD_HEAD)
+	return NULL;
+    if ((w = workerIndexFind(storeKeyPublicByRequestMethod(request, METHOD_GET))) == 0)
+	return NULL;
+    debug(87, 3) ("workerPeerSelect: worker %d has '%s'\n", w, urlCanonical(request));
+    worker_forwarded++;
+    return workerPeer(w);
+}
+
+/* Add the header vouching for request to the worker it is forwarded to */
+void
+workerRequestHeader(request_t * request, HttpHeader * hdr)
+{
+    char buf[WORKER_SECRET_LEN + 32];
+    if (request->client_addr.s_addr != no_addr.s_addr)
+	snprintf(buf, sizeof(buf), "%s %s", worker_index->secret, inet_ntoa(request->client_addr));
+    else
+	xstrncpy(buf, worker_index->secret, sizeof(buf));
+    httpHeaderDelByName(hdr, WORKER_HEADER);
+    httpHeaderPutExt(hdr, WORKER_HEADER, buf);
+}
+
+/*
+ * Whether request, received on the worker port or not, was forwarded
+ * by another worker.  The header is removed, and the address of the
+ * other worker's client put in place of the loopback one.
+ */
+int
+workerRequestCheck(request_t * request, int worker_port)
+{
+    String s;
+    const char *v;
+    struct in_addr addr;
+    int ok = 0;
+    if (!worker_id)
+	return 0;
+    s = httpHeaderGetByName(&request->header, WORKER_HEADER);
+    if (!strBuf(s))
+	return 0;
+    httpHeaderDelByName(&request->header, WORKER_HEADER);
+    v = strBuf(s);
+    if (worker_port && strncmp(v, worker_index->secret, WORKER_SECRET_LEN) == 0) {
+	v += WORKER_SECRET_LEN;
+	if (*v == '\0') {
+	    ok = 1;
+	} else if (*v == ' ' && safe_inet_addr(v + 1, &addr)) {
+	    request->client_addr = addr;
+#if FOLLOW_X_FORWARDED_FOR
+	    request->indirect_client_addr = addr;
+#endif
+	    ok = 1;
+	}
+    }
+    if (!ok)
+	debug(87, 1) ("WARNING: Request from %s with a bad %s header\n",
+	    inet_ntoa(request->client_addr), WORKER_HEADER);
+    stringClean(&s);
+    return ok;
+}
+
+void
+workerSetPort(u_short port)
+{
+    worker_index->worker[worker_id].port = port;
+}
+
+static void
+workerStats(StoreEntry * sentry)
+{
+    int w;
+    storeAppendPrintf(sentry, "This is worker %d of %d, forwarded %d requests to the others\n",
+	worker_id, worker_index->workers, worker_forwarded);
+    storeAppendPrintf(sentry, "Shared cache index: %d entries for each worker\n",
+	worker_index->slots);
+    storeAppendPrintf(sentry, "\n%6s %8s %6s %10s\n", "Worker", "PID", "Port", "Entries");
+    for (w = 1; w <= worker_index->workers; w++)
+	storeAppendPrintf(sentry, "%6d %8d %6d %10d\n", w,
+	    (int) worker_index->worker[w].pid,
+	    (int) worker_index->worker[w].port,
+	    worker_index->worker[w].entries);
+}
+
+/* Shut down should the master process go away */
+static void
+workerCheckMaster(void *unused)
+{
+    if (getppid() != worker_master) {
+	debug(87, 0) ("The master process is gone, shutting down\n");
+	shut_down(SIGTERM);
+	return;
+    }
+    eventAdd("workerCheckMaster", workerCheckMaster, NULL, 1.0, 0);
+}
+
+/* In a worker just forked, configure it as itself */
+static void
+workerStarted(int w)
+{
+    worker_id = w;
+    worker_master = getppid();
+    memset(worker_table[w], 0, worker_index->slots * sizeof(uint64_t));
+    worker_index->worker[w].entries = 0;
+    worker_index->worker[w].port = 0;
+    parseConfigFile(ConfigFile);
+    cachemgrRegister("workers",
+	"SMP Workers",
+	workerStats, 0, 1);
+    eventAdd("workerCheckMaster", workerCheckMaster, NULL, 1.0, 0);
+}
+
+static pid_t
+workerFork(int w)
+{
+    pid_t pid;
+    if ((pid = fork()) < 0) {
+	debug(87, 0) ("workerFork: worker %d: fork: %s\n", w, xstrerror());
+	return -1;
+    }
+    if (pid == 0) {
+	workerStarted(w);
+	return 0;
+    }
+    worker_index->worker[w].pid = pid;
+    debug(87, 1) ("Worker %d started as process %d\n", w, (int) pid);
+    return pid;
+}
+
+static void
+workersSignal(int sig)
+{
+    workers_signal = sig;
+#if !HAVE_SIGACTION
+    signal(sig, workersSignal);
+#endif
+}
+
+/*
+ * Fork the workers.  Returns in each of them, while the process started
+ * stays in here, restarting the workers that fail and passing signals
+ * on to them, until they are all gone.
+ */
+void
+workersStart(void)
+{
+    time_t started[WORKERS_MAX + 1];
+    int failures[WORKERS_MAX + 1];
+    int shutting = 0, failed = 0;
+    int w, sig, status;
+    pid_t pid;
+
+    leave_suid();		/* cache.log is the workers' as well */
+    _db_init(Config.Log.log, Config.debugOptions);
+    enter_suid();
+    workerIndexCreate();
+    for (w = 1; w <= Config.workers; w++) {
+	if (workerFork(w) == 0)
+	    return;
+	started[w] = time(NULL);
+	failures[w] = 0;
+    }
+    squid_signal(SIGHUP, workersSignal, 0);
+    squid_signal(SIGUSR1, workersSignal, 0);
+    squid_signal(SIGUSR2, workersSignal, 0);
+    squid_signal(SIGTERM, workersSignal, 0);
+    squid_signal(SIGINT, workersSignal, 0);
+    comm_select_init();		/* for writePidFile() */
+    writePidFile();
+    for (;;) {
+	if ((sig = workers_signal)) {
+	    workers_signal = 0;
+	    if (sig == SIGTERM || sig == SIGINT)
+		shutting = 1;
+	    for (w = 1; w <= Config.workers; w++)
+		if (worker_index->worker[w].pid > 0)
+		    kill(worker_index->worker[w].pid, sig);
+	}
+	pid = waitpid(-1, &status, WNOHANG);
+	getCurrentTime();
+	if (pid < 0 && errno == ECHILD)
+	    break;
+	if (pid <= 0) {
+	    sleep(1);		/* cut short by a signal */
+	    continue;
+	}
+	for (w = 1; w <= Config.workers; w++)
+	    if (worker_index->worker[w].pid == pid)
+		break;
+	if (w > Config.workers)
+	    continue;
+	worker_index->worker[w].pid = 0;
+	worker_index->worker[w].port = 0;
+	if (WIFEXITED(status)) {
+	    debug(87, 1) ("Worker %d exited with status %d\n", w, WEXITSTATUS(status));
+	    if (shutting || WEXITSTATUS(status) == 0)
+		continue;
+	} else if (WIFSIGNALED(status)) {
+	    debug(87, 0) ("Worker %d exited due to signal %d\n", w, WTERMSIG(status));
+	    if (shutting)
+		continue;
+	}
+	if (time(NULL) - started[w] < 10)
+	    failures[w]++;
+	else
+	    failures[w] = 0;
+	if (failures[w] == 5) {
+	    debug(87, 0) ("Worker %d failed repeatedly, not restarting it\n", w);
+	    failed = 1;
+	    continue;
+	}
+	if (failures[w])
+	    sleep(3);
+	if (workerFork(w) == 0)
+	    return;
+	started[w] = time(NULL);
+    }
+    if (Config.pidFilename && strcmp(Config.pidFilename, "none") != 0) {
+	enter_suid();
+	safeunlink(Config.pidFilename, 0);
+	leave_suid();
+    }
+    debug(87, 1) ("All workers are gone, exiting\n");
+    exit(failed ? 1 : 0);
+}
+
+/*
+ * Worker adjustments to the configuration just parsed: each worker has
+ * its share of the caches, and the first worker alone talks ICP, HTCP
+ * and SNMP.
+ */
+void
+workerConfigure(void)
+{
+    SwapDir *sd;
+    int i;
+    if (Config.workers > WORKERS_MAX)
+	fatalf("workers: at most %d are supported\n", WORKERS_MAX);
+#ifndef SO_REUSEPORT
+    if (Config.workers > 1)
+	fatal("workers: SO_REUSEPORT is not supported on this platform");
+#endif
+    if (!worker_id)
+	return;
+    for (i = 0; i < Config.cacheSwap.n_configured; i++) {
+	sd = &Config.cacheSwap.swapDirs[i];
+	if (strcmp(sd->type, "coss") == 0)
+	    fatalf("workers: cache_dir coss %s can not be shared out\n", sd->path);
+	sd->max_size /= Config.workers;
+    }
+    Config.memMaxSize /= Config.workers;
+    if (worker_id > 1) {
+	Config.Port.icp = 0;
+#if USE_HTCP
+	Config.Port.htcp = 0;
+#endif
+#ifdef SQUID_SNMP
+	Config.Port.snmp = 0;
+#endif
+    }
+}
+
+/* The path of a worker's part of the cache_dir at path */
+char *
+workerSwapDirPath(char *path)
+{
+    LOCAL_ARRAY(char, buf, MAXPATHLEN);
+    if (!worker_id)
+	return path;
+    snprintf(buf, MAXPATHLEN, "%s/worker%d", path, worker_id);
+    return buf;
+}
+
+/* squid -z: create the cache_dirs and every worker's part of them */
+void
+workersCreateSwapDirectories(void)
+{
+    int i, w, n = Config.workers;
+    for (i = 0; i < Config.cacheSwap.n_configured; i++)
+	if (mkdir(Config.cacheSwap.swapDirs[i].path, 0755) < 0 && errno != EEXIST)
+	    debug(87, 0) ("%s: %s\n", Config.cacheSwap.swapDirs[i].path, xstrerror());
+    for (w = 1; w <= n; w++) {
+	worker_id = w;
+	parseConfigFile(ConfigFile);
+	storeCreateSwapDirectories();
+    }
+    worker_id = 0;
+}
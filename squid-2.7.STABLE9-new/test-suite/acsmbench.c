@@ -0,0 +1,123 @@
+/*
+ * $Id$
+ *
+ * Replay a URL corpus through the keyword matcher built with the full
+ * 256-way state table and with the compact layout.  Every URL must get
+ * the same match from both; the time per URL and the resident size of
+ * each layout are reported.
+ *
+ *   acsmbench keywords.txt urls.txt [rounds]
+ *
+ * keywords.txt is in the video_keywords_file format, urls.txt holds one
+ * URL per line.
+ */
+
+#include "squid.h"
+
+int _db_level;
+int debugLevels[MAX_DEBUG_SECTIONS];
+
+void
+_db_print(const char *format,...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static ACSM_STRUCT *
+load(const char *file, int compact)
+{
+    ACSM_STRUCT *acsm;
+    acsm_compact = compact;
+    if ((acsm = acsmLoad(file)) == NULL) {
+	fprintf(stderr, "%s: can not build the automaton\n", file);
+	exit(1);
+    }
+    return acsm;
+}
+
+static double
+replay(ACSM_STRUCT * acsm, char **url, size_t *len, int n, int rounds)
+{
+    double t0 = now();
+    int r, i;
+    uint32_t end;
+    for (r = 0; r < rounds; r++)
+	for (i = 0; i < n; i++)
+	    acsmSearchBest(acsm, (unsigned char *) url[i], len[i], &end);
+    return (now() - t0) / ((double) rounds * n);
+}
+
+int
+main(int argc, char *argv[])
+{
+    ACSM_STRUCT *full, *compact;
+    ACSM_PATTERN *a, *b;
+    uint32_t ea, eb;
+    char **url = NULL;
+    size_t *len = NULL;
+    char line[8192];
+    int n = 0, size = 0, rounds, i, bad = 0;
+    FILE *fp;
+
+    if (argc < 3) {
+	fprintf(stderr, "usage: %s keywords.txt urls.txt [rounds]\n", argv[0]);
+	return 1;
+    }
+    rounds = argc > 3 ? atoi(argv[3]) : 10;
+    if ((fp = fopen(argv[2], "r")) == NULL) {
+	perror(argv[2]);
+	return 1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+	line[strcspn(line, "\r\n")] = '\0';
+	if (n == size) {
+	    size = size ? size * 2 : 1024;
+	    url = xrealloc(url, size * sizeof(*url));
+	    len = xrealloc(len, size * sizeof(*len));
+	}
+	len[n] = strlen(line);
+	url[n++] = xstrdup(line);
+    }
+    fclose(fp);
+    if (n == 0 || rounds < 1) {
+	fprintf(stderr, "%s: no URLs\n", argv[2]);
+	return 1;
+    }
+    full = load(argv[1], 0);
+    compact = load(argv[1], 1);
+    if (!compact->acsmCompact) {
+	fprintf(stderr, "%s: too many states for the compact layout\n", argv[1]);
+	return 1;
+    }
+    for (i = 0; i < n; i++) {
+	ea = eb = 0;
+	a = acsmSearchBest(full, (unsigned char *) url[i], len[i], &ea);
+	b = acsmSearchBest(compact, (unsigned char *) url[i], len[i], &eb);
+	if ((a == NULL) != (b == NULL) || (a && (a->urlflag != b->urlflag || ea != eb ||
+		    strcmp((char *) a->patrn_cap, (char *) b->patrn_cap) != 0))) {
+	    printf("MISMATCH %s: full %s/%u, compact %s/%u\n", url[i],
+		a ? (char *) a->patrn_cap : "-", ea,
+		b ? (char *) b->patrn_cap : "-", eb);
+	    bad++;
+	}
+    }
+    printf("%d URLs, %d states, %d mismatches\n", n, full->acsmNumState + 1, bad);
+    printf("full:    %8.1f ns/URL %10lu bytes\n", replay(full, url, len, n, rounds),
+	(unsigned long) acsmMemSize(full));
+    printf("compact: %8.1f ns/URL %10lu bytes, %u classes\n", replay(compact, url, len, n, rounds),
+	(unsigned long) acsmMemSize(compact), compact->acsmCompact->NumClass);
+    acsmFree(full);
+    acsmFree(compact);
+    return bad ? 1 : 0;
+}
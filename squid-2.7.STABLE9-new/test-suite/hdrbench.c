@@ -0,0 +1,273 @@
+/*
+ * $Id$
+ *
+ * Resolve the field names of captured HTTP header blocks to header ids
+ * with the linear scan over the header table that httpHeaderIdByName()
+ * does and with the perfect hash behind httpHeaderIdByNameDef().  Every
+ * name must get the same id from both; the rate of each is reported,
+ * together with the time httpHeaderParse() takes per block.
+ *
+ *   hdrbench [headers.txt] [rounds]
+ *
+ * headers.txt holds header blocks without their request or status line,
+ * each ended by an empty line.  Without it a typical request and reply
+ * are used.
+ */
+
+#include "squid.h"
+
+void
+_db_print(const char *format,...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+void
+xassert(const char *msg, const char *file, int line)
+{
+    fprintf(stderr, "assertion failed: %s:%d: \"%s\"\n", file, line, msg);
+    abort();
+}
+
+void
+fatalf(const char *fmt,...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    exit(1);
+}
+
+/* not reached from the parser, only linked in by the cache manager reports */
+void
+cachemgrRegister(const char *action, const char *desc, OBJH * handler, int pw_req_flag, int atomic)
+{
+}
+
+void
+storeAppend(StoreEntry * e, const char *buf, int len)
+{
+}
+
+void
+storeAppendPrintf(StoreEntry * e, const char *fmt,...)
+{
+}
+
+void
+storeAppendVPrintf(StoreEntry * e, const char *fmt, va_list ap)
+{
+}
+
+void
+storeBuffer(StoreEntry * e)
+{
+}
+
+void
+storeBufferFlush(StoreEntry * e)
+{
+}
+
+const char *
+storeKeyText(const cache_key * key)
+{
+    return "";
+}
+
+int
+aclCheckFastRequest(const acl_access * A, request_t * request)
+{
+    return 0;
+}
+
+double
+gb_to_double(const gb_t * g)
+{
+    return 0.0;
+}
+
+const char *
+gb_to_str(const gb_t * g)
+{
+    return "";
+}
+
+void
+gb_flush(gb_t * g)
+{
+}
+
+int
+stringHasWhitespace(const char *s)
+{
+    return strpbrk(s, " \t\r\n") != NULL;
+}
+
+static const char *sample =
+"Host: www.example.com\n"
+"User-Agent: Mozilla/5.0 (X11; Linux x86_64)\n"
+"Accept: text/html,application/xhtml+xml\n"
+"Accept-Language: en-US,en;q=0.5\n"
+"Accept-Encoding: gzip, deflate\n"
+"Connection: keep-alive\n"
+"Cookie: a=b\n"
+"If-Modified-Since: Sat, 29 Oct 1994 19:43:31 GMT\n"
+"Cache-Control: max-age=0\n"
+"Upgrade-Insecure-Requests: 1\n"
+"\n"
+"Date: Mon, 01 Jan 2024 00:00:00 GMT\n"
+"Server: Apache\n"
+"Last-Modified: Mon, 01 Jan 2024 00:00:00 GMT\n"
+"ETag: \"abc\"\n"
+"Accept-Ranges: bytes\n"
+"Content-Length: 1234\n"
+"Content-Type: text/html\n"
+"Expires: Tue, 02 Jan 2024 00:00:00 GMT\n"
+"Vary: Accept-Encoding\n"
+"X-Cache: MISS\n"
+"Via: 1.1 proxy\n"
+"Age: 10\n"
+"\n";
+
+static MemBuf *block;
+static int nblock, sblock;
+static const char **name;
+static int *namelen;
+static int nname, sname;
+
+/* one header line: CRLF ended in the block, its name kept for the lookups */
+static void
+addLine(MemBuf * mb, const char *line)
+{
+    size_t len = strcspn(line, "\r\n");
+    const char *c;
+    memBufAppend(mb, line, len);
+    memBufAppend(mb, "\r\n", 2);
+    if (*line == ' ' || *line == '\t' || (c = memchr(line, ':', len)) == NULL)
+	return;
+    if (nname == sname) {
+	sname = sname ? sname * 2 : 256;
+	name = xrealloc(name, sname * sizeof(*name));
+	namelen = xrealloc(namelen, sname * sizeof(*namelen));
+    }
+    namelen[nname] = c - line;
+    name[nname++] = xstrndup(line, c - line + 1);
+}
+
+static MemBuf *
+newBlock(void)
+{
+    if (nblock == sblock) {
+	sblock = sblock ? sblock * 2 : 64;
+	block = xrealloc(block, sblock * sizeof(*block));
+    }
+    memBufDefInit(&block[nblock]);
+    return &block[nblock++];
+}
+
+static void
+addLines(FILE * fp, const char *text)
+{
+    char line[8192];
+    MemBuf *mb = NULL;
+    for (;;) {
+	if (fp) {
+	    if (!fgets(line, sizeof(line), fp))
+		break;
+	} else {
+	    size_t len;
+	    if (!*text)
+		break;
+	    len = strcspn(text, "\n") + 1;
+	    xstrncpy(line, text, len < sizeof(line) ? len : sizeof(line));
+	    text += len;
+	}
+	if (strcspn(line, "\r\n") == 0) {
+	    mb = NULL;
+	    continue;
+	}
+	if (!mb)
+	    mb = newBlock();
+	addLine(mb, line);
+    }
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int
+main(int argc, char *argv[])
+{
+    HttpHeaderFieldAttrs attrs[HDR_ENUM_END];
+    HttpHeaderFieldInfo *linear;
+    HttpHeader hdr;
+    volatile int sink = 0;
+    double t0, tl, th, tp;
+    int rounds, r, i, bad = 0, failed = 0;
+    FILE *fp = NULL;
+
+    if (argc > 1 && (fp = fopen(argv[1], "r")) == NULL) {
+	perror(argv[1]);
+	return 1;
+    }
+    rounds = argc > 2 ? atoi(argv[2]) : 500000;
+    memInit();
+    httpHeaderInitModule();
+    addLines(fp, sample);
+    if (fp)
+	fclose(fp);
+    if (nname == 0 || rounds < 1) {
+	fprintf(stderr, "%s: no header fields\n", argc > 1 ? argv[1] : "sample");
+	return 1;
+    }
+    /* the table the lookups scanned before the hash */
+    for (i = 0; i < HDR_ENUM_END; i++) {
+	attrs[i].name = httpHeaderNameById(i);
+	attrs[i].id = i;
+	attrs[i].type = ftStr;
+    }
+    linear = httpHeaderBuildFieldsInfo(attrs, HDR_ENUM_END);
+    for (i = 0; i < nname; i++) {
+	int a = httpHeaderIdByName(name[i], namelen[i], linear, HDR_ENUM_END);
+	int b = httpHeaderIdByNameDef(name[i], namelen[i]);
+	if (a != b) {
+	    printf("MISMATCH %s: linear %d, hash %d\n", name[i], a, b);
+	    bad++;
+	}
+    }
+    t0 = now();
+    for (r = 0; r < rounds; r++)
+	for (i = 0; i < nname; i++)
+	    sink += httpHeaderIdByName(name[i], namelen[i], linear, HDR_ENUM_END);
+    tl = (now() - t0) / ((double) rounds * nname);
+    t0 = now();
+    for (r = 0; r < rounds; r++)
+	for (i = 0; i < nname; i++)
+	    sink += httpHeaderIdByNameDef(name[i], namelen[i]);
+    th = (now() - t0) / ((double) rounds * nname);
+    t0 = now();
+    for (r = 0; r < rounds / 10 + 1; r++)
+	for (i = 0; i < nblock; i++) {
+	    httpHeaderInit(&hdr, hoRequest);
+	    if (!httpHeaderParse(&hdr, block[i].buf, block[i].buf + block[i].size))
+		failed++;
+	    httpHeaderClean(&hdr);
+	}
+    tp = (now() - t0) / ((double) (rounds / 10 + 1) * nblock);
+    printf("%d blocks, %d field names, %d mismatches, %d blocks not parsed\n", nblock, nname, bad, failed);
+    printf("linear: %6.1f ns/name %6.1f M names/s\n", tl, 1e3 / tl);
+    printf("hash:   %6.1f ns/name %6.1f M names/s\n", th, 1e3 / th);
+    printf("parse:  %6.1f ns/block\n", tp);
+    httpHeaderDestroyFieldsInfo(linear, HDR_ENUM_END);
+    return bad || failed ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+#!/bin/sh
+#
+# $Id$
+#
+# Disk hit benchmark for the cache_dir I/O paths: fills a cache_dir with
+# objects from a local origin server, then fetches them again and again
+# as disk hits (cache_mem is too small to hold them) and reports the
+# fetch rate, the disk reads per second aufs made and the CPU time Squid
+# and its helpers used per GB served.
+#
+#   store-io-bench.sh [-n objects] [-s KB] [-r rounds] [-p parallel]
+#                     [-P port] squid-binary cache_dir-type
+#
+# Compare the aufs thread pool, the aufs io_uring engine and diskd with
+# one build configured --with-aufs-io-uring and one without:
+#
+#   sh store-io-bench.sh threads/src/squid aufs
+#   sh store-io-bench.sh uring/src/squid aufs
+#   sh store-io-bench.sh threads/src/squid diskd
+#
+# Needs python3 (the origin server), curl and awk.  squidclient and the
+# diskd daemon are looked for next to the squid binary in the build tree;
+# set SQUIDCLIENT and DISKD to override.
+
+N=400
+SIZE=128
+ROUNDS=5
+PAR=16
+PORT=31380
+while getopts n:s:r:p:P: c; do
+	case $c in
+	n) N=$OPTARG ;;
+	s) SIZE=$OPTARG ;;
+	r) ROUNDS=$OPTARG ;;
+	p) PAR=$OPTARG ;;
+	P) PORT=$OPTARG ;;
+	*) sed -n '11,12p' $0; exit 1 ;;
+	esac
+done
+shift `expr $OPTIND - 1`
+if [ $# -ne 2 ]; then
+	sed -n '11,12p' $0
+	exit 1
+fi
+SQUID=`cd \`dirname $1\` && pwd`/`basename $1`
+TYPE=$2
+BIN=`dirname $SQUID`
+TOP=`cd \`dirname $0\`/.. && pwd`
+SQUIDCLIENT=${SQUIDCLIENT:-$BIN/../tools/squidclient}
+DISKD=${DISKD:-$BIN/fs/diskd-daemon}
+OPORT=`expr $PORT + 1`
+
+W=`mktemp -d /tmp/store-io-bench.XXXXXX` || exit 1
+SQUID_PID=
+ORIGIN_PID=
+cleanup() {
+	[ -n "$SQUID_PID" ] && kill -9 $SQUID_PID `pgrep -P $SQUID_PID` 2>/dev/null
+	[ -n "$ORIGIN_PID" ] && kill $ORIGIN_PID 2>/dev/null
+	rm -rf $W
+}
+trap cleanup 0
+trap 'exit 1' 1 2 15
+
+mkdir $W/www $W/cache $W/logs $W/icons
+# copies, for cache_effective_user to read
+cp -r $TOP/errors/English $W/errors
+cp $TOP/icons/*.gif $W/icons
+cp $TOP/src/mime.conf.default $W/mime.conf
+i=1
+while [ $i -le $N ]; do
+	head -c `expr $SIZE \* 1024` /dev/urandom > $W/www/f$i.bin
+	i=`expr $i + 1`
+done
+
+cat > $W/squid.conf <<EOF
+http_port 127.0.0.1:$PORT
+icp_port 0
+cache_dir $TYPE $W/cache 1000 16 256
+cache_mem 1 MB
+maximum_object_size_in_memory 8 KB
+client_sendfile off
+diskd_program $DISKD
+unlinkd_program $BIN/unlinkd
+logfile_daemon $BIN/logfile-daemon
+access_log none
+cache_store_log none
+cache_log $W/logs/cache.log
+pid_filename $W/squid.pid
+mime_table $W/mime.conf
+icon_directory $W/icons
+error_directory $W/errors
+visible_hostname store-io-bench
+acl all src 0.0.0.0/0.0.0.0
+http_access allow all
+refresh_pattern . 1000 100% 10000 override-expire ignore-reload
+debug_options ALL,1
+EOF
+if [ `id -u` -eq 0 ]; then
+	echo "cache_effective_user nobody" >> $W/squid.conf
+	chown -R nobody $W
+fi
+
+(cd $W/www && exec python3 -m http.server --bind 127.0.0.1 $OPORT) >/dev/null 2>&1 &
+ORIGIN_PID=$!
+$SQUID -f $W/squid.conf -z >/dev/null 2>&1
+$SQUID -f $W/squid.conf -N -D >/dev/null 2>&1 &
+SQUID_PID=$!
+sleep 3
+if ! kill -0 $SQUID_PID 2>/dev/null; then
+	echo "squid did not start:"
+	tail $W/logs/cache.log
+	exit 1
+fi
+
+# fetch every object $1 times: $PAR curls, each getting its share of them
+# one after another over a single persistent connection, so that the
+# client costs little next to Squid
+fetch() {
+	pids=
+	i=0
+	while [ $i -lt $PAR ]; do
+		awk -v r=$1 -v n=$N -v par=$PAR -v k=$i -v o=$OPORT 'BEGIN {
+			for (j = 0; j < r; j++)
+				for (f = 1 + k; f <= n; f += par)
+					printf "url = \"http://127.0.0.1:%d/f%d.bin\"\noutput = \"/dev/null\"\n", o, f
+		}' | curl -s -x http://127.0.0.1:$PORT -K - &
+		pids="$pids $!"
+		i=`expr $i + 1`
+	done
+	wait $pids
+}
+# CPU time in ticks of squid and its helpers (diskd, unlinkd)
+cpu() {
+	for p in $SQUID_PID `pgrep -P $SQUID_PID`; do
+		awk '{print $14 + $15}' /proc/$p/stat
+	done | awk '{s += $1} END {print s}'
+}
+reads() {
+	$SQUIDCLIENT -h 127.0.0.1 -p $PORT mgr:squidaio_counts 2>/dev/null | awk '$1 == "read" {print $2}'
+}
+
+fetch 1
+sleep 2
+c0=`cpu`; t0=`date +%s.%N`
+[ $TYPE = aufs ] && r0=`reads`
+fetch $ROUNDS
+t1=`date +%s.%N`; c1=`cpu`
+[ $TYPE = aufs ] && r1=`reads`
+hits=`$SQUIDCLIENT -h 127.0.0.1 -p $PORT mgr:counters | awk -F' = ' '$1 == "client_http.hits" {print $2}'`
+
+python3 - $TYPE $SQUID $N $ROUNDS $SIZE $t0 $t1 $c0 $c1 `getconf CLK_TCK` ${hits:-0} ${r0:--} ${r1:--} <<'EOF'
+import sys
+type, squid, n, rounds, size, t0, t1, c0, c1, hz, hits, r0, r1 = sys.argv[1:]
+fetches = int(n) * int(rounds)
+t = float(t1) - float(t0)
+cpu = (float(c1) - float(c0)) / int(hz)
+gb = fetches * int(size) / 1048576.0
+iops = "%.0f" % ((int(r1) - int(r0)) / t) if r0 != "-" else "-"
+print("%s %s: %d fetches of %s KB in %.2f s, %.0f/s, %s reads/s, %.2f s CPU per GB, %s hits"
+      % (type, squid, fetches, size, t, fetches / t, iops, cpu / gb, hits))
+EOF